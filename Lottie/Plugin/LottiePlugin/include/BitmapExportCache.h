@@ -0,0 +1,289 @@
+/*************************************************************************
+* ADOBE CONFIDENTIAL
+* ___________________
+*
+*  Copyright 2018 Adobe Systems Incorporated
+*  All Rights Reserved.
+*
+* NOTICE:  All information contained herein is, and remains
+* the property of Adobe Systems Incorporated and its suppliers,
+* if any.  The intellectual and technical concepts contained
+* herein are proprietary to Adobe Systems Incorporated and its
+* suppliers and are protected by all applicable intellectual property
+* laws, including trade secret and copyright laws.
+* Dissemination of this information or reproduction of this material
+* is strictly forbidden unless prior written permission is obtained
+* from Adobe Systems Incorporated.
+**************************************************************************/
+
+/**
+ * @file  BitmapExportCache.h
+ *
+ * @brief This file contains the cache of the bitmaps encoded into the image
+ *        folder of the output.
+ */
+
+#ifndef BITMAP_EXPORT_CACHE_H_
+#define BITMAP_EXPORT_CACHE_H_
+
+#include "FCMTypes.h"
+#include "Utils.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+/* -------------------------------------------------- Macros / Constants */
+
+// Manifest of the encoded images, kept in the image folder
+#define BITMAP_CACHE_FILE_NAME  ".imagecache"
+
+#define BITMAP_CACHE_READ_SIZE  (64 * 1024)
+
+/* -------------------------------------------------- Structs / Unions */
+
+namespace LottieExporter
+{
+    struct BITMAP_CACHE_ENTRY
+    {
+        std::string name;       // file name in the image folder
+        std::uint64_t hash;     // hash of the encoded file
+        FCM::Boolean used;      // referenced by the current publish
+    };
+};
+
+/* -------------------------------------------------- Class Decl */
+
+namespace LottieExporter
+{
+    // Remembers which library bitmaps have been encoded into the image folder.
+    //
+    // Entries are keyed by the identity of the media item (library path and
+    // size) and hold a hash of the encoded pixels. An entry left by an earlier
+    // publish is only reused if the file on disk still has that hash. Within a
+    // publish, items encoding to the same bytes share one file.
+    class BitmapExportCache
+    {
+    public:
+
+        BitmapExportCache() : m_pCallback(NULL), m_persistent(false)
+        {
+        }
+
+        // Reads the manifest of a previous publish to the same folder. With
+        // persistent off, only the current publish is cached. The key does
+        // not see edits that keep the name and size, so persistence is left
+        // to the user.
+        void Load(const std::string& folder, FCM::Boolean persistent, FCM::PIFCMCallback pCallback)
+        {
+            std::fstream file;
+            std::string line;
+
+            m_folder = folder;
+            m_persistent = persistent;
+            m_pCallback = pCallback;
+            m_entries.clear();
+            m_contents.clear();
+            m_names.clear();
+
+            if (!m_persistent)
+                return;
+
+            Utils::OpenFStream(m_folder + "/" + BITMAP_CACHE_FILE_NAME, file, std::ios_base::in | std::ios_base::binary, m_pCallback);
+            if (!file)
+                return;
+
+            // key \t hash \t name; the key (library path) may itself hold tabs
+            while (std::getline(file, line))
+            {
+                size_t nameSep = line.rfind('\t');
+                if (nameSep == std::string::npos || nameSep == 0)
+                    continue;
+                size_t hashSep = line.rfind('\t', nameSep - 1);
+                if (hashSep == std::string::npos)
+                    continue;
+
+                BITMAP_CACHE_ENTRY entry;
+                entry.hash = strtoull(line.substr(hashSep + 1, nameSep - hashSep - 1).c_str(), NULL, 16);
+                entry.name = line.substr(nameSep + 1);
+                entry.used = false;
+                if (entry.name.empty())
+                    continue;
+
+                m_entries[line.substr(0, hashSep)] = entry;
+                m_names.insert(entry.name);
+            }
+        }
+
+        // Name of the file already holding the item, if any
+        FCM::Boolean Lookup(const std::string& key, std::string& name)
+        {
+            std::map<std::string, BITMAP_CACHE_ENTRY>::iterator it = m_entries.find(key);
+            if (it == m_entries.end())
+                return false;
+
+            BITMAP_CACHE_ENTRY& entry = it->second;
+            if (!entry.used)
+            {
+                // Left by a previous publish: the file may have been edited
+                // or deleted since.
+                std::uint64_t hash;
+                if (!HashFile(entry.name, hash) || hash != entry.hash)
+                {
+                    m_entries.erase(it);
+                    return false;
+                }
+                entry.used = true;
+                m_contents.insert(std::make_pair(entry.hash, entry.name));
+            }
+
+            name = entry.name;
+            return true;
+        }
+
+        // Name of a file of the current publish with the same content
+        FCM::Boolean FindContent(std::uint64_t hash, std::string& name) const
+        {
+            std::map<std::uint64_t, std::string>::const_iterator it = m_contents.find(hash);
+            if (it == m_contents.end())
+                return false;
+
+            name = it->second;
+            return true;
+        }
+
+        // Files listed in the manifest are not overwritten by new items
+        FCM::Boolean IsNameTaken(const std::string& name) const
+        {
+            return m_names.find(name) != m_names.end();
+        }
+
+        void Add(const std::string& key, const std::string& name, std::uint64_t hash)
+        {
+            BITMAP_CACHE_ENTRY entry;
+            entry.name = name;
+            entry.hash = hash;
+            entry.used = true;
+
+            m_entries[key] = entry;
+            m_names.insert(name);
+            m_contents.insert(std::make_pair(hash, name));
+        }
+
+        // Writes the entries used by the current publish
+        void Save()
+        {
+            std::fstream file;
+            char hash[32];
+
+            if (!m_persistent || m_contents.empty())
+                return;
+
+            Utils::OpenFStream(m_folder + "/" + BITMAP_CACHE_FILE_NAME, file, std::ios_base::trunc | std::ios_base::out | std::ios_base::binary, m_pCallback);
+            if (!file)
+            {
+                Utils::Trace(m_pCallback, "Image cache (%s) could not be written\n", m_folder.c_str());
+                return;
+            }
+
+            for (std::map<std::string, BITMAP_CACHE_ENTRY>::const_iterator it = m_entries.begin(); it != m_entries.end(); ++it)
+            {
+                if (!it->second.used)
+                    continue;
+
+                snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)it->second.hash);
+                file << it->first << '\t' << hash << '\t' << it->second.name << '\n';
+            }
+            file.close();
+        }
+
+        // Hash of a file of the image folder
+        FCM::Boolean HashFile(const std::string& name, std::uint64_t& hash) const
+        {
+            std::fstream file;
+
+            Utils::OpenFStream(m_folder + "/" + name, file, std::ios_base::in | std::ios_base::binary, m_pCallback);
+            if (!file)
+                return false;
+
+            HashStream(file, hash);
+            return true;
+        }
+
+        // True if two files of the image folder have the same bytes; a
+        // matching hash only makes them candidates
+        FCM::Boolean IsSameFile(const std::string& name, const std::string& other) const
+        {
+            std::fstream file;
+            std::fstream otherFile;
+
+            Utils::OpenFStream(m_folder + "/" + name, file, std::ios_base::in | std::ios_base::binary, m_pCallback);
+            Utils::OpenFStream(m_folder + "/" + other, otherFile, std::ios_base::in | std::ios_base::binary, m_pCallback);
+            if (!file || !otherFile)
+                return false;
+
+            file.seekg(0, std::ios_base::end);
+            otherFile.seekg(0, std::ios_base::end);
+            if (file.tellg() != otherFile.tellg())
+                return false;
+            file.seekg(0, std::ios_base::beg);
+            otherFile.seekg(0, std::ios_base::beg);
+
+            std::vector<char> buffer(BITMAP_CACHE_READ_SIZE);
+            std::vector<char> otherBuffer(BITMAP_CACHE_READ_SIZE);
+            while (file && otherFile)
+            {
+                file.read(&buffer[0], buffer.size());
+                otherFile.read(&otherBuffer[0], otherBuffer.size());
+                std::streamsize count = file.gcount();
+                if (count != otherFile.gcount() || memcmp(&buffer[0], &otherBuffer[0], (size_t)count) != 0)
+                    return false;
+            }
+            return true;
+        }
+
+        // 64-bit FNV-1a of the rest of a stream. Does not use the callback,
+        // so it can run on any thread.
+        static void HashStream(std::istream& in, std::uint64_t& hash)
+        {
+            std::vector<char> buffer(BITMAP_CACHE_READ_SIZE);
+
+            hash = 14695981039346656037ULL;
+            while (in)
+            {
+                in.read(&buffer[0], buffer.size());
+                std::streamsize count = in.gcount();
+                for (std::streamsize i = 0; i < count; i++)
+                {
+                    hash ^= (unsigned char)buffer[i];
+                    hash *= 1099511628211ULL;
+                }
+            }
+        }
+
+    private:
+
+        std::string m_folder;
+
+        FCM::PIFCMCallback m_pCallback;
+
+        FCM::Boolean m_persistent;
+
+        // Media item key -> encoded file
+        std::map<std::string, BITMAP_CACHE_ENTRY> m_entries;
+
+        // Content hash -> file, for the files of the current publish
+        std::map<std::uint64_t, std::string> m_contents;
+
+        // Every file name listed in the manifest
+        std::set<std::string> m_names;
+    };
+};
+
+#endif // BITMAP_EXPORT_CACHE_H_
@@ -0,0 +1,174 @@
+/*************************************************************************
+* ADOBE CONFIDENTIAL
+* ___________________
+*
+*  Copyright 2018 Adobe Systems Incorporated
+*  All Rights Reserved.
+*
+* NOTICE:  All information contained herein is, and remains
+* the property of Adobe Systems Incorporated and its suppliers,
+* if any.  The intellectual and technical concepts contained
+* herein are proprietary to Adobe Systems Incorporated and its
+* suppliers and are protected by all applicable intellectual property
+* laws, including trade secret and copyright laws.
+* Dissemination of this information or reproduction of this material
+* is strictly forbidden unless prior written permission is obtained
+* from Adobe Systems Incorporated.
+**************************************************************************/
+
+/**
+ * @file  ExportWorkerPool.h
+ *
+ * @brief This file contains a small, bounded pool of threads running the
+ *        export of assets (images, sounds) in the background.
+ */
+
+#ifndef EXPORT_WORKER_POOL_H_
+#define EXPORT_WORKER_POOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* -------------------------------------------------- Macros / Constants */
+
+// Upper bound of worker threads, whatever the number of cores
+#define EXPORT_MAX_THREADS      4
+
+// Jobs waiting for a worker; Enqueue blocks beyond this
+#define EXPORT_QUEUE_SIZE       32
+
+/* -------------------------------------------------- Class Decl */
+
+namespace LottieExporter
+{
+    class ExportWorkerPool
+    {
+    public:
+
+        typedef std::function<void()> Job;
+
+        ExportWorkerPool() : m_numThreads(0), m_running(0), m_stop(false)
+        {
+        }
+
+        ~ExportWorkerPool()
+        {
+            Stop();
+        }
+
+        // Number of workers started by the first Enqueue. With 0, jobs run
+        // on the calling thread.
+        void SetNumThreads(unsigned int numThreads)
+        {
+            m_numThreads = (numThreads > EXPORT_MAX_THREADS) ? EXPORT_MAX_THREADS : numThreads;
+        }
+
+        // Default: one core is left to the timeline traversal
+        static unsigned int GetDefaultNumThreads()
+        {
+            unsigned int cores = std::thread::hardware_concurrency();
+            return (cores > 1) ? cores - 1 : 0;
+        }
+
+        void Enqueue(const Job& job)
+        {
+            if (m_numThreads == 0)
+            {
+                job();
+                return;
+            }
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+
+            if (m_threads.empty())
+            {
+                for (unsigned int i = 0; i < m_numThreads; i++)
+                {
+                    m_threads.push_back(std::thread(&ExportWorkerPool::Work, this));
+                }
+            }
+
+            m_spaceAvailable.wait(lock, [this] { return m_jobs.size() < EXPORT_QUEUE_SIZE; });
+            m_jobs.push_back(job);
+            m_jobAvailable.notify_one();
+        }
+
+        // Waits until every job enqueued so far has run
+        void Join()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_idle.wait(lock, [this] { return m_jobs.empty() && m_running == 0; });
+        }
+
+    private:
+
+        void Stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_jobAvailable.notify_all();
+
+            for (size_t i = 0; i < m_threads.size(); i++)
+            {
+                m_threads[i].join();
+            }
+            m_threads.clear();
+        }
+
+        void Work()
+        {
+            for (;;)
+            {
+                Job job;
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_jobAvailable.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+                    if (m_jobs.empty())
+                        return;
+
+                    job = m_jobs.front();
+                    m_jobs.pop_front();
+                    m_running++;
+                }
+                m_spaceAvailable.notify_one();
+
+                job();
+
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_running--;
+                    if (m_jobs.empty() && m_running == 0)
+                        m_idle.notify_all();
+                }
+            }
+        }
+
+    private:
+
+        unsigned int m_numThreads;
+
+        std::vector<std::thread> m_threads;
+
+        std::deque<Job> m_jobs;
+
+        unsigned int m_running;
+
+        bool m_stop;
+
+        std::mutex m_mutex;
+
+        std::condition_variable m_jobAvailable;
+
+        std::condition_variable m_spaceAvailable;
+
+        std::condition_variable m_idle;
+    };
+};
+
+#endif // EXPORT_WORKER_POOL_H_
@@ -53,6 +53,10 @@ namespace LottieExporter
     {
     public:
 
+        // The publisher deletes the writer through this interface; the
+        // writer joins its background threads when destroyed
+        virtual ~IOutputWriter() {}
+
         // Marks the begining of the output
         virtual FCM::Result StartOutput(std::string& outputFileName) = 0;
 
@@ -0,0 +1,120 @@
+/*************************************************************************
+* ADOBE CONFIDENTIAL
+* ___________________
+*
+*  Copyright 2018 Adobe Systems Incorporated
+*  All Rights Reserved.
+*
+* NOTICE:  All information contained herein is, and remains
+* the property of Adobe Systems Incorporated and its suppliers,
+* if any.  The intellectual and technical concepts contained
+* herein are proprietary to Adobe Systems Incorporated and its
+* suppliers and are protected by all applicable intellectual property
+* laws, including trade secret and copyright laws.
+* Dissemination of this information or reproduction of this material
+* is strictly forbidden unless prior written permission is obtained
+* from Adobe Systems Incorporated.
+**************************************************************************/
+
+/**
+ * @file  IdTable.h
+ *
+ * @brief This file contains a table of values indexed directly by object or
+ *        resource id.
+ */
+
+#ifndef ID_TABLE_H_
+#define ID_TABLE_H_
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+/* -------------------------------------------------- Macros / Constants */
+
+// Smallest id accepted; -1 is the object id of the root null layer
+#define ID_TABLE_MIN_ID     -1
+
+/* -------------------------------------------------- Class Decl */
+
+namespace LottieExporter
+{
+    // Object and resource ids handed out by Animate are small and dense, so
+    // they index a vector directly: lookups are O(1) and never insert.
+    // Iterating from MinId() to EndId() visits the ids in increasing order,
+    // like a std::map would.
+    template <typename T>
+    class IdTable
+    {
+    public:
+
+        // Entry of an id, default constructed if it was not there yet. An
+        // id below ID_TABLE_MIN_ID is refused: it gets a scratch entry that
+        // no lookup finds.
+        T& Insert(int id)
+        {
+            assert(id >= ID_TABLE_MIN_ID);
+            if (id < ID_TABLE_MIN_ID)
+            {
+                m_invalid = T();
+                return m_invalid;
+            }
+
+            size_t index = Index(id);
+            if (index >= m_values.size())
+            {
+                m_values.resize(index + 1);
+                m_present.resize(index + 1, false);
+            }
+            m_present[index] = true;
+            return m_values[index];
+        }
+
+        // NULL if the id has no entry
+        T* Find(int id)
+        {
+            size_t index = Index(id);
+            return (id >= ID_TABLE_MIN_ID && index < m_values.size() && m_present[index]) ? &m_values[index] : NULL;
+        }
+
+        const T* Find(int id) const
+        {
+            size_t index = Index(id);
+            return (id >= ID_TABLE_MIN_ID && index < m_values.size() && m_present[index]) ? &m_values[index] : NULL;
+        }
+
+        int MinId() const
+        {
+            return ID_TABLE_MIN_ID;
+        }
+
+        // One past the largest id
+        int EndId() const
+        {
+            return (int)m_values.size() + ID_TABLE_MIN_ID;
+        }
+
+        void Clear()
+        {
+            m_values.clear();
+            m_present.clear();
+        }
+
+    private:
+
+        static size_t Index(int id)
+        {
+            return (size_t)((long long)id - ID_TABLE_MIN_ID);
+        }
+
+    private:
+
+        std::vector<T> m_values;
+
+        std::vector<bool> m_present;
+
+        T m_invalid;
+    };
+};
+
+#endif // ID_TABLE_H_
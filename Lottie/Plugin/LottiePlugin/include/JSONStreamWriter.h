@@ -0,0 +1,353 @@
+/*************************************************************************
+* ADOBE CONFIDENTIAL
+* ___________________
+*
+*  Copyright 2018 Adobe Systems Incorporated
+*  All Rights Reserved.
+*
+* NOTICE:  All information contained herein is, and remains
+* the property of Adobe Systems Incorporated and its suppliers,
+* if any.  The intellectual and technical concepts contained
+* herein are proprietary to Adobe Systems Incorporated and its
+* suppliers and are protected by all applicable intellectual property
+* laws, including trade secret and copyright laws.
+* Dissemination of this information or reproduction of this material
+* is strictly forbidden unless prior written permission is obtained
+* from Adobe Systems Incorporated.
+**************************************************************************/
+
+/**
+ * @file  JSONStreamWriter.h
+ *
+ * @brief This file contains a buffered, single pass writer for compact JSON.
+ */
+
+#ifndef JSON_STREAM_WRITER_H_
+#define JSON_STREAM_WRITER_H_
+
+#include <cstdio>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "NumberFormatter.h"
+
+/* -------------------------------------------------- Macros / Constants */
+
+#define JSON_STREAM_BUFFER_SIZE (64 * 1024)
+
+/* -------------------------------------------------- Class Decl */
+
+namespace LottieExporter
+{
+    // Emits compact JSON straight to an output stream. Values are written as
+    // soon as they are produced, so memory use is bounded by the write buffer
+    // and not by the size of the document. Separators are tracked per nesting
+    // level; callers only open/close scopes and write keys and values.
+    class JSONStreamWriter
+    {
+    public:
+
+        JSONStreamWriter(std::ostream& out, size_t bufferSize = JSON_STREAM_BUFFER_SIZE) :
+            m_out(out),
+            m_buffer(bufferSize > 0 ? bufferSize : 1),
+            m_used(0),
+            m_afterKey(false),
+            m_omitDefaults(false),
+            m_omitMetadata(false),
+            m_numberClass(NUMBER_CLASS_DEFAULT)
+        {
+            for (int c = 0; c < NUMBER_CLASS_COUNT; c++)
+                m_precision[c] = NumberFormatter::DefaultPrecision((NumberClass)c);
+        }
+
+        ~JSONStreamWriter()
+        {
+            Flush();
+        }
+
+        // Objects and arrays. Pass a name to open the scope as a member of
+        // the enclosing object.
+        void StartObject(const char* name = NULL)
+        {
+            if (name)
+                WriteKey(name);
+            BeginValue();
+            Put('{');
+            m_first.push_back(true);
+        }
+
+        void EndObject()
+        {
+            m_first.pop_back();
+            Put('}');
+        }
+
+        void StartArray(const char* name = NULL)
+        {
+            if (name)
+                WriteKey(name);
+            BeginValue();
+            Put('[');
+            m_first.push_back(true);
+        }
+
+        void EndArray()
+        {
+            m_first.pop_back();
+            Put(']');
+        }
+
+        void WriteKey(const char* name)
+        {
+            BeginValue();
+            WriteString(name, strlen(name));
+            Put(':');
+            m_afterKey = true;
+        }
+
+        // Array elements (or the value following WriteKey)
+        void WriteValue(bool value)
+        {
+            BeginValue();
+            if (value)
+                Put("true", 4);
+            else
+                Put("false", 5);
+        }
+
+        void WriteValue(int value) { WriteValue((long long)value); }
+        void WriteValue(unsigned int value) { WriteValue((unsigned long long)value); }
+        void WriteValue(long value) { WriteValue((long long)value); }
+        void WriteValue(unsigned long value) { WriteValue((unsigned long long)value); }
+
+        void WriteValue(long long value)
+        {
+            char num[32];
+            BeginValue();
+            Put(num, snprintf(num, sizeof(num), "%lld", value));
+        }
+
+        void WriteValue(unsigned long long value)
+        {
+            char num[32];
+            BeginValue();
+            Put(num, snprintf(num, sizeof(num), "%llu", value));
+        }
+
+        // Every number of the document comes from the single precision
+        // values of the DOM, so the shortest text is the one of the float
+        void WriteValue(float value) { WriteValue((double)value); }
+
+        void WriteValue(double value)
+        {
+            char num[NUMBER_FORMAT_BUFFER_SIZE];
+            BeginValue();
+            Put(num, NumberFormatter::Format(value, m_precision[m_numberClass], true, num));
+        }
+
+        void WriteValue(const char* value)
+        {
+            BeginValue();
+            WriteString(value, strlen(value));
+        }
+
+        void WriteValue(const std::string& value)
+        {
+            BeginValue();
+            WriteString(value.c_str(), value.length());
+        }
+
+        // Object members
+        template <typename T>
+        void WriteProperty(const char* name, const T& value)
+        {
+            WriteKey(name);
+            WriteValue(value);
+        }
+
+        // A member the format gives a default to, left out when it has that
+        // value and defaults are omitted
+        template <typename T, typename D>
+        void WriteOptional(const char* name, const T& value, const D& defaultValue)
+        {
+            if (!m_omitDefaults || !(value == defaultValue))
+                WriteProperty(name, value);
+        }
+
+        // A member only editors use (names, match names, property indices),
+        // left out when metadata is omitted
+        template <typename T>
+        void WriteMetadata(const char* name, const T& value)
+        {
+            if (!m_omitMetadata)
+                WriteProperty(name, value);
+        }
+
+        void SetOmitDefaults(bool omit) { m_omitDefaults = omit; }
+        void SetOmitMetadata(bool omit) { m_omitMetadata = omit; }
+        bool OmitsDefaults() const { return m_omitDefaults; }
+
+        // Decimals kept for the numbers of a class, negative for the
+        // shortest text. Numbers are written with the precision of the
+        // current class (see NumberClassScope).
+        void SetPrecision(NumberClass numberClass, int decimals) { m_precision[numberClass] = decimals; }
+
+        NumberClass SetNumberClass(NumberClass numberClass)
+        {
+            NumberClass previous = m_numberClass;
+            m_numberClass = numberClass;
+            return previous;
+        }
+
+        // Output of another writer: an array element or, when it is a
+        // "key":value pair, an object member. Written as is.
+        void WriteRaw(const std::string& json)
+        {
+            BeginValue();
+            Put(json.c_str(), json.length());
+        }
+
+        void Flush()
+        {
+            Drain();
+            m_out.flush();
+        }
+
+    private:
+
+        // Hands the buffered bytes to the stream
+        void Drain()
+        {
+            if (m_used > 0)
+            {
+                m_out.write(&m_buffer[0], m_used);
+                m_used = 0;
+            }
+        }
+
+        void BeginValue()
+        {
+            if (m_afterKey)
+            {
+                m_afterKey = false;
+                return;
+            }
+
+            if (!m_first.empty())
+            {
+                if (m_first.back())
+                    m_first.back() = false;
+                else
+                    Put(',');
+            }
+        }
+
+        void WriteString(const char* str, size_t len)
+        {
+            static const char hex[] = "0123456789abcdef";
+
+            Put('"');
+            for (size_t i = 0; i < len; i++)
+            {
+                unsigned char ch = (unsigned char)str[i];
+                switch (ch)
+                {
+                    case '"':  Put("\\\"", 2); break;
+                    case '\\': Put("\\\\", 2); break;
+                    case '\b': Put("\\b", 2); break;
+                    case '\f': Put("\\f", 2); break;
+                    case '\n': Put("\\n", 2); break;
+                    case '\r': Put("\\r", 2); break;
+                    case '\t': Put("\\t", 2); break;
+                    default:
+                        if (ch < 0x20)
+                        {
+                            char esc[6] = { '\\', 'u', '0', '0', hex[ch >> 4], hex[ch & 0xF] };
+                            Put(esc, 6);
+                        }
+                        else
+                        {
+                            Put((char)ch);
+                        }
+                        break;
+                }
+            }
+            Put('"');
+        }
+
+        void Put(char ch)
+        {
+            if (m_used == m_buffer.size())
+            {
+                Drain();
+            }
+            m_buffer[m_used++] = ch;
+        }
+
+        void Put(const char* str, size_t len)
+        {
+            while (len > 0)
+            {
+                if (m_used == m_buffer.size())
+                {
+                    Drain();
+                }
+                size_t chunk = m_buffer.size() - m_used;
+                if (chunk > len)
+                    chunk = len;
+                memcpy(&m_buffer[m_used], str, chunk);
+                m_used += chunk;
+                str += chunk;
+                len -= chunk;
+            }
+        }
+
+    private:
+
+        std::ostream& m_out;
+
+        std::vector<char> m_buffer;
+
+        size_t m_used;
+
+        // One entry per open object/array: true until the first member
+        std::vector<bool> m_first;
+
+        bool m_afterKey;
+
+        bool m_omitDefaults;
+
+        bool m_omitMetadata;
+
+        int m_precision[NUMBER_CLASS_COUNT];
+
+        NumberClass m_numberClass;
+    };
+
+
+    // Writes the numbers of a block with the precision of a class
+    class NumberClassScope
+    {
+    public:
+
+        NumberClassScope(JSONStreamWriter& writer, NumberClass numberClass) :
+            m_writer(writer),
+            m_previous(writer.SetNumberClass(numberClass))
+        {
+        }
+
+        ~NumberClassScope()
+        {
+            m_writer.SetNumberClass(m_previous);
+        }
+
+    private:
+
+        JSONStreamWriter& m_writer;
+
+        NumberClass m_previous;
+    };
+};
+
+#endif // JSON_STREAM_WRITER_H_
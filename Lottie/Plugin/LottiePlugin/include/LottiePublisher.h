@@ -18,6 +18,7 @@
 #ifndef PUBLISHER_H_
 #define PUBLISHER_H_
 
+#include <map>
 #include <vector>
 
 #include "Version.h"
@@ -34,6 +35,9 @@
 #include "FrameElement/ITextStyle.h"
 #include "Exporter/Service/IFrameCommandGenerator.h"
 #include "OutputWriter.h"
+#include "MatrixDecomposition.h"
+#include "PathSimplifier.h"
+#include "ShapeRecognizer.h"
 #include "PluginConfiguration.h"
 
 /* -------------------------------------------------- Forward Decl */
@@ -53,6 +57,7 @@ namespace Application
 namespace LottieExporter
 {
 	class CPublisher;
+	class PublishBenchmark;
 	class ResourcePalette;
 	class TimelineBuilder;
 	class TimelineBuilderFactory;
@@ -85,6 +90,81 @@ namespace DOM
 
 #define MAX_RETRY_ATTEMPT               10
 
+// Publish setting that additionally writes the CreateJS style JSON tree
+// (<output>.legacy.json). Meant for debugging only.
+#define PUBLISH_SETTINGS_KEY_LEGACY_JSON    "legacy_json"
+
+// Publish setting overriding the error allowed when reducing transform
+// keyframes. A negative value keeps every sampled keyframe.
+#define PUBLISH_SETTINGS_KEY_KEYFRAME_TOLERANCE "keyframe_tolerance"
+
+// Publish setting enabling the split of curved edges bulging more than the
+// given distance (px) from their chord. Off (0) by default.
+#define PUBLISH_SETTINGS_KEY_CURVE_TOLERANCE "curve_tolerance"
+
+// Publish setting overriding the distance (px) paths may move when their
+// redundant vertices are removed. A negative value keeps every edge.
+#define PUBLISH_SETTINGS_KEY_PATH_TOLERANCE "path_tolerance"
+
+// Publish setting choosing how much of the document is written: "full"
+// (every member), "compact" (members at their default left out, the
+// default) or "minimal" (names and other editor metadata left out as well).
+#define PUBLISH_SETTINGS_KEY_OUTPUT_PROFILE "output_profile"
+
+// Publish settings overriding the decimals written for path vertices,
+// transforms, colors, ease handles and keyframe times. A negative value
+// writes the shortest text that reads back as the same number.
+#define PUBLISH_SETTINGS_KEY_VERTEX_PRECISION    "vertex_precision"
+#define PUBLISH_SETTINGS_KEY_TRANSFORM_PRECISION "transform_precision"
+#define PUBLISH_SETTINGS_KEY_COLOR_PRECISION     "color_precision"
+#define PUBLISH_SETTINGS_KEY_EASE_PRECISION      "ease_precision"
+#define PUBLISH_SETTINGS_KEY_TIME_PRECISION      "time_precision"
+
+// Publish setting; "true" reuses the images left in the output folder by
+// the previous publish instead of encoding every bitmap again. Off by
+// default: a bitmap edited or re-imported under the same name and size is
+// not told apart from the one encoded before.
+#define PUBLISH_SETTINGS_KEY_IMAGE_CACHE    "image_cache"
+
+// Publish setting; "false" reduces and writes every symbol again instead of
+// reusing the output written for the symbols whose model did not change
+// since the previous publish. The symbols are built again either way.
+#define PUBLISH_SETTINGS_KEY_SYMBOL_CACHE   "symbol_cache"
+
+// Publish setting giving the number of threads hashing the encoded images.
+// The export services are only called on the publishing thread; "0" hashes
+// the images there too.
+#define PUBLISH_SETTINGS_KEY_EXPORT_THREADS "export_threads"
+
+// Publish setting giving the number of threads writing the layers of the
+// JSON, one per core by default. "1" writes them on a single thread; the
+// output is the same.
+#define PUBLISH_SETTINGS_KEY_SERIALIZE_THREADS "serialize_threads"
+
+// Publish setting naming a file that receives a trace of the resource
+// palette and timeline builder calls, for PublishTraceReplayer.
+#define PUBLISH_SETTINGS_KEY_TRACE_FILE     "trace_file"
+
+// Publish setting; "true" times the phases of the publish and prints a
+// summary of the times and object counts to the output panel.
+#define PUBLISH_SETTINGS_KEY_PROFILE        "profile"
+
+// Publish setting; "true" also writes the summary to <name>.stats.json
+// next to the output, for tracking the publish cost over time.
+#define PUBLISH_SETTINGS_KEY_STATS_FILE     "stats_file"
+
+// Publish setting replacing the document with a synthetic scene, e.g.
+// "layers=100,frames=240,edges=32,holes=0.25,gradients=0.25,bitmaps=0.1"
+// (see SyntheticScene), and tracing the cost of its export.
+#define PUBLISH_SETTINGS_KEY_BENCHMARK_SCENE "benchmark_scene"
+
+// Publish setting naming the file the benchmark results are compared with.
+// It is written with the results of the run when it does not exist.
+#define PUBLISH_SETTINGS_KEY_BENCHMARK_BASELINE "benchmark_baseline"
+
+// Maximum number of times a curved edge is halved (16 pieces)
+#define MAX_CURVE_SPLIT_DEPTH           4
+
 
 /* -------------------------------------------------- Structs / Unions */
 
@@ -142,6 +222,37 @@ namespace LottieExporter
 
 		FCM::Boolean IsPreviewNeeded(const PIFCMDictionary pDictConfig);
 
+		FCM::Boolean IsLegacyOutputNeeded(const PIFCMDictionary pDictPublishSettings);
+
+		float GetKeyframeTolerance(const PIFCMDictionary pDictPublishSettings);
+
+		double GetCurveTolerance(const PIFCMDictionary pDictPublishSettings);
+
+		double GetPathTolerance(const PIFCMDictionary pDictPublishSettings);
+
+		OutputProfile GetOutputProfile(const PIFCMDictionary pDictPublishSettings);
+
+		int GetNumberPrecision(const PIFCMDictionary pDictPublishSettings, NumberClass numberClass);
+
+		FCM::Boolean IsImageCacheEnabled(const PIFCMDictionary pDictPublishSettings);
+
+		FCM::Boolean IsSymbolCacheEnabled(const PIFCMDictionary pDictPublishSettings);
+
+		unsigned int GetExportThreads(const PIFCMDictionary pDictPublishSettings);
+
+		unsigned int GetSerializeThreads(const PIFCMDictionary pDictPublishSettings);
+
+		std::string GetTraceFile(const PIFCMDictionary pDictPublishSettings);
+
+		FCM::Boolean IsProfilingEnabled(const PIFCMDictionary pDictPublishSettings);
+
+		FCM::Boolean IsStatsFileEnabled(const PIFCMDictionary pDictPublishSettings);
+
+		FCM::Result RunBenchmark(
+			const std::string& sceneSpec,
+			std::string& outFile,
+			const PIFCMDictionary pDictPublishSettings);
+
 		FCM::Result Init();
 
 		FCM::Result ShowPreview(const std::string& outFile);
@@ -154,6 +265,9 @@ namespace LottieExporter
 
 		AutoPtr<IFrameCommandGenerator> m_frameCmdGeneratorService;
 		AutoPtr<IResourcePalette> m_pResourcePalette;
+
+		// Symbols written by the previous publishes
+		SymbolFragmentCache m_symbolCache;
 	};
 
 
@@ -194,14 +308,54 @@ namespace LottieExporter
 
 		~ResourcePalette();
 
-		void Init(IOutputWriter* pOutputWriter);
+		void Init(IOutputWriter* pOutputWriter, double curveTolerance = 0);
 
 		void Clear();
 
+		// The frame commands of every scene are generated with what looks
+		// like an empty palette; the resources stay defined for the model
+		void StartScene();
+
 		FCM::Result HasResource(
 			const std::string& name,
 			FCM::Boolean& hasResource);
 
+		// Build the Lottie model from the decoded shape data. Called while
+		// reading the DOM and when replaying a publish trace.
+		void StartShape(FCM::U_Int32 resourceId);
+
+		void StartFillRegion(FCM::U_Int32 resourceId);
+
+		void StartStrokePath(FCM::U_Int32 resourceId);
+
+		void SetSolidColor(const DOM::Utils::COLOR& color);
+
+		void SetLinearGradient(
+			const DOM::Utils::MATRIX2D& matrix,
+			const std::vector<DOM::Utils::GRADIENT_COLOR_POINT>& colorPoints);
+
+		void SetRadialGradient(
+			const DOM::Utils::MATRIX2D& matrix,
+			FCM::S_Int32 focalPoint,
+			const std::vector<DOM::Utils::GRADIENT_COLOR_POINT>& colorPoints);
+
+		void SetSolidStroke(
+			FCM::Double thickness,
+			FCM::U_Int32 lineCap,
+			FCM::U_Int32 lineJoin,
+			FCM::Double miterLimit);
+
+		void AddPath(const std::vector<DOM::Utils::SEGMENT>& edges, FCM::Boolean isHole);
+
+		// Turns the last fill region into a hole layer
+		void StartHoles(FCM::U_Int32 resourceId);
+
+		void DefineBitmap(
+			FCM::U_Int32 resourceId,
+			FCM::S_Int32 height,
+			FCM::S_Int32 width,
+			const std::string& libPathName);
+
 	private:
 
 		FCM::Result ExportFill(DOM::FrameElement::PIShape pIShape,FCM::U_Int32 resourceId);
@@ -220,6 +374,8 @@ namespace LottieExporter
 
         FCM::Result ExportPath(DOM::Service::Shape::PIPath pPath,FCM::Boolean ishole);
 
+		FCM::Result GetSegments(DOM::Service::Shape::PIPath pPath);
+
 		FCM::Result ExportSolidFillStyle(
 			DOM::FillStyle::ISolidFillStyle* pSolidFillStyle);
 
@@ -240,6 +396,15 @@ namespace LottieExporter
 			DOM::FrameElement::PIShape pShape,
 			DOM::FrameElement::PIShape& pNewShape);
 
+		// Id of a resource of the current scene in the model
+		FCM::U_Int32 AddGlobalResource(FCM::U_Int32 resourceId);
+
+		// True if a library item of that name was defined by an earlier
+		// scene; the resource then refers to that definition
+		FCM::Boolean FindLibraryResource(const std::string& name, FCM::U_Int32 resourceId);
+
+		PublishProfiler& GetProfiler();
+
 	private:
 
 		IOutputWriter* m_pOutputWriter;
@@ -247,8 +412,27 @@ namespace LottieExporter
 		std::vector<FCM::U_Int32> m_resourceList;
 
 		std::vector<std::string> m_resourceNames;
+
+		// Scenes started so far, and the lowest id no scene has used
+		FCM::U_Int32 m_sceneCount;
+
+		FCM::U_Int32 m_nextResourceId;
+
+		// Ids of the symbols, bitmaps and sounds in the model, by library name
+		std::map<std::string, FCM::U_Int32> m_libraryResourceIds;
         
-        int mCurveFactor =2;
+		// Curved edges are split only when they bulge more than this from
+		// their chord; 0 keeps one cubic per edge
+		double m_curveTolerance;
+
+		// Edges of the current path as read from the DOM, and once split
+		std::vector<DOM::Utils::SEGMENT> m_edges;
+
+		std::vector<DOM::Utils::SEGMENT> m_segments;
+
+		PathSimplifier m_pathSimplifier;
+
+		ShapeRecognizer m_shapeRecognizer;
 	};
 
 
@@ -336,13 +520,50 @@ namespace LottieExporter
 
 		void Init(IOutputWriter* pOutputWriter);
 
+	private:
+
+		PublishTraceWriter& GetPublishTrace();
+
+		LottieExporter::LottieManager* GetLottieManager();
+
+		// Id of a resource in the shared palette of the document
+		FCM::U_Int32 GetResourceId(FCM::U_Int32 resourceId);
+
+		void AddSymbolInstance(
+			FCM::U_Int32 objectId,
+			FCM::U_Int32 resourceId,
+			FCM::U_Int32 placeAfterObjectId,
+			const DOM::Utils::MATRIX2D& matrix);
+
+		void FlushDisplayTransforms();
+
+		void ApplyDisplayTransform(
+			FCM::U_Int32 objectId,
+			const DOM::Utils::MATRIX2D& matrix,
+			const MATRIX_COMPONENTS& components);
+
+		void AddKeyframe(keyframe_track& track, const float* value);
+
 	private:
 
 		IOutputWriter* m_pOutputWriter;
 
 		ITimelineWriter* m_pTimelineWriter;
 
+		// Layers of the timeline, a symbol precomp once built
+		composition* m_composition;
+
 		FCM::U_Int32 m_frameIndex;
+
+		// Id of the builder in the publish trace
+		FCM::U_Int32 m_traceId;
+
+		// Display transforms of the current frame, decomposed in one batch
+		std::vector<FCM::U_Int32> m_pendingObjectIds;
+
+		std::vector<DOM::Utils::MATRIX2D> m_pendingMatrices;
+
+		std::vector<MATRIX_COMPONENTS> m_pendingComponents;
 	};
 
 
@@ -367,6 +588,114 @@ namespace LottieExporter
 		IOutputWriter* m_pOutputWriter;
 	};
 
+	// Drives a resource palette and timeline builders from a publish trace
+	// the way Animate does during a publish, so that the Lottie output can
+	// be rebuilt without the DOM. Images are not encoded again: the output
+	// refers to the files written by the recorded publish.
+	class PublishTraceReplayer : public IPublishTraceHandler
+	{
+	public:
+
+		PublishTraceReplayer(JSONOutputWriter* pOutputWriter, double curveTolerance = 0);
+
+		~PublishTraceReplayer();
+
+		// Writes the Lottie output of a trace with a writer set up by the
+		// caller. The time taken to build the model and to serialize it is
+		// added to the benchmark, if given.
+		static FCM::Result Replay(
+			const std::string& traceFile,
+			JSONOutputWriter& outputWriter,
+			std::string& outputFile,
+			FCM::PIFCMCallback pCallback,
+			double curveTolerance = 0,
+			PublishBenchmark* pBenchmark = NULL);
+
+		virtual void Document(
+			const DOM::Utils::COLOR& background,
+			FCM::U_Int32 stageHeight,
+			FCM::U_Int32 stageWidth,
+			FCM::U_Int32 fps);
+
+		virtual void DefineShape(FCM::U_Int32 resourceId);
+
+		virtual void FillRegion(FCM::U_Int32 resourceId);
+
+		virtual void StrokePath(FCM::U_Int32 resourceId);
+
+		virtual void SolidColor(const DOM::Utils::COLOR& color);
+
+		virtual void LinearGradient(
+			const DOM::Utils::MATRIX2D& matrix,
+			const std::vector<DOM::Utils::GRADIENT_COLOR_POINT>& colorPoints);
+
+		virtual void RadialGradient(
+			const DOM::Utils::MATRIX2D& matrix,
+			FCM::S_Int32 focalPoint,
+			const std::vector<DOM::Utils::GRADIENT_COLOR_POINT>& colorPoints);
+
+		virtual void SolidStroke(
+			FCM::Double thickness,
+			FCM::U_Int32 lineCap,
+			FCM::U_Int32 lineJoin,
+			FCM::Double miterLimit);
+
+		virtual void Path(const std::vector<DOM::Utils::SEGMENT>& edges, FCM::Boolean isHole);
+
+		virtual void Holes(FCM::U_Int32 resourceId);
+
+		virtual void DefineBitmap(
+			FCM::U_Int32 resourceId,
+			FCM::S_Int32 height,
+			FCM::S_Int32 width,
+			const std::string& libPathName,
+			const std::string& fileName);
+
+		virtual void CreateTimeline(FCM::U_Int32 timelineId);
+
+		virtual void PlaceObject(
+			FCM::U_Int32 timelineId,
+			TraceRecordType type,
+			FCM::U_Int32 objectId,
+			FCM::U_Int32 resourceId,
+			FCM::U_Int32 placeAfterObjectId,
+			const DOM::Utils::MATRIX2D& matrix);
+
+		virtual void UpdateZOrder(FCM::U_Int32 timelineId, FCM::U_Int32 objectId, FCM::U_Int32 placeAfterObjectId);
+
+		virtual void UpdateMask(FCM::U_Int32 timelineId, FCM::U_Int32 objectId, FCM::U_Int32 maskTillObjectId);
+
+		virtual void Remove(FCM::U_Int32 timelineId, FCM::U_Int32 objectId);
+
+		virtual void UpdateBlendMode(FCM::U_Int32 timelineId, FCM::U_Int32 objectId, FCM::U_Int32 blendMode);
+
+		virtual void UpdateVisibility(FCM::U_Int32 timelineId, FCM::U_Int32 objectId, FCM::Boolean visible);
+
+		virtual void UpdateDisplayTransform(
+			FCM::U_Int32 timelineId,
+			FCM::U_Int32 objectId,
+			const DOM::Utils::MATRIX2D& matrix);
+
+		virtual void ShowFrame(FCM::U_Int32 timelineId);
+
+		virtual void BuildTimeline(FCM::U_Int32 timelineId, FCM::U_Int32 resourceId);
+
+		virtual void StartScene(FCM::U_Int32 firstFrame, FCM::U_Int32 frameCount);
+
+	private:
+
+		// NULL if the trace never created the timeline
+		TimelineBuilder* GetTimeline(FCM::U_Int32 timelineId);
+
+	private:
+
+		JSONOutputWriter* m_pOutputWriter;
+
+		ResourcePalette* m_pResourcePalette;
+
+		std::map<FCM::U_Int32, TimelineBuilder*> m_timelines;
+	};
+
 	FCM::Result RegisterPublisher(PIFCMDictionary pPlugins, FCM::FCMCLSID docId);
 };
 
@@ -0,0 +1,92 @@
+/*************************************************************************
+* ADOBE CONFIDENTIAL
+* ___________________
+*
+*  Copyright 2018 Adobe Systems Incorporated
+*  All Rights Reserved.
+*
+* NOTICE:  All information contained herein is, and remains
+* the property of Adobe Systems Incorporated and its suppliers,
+* if any.  The intellectual and technical concepts contained
+* herein are proprietary to Adobe Systems Incorporated and its
+* suppliers and are protected by all applicable intellectual property
+* laws, including trade secret and copyright laws.
+* Dissemination of this information or reproduction of this material
+* is strictly forbidden unless prior written permission is obtained
+* from Adobe Systems Incorporated.
+**************************************************************************/
+
+/**
+ * @file  MatrixDecomposition.h
+ *
+ * @brief This file contains the decomposition of a 2D matrix into its
+ *        translation, scale, rotation and skew.
+ */
+
+#ifndef MATRIX_DECOMPOSITION_H_
+#define MATRIX_DECOMPOSITION_H_
+
+#include "FCMTypes.h"
+#include "Utils/DOMTypes.h"
+#include <cmath>
+#include <cstddef>
+
+/* -------------------------------------------------- Macros / Constants */
+
+#define MATRIX_RADIANS_TO_DEGREES   57.29577951308232
+
+// Skew angles closer than this (in degrees) are treated as a rotation
+#define MATRIX_SKEW_TOLERANCE       0.01
+
+/* -------------------------------------------------- Structs / Unions */
+
+namespace LottieExporter
+{
+    // Same conventions as DOM::Utils::IMatrix2D: angles are in degrees and
+    // the rotation is NaN when the matrix is skewed (skewX != skewY).
+    struct MATRIX_COMPONENTS
+    {
+        FCM::Float tx;
+        FCM::Float ty;
+        FCM::Float scaleX;
+        FCM::Float scaleY;
+        FCM::Float rotation;
+        FCM::Float skewX;
+        FCM::Float skewY;
+    };
+
+    /* -------------------------------------------------- Functions */
+
+    inline void DecomposeMatrix(const DOM::Utils::MATRIX2D& matrix, MATRIX_COMPONENTS& components)
+    {
+        double skewX = std::atan2(-(double)matrix.c, (double)matrix.d) * MATRIX_RADIANS_TO_DEGREES;
+        double skewY = std::atan2((double)matrix.b, (double)matrix.a) * MATRIX_RADIANS_TO_DEGREES;
+
+        // +180 and -180 are the same angle
+        double diff = std::remainder(skewX - skewY, 360.0);
+
+        components.tx = matrix.tx;
+        components.ty = matrix.ty;
+        components.scaleX = (FCM::Float)std::sqrt((double)matrix.a * matrix.a + (double)matrix.b * matrix.b);
+        components.scaleY = (FCM::Float)std::sqrt((double)matrix.c * matrix.c + (double)matrix.d * matrix.d);
+        components.skewX = (FCM::Float)skewX;
+        components.skewY = (FCM::Float)skewY;
+        components.rotation = (std::fabs(diff) < MATRIX_SKEW_TOLERANCE) ? (FCM::Float)skewY : NAN;
+    }
+
+    // Decomposes all the matrices of a frame at once. The loop has no calls
+    // other than the math functions and no data dependency between entries,
+    // so it is left to the compiler to vectorize.
+    inline void DecomposeMatrices(
+        const DOM::Utils::MATRIX2D* pMatrices,
+        MATRIX_COMPONENTS* pComponents,
+        size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            DecomposeMatrix(pMatrices[i], pComponents[i]);
+        }
+    }
+};
+
+#endif // MATRIX_DECOMPOSITION_H_
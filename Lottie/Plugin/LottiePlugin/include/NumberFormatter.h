@@ -0,0 +1,210 @@
+/*************************************************************************
+* ADOBE CONFIDENTIAL
+* ___________________
+*
+*  Copyright 2018 Adobe Systems Incorporated
+*  All Rights Reserved.
+*
+* NOTICE:  All information contained herein is, and remains
+* the property of Adobe Systems Incorporated and its suppliers,
+* if any.  The intellectual and technical concepts contained
+* herein are proprietary to Adobe Systems Incorporated and its
+* suppliers and are protected by all applicable intellectual property
+* laws, including trade secret and copyright laws.
+* Dissemination of this information or reproduction of this material
+* is strictly forbidden unless prior written permission is obtained
+* from Adobe Systems Incorporated.
+**************************************************************************/
+
+/**
+ * @file  NumberFormatter.h
+ *
+ * @brief This file contains the conversion of numbers to the text written
+ *        in the JSON output.
+ */
+
+#ifndef NUMBER_FORMATTER_H_
+#define NUMBER_FORMATTER_H_
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+/* -------------------------------------------------- Macros / Constants */
+
+// Decimals kept for each class of number. A negative count writes the
+// shortest text that reads back as the same value.
+#define NUMBER_PRECISION_DEFAULT    -1
+#define NUMBER_PRECISION_VERTEX     2
+#define NUMBER_PRECISION_TRANSFORM  3
+#define NUMBER_PRECISION_COLOR      3
+#define NUMBER_PRECISION_EASE       3
+#define NUMBER_PRECISION_TIME       0
+
+// Largest count of decimals a number is rounded to
+#define NUMBER_FORMAT_MAX_DECIMALS  17
+
+// Room for any number written by the formatter
+#define NUMBER_FORMAT_BUFFER_SIZE   32
+
+/* -------------------------------------------------- Enums */
+
+namespace LottieExporter
+{
+    // What a number stands for; each class has its own precision
+    enum NumberClass
+    {
+        NUMBER_CLASS_DEFAULT,
+        NUMBER_CLASS_VERTEX,        // path vertices and tangents
+        NUMBER_CLASS_TRANSFORM,     // position, anchor, scale, rotation, opacity
+        NUMBER_CLASS_COLOR,         // color components and gradient stops
+        NUMBER_CLASS_EASE,          // keyframe ease handles
+        NUMBER_CLASS_TIME,          // keyframe times
+
+        NUMBER_CLASS_COUNT
+    };
+}
+
+/* -------------------------------------------------- Class Decl */
+
+namespace LottieExporter
+{
+    // Locale independent number to text conversion. Rounding to a fixed
+    // count of decimals is a multiply and an integer conversion. The
+    // shortest form tries one decimal more at a time until the decimal
+    // reads back as the value: the digits q and the power of ten 10^d are
+    // both exact doubles, so q / 10^d is rounded exactly as a JSON parser
+    // rounds the text. Values out of that range go through "%.17g".
+    class NumberFormatter
+    {
+    public:
+
+        static int DefaultPrecision(NumberClass numberClass)
+        {
+            static const int precision[NUMBER_CLASS_COUNT] =
+            {
+                NUMBER_PRECISION_DEFAULT,
+                NUMBER_PRECISION_VERTEX,
+                NUMBER_PRECISION_TRANSFORM,
+                NUMBER_PRECISION_COLOR,
+                NUMBER_PRECISION_EASE,
+                NUMBER_PRECISION_TIME
+            };
+            return precision[numberClass];
+        }
+
+        // Writes 'value' with at most 'decimals' decimals, trailing zeros
+        // removed. A negative count gives the shortest text for the value;
+        // 'single' makes that the shortest text for the value as a float.
+        // Returns the length, the text is terminated.
+        static size_t Format(double value, int decimals, bool single, char* num)
+        {
+            if (!std::isfinite(value))
+            {
+                // JSON has no representation for NaN/Inf
+                value = 0;
+            }
+
+            if (decimals >= 0)
+                return Fixed(value, decimals > NUMBER_FORMAT_MAX_DECIMALS ? NUMBER_FORMAT_MAX_DECIMALS : decimals, num);
+            return Shortest(value, single, num);
+        }
+
+    private:
+
+        static double Pow10(int exponent)
+        {
+            static const double pow10[NUMBER_FORMAT_MAX_DECIMALS + 1] =
+            {
+                1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8,
+                1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17
+            };
+            return pow10[exponent];
+        }
+
+        // Integers below this are exact doubles
+        static double MaxExact()
+        {
+            return 9007199254740992.0;
+        }
+
+        static size_t Fixed(double value, int decimals, char* num)
+        {
+            double scaled = value * Pow10(decimals);
+            if (std::fabs(scaled) >= MaxExact())
+                return Shortest(value, false, num);
+
+            return WriteDecimal((long long)std::floor(scaled + 0.5), decimals, num);
+        }
+
+        static size_t Shortest(double value, bool single, char* num)
+        {
+            for (int decimals = 0; decimals <= NUMBER_FORMAT_MAX_DECIMALS; decimals++)
+            {
+                double power = Pow10(decimals);
+                double scaled = value * power;
+                if (std::fabs(scaled) >= MaxExact())
+                    break;
+
+                double digits = std::floor(scaled + 0.5);
+                double back = digits / power;
+                if (single ? (float)back == (float)value : back == value)
+                    return WriteDecimal((long long)digits, decimals, num);
+            }
+
+            int len = snprintf(num, NUMBER_FORMAT_BUFFER_SIZE, single ? "%.9g" : "%.17g", value);
+
+            // The C library writes the decimal point of the current locale
+            char* comma = strchr(num, ',');
+            if (comma)
+                *comma = '.';
+            return len;
+        }
+
+        // Writes digits * 10^-decimals
+        static size_t WriteDecimal(long long digits, int decimals, char* num)
+        {
+            char reversed[NUMBER_FORMAT_BUFFER_SIZE];
+            size_t count = 0;
+
+            bool negative = digits < 0;
+            unsigned long long magnitude = negative ? 0ULL - (unsigned long long)digits : (unsigned long long)digits;
+
+            // Trailing zeros of the fraction are not written
+            while (decimals > 0 && magnitude % 10 == 0)
+            {
+                magnitude /= 10;
+                decimals--;
+            }
+
+            do
+            {
+                reversed[count++] = (char)('0' + magnitude % 10);
+                magnitude /= 10;
+                if ((int)count == decimals)
+                    reversed[count++] = '.';
+            } while (magnitude > 0);
+
+            // Fraction smaller than 0.1
+            while ((int)count <= decimals)
+            {
+                if ((int)count == decimals)
+                    reversed[count++] = '.';
+                else
+                    reversed[count++] = '0';
+            }
+            if (reversed[count - 1] == '.')
+                reversed[count++] = '0';
+
+            size_t len = 0;
+            if (negative && !(count == 1 && reversed[0] == '0'))
+                num[len++] = '-';
+            while (count > 0)
+                num[len++] = reversed[--count];
+            num[len] = '\0';
+            return len;
+        }
+    };
+};
+
+#endif // NUMBER_FORMATTER_H_
@@ -0,0 +1,108 @@
+/*************************************************************************
+* ADOBE CONFIDENTIAL
+* ___________________
+*
+*  Copyright 2018 Adobe Systems Incorporated
+*  All Rights Reserved.
+*
+* NOTICE:  All information contained herein is, and remains
+* the property of Adobe Systems Incorporated and its suppliers,
+* if any.  The intellectual and technical concepts contained
+* herein are proprietary to Adobe Systems Incorporated and its
+* suppliers and are protected by all applicable intellectual property
+* laws, including trade secret and copyright laws.
+* Dissemination of this information or reproduction of this material
+* is strictly forbidden unless prior written permission is obtained
+* from Adobe Systems Incorporated.
+**************************************************************************/
+
+/**
+ * @file  ObjectArena.h
+ *
+ * @brief This file contains the arena owning the objects of the Lottie
+ *        model for the duration of a publish.
+ */
+
+#ifndef OBJECT_ARENA_H_
+#define OBJECT_ARENA_H_
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+/* -------------------------------------------------- Macros / Constants */
+
+// Objects per block
+#define ARENA_BLOCK_SIZE    64
+
+/* -------------------------------------------------- Class Decl */
+
+namespace LottieExporter
+{
+    // Creates objects of one type in blocks of contiguous storage. Objects
+    // never move and are all destroyed together, by Clear() or when the
+    // arena goes away.
+    template <typename T, size_t BlockSize = ARENA_BLOCK_SIZE>
+    class ObjectArena
+    {
+    public:
+
+        ObjectArena() : m_used(BlockSize)
+        {
+        }
+
+        ~ObjectArena()
+        {
+            Clear();
+        }
+
+        T* Create()
+        {
+            if (m_used == BlockSize)
+            {
+                m_blocks.push_back(static_cast<T*>(::operator new(sizeof(T) * BlockSize)));
+                m_used = 0;
+            }
+
+            T* object = new (m_blocks.back() + m_used) T();
+            m_used++;
+            return object;
+        }
+
+        size_t Size() const
+        {
+            return m_blocks.empty() ? 0 : (m_blocks.size() - 1) * BlockSize + m_used;
+        }
+
+        void Clear()
+        {
+            while (!m_blocks.empty())
+            {
+                T* block = m_blocks.back();
+                while (m_used > 0)
+                {
+                    m_used--;
+                    (block + m_used)->~T();
+                }
+                ::operator delete(block);
+                m_blocks.pop_back();
+                m_used = BlockSize;
+            }
+        }
+
+    private:
+
+        // Not copyable: the model holds pointers into the blocks
+        ObjectArena(const ObjectArena&);
+        ObjectArena& operator=(const ObjectArena&);
+
+    private:
+
+        std::vector<T*> m_blocks;
+
+        // Objects created in the last block
+        size_t m_used;
+    };
+};
+
+#endif // OBJECT_ARENA_H_
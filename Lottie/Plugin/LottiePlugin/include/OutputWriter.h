@@ -19,7 +19,16 @@
 #define OUTPUT_WRITER_H_
 #include "PublishToLottie.h"
 #include "IOutputWriter.h"
+#include "JSONStreamWriter.h"
+#include "BitmapExportCache.h"
+#include "ExportWorkerPool.h"
+#include "PublishTrace.h"
+#include "PublishProfiler.h"
+#include "PathSimplifier.h"
+#include "SymbolFragmentCache.h"
+#include "ParallelLoop.h"
 #include <string>
+#include <fstream>
 #include <map>
 
 /* -------------------------------------------------- Forward Decl */
@@ -40,6 +49,14 @@ namespace LottieExporter
         INVALID_STROKE_STYLE_TYPE,
         SOLID_STROKE_STYLE_TYPE
     };
+
+    // How much of what the players can do without goes into the document
+    enum OutputProfile
+    {
+        FULL_OUTPUT_PROFILE,        // every member, as written so far
+        COMPACT_OUTPUT_PROFILE,     // no default values, constant tracks made static
+        MINIMAL_OUTPUT_PROFILE      // compact, without names, match names and indices
+    };
 }
 
 
@@ -48,6 +65,12 @@ namespace LottieExporter
 #define IMAGE_FOLDER "images"
 #define SOUND_FOLDER "sounds"
 
+// Smaller compositions are not worth handing to the serialize threads
+#define SERIALIZE_PARALLEL_MIN_LAYERS   16
+
+// Layers written into buffers before they are copied to the output
+#define SERIALIZE_BATCH_LAYERS          256
+
 
 /* -------------------------------------------------- Structs / Unions */
 
@@ -79,6 +102,22 @@ struct FRAME_SCRIPT
 	FCM::U_Int32 layerNumber;
 	std::string script;
 };
+
+    // Shapes of a shape resource, serialized once. Resources drawing the same
+    // content share an entry; entries used by more than one layer are written
+    // once as a precomp asset and referenced by id.
+    struct SHAPE_CONTENT
+    {
+        std::string shapes;     // "shapes":[...] member
+        FCM::U_Int32 users;     // number of layers drawing it
+        std::string refId;      // precomp asset id, empty if written inline
+        double left;            // bounds, in resource coordinates
+        double top;
+        double width;
+        double height;
+    };
+
+    struct ASSET_EXPORT_JOB;
 }
 /* -------------------------------------------------- Class Decl */
 
@@ -101,9 +140,16 @@ namespace LottieExporter
             FCM::U_Int32 stageWidth,
             FCM::U_Int32 fps);
 
-        // Marks the end of the Document
+        // Marks the end of the Document. The assets are finished and the
+        // file is opened here, then the model is handed to the document
+        // writer and written to the file in the background; the model must
+        // not be touched again.
         virtual FCM::Result EndDocument();
 
+        // Waits for the document file and reports how the write went, done
+        // at the latest by EndOutput
+        FCM::Result FinishDocument();
+
         // Marks the start of a timeline
         virtual FCM::Result StartDefineTimeline();
 
@@ -216,7 +262,9 @@ namespace LottieExporter
             FCM::U_Int32 resId, 
             const std::string& libPathName,
             DOM::LibraryItem::PIMediaItem pMediaItem);
-        JSONOutputWriter(FCM::PIFCMCallback pCallback);
+        // legacyOutput: also build the CreateJS style JSON tree and write it
+        // next to the Lottie file (debug only)
+        JSONOutputWriter(FCM::PIFCMCallback pCallback, FCM::Boolean legacyOutput = false);
 
         virtual ~JSONOutputWriter();
 
@@ -225,20 +273,41 @@ namespace LottieExporter
         
         // End of a path 
 		virtual FCM::Result EndDefinePath();
-		FCM::Result AddIp(JSONNode &firstNode);
-		FCM::Result AddOp(JSONNode &firstNode);
-		FCM::Result AddVersion(JSONNode &firstNode);
-		FCM::Result AddFr(JSONNode &firstNode);
-        FCM::Result AddLayers(JSONNode &firstNode);
-		FCM::Result AddWidthHeight(JSONNode &firstNode);
+		FCM::Result AddIp(JSONStreamWriter& writer);
+		FCM::Result AddOp(JSONStreamWriter& writer);
+		FCM::Result AddVersion(JSONStreamWriter& writer);
+		FCM::Result AddFr(JSONStreamWriter& writer);
+        FCM::Result AddLayers(JSONStreamWriter& writer, const composition* comp);
+        void AddLayer(JSONStreamWriter& writer, const Layer* layer);
+        std::string WriteLayer(const Layer* layer);
+		FCM::Result AddWidthHeight(JSONStreamWriter& writer);
 		
-		FCM::Result AddAssets(JSONNode &firstNode);
-		FCM::Result AddMarkers(JSONNode &firstNode);
-        FCM::Result AddGroup(int resourceId);
-        FCM::Result AddHoles();
-        FCM::Result AddItems(struct group *gr);
+		FCM::Result AddAssets(JSONStreamWriter& writer);
+		FCM::Result AddMarkers(JSONStreamWriter& writer);
+        FCM::Result AddLayerTransform(JSONStreamWriter& writer, const Layer* layer, const double* precompAnchor = NULL);
+        void AddTimeRemap(JSONStreamWriter& writer, const Layer* layer, const composition* symbol);
+        FCM::Result AddGroup(JSONStreamWriter& writer, int resourceId, const path_track* morph = NULL);
+        FCM::Result AddShapeGroup(JSONStreamWriter& writer, const group* gr, const path_track* morph = NULL, std::uint32_t index = 0);
+        FCM::Result AddItems(JSONStreamWriter& writer, const group* gr, const path_track* morph, std::uint32_t index);
+        FCM::Result AddPath(JSONStreamWriter& writer, const ks& path);
 		FCM::Result InitFileName(const std::string& outputFileName);
 		LottieExporter::LottieManager* GetLottieManager() { return m_LottieManager; }
+        FCM::Boolean IsLegacyOutput() const { return m_legacyOutput; }
+        void SetKeyframeTolerance(float tolerance) { m_keyframeTolerance = tolerance; }
+        void SetPathTolerance(double tolerance) { m_pathTolerance = tolerance; }
+        double GetPathTolerance() const { return m_pathTolerance; }
+        void SetOutputProfile(OutputProfile profile) { m_outputProfile = profile; }
+        void SetNumberPrecision(NumberClass numberClass, int decimals) { m_numberPrecision[numberClass] = decimals; }
+        void SetPersistentImageCache(FCM::Boolean persistent) { m_persistentImageCache = persistent; }
+        // NULL writes every symbol again
+        void SetSymbolCache(SymbolFragmentCache* pSymbolCache) { m_pSymbolCache = pSymbolCache; }
+        void SetExportThreads(unsigned int numThreads) { m_exportPool.SetNumThreads(numThreads); }
+        void SetSerializeThreads(unsigned int numThreads) { m_serializeLoop.SetNumThreads(numThreads); }
+        void SetTraceFile(const std::string& traceFile) { m_traceFile = traceFile; }
+        PublishTraceWriter& GetPublishTrace() { return m_publishTrace; }
+        const std::string& GetOutputJSONFilePath() const { return m_outputJSONFilePath; }
+        void SetProfiling(FCM::Boolean enabled, FCM::Boolean statsFile) { m_profiler.SetEnabled(enabled || statsFile); m_statsFile = statsFile; }
+        PublishProfiler& GetProfiler() { return m_profiler; }
 		
 
     private:
@@ -251,6 +320,58 @@ namespace LottieExporter
 
         void SetImageExportFileName(const std::string& libPathName, const std::string& name);
 
+        FCM::Result ExportImage(
+            const std::string& libPathName,
+            FCM::S_Int32 height,
+            FCM::S_Int32 width,
+            DOM::LibraryItem::PIMediaItem pMediaItem,
+            std::string& name);
+
+        // Exports the asset and queues the hash of an image
+        void QueueAssetExport(ASSET_EXPORT_JOB* pJob);
+
+        // Waits for the hashes and applies the results in queue order
+        FCM::Result FinishAssetExport();
+
+        // Reduces the model and writes the document file
+        FCM::Result WriteDocument();
+
+        FCM::Result WriteLegacyDocument();
+
+        FCM::Result BuildShapeContents();
+
+        const SHAPE_CONTENT* GetShapeContent(const Layer* layer) const;
+
+        // "shapes" member of a shape resource
+        std::string WriteShapes(int resourceId);
+
+        // WriteShapes of a resource, done once per document
+        const std::string& GetResourceShapes(int resourceId);
+
+        FCM::U_Int32 FindShapeContent(const std::string& shapes) const;
+
+        // Takes the content of 'content'
+        void AddShapeContent(SHAPE_CONTENT& content);
+
+        // Sizes every symbol precomp to the content its layers draw
+        void MeasureSymbols();
+
+        // Marks the symbols found in the symbol cache as cached
+        void LookupCachedSymbols();
+
+        // Cache key of a symbol composition as it was built
+        std::string GetSymbolCacheKey(const composition* comp);
+
+        // Reduces the cached symbols whose shapes are no longer shared as
+        // they were when cached; false if there was one
+        FCM::Boolean CheckCachedSymbols();
+
+        // "layers" of a symbol asset, from the cache or written and cached
+        void AddSymbolLayers(JSONStreamWriter& writer, size_t index);
+
+        // Applies the output profile and the number precision to a writer
+        void ConfigureWriter(JSONStreamWriter& writer) const;
+
     private:
 
 		std::string m_outputFolder;
@@ -304,6 +425,8 @@ namespace LottieExporter
 
         FCM::PIFCMCallback m_pCallback;
 
+        FCM::Boolean m_legacyOutput;
+
         FCM::U_Int32 m_imageFileNameLabel;
 
         FCM::U_Int32 m_soundFileNameLabel;
@@ -314,21 +437,72 @@ namespace LottieExporter
         
         FCM::Boolean m_soundFolderCreated;
 
-		JSONNode* m_ip = nullptr;
-		JSONNode* m_op = nullptr;
-		JSONNode* m_version = nullptr;
-		JSONNode* m_fr = nullptr;
-		JSONNode* m_width = nullptr;
-		JSONNode* m_height = nullptr;
-        JSONNode * m_layers =nullptr;
-        JSONNode *m_shapes= nullptr;
-        JSONNode *m_items= nullptr;
-        JSONNode *m_group= nullptr;
-        JSONNode *m_assets= nullptr;
-        JSONNode *m_inv= nullptr;
-        JSONNode *m_outv= nullptr;
-        JSONNode *m_cv= nullptr;
-        JSONNode *m_cv2= nullptr;
+        float m_keyframeTolerance;
+
+        double m_pathTolerance;
+
+        OutputProfile m_outputProfile;
+
+        int m_numberPrecision[NUMBER_CLASS_COUNT];
+
+        FCM::Boolean m_persistentImageCache;
+
+        BitmapExportCache m_bitmapCache;
+
+        // Exports whose results are not applied yet, in the order they were
+        // queued
+        std::vector<ASSET_EXPORT_JOB*> m_exportJobs;
+
+        ExportWorkerPool m_exportPool;
+
+        // A single worker writing the document. It only works on the model
+        // and the opened file: the calls back into Animate are made by
+        // EndDocument and FinishDocument, on the publishing thread.
+        ExportWorkerPool m_documentPool;
+
+        std::fstream m_documentFile;
+
+        FCM::Boolean m_documentPending;
+
+        FCM::Result m_documentResult;
+
+        // Shape contents shared as precomps by the last document
+        FCM::U_Int32 m_sharedShapeContents;
+
+        // Writes the layers of large compositions, on the document writer
+        ParallelLoop m_serializeLoop;
+
+        std::vector<SHAPE_CONTENT> m_shapeContents;
+
+        // Shape resource id -> index in m_shapeContents
+        IdTable<FCM::U_Int32> m_shapeContentOfResource;
+
+        // Hash of the shapes -> indices in m_shapeContents
+        std::map<std::uint64_t, std::vector<FCM::U_Int32> > m_shapeContentsByHash;
+
+        // Shape resource id -> its "shapes" member. The resources do not
+        // change once the document ends.
+        std::map<int, std::string> m_resourceShapes;
+
+        // Owned by the publisher, kept from one publish to the next
+        SymbolFragmentCache* m_pSymbolCache;
+
+        // Cache key of each composition, by index
+        std::vector<std::string> m_symbolKeys;
+
+        // Cache entry of each composition, NULL if it is written from the model
+        std::vector<const SYMBOL_CACHE_ENTRY*> m_symbolEntries;
+
+        // Palette and builder calls are recorded here when a trace file is set
+        std::string m_traceFile;
+
+        PublishTraceWriter m_publishTrace;
+
+        PublishProfiler m_profiler;
+
+        // Write <name>.stats.json along with the summary
+        FCM::Boolean m_statsFile;
+
 		LottieExporter::LottieManager *m_LottieManager = nullptr;
        
 
@@ -389,7 +563,7 @@ namespace LottieExporter
 
         virtual FCM::Result SetFrameLabel(FCM::StringRep16 pLabel, DOM::KeyFrameLabelType labelType);
 
-        JSONTimelineWriter(FCM::PIFCMCallback pCallback);
+        JSONTimelineWriter(FCM::PIFCMCallback pCallback, FCM::Boolean legacyOutput = false);
 
         virtual ~JSONTimelineWriter();
 
@@ -408,6 +582,7 @@ namespace LottieExporter
         JSONNode* m_pFrameElement;
 
         FCM::PIFCMCallback m_pCallback;
+        FCM::Boolean m_legacyOutput;
 		FCM::S_Int32 m_frameIndex = -1;
 		std::vector<LottieExporter::FRAME_SCRIPT> m_TimelineScripts;
 		JSONNode* m_TimelineSounds = nullptr;
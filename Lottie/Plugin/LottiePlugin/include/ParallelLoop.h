@@ -0,0 +1,194 @@
+/*************************************************************************
+* ADOBE CONFIDENTIAL
+* ___________________
+*
+*  Copyright 2018 Adobe Systems Incorporated
+*  All Rights Reserved.
+*
+* NOTICE:  All information contained herein is, and remains
+* the property of Adobe Systems Incorporated and its suppliers,
+* if any.  The intellectual and technical concepts contained
+* herein are proprietary to Adobe Systems Incorporated and its
+* suppliers and are protected by all applicable intellectual property
+* laws, including trade secret and copyright laws.
+* Dissemination of this information or reproduction of this material
+* is strictly forbidden unless prior written permission is obtained
+* from Adobe Systems Incorporated.
+**************************************************************************/
+
+/**
+ * @file  ParallelLoop.h
+ *
+ * @brief This file contains a pool of threads running the iterations of a
+ *        loop whose iterations do not depend on each other.
+ */
+
+#ifndef PARALLEL_LOOP_H_
+#define PARALLEL_LOOP_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* -------------------------------------------------- Class Decl */
+
+namespace LottieExporter
+{
+    // The workers are started by the first Run and kept for the next ones.
+    // Iterations are handed out one at a time from a shared counter, so a
+    // thread done with its cheap iterations goes on with the ones left.
+    // Which thread runs an iteration is not defined: the results must go
+    // to a slot of their own.
+    class ParallelLoop
+    {
+    public:
+
+        typedef std::function<void(size_t)> Body;
+
+        ParallelLoop() :
+            m_numThreads(0),
+            m_body(NULL),
+            m_count(0),
+            m_next(0),
+            m_generation(0),
+            m_running(0),
+            m_stop(false)
+        {
+        }
+
+        ~ParallelLoop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_start.notify_all();
+
+            for (size_t i = 0; i < m_threads.size(); i++)
+            {
+                m_threads[i].join();
+            }
+        }
+
+        // Threads running the iterations, the calling thread included. With
+        // 0 or 1, Run is a plain loop.
+        void SetNumThreads(unsigned int numThreads)
+        {
+            m_numThreads = numThreads;
+        }
+
+        unsigned int GetNumThreads() const
+        {
+            return m_numThreads;
+        }
+
+        static unsigned int GetDefaultNumThreads()
+        {
+            unsigned int cores = std::thread::hardware_concurrency();
+            return (cores > 0) ? cores : 1;
+        }
+
+        // Calls body(i) for each i in [0, count) and returns once every
+        // iteration has run. Not reentrant.
+        void Run(size_t count, const Body& body)
+        {
+            if (m_numThreads <= 1 || count <= 1)
+            {
+                for (size_t i = 0; i < count; i++)
+                    body(i);
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                while (m_threads.size() < m_numThreads - 1)
+                {
+                    m_threads.push_back(std::thread(&ParallelLoop::Work, this));
+                }
+
+                m_body = &body;
+                m_count = count;
+                m_next = 0;
+                m_running = m_threads.size();
+                m_generation++;
+            }
+            m_start.notify_all();
+
+            RunIterations();
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_done.wait(lock, [this] { return m_running == 0; });
+            m_body = NULL;
+        }
+
+    private:
+
+        ParallelLoop(const ParallelLoop&);
+        ParallelLoop& operator=(const ParallelLoop&);
+
+        void RunIterations()
+        {
+            for (size_t i = m_next++; i < m_count; i = m_next++)
+            {
+                (*m_body)(i);
+            }
+        }
+
+        void Work()
+        {
+            size_t generation = 0;
+
+            for (;;)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_start.wait(lock, [this, generation] { return m_stop || m_generation != generation; });
+                    if (m_stop)
+                        return;
+
+                    generation = m_generation;
+                }
+
+                RunIterations();
+
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_running--;
+                    if (m_running == 0)
+                        m_done.notify_one();
+                }
+            }
+        }
+
+    private:
+
+        unsigned int m_numThreads;
+
+        std::vector<std::thread> m_threads;
+
+        const Body* m_body;
+
+        size_t m_count;
+
+        std::atomic<size_t> m_next;
+
+        size_t m_generation;
+
+        size_t m_running;
+
+        bool m_stop;
+
+        std::mutex m_mutex;
+
+        std::condition_variable m_start;
+
+        std::condition_variable m_done;
+    };
+};
+
+#endif // PARALLEL_LOOP_H_
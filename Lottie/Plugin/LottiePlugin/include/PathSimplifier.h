@@ -0,0 +1,279 @@
+/*************************************************************************
+* ADOBE CONFIDENTIAL
+* ___________________
+*
+*  Copyright 2018 Adobe Systems Incorporated
+*  All Rights Reserved.
+*
+* NOTICE:  All information contained herein is, and remains
+* the property of Adobe Systems Incorporated and its suppliers,
+* if any.  The intellectual and technical concepts contained
+* herein are proprietary to Adobe Systems Incorporated and its
+* suppliers and are protected by all applicable intellectual property
+* laws, including trade secret and copyright laws.
+* Dissemination of this information or reproduction of this material
+* is strictly forbidden unless prior written permission is obtained
+* from Adobe Systems Incorporated.
+**************************************************************************/
+
+/**
+ * @file  PathSimplifier.h
+ *
+ * @brief This file contains the cleanup of the edges of a path before they
+ *        are converted to Lottie vertices.
+ */
+
+#ifndef PATH_SIMPLIFIER_H_
+#define PATH_SIMPLIFIER_H_
+
+#include "FCMTypes.h"
+#include "Utils/DOMTypes.h"
+#include <cmath>
+#include <utility>
+#include <vector>
+
+/* -------------------------------------------------- Macros / Constants */
+
+// Distance (px) a simplified path may move away from the original one. A
+// twip, the precision Animate stores its shapes with.
+#define PATH_SIMPLIFY_TOLERANCE     0.05
+
+// Edges shorter than this (px) are dropped and gaps this small closed; far
+// below a twip, so that no edge Animate stored is lost
+#define PATH_SIMPLIFY_SNAP          0.001
+
+/* -------------------------------------------------- Class Decl */
+
+namespace LottieExporter
+{
+    // Removes what the region generator leaves in a path but nobody can
+    // see: curves flat enough to be lines, zero length edges, gaps between
+    // edges and vertices in the middle of straight runs (Douglas-Peucker on
+    // every run of lines, curves are kept as they are).
+    //
+    // Nothing moves by more than the tolerance. The stages share it: a
+    // vertex snaps by at most the snap distance, a flattened curve is
+    // within half the tolerance of its chord and Douglas-Peucker keeps the
+    // lines within the rest. With a tolerance of 0 only exact duplicates
+    // and collinear vertices go.
+    class PathSimplifier
+    {
+    public:
+
+        // The result is valid until the next call
+        const std::vector<DOM::Utils::SEGMENT>& Simplify(
+            const std::vector<DOM::Utils::SEGMENT>& edges,
+            double tolerance)
+        {
+            m_joined.clear();
+            m_simplified.clear();
+
+            double snap = tolerance < PATH_SIMPLIFY_SNAP ? tolerance : PATH_SIMPLIFY_SNAP;
+            double flatten = tolerance / 2;
+            double lines = tolerance - flatten - snap;
+
+            Join(edges, flatten, snap);
+            SimplifyLines(lines > 0 ? lines : 0);
+
+            return m_simplified;
+        }
+
+    private:
+
+        static DOM::Utils::POINT2D GetStart(const DOM::Utils::SEGMENT& segment)
+        {
+            return segment.segmentType == DOM::Utils::LINE_SEGMENT ?
+                segment.line.endPoint1 : segment.quadBezierCurve.anchor1;
+        }
+
+        static DOM::Utils::POINT2D GetEnd(const DOM::Utils::SEGMENT& segment)
+        {
+            return segment.segmentType == DOM::Utils::LINE_SEGMENT ?
+                segment.line.endPoint2 : segment.quadBezierCurve.anchor2;
+        }
+
+        static void SetStart(DOM::Utils::SEGMENT& segment, const DOM::Utils::POINT2D& point)
+        {
+            if (segment.segmentType == DOM::Utils::LINE_SEGMENT)
+                segment.line.endPoint1 = point;
+            else
+                segment.quadBezierCurve.anchor1 = point;
+        }
+
+        static void SetEnd(DOM::Utils::SEGMENT& segment, const DOM::Utils::POINT2D& point)
+        {
+            if (segment.segmentType == DOM::Utils::LINE_SEGMENT)
+                segment.line.endPoint2 = point;
+            else
+                segment.quadBezierCurve.anchor2 = point;
+        }
+
+        static DOM::Utils::SEGMENT MakeLine(const DOM::Utils::POINT2D& start, const DOM::Utils::POINT2D& end)
+        {
+            DOM::Utils::SEGMENT line;
+            line.structSize = sizeof(DOM::Utils::SEGMENT);
+            line.segmentType = DOM::Utils::LINE_SEGMENT;
+            line.line.endPoint1 = start;
+            line.line.endPoint2 = end;
+            return line;
+        }
+
+        static double Distance(const DOM::Utils::POINT2D& a, const DOM::Utils::POINT2D& b)
+        {
+            return std::hypot((double)a.x - b.x, (double)a.y - b.y);
+        }
+
+        // Distance from p to the segment [a, b]
+        static double DistanceToLine(const DOM::Utils::POINT2D& p, const DOM::Utils::POINT2D& a, const DOM::Utils::POINT2D& b)
+        {
+            double dx = (double)b.x - a.x;
+            double dy = (double)b.y - a.y;
+            double length2 = dx * dx + dy * dy;
+            double s = length2 > 0 ? (((double)p.x - a.x) * dx + ((double)p.y - a.y) * dy) / length2 : 0;
+
+            s = s < 0 ? 0 : (s > 1 ? 1 : s);
+            return std::hypot(a.x + s * dx - p.x, a.y + s * dy - p.y);
+        }
+
+        // Flattens the curves within 'flatten' of their chord, drops the
+        // edges shorter than 'snap' and makes every edge start exactly where
+        // the previous one ends, the last one included when the path closes.
+        void Join(const std::vector<DOM::Utils::SEGMENT>& edges, double flatten, double snap)
+        {
+            m_joined.reserve(edges.size());
+            for (size_t i = 0; i < edges.size(); i++)
+            {
+                DOM::Utils::SEGMENT segment = edges[i];
+
+                if (segment.segmentType == DOM::Utils::QUAD_BEZIER_SEGMENT)
+                {
+                    // A quad bulges |anchor1 - 2 * control + anchor2| / 4 from its chord
+                    const DOM::Utils::QUAD_BEZIER_CURVE& quad = segment.quadBezierCurve;
+                    double bulge = std::hypot(
+                        (double)quad.anchor1.x - 2.0 * quad.control.x + quad.anchor2.x,
+                        (double)quad.anchor1.y - 2.0 * quad.control.y + quad.anchor2.y) / 4;
+
+                    if (bulge <= flatten)
+                        segment = MakeLine(quad.anchor1, quad.anchor2);
+                }
+
+                if (!m_joined.empty() && Distance(GetEnd(m_joined.back()), GetStart(segment)) <= snap)
+                    SetStart(segment, GetEnd(m_joined.back()));
+
+                if (IsDegenerate(segment, snap))
+                    continue;
+
+                m_joined.push_back(segment);
+            }
+
+            if (m_joined.size() > 1 &&
+                Distance(GetEnd(m_joined.back()), GetStart(m_joined.front())) <= snap)
+                SetEnd(m_joined.back(), GetStart(m_joined.front()));
+        }
+
+        static bool IsDegenerate(const DOM::Utils::SEGMENT& segment, double snap)
+        {
+            if (segment.segmentType == DOM::Utils::LINE_SEGMENT)
+                return Distance(segment.line.endPoint1, segment.line.endPoint2) <= snap;
+
+            const DOM::Utils::QUAD_BEZIER_CURVE& quad = segment.quadBezierCurve;
+            return Distance(quad.anchor1, quad.anchor2) <= snap &&
+                Distance(quad.anchor1, quad.control) <= snap;
+        }
+
+        // Replaces every run of lines by the fewest lines within tolerance
+        // of it. The ends of a run stay, so curves are never touched.
+        void SimplifyLines(double tolerance)
+        {
+            m_simplified.reserve(m_joined.size());
+
+            size_t i = 0;
+            while (i < m_joined.size())
+            {
+                if (m_joined[i].segmentType != DOM::Utils::LINE_SEGMENT)
+                {
+                    m_simplified.push_back(m_joined[i]);
+                    i++;
+                    continue;
+                }
+
+                // A run also ends where the next line does not start at the
+                // end of the previous one
+                m_points.clear();
+                m_points.push_back(m_joined[i].line.endPoint1);
+                do
+                {
+                    m_points.push_back(m_joined[i].line.endPoint2);
+                    i++;
+                }
+                while (i < m_joined.size() && m_joined[i].segmentType == DOM::Utils::LINE_SEGMENT &&
+                    m_joined[i].line.endPoint1.x == m_points.back().x &&
+                    m_joined[i].line.endPoint1.y == m_points.back().y);
+
+                MarkKeptPoints(tolerance);
+
+                size_t start = 0;
+                for (size_t p = 1; p < m_points.size(); p++)
+                {
+                    if (m_keep[p])
+                    {
+                        m_simplified.push_back(MakeLine(m_points[start], m_points[p]));
+                        start = p;
+                    }
+                }
+            }
+        }
+
+        // Douglas-Peucker over m_points, without recursion
+        void MarkKeptPoints(double tolerance)
+        {
+            size_t last = m_points.size() - 1;
+
+            m_keep.assign(m_points.size(), false);
+            m_keep[0] = m_keep[last] = true;
+
+            m_ranges.clear();
+            m_ranges.push_back(std::make_pair(0, last));
+            while (!m_ranges.empty())
+            {
+                size_t first = m_ranges.back().first;
+                size_t end = m_ranges.back().second;
+                size_t farthest = first;
+                double farthestDistance = tolerance;
+
+                m_ranges.pop_back();
+                for (size_t p = first + 1; p < end; p++)
+                {
+                    double distance = DistanceToLine(m_points[p], m_points[first], m_points[end]);
+                    if (distance > farthestDistance)
+                    {
+                        farthest = p;
+                        farthestDistance = distance;
+                    }
+                }
+
+                if (farthest != first)
+                {
+                    m_keep[farthest] = true;
+                    m_ranges.push_back(std::make_pair(first, farthest));
+                    m_ranges.push_back(std::make_pair(farthest, end));
+                }
+            }
+        }
+
+    private:
+
+        // Reused from one path to the next
+        std::vector<DOM::Utils::SEGMENT> m_joined;
+
+        std::vector<DOM::Utils::SEGMENT> m_simplified;
+
+        std::vector<DOM::Utils::POINT2D> m_points;
+
+        std::vector<bool> m_keep;
+
+        std::vector<std::pair<size_t, size_t> > m_ranges;
+    };
+};
+
+#endif // PATH_SIMPLIFIER_H_
@@ -0,0 +1,238 @@
+/*************************************************************************
+* ADOBE CONFIDENTIAL
+* ___________________
+*
+*  Copyright 2018 Adobe Systems Incorporated
+*  All Rights Reserved.
+*
+* NOTICE:  All information contained herein is, and remains
+* the property of Adobe Systems Incorporated and its suppliers,
+* if any.  The intellectual and technical concepts contained
+* herein are proprietary to Adobe Systems Incorporated and its
+* suppliers and are protected by all applicable intellectual property
+* laws, including trade secret and copyright laws.
+* Dissemination of this information or reproduction of this material
+* is strictly forbidden unless prior written permission is obtained
+* from Adobe Systems Incorporated.
+**************************************************************************/
+
+/**
+ * @file  PublishBenchmark.h
+ *
+ * @brief This file contains the measurements of a benchmark run and their
+ *        comparison with a stored baseline.
+ */
+
+#ifndef PUBLISH_BENCHMARK_H_
+#define PUBLISH_BENCHMARK_H_
+
+#include "FCMTypes.h"
+#include "Utils.h"
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef _WINDOWS
+    #include "Windows.h"
+    #include "Psapi.h"
+    #pragma comment(lib, "Psapi.lib")
+#else
+    #include <sys/resource.h>
+#endif
+
+/* -------------------------------------------------- Macros / Constants */
+
+// A result this much above its baseline is reported as a regression
+#define BENCHMARK_REGRESSION_RATIO  1.1
+
+/* -------------------------------------------------- Structs / Unions */
+
+namespace LottieExporter
+{
+    struct BENCHMARK_RESULT
+    {
+        std::string name;
+
+        double value;
+
+        // "ms", "KB", "bytes" or "" (a count)
+        std::string unit;
+    };
+};
+
+/* -------------------------------------------------- Class Decl */
+
+namespace LottieExporter
+{
+    // Wall time of consecutive phases plus any other figure worth tracking.
+    // Every result is a cost: lower is better.
+    class PublishBenchmark
+    {
+    public:
+
+        PublishBenchmark(FCM::PIFCMCallback pCallback) : m_pCallback(pCallback), m_inPhase(false)
+        {
+        }
+
+        // Ends the running phase, if any
+        void StartPhase(const std::string& name)
+        {
+            EndPhase();
+            m_phase = name;
+            m_phaseStart = std::chrono::steady_clock::now();
+            m_inPhase = true;
+        }
+
+        void EndPhase()
+        {
+            if (!m_inPhase)
+                return;
+
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - m_phaseStart;
+            AddResult(m_phase, elapsed.count(), "ms");
+            m_inPhase = false;
+        }
+
+        void AddResult(const std::string& name, double value, const std::string& unit)
+        {
+            BENCHMARK_RESULT result;
+            result.name = name;
+            result.value = value;
+            result.unit = unit;
+            m_results.push_back(result);
+        }
+
+        const std::vector<BENCHMARK_RESULT>& GetResults() const
+        {
+            return m_results;
+        }
+
+        // Peak resident memory of the process, in KB. It includes the host
+        // application, so only runs made in the same conditions compare.
+        static double GetPeakMemory()
+        {
+#ifdef _WINDOWS
+            PROCESS_MEMORY_COUNTERS counters;
+            if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+                return counters.PeakWorkingSetSize / 1024.0;
+            return 0;
+#else
+            struct rusage usage;
+            if (getrusage(RUSAGE_SELF, &usage) != 0)
+                return 0;
+#ifdef __APPLE__
+            // Bytes on macOS, KB elsewhere
+            return usage.ru_maxrss / 1024.0;
+#else
+            return (double)usage.ru_maxrss;
+#endif
+#endif
+        }
+
+        // Traces every result, next to its baseline value when the baseline
+        // file exists. Otherwise the results become the baseline. Returns
+        // the number of regressions.
+        FCM::U_Int32 Report(const std::string& baselineFile)
+        {
+            std::vector<BENCHMARK_RESULT> baseline;
+            FCM::U_Int32 regressions = 0;
+
+            EndPhase();
+
+            FCM::Boolean hasBaseline = !baselineFile.empty() && ReadBaseline(baselineFile, baseline);
+            for (size_t i = 0; i < m_results.size(); i++)
+            {
+                const BENCHMARK_RESULT& result = m_results[i];
+                const BENCHMARK_RESULT* pBase = hasBaseline ? Find(baseline, result.name) : NULL;
+                std::string unit = result.unit.empty() ? "" : " " + result.unit;
+
+                if (pBase && pBase->value > 0)
+                {
+                    double ratio = result.value / pBase->value;
+                    FCM::Boolean regressed = ratio > BENCHMARK_REGRESSION_RATIO;
+
+                    Utils::Trace(m_pCallback, "Benchmark %s: %.2f%s (baseline %.2f, %+.1f%%)%s\n",
+                        result.name.c_str(), result.value, unit.c_str(), pBase->value,
+                        (ratio - 1) * 100, regressed ? " REGRESSION" : "");
+                    if (regressed)
+                        regressions++;
+                }
+                else
+                {
+                    Utils::Trace(m_pCallback, "Benchmark %s: %.2f%s\n",
+                        result.name.c_str(), result.value, unit.c_str());
+                }
+            }
+
+            if (!baselineFile.empty() && !hasBaseline)
+            {
+                WriteBaseline(baselineFile);
+            }
+            return regressions;
+        }
+
+    private:
+
+        static const BENCHMARK_RESULT* Find(const std::vector<BENCHMARK_RESULT>& results, const std::string& name)
+        {
+            for (size_t i = 0; i < results.size(); i++)
+            {
+                if (results[i].name == name)
+                    return &results[i];
+            }
+            return NULL;
+        }
+
+        // One "name value unit" line per result
+        FCM::Boolean ReadBaseline(const std::string& baselineFile, std::vector<BENCHMARK_RESULT>& baseline)
+        {
+            std::fstream file;
+
+            Utils::OpenFStream(baselineFile, file, std::ios_base::in, m_pCallback);
+            if (!file)
+                return false;
+
+            BENCHMARK_RESULT result;
+            while (file >> result.name >> result.value)
+            {
+                std::getline(file, result.unit);
+                result.unit.erase(0, result.unit.find_first_not_of(' '));
+                baseline.push_back(result);
+            }
+            return true;
+        }
+
+        void WriteBaseline(const std::string& baselineFile)
+        {
+            std::fstream file;
+
+            Utils::OpenFStream(baselineFile, file, std::ios_base::trunc | std::ios_base::out, m_pCallback);
+            if (!file)
+            {
+                Utils::Trace(m_pCallback, "Benchmark baseline (%s) could not be written\n", baselineFile.c_str());
+                return;
+            }
+
+            for (size_t i = 0; i < m_results.size(); i++)
+            {
+                file << m_results[i].name << " " << m_results[i].value << " " << m_results[i].unit << "\n";
+            }
+            Utils::Trace(m_pCallback, "Benchmark baseline written to %s\n", baselineFile.c_str());
+        }
+
+    private:
+
+        FCM::PIFCMCallback m_pCallback;
+
+        std::vector<BENCHMARK_RESULT> m_results;
+
+        std::string m_phase;
+
+        std::chrono::steady_clock::time_point m_phaseStart;
+
+        FCM::Boolean m_inPhase;
+    };
+};
+
+#endif // PUBLISH_BENCHMARK_H_
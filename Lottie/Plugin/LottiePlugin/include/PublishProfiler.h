@@ -0,0 +1,312 @@
+/*************************************************************************
+* ADOBE CONFIDENTIAL
+* ___________________
+*
+*  Copyright 2018 Adobe Systems Incorporated
+*  All Rights Reserved.
+*
+* NOTICE:  All information contained herein is, and remains
+* the property of Adobe Systems Incorporated and its suppliers,
+* if any.  The intellectual and technical concepts contained
+* herein are proprietary to Adobe Systems Incorporated and its
+* suppliers and are protected by all applicable intellectual property
+* laws, including trade secret and copyright laws.
+* Dissemination of this information or reproduction of this material
+* is strictly forbidden unless prior written permission is obtained
+* from Adobe Systems Incorporated.
+**************************************************************************/
+
+/**
+ * @file  PublishProfiler.h
+ *
+ * @brief This file contains the timers and counters of the phases of a
+ *        publish.
+ */
+
+#ifndef PUBLISH_PROFILER_H_
+#define PUBLISH_PROFILER_H_
+
+#include "FCMTypes.h"
+#include "Utils.h"
+#include "JSONStreamWriter.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+/* -------------------------------------------------- Macros / Constants */
+
+// Suffix of the stats file written next to the Lottie JSON
+#define PUBLISH_STATS_FILE_EXTENSION    ".stats.json"
+
+/* -------------------------------------------------- Enums */
+
+namespace LottieExporter
+{
+    // Phases nest (frame command generation includes the palette calls it
+    // triggers), so their times do not add up to the total. The encoding
+    // phases are part of the palette calls defining the bitmaps and sounds.
+    enum ProfilePhase
+    {
+        PROFILE_PHASE_TOTAL = 0,
+        PROFILE_PHASE_FRAME_COMMANDS,
+        PROFILE_PHASE_REGIONS,
+        PROFILE_PHASE_SEGMENT_READ,
+        PROFILE_PHASE_SEGMENT_CONVERSION,
+        PROFILE_PHASE_TIMELINE_BUILD,
+        PROFILE_PHASE_KEYFRAME_REDUCTION,
+        PROFILE_PHASE_SERIALIZATION,
+        PROFILE_PHASE_ASSET_WAIT,
+        PROFILE_PHASE_IMAGE_ENCODING,
+        PROFILE_PHASE_SOUND_ENCODING,
+        PROFILE_PHASE_COUNT
+    };
+
+    enum ProfileCounter
+    {
+        PROFILE_COUNTER_LAYERS = 0,
+        PROFILE_COUNTER_GROUPS,
+        PROFILE_COUNTER_VERTICES,
+        PROFILE_COUNTER_KEYFRAMES,
+        PROFILE_COUNTER_IMAGES,
+        PROFILE_COUNTER_SOUNDS,
+        PROFILE_COUNTER_OUTPUT_BYTES,
+        PROFILE_COUNTER_CACHED_SYMBOLS,
+        PROFILE_COUNTER_COUNT
+    };
+};
+
+/* -------------------------------------------------- Class Decl */
+
+namespace LottieExporter
+{
+    // Accumulates the time spent in each phase and the size of what was
+    // exported. Safe to update from the export workers. Does nothing, and
+    // costs no clock reads, unless enabled.
+    class PublishProfiler
+    {
+    public:
+
+        PublishProfiler() : m_enabled(false)
+        {
+            Reset();
+        }
+
+        void SetEnabled(FCM::Boolean enabled)
+        {
+            m_enabled = enabled;
+        }
+
+        FCM::Boolean IsEnabled() const
+        {
+            return m_enabled;
+        }
+
+        void Reset()
+        {
+            for (int i = 0; i < PROFILE_PHASE_COUNT; i++)
+            {
+                m_time[i] = 0;
+                m_calls[i] = 0;
+            }
+            for (int i = 0; i < PROFILE_COUNTER_COUNT; i++)
+            {
+                m_counters[i] = 0;
+            }
+        }
+
+        // Clears the previous publish and starts its total time
+        void Start()
+        {
+            Reset();
+            if (m_enabled)
+                m_start = std::chrono::steady_clock::now();
+        }
+
+        void Stop()
+        {
+            if (m_enabled)
+                AddTime(PROFILE_PHASE_TOTAL, std::chrono::steady_clock::now() - m_start);
+        }
+
+        void AddTime(ProfilePhase phase, std::chrono::steady_clock::duration elapsed)
+        {
+            m_time[phase] += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+            m_calls[phase]++;
+        }
+
+        void AddCount(ProfileCounter counter, std::uint64_t count)
+        {
+            if (m_enabled)
+                m_counters[counter] += count;
+        }
+
+        void SetCount(ProfileCounter counter, std::uint64_t count)
+        {
+            if (m_enabled)
+                m_counters[counter] = count;
+        }
+
+        double GetTime(ProfilePhase phase) const
+        {
+            return m_time[phase] / 1e6;
+        }
+
+        std::uint64_t GetCalls(ProfilePhase phase) const
+        {
+            return m_calls[phase];
+        }
+
+        std::uint64_t GetCount(ProfileCounter counter) const
+        {
+            return m_counters[counter];
+        }
+
+        static const char* GetName(ProfilePhase phase)
+        {
+            static const char* names[PROFILE_PHASE_COUNT] =
+            {
+                "total",
+                "frame_commands",
+                "region_generation",
+                "segment_read",
+                "segment_conversion",
+                "timeline_build",
+                "keyframe_reduction",
+                "serialization",
+                "asset_wait",
+                "image_encoding",
+                "sound_encoding"
+            };
+            return names[phase];
+        }
+
+        static const char* GetName(ProfileCounter counter)
+        {
+            static const char* names[PROFILE_COUNTER_COUNT] =
+            {
+                "layers",
+                "groups",
+                "vertices",
+                "keyframes",
+                "images",
+                "sounds",
+                "output_bytes",
+                "cached_symbols"
+            };
+            return names[counter];
+        }
+
+        // Summary for the output panel
+        void Trace(FCM::PIFCMCallback pCallback) const
+        {
+            if (!m_enabled)
+                return;
+
+            Utils::Trace(pCallback, "Publish stats:\n");
+            for (int i = 0; i < PROFILE_PHASE_COUNT; i++)
+            {
+                if (m_calls[i] == 0)
+                    continue;
+
+                Utils::Trace(pCallback, "  %-20s %10.1f ms (%llu calls)\n", GetName((ProfilePhase)i),
+                    GetTime((ProfilePhase)i), (unsigned long long)GetCalls((ProfilePhase)i));
+            }
+            for (int i = 0; i < PROFILE_COUNTER_COUNT; i++)
+            {
+                Utils::Trace(pCallback, "  %-20s %10llu\n", GetName((ProfileCounter)i),
+                    (unsigned long long)GetCount((ProfileCounter)i));
+            }
+        }
+
+        // {"phases":{"<phase>":{"ms":..,"calls":..},..},"counters":{"<counter>":..,..}}
+        FCM::Result WriteStats(const std::string& fileName, FCM::PIFCMCallback pCallback) const
+        {
+            std::fstream file;
+
+            if (!m_enabled)
+                return FCM_SUCCESS;
+
+            Utils::OpenFStream(fileName, file, std::ios_base::trunc | std::ios_base::out | std::ios_base::binary, pCallback);
+            if (!file)
+            {
+                Utils::Trace(pCallback, "Stats file (%s) could not be opened\n", fileName.c_str());
+                return FCM_GENERAL_ERROR;
+            }
+
+            JSONStreamWriter writer(file);
+            writer.StartObject();
+            writer.StartObject("phases");
+            for (int i = 0; i < PROFILE_PHASE_COUNT; i++)
+            {
+                writer.StartObject(GetName((ProfilePhase)i));
+                writer.WriteProperty("ms", GetTime((ProfilePhase)i));
+                writer.WriteProperty("calls", (unsigned long long)GetCalls((ProfilePhase)i));
+                writer.EndObject();
+            }
+            writer.EndObject();
+            writer.StartObject("counters");
+            for (int i = 0; i < PROFILE_COUNTER_COUNT; i++)
+            {
+                writer.WriteProperty(GetName((ProfileCounter)i), (unsigned long long)GetCount((ProfileCounter)i));
+            }
+            writer.EndObject();
+            writer.EndObject();
+            writer.Flush();
+
+            return FCM_SUCCESS;
+        }
+
+    private:
+
+        FCM::Boolean m_enabled;
+
+        std::chrono::steady_clock::time_point m_start;
+
+        std::atomic<std::int64_t> m_time[PROFILE_PHASE_COUNT];
+
+        std::atomic<std::uint64_t> m_calls[PROFILE_PHASE_COUNT];
+
+        std::atomic<std::uint64_t> m_counters[PROFILE_COUNTER_COUNT];
+    };
+
+
+    // Adds the time until the end of the scope to a phase
+    class ProfileScope
+    {
+    public:
+
+        ProfileScope(PublishProfiler& profiler, ProfilePhase phase) :
+            m_profiler(profiler),
+            m_phase(phase),
+            m_enabled(profiler.IsEnabled())
+        {
+            if (m_enabled)
+                m_start = std::chrono::steady_clock::now();
+        }
+
+        ~ProfileScope()
+        {
+            if (m_enabled)
+                m_profiler.AddTime(m_phase, std::chrono::steady_clock::now() - m_start);
+        }
+
+    private:
+
+        ProfileScope(const ProfileScope&);
+        ProfileScope& operator=(const ProfileScope&);
+
+    private:
+
+        PublishProfiler& m_profiler;
+
+        ProfilePhase m_phase;
+
+        FCM::Boolean m_enabled;
+
+        std::chrono::steady_clock::time_point m_start;
+    };
+};
+
+#endif // PUBLISH_PROFILER_H_
@@ -27,43 +27,33 @@
 #include<iostream>
 #define COORD_ERR 0.0001
 #include <memory>
+#include <algorithm>
 #include <string>
+#include "ObjectArena.h"
+#include "IdTable.h"
 
 
 #define ENUM_TO_STR(ENUM) std::string(#ENUM)
 #define INVALID_LAYER_INDEX -1
+// Default error allowed when fitting transform keyframes (px, % or degrees).
+// A negative tolerance keeps every sampled keyframe.
+#define KEYFRAME_REDUCTION_TOLERANCE 0.05f
 struct coordinates
 {
     double x;
     double y;
 };
-struct offsetkeyframe
-{
-    float start[3]={0};
-    float time;
-    coordinates i;
-    coordinates o;
-    int h=1; //for hold interpolation
-    
-};
 struct anchor_point{
     int a = 0;
     float k[3]={0,0,0};
     int ix=1;
     int frame_number;
 };
-struct multidimensional_keyframed
-{
-   coordinates ti;
-   coordinates to;
-};
 struct position{
     int a = 0;
     float k[3]={0,0,0};
     int ix=2;
     int frame_number;
-    offsetkeyframe offset; ///for in and out values
-    multidimensional_keyframed multi_keyframe; //for ti and to
     
 };
 struct scale{
@@ -71,14 +61,12 @@ struct scale{
     float k[3] = { 100,100,100 };
     int ix=6;
     float frame_number;
-    offsetkeyframe offset;
 };
 struct rotation{
     int a = 0;
     float k = 0;
     int ix=10;
     int frame_number;
-    offsetkeyframe offset;
     
 };
 struct opacity{
@@ -118,10 +106,82 @@ struct layer_prop {
     std::vector<skew_axis>sa;
     //skew_axis sa;
 };
+#define KEYFRAME_TRACK_MAX_DIMS 2
+// Keys of one animated transform property, one column per field: the
+// times, the values (dims per key) and whether each key holds until the
+// next one. The ease handles (dims per key) are only filled in by the
+// keyframe reduction; until then every key is a hold.
+struct keyframe_track
+{
+    int dims = 2;
+    int ix = 0;
+    std::vector<float> t;
+    std::vector<float> v;
+    std::vector<std::uint8_t> h;
+    std::vector<coordinates> o;
+    std::vector<coordinates> i;
+
+    std::uint32_t Size() const { return t.size(); }
+    bool IsAnimated() const { return t.size() > 1; }
+    bool IsEased() const { return !o.empty(); }
+    float* Value(std::uint32_t key) { return &v[key * dims]; }
+    const float* Value(std::uint32_t key) const { return &v[key * dims]; }
+    void Reserve(std::uint32_t keys)
+    {
+        t.reserve(keys);
+        v.reserve(keys * dims);
+        h.reserve(keys);
+    }
+    void Add(float time, const float* value)
+    {
+        t.push_back(time);
+        v.insert(v.end(), value, value + dims);
+        h.push_back(1);
+    }
+    // The value a placement was created with, at the frame it was placed on
+    void SetLast(float time, const float* value)
+    {
+        t.back() = time;
+        std::copy(value, value + dims, Value(Size() - 1));
+    }
+    void Clear()
+    {
+        t.clear();
+        v.clear();
+        h.clear();
+        o.clear();
+        i.clear();
+    }
+};
+// Transform of a layer. Only position, scale and rotation are animated,
+// the anchor point and opacity stay at their defaults.
+struct layer_transform {
+    keyframe_track p;
+    keyframe_track s;
+    keyframe_track r;
+    anchor_point a;
+    opacity o;
+    layer_transform()
+    {
+        p.dims = 2;
+        p.ix = 2;
+        s.dims = 2;
+        s.ix = 6;
+        r.dims = 1;
+        r.ix = 10;
+    }
+};
 enum Layer_type
 {
     Precomp,Solid,Image,Null,Shape,Text
 };
+// How a symbol instance goes through the frames of its symbol
+enum Instance_loop
+{
+    LoopInstance,       //from the first frame to the end, over and over
+    PlayOnceInstance,   //from the first frame to the end, then holds it
+    SingleFrameInstance //shows the first frame only
+};
 struct color
 {
     int a=0;
@@ -281,21 +341,21 @@ struct stroke{
 };
 struct size{
     int a=0;
-    int k[2];
+    float k[2]={0};
     int ix=2;
     int frame_number;
 };
 struct position_for_rect
 {
     int a=0;
-    int k[2]={0};
+    float k[2]={0};
     int ix=3;
     
 };
 struct rect_rounded_corners
 {
     int a=0;
-    int k=0;
+    float k=0;
     int ix=4;
 };
 struct rect
@@ -311,26 +371,24 @@ struct rect
     rect_rounded_corners r;
     
 };
-struct x{
-    int a=0;
-    int k=0;
-    int ix=4;
-};
-
-struct maskproperties
+struct ellipse
 {
-    bool inv=false;
-    std::string nm="Mask ";
-    ks pt;
-    opacity o;
-    std::string mode;
-    x expansion;
+    std::string ty="el";
+    bool isellipse=false;
+    int d=1;
+    size s;
+    position_for_rect p;
+    std::string nm="Ellipse Path 1";
+    std::string mn="ADBE Vector Shape - Ellipse";
+    bool hd=false;
 };
-
 struct group{
     std::string ty="gr";
-    rect r; //only for null layer
+    rect r; //stage rectangle of a null layer, or a path recognised as a rectangle
+    ellipse el;
+    float shape_angle=0; //degrees the rectangle or ellipse is turned around its centre
     shape sh;
+    std::vector<struct ks> holes; //more paths of the fill, cut out by its even-odd rule
     fill fl;
     stroke st;
     layer_prop ks;
@@ -354,15 +412,22 @@ struct image_resource
     int resourceid;
     std::string cl;
     std::string ref_id;
+    std::string u;  //asset folder, set once the bitmap is exported
+    std::string p;  //asset file name
     
 };
-struct hole_layer
+// Paths of a shape layer whose geometry is tweened. Key k of the path of
+// group g is paths[g][k]; every key of a group has the same vertex count.
+// A key holds until the next one unless h is 0, then it moves linearly.
+struct path_track
 {
-     group * gr;
-     std::vector<maskproperties *>mp;
-    bool hasmask= true;
-};
+    std::vector<float> t;
+    std::vector<std::uint8_t> h;
+    std::vector<std::vector<ks> > paths;
 
+    std::uint32_t Size() const { return t.size(); }
+    bool IsAnimated() const { return t.size() > 1; }
+};
 struct Layer
 {
     std::uint32_t ddd = 0;
@@ -380,13 +445,34 @@ struct Layer
     std::uint32_t bm = 0;
     std::uint32_t parent_ind=ind;
     std::uint32_t placeafterobjectId;
+    Instance_loop loop = LoopInstance;  //symbol instances only
+    std::uint32_t first_frame = 0;      //first symbol frame an instance shows
     
     //int call=0;
-    layer_prop ks;
+    layer_transform ks;
+    path_track morph;
 
    
     
 };
+// Layers of a timeline. The root timelines of the scenes make the main
+// composition; a symbol timeline is built once into a precomp asset that
+// every instance of the symbol refers to.
+struct composition
+{
+    std::string id;     //asset id, empty for the main composition
+    std::string nm;
+    int resourceId = 0;
+    std::uint32_t op = 0;   //frames of the timeline
+    // The symbol origin sits at (-left, -top) inside the precomp
+    double left = 0;
+    double top = 0;
+    double width = 0;
+    double height = 0;
+    bool cached = false;    //written as an earlier publish wrote it; left as built
+    std::vector<Layer *> layers;
+    LottieExporter::IdTable<Layer *> objectId_layer;
+};
 
 
 
@@ -414,38 +500,79 @@ namespace  LottieExporter {
         int                                 GetIp(){return m_ip;}
         int                                 GetOp(){return m_op;}
         //vector<Layer>                       GetLayers(){return layers;}
-        int                                 GetNumofLayers(){return layers.size();}
-        int                                 GetNumofGroups(int resourceid){return resourceId_group[resourceid].size();}
+        int                                 GetNumofLayers() const;
+        size_t                              GetNumofAllGroups() const {return m_groupArena.Size();}
+        size_t                              GetNumofKeyframes() const;
+        int                                 GetNumofGroups(int resourceid) const {return GetGroupAtResourceId(resourceid).size();}
 		std::string                         GetVersion() { return m_version; }
 		void                                SetVersion(std::string val) { m_version = val; }
 		void                                SetStageWidthHeight(int width, int height) { mStageWidth = width, mStageHeight = height; }
 		void                                GetStageWidthHeight(int &width, int &height) { width = mStageWidth, height = mStageHeight; }
         void                                 SetOp(int frameindex){if(m_op<frameindex) m_op=frameindex;}
+        // Frames of the timeline being built, to size the keyframe tracks
+        void                                SetFrameCount(int frameCount) { m_frameCount = frameCount; }
+        int                                 GetFrameCount() const { return m_frameCount; }
+        // Scenes play one after the other in the main composition. Resource
+        // ids belong to a scene, so the ones of the previous scene are dropped.
+        void                                StartScene(int firstFrame, int frameCount)
+        {
+            m_sceneStart = firstFrame;
+            m_frameCount = firstFrame + frameCount;
+            sceneResourceId.Clear();
+        }
+        int                                 GetSceneStart() const { return m_sceneStart; }
+        // Resources of the current scene that are known by another id in
+        // the model, because an earlier scene used the id or the resource
+        void                                MapResourceId(int resourceId, int globalId) { sceneResourceId.Insert(resourceId) = globalId; }
+        int                                 GetResourceId(int resourceId) const
+        {
+            const int * globalId = sceneResourceId.Find(resourceId);
+            return globalId ? *globalId : resourceId;
+        }
+        // Every timeline builds its own composition; layers are created in
+        // and looked up from the one set last
+        composition *                       CreateComposition() { return m_compositionArena.Create(); }
+        void                                SetComposition(composition * comp) { m_composition = comp; }
+        // A symbol timeline of 'frameCount' frames is complete: it becomes a
+        // precomp asset, its layers under a null layer at the symbol origin
+        void                                DefineComposition(composition * comp, int resourceId, const std::string& name, int frameCount);
+        // Resizes a symbol precomp to the bounds of its content, relative to
+        // the symbol origin, and moves the origin layer along
+        void                                SetCompositionBounds(composition * comp, double left, double top, double width, double height);
+        // The root timeline of a scene is complete: its layers join the main
+        // composition, under the root layer
+        void                                AddToMainComposition(composition * comp);
+        // Index 0 is the main composition, the symbols follow in the order
+        // they were defined
+        size_t                              GetNumofCompositions() const { return m_compositions.size() + 1; }
+        const composition *                 GetCompositionAtIndex(size_t index) const
+        {
+            return index == 0 ? &m_mainComposition : m_compositions[index - 1];
+        }
+        composition *                       GetCompositionAtIndex(size_t index)
+        {
+            return index == 0 ? &m_mainComposition : m_compositions[index - 1];
+        }
+        const composition *                 GetCompositionOfResource(int resourceId) const
+        {
+            composition * const * comp = resourceId_composition.Find(resourceId);
+            return comp ? *comp : NULL;
+        }
         void                                CreateLayer(enum Layer_type ty,int parent_ind , int objectid,int resourceId,int placeafterobjectid)
         {
-            layers.push_back(new Layer);
+            std::vector<Layer *>& layers = m_composition->layers;
+            layers.push_back(m_layerArena.Create());
             std::uint32_t size=layers.size();
-            layers[size-1]->op=GetOp();
+            layers[size-1]->op=0; //until removed or its timeline ends
             layers[size-1]->ty=ty;
             layers[size-1]->ind=size;
             layers[size-1]->parent_ind=parent_ind;
-            position pos;
-            pos.k[0]=0;
-            pos.k[1]=0;
-            pos.frame_number=0;
-            layers[size-1]->ks.p.push_back(pos);
-            scale s;
-            layers[size-1]->ks.s.push_back(s);
-            anchor_point a;
-            layers[size-1]->ks.a.push_back(a);
-            opacity o;
-            layers[size-1]->ks.o.push_back(o);
-            rotation r;
-            layers[size-1]->ks.r.push_back(r);
-            skew sk;
-            layers[size-1]->ks.sk.push_back(sk);
-            skew_axis sa;
-            layers[size-1]->ks.sa.push_back(sa);
+            const float pos[2] = { 0, 0 };
+            layers[size-1]->ks.p.Add(0, pos);
+            const float s[2] = { 100, 100 };
+            layers[size-1]->ks.s.Add(0, s);
+            const float r = 0;
+            layers[size-1]->ks.r.Add(0, &r);
             layers[size-1]->objectId = objectid;
             layers[size-1]->resourceId = resourceId;
             layers[size-1]->placeafterobjectId = placeafterobjectid;
@@ -454,7 +581,8 @@ namespace  LottieExporter {
             if(layers[size-1]->ty == 2)
             {
                 image_resource * img =Getimage_resource_with_id(resourceId);
-                layers[size-1]->nm=img->libitemname;
+                if (img)
+                    layers[size-1]->nm=img->libitemname;
                 
             }
             else
@@ -468,13 +596,13 @@ namespace  LottieExporter {
         
         void shape_layer_map(int objectId, Layer * layer)
         {
-            objectId_layer[objectId] = layer;
+            m_composition->objectId_layer.Insert(objectId) = layer;
             //std:: cout<<"bm"<<shapeid_layer[objectId]->bm<<std::endl;
         }
         
         void resource_group_map(int resourceId, group * gr)
         {
-            resourceId_group[resourceId].push_back(gr);
+            resourceId_group.Insert(resourceId).push_back(gr);
             //std:: cout<<"bm"<<shapeid_layer[objectId]->bm<<std::endl;
         }
         bool comparePlaceAfterObject(const Layer& a, const Layer& b)
@@ -487,6 +615,7 @@ namespace  LottieExporter {
         }
         void SortLayers()
         {
+            std::vector<Layer *>& layers = m_composition->layers;
             std::sort(layers.begin(),layers.end(),[this](Layer* a, Layer* b) { return this->LottieManager::comparePlaceAfterObject(*a, *b); });
         }
         
@@ -494,6 +623,7 @@ namespace  LottieExporter {
         
         Layer *                                 GetLayer()
         {
+            const std::vector<Layer *>& layers = m_composition->layers;
             std::uint32_t size=layers.size();
             if(size!=0)
                 return layers[size-1];
@@ -502,29 +632,30 @@ namespace  LottieExporter {
         }
         Layer *                                 GetLayerAtIndex(int index)
         {
+            const std::vector<Layer *>& layers = m_composition->layers;
             std::uint32_t size=layers.size();
             if(index >= 0 && index < size)
             {return layers[index];}
             else
                 return NULL;
         }
-        Layer *                                 GetLayerAtObjectId(int objectId)
+        // Lookups by id return NULL (or an empty list) for unknown ids and
+        // never add an entry
+        Layer *                                 GetLayerAtObjectId(int objectId) const
         {
-            //std::uint32_t size=layers.size();
-            return objectId_layer[objectId];
-            
+            Layer * const * layer = m_composition->objectId_layer.Find(objectId);
+            return layer ? *layer : NULL;
         }
-        std::vector<group *>                                GetGroupAtResourceId(int resourceId)
+        const std::vector<group *> &            GetGroupAtResourceId(int resourceId) const
         {
-            //std::uint32_t size=layers.size();
-            return resourceId_group[resourceId];
-            
+            const std::vector<group *> * groups = resourceId_group.Find(resourceId);
+            return groups ? *groups : m_noGroups;
         }
-        std::map<int, Layer*> GetobjIdLayer()
+        const IdTable<Layer*> &                 GetobjIdLayer() const
         {
-            return objectId_layer;
+            return m_composition->objectId_layer;
         }
-        std::map<int, image_resource*> Getimageresource_id()
+        const IdTable<image_resource*> &        Getimageresource_id() const
         {
             return image_resource_id;
         }
@@ -537,20 +668,9 @@ namespace  LottieExporter {
             gr[size-1]->hasmask=true;
  
         }*/
-       void CreateHoleLayer(group * gr)
-        {
-            hole_layers.push_back(new hole_layer);
-            std::uint32_t size = hole_layers.size();
-            hole_layers[size-1]->gr = gr;
-            
-            
-            
-        }
-        
-        
         void                                CreateGroup()
         {
-            gr.push_back(new group);
+            gr.push_back(m_groupArena.Create());
             std::uint32_t size=gr.size();
             //gr[size-1]->parent_layer=layers.size();
             position pos;
@@ -593,35 +713,11 @@ namespace  LottieExporter {
             else
                 return NULL;
         }
-        void DeleteLastGroup(int resourceId)
-        {
-            gr.pop_back();
-            resourceId_group[resourceId].pop_back();
-        }
-        hole_layer *                               Getholelayer()
-        {   std::uint32_t size=hole_layers.size();
-            if(size!=0)
-                return hole_layers[size-1];
-            else
-                return NULL;
-        }
-        std::vector<hole_layer * >                              GetholelayersAtresourceid( int resourceid)
-        {
-                return resource_hole[resourceid];
-          
-        }
-        hole_layer *                             Getholelayerfrommap( int resourceid,int j)
+        group *                                 GetGroupAtIndex(int index,int resource_id) const
         {
-            return resource_hole[resourceid][j];
-            
+            const std::vector<group *> & groups = GetGroupAtResourceId(resource_id);
+            return (index >= 0 && index < (int)groups.size()) ? groups[index] : NULL;
         }
-        group *                                 GetGroupAtIndex(int index,int resource_id)
-        {
-    
-            return resourceId_group[resource_id][index];
-          
-                
-            }
         void GetFileExtension(const std::string& path, std::string& extension)
         {
             size_t index = path.find_last_of(".");
@@ -633,7 +729,7 @@ namespace  LottieExporter {
         }
         
         void createimage_resourceid(int width,int height,std::string libitemname,int resourceid){
-            image_resources.push_back(new image_resource);
+            image_resources.push_back(m_imageResourceArena.Create());
             std::uint32_t size=image_resources.size();
             image_resources[size-1]->width = width;
             image_resources[size-1]->height = height;
@@ -657,55 +753,79 @@ namespace  LottieExporter {
             else
                 return NULL;
         }
-        image_resource *                               Getimage_resource_with_id(int resourceid)
+        int                                 GetNumofImageResources(){return image_resources.size();}
+        image_resource *                               GetImageResourceAtIndex(int index)
         {
-                return image_resource_id[resourceid];
-          
+            return image_resources[index];
         }
-        
-        void image_resource_id_map(int resourceId, image_resource * image_resource)
+        image_resource *                               Getimage_resource_with_id(int resourceid) const
         {
-            image_resource_id[resourceId] = image_resource;
-           
-        }
-        void hole_layer_resource_id_map(int resourceId, hole_layer * hole_layer)
-        {
-            resource_hole[resourceId] .push_back( hole_layer);
-            
+            image_resource * const * image = image_resource_id.Find(resourceid);
+            return image ? *image : NULL;
         }
-          void object_resource_map(int resourceId,int objectid){
-            object_resource[resourceId].push_back(objectid);
-        }
-        std::map<int,std::vector<hole_layer *>>  get_hole_resource_map()
+        
+        void image_resource_id_map(int resourceId, image_resource * image_resource)
         {
-            return resource_hole;
+            image_resource_id.Insert(resourceId) = image_resource;
         }
-         std::map<int,std::vector<int>>  get_object_resource_map()
+
+        // Objects created for the model so far
+        size_t                              GetObjectCount() const
         {
-            return object_resource;
+            return m_layerArena.Size() + m_groupArena.Size() + m_imageResourceArena.Size() + m_compositionArena.Size();
         }
+
+        // Replaces the per frame hold keys of the layer transforms with
+        // interpolated keyframes that stay within the given tolerance
+        void                                ReduceKeyframes(float tolerance);
+
+        // Merges the shape layers of a shape tween (or frame by frame shape
+        // animation), one per frame at the same depth, into a single layer
+        // with an animated path. Keys within tolerance of a linear
+        // interpolation are dropped unless the tolerance is negative.
+        void                                MergeShapeTweens(float tolerance);
+
+        // Turns transform tracks and animated paths whose keys all have the
+        // same value into a single static key
+        void                                CollapseStaticTracks();
         
 		
 		
 	
 
+        // The same for a single composition. The passes above leave out
+        // the cached compositions.
+        void                                ReduceKeyframes(composition& comp, float tolerance);
+        void                                MergeShapeTweens(composition& comp, float tolerance);
+        void                                CollapseStaticTracks(composition& comp);
+
 	private:
+
 		std::string									m_version="5.5.4";
 		int                                 m_fps = 24;
+        int                                 m_frameCount = 0;
+        int                                 m_sceneStart = 0;
         int                                 m_ip=0;
         int                                 m_op=0;
 		float                               mStageHeight = 550;
 		float                               mStageWidth = 400;
 		std::string                         mOutputFilePath;
-        std::vector<Layer *>layers;
+        composition                         m_mainComposition;
+        composition *                       m_composition = &m_mainComposition;
+        std::vector<composition *>          m_compositions;
         std::vector<group *>gr;
         std::vector<image_resource *>image_resources;
-        std::map<int , Layer *>objectId_layer;
-        std::map<int , std::vector<group *> >resourceId_group;
-        std::map<int,image_resource *> image_resource_id;
-        std::map<int,std::vector<hole_layer * > > resource_hole;
-        std::vector<hole_layer *>hole_layers;
-        std::map<int,std::vector<int>> object_resource;
+        IdTable<int>sceneResourceId;
+        IdTable<composition *>resourceId_composition;
+        IdTable<std::vector<group *> >resourceId_group;
+        IdTable<image_resource *> image_resource_id;
+        const std::vector<group *>          m_noGroups;
+
+        // Storage of the model; released with the manager, once per publish
+        ObjectArena<Layer>                  m_layerArena;
+        ObjectArena<group>                  m_groupArena;
+        ObjectArena<image_resource>         m_imageResourceArena;
+        ObjectArena<composition>            m_compositionArena;
        
 	
 		
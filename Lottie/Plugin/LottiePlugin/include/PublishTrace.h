@@ -0,0 +1,912 @@
+/*************************************************************************
+* ADOBE CONFIDENTIAL
+* ___________________
+*
+*  Copyright 2018 Adobe Systems Incorporated
+*  All Rights Reserved.
+*
+* NOTICE:  All information contained herein is, and remains
+* the property of Adobe Systems Incorporated and its suppliers,
+* if any.  The intellectual and technical concepts contained
+* herein are proprietary to Adobe Systems Incorporated and its
+* suppliers and are protected by all applicable intellectual property
+* laws, including trade secret and copyright laws.
+* Dissemination of this information or reproduction of this material
+* is strictly forbidden unless prior written permission is obtained
+* from Adobe Systems Incorporated.
+**************************************************************************/
+
+/**
+ * @file  PublishTrace.h
+ *
+ * @brief This file contains the recorder and the reader of publish traces:
+ *        binary captures of the resource palette and timeline builder calls
+ *        of a publish, replayed without Animate.
+ */
+
+#ifndef PUBLISH_TRACE_H_
+#define PUBLISH_TRACE_H_
+
+#include "FCMTypes.h"
+#include "Utils/DOMTypes.h"
+#include "Utils.h"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <string>
+#include <vector>
+
+/* -------------------------------------------------- Macros / Constants */
+
+#define PUBLISH_TRACE_MAGIC         "LTRC"
+
+#define PUBLISH_TRACE_VERSION       1
+
+#define PUBLISH_TRACE_BUFFER_SIZE   (64 * 1024)
+
+/* -------------------------------------------------- Enums */
+
+namespace LottieExporter
+{
+    // Every record is the type (1 byte), the size of its payload (4 bytes)
+    // and the payload. Readers skip the types they do not know.
+    enum TraceRecordType
+    {
+        TRACE_RECORD_DOCUMENT = 1,
+
+        // Resource palette
+        TRACE_RECORD_DEFINE_SHAPE,
+        TRACE_RECORD_FILL_REGION,
+        TRACE_RECORD_STROKE_PATH,
+        TRACE_RECORD_SOLID_COLOR,
+        TRACE_RECORD_LINEAR_GRADIENT,
+        TRACE_RECORD_RADIAL_GRADIENT,
+        TRACE_RECORD_SOLID_STROKE,
+        TRACE_RECORD_PATH,
+        TRACE_RECORD_HOLES,
+        TRACE_RECORD_DEFINE_BITMAP,
+
+        // Timeline builders
+        TRACE_RECORD_CREATE_TIMELINE,
+        TRACE_RECORD_ADD_SHAPE,
+        TRACE_RECORD_ADD_BITMAP,
+        TRACE_RECORD_ADD_MOVIE_CLIP,
+        TRACE_RECORD_ADD_GRAPHIC,
+        TRACE_RECORD_UPDATE_Z_ORDER,
+        TRACE_RECORD_UPDATE_MASK,
+        TRACE_RECORD_REMOVE,
+        TRACE_RECORD_UPDATE_BLEND_MODE,
+        TRACE_RECORD_UPDATE_VISIBILITY,
+        TRACE_RECORD_UPDATE_DISPLAY_TRANSFORM,
+        TRACE_RECORD_SHOW_FRAME,
+        TRACE_RECORD_BUILD_TIMELINE,
+
+        // Document
+        TRACE_RECORD_START_SCENE
+    };
+};
+
+/* -------------------------------------------------- Class Decl */
+
+namespace LottieExporter
+{
+    // Receives the calls read back from a trace, in the order they were
+    // recorded. Timelines are told apart by the id given at their creation.
+    class IPublishTraceHandler
+    {
+    public:
+
+        virtual ~IPublishTraceHandler() {}
+
+        virtual void Document(
+            const DOM::Utils::COLOR& background,
+            FCM::U_Int32 stageHeight,
+            FCM::U_Int32 stageWidth,
+            FCM::U_Int32 fps) {}
+
+        virtual void DefineShape(FCM::U_Int32 resourceId) {}
+
+        virtual void FillRegion(FCM::U_Int32 resourceId) {}
+
+        virtual void StrokePath(FCM::U_Int32 resourceId) {}
+
+        virtual void SolidColor(const DOM::Utils::COLOR& color) {}
+
+        virtual void LinearGradient(
+            const DOM::Utils::MATRIX2D& matrix,
+            const std::vector<DOM::Utils::GRADIENT_COLOR_POINT>& colorPoints) {}
+
+        virtual void RadialGradient(
+            const DOM::Utils::MATRIX2D& matrix,
+            FCM::S_Int32 focalPoint,
+            const std::vector<DOM::Utils::GRADIENT_COLOR_POINT>& colorPoints) {}
+
+        virtual void SolidStroke(
+            FCM::Double thickness,
+            FCM::U_Int32 lineCap,
+            FCM::U_Int32 lineJoin,
+            FCM::Double miterLimit) {}
+
+        virtual void Path(const std::vector<DOM::Utils::SEGMENT>& edges, FCM::Boolean isHole) {}
+
+        virtual void Holes(FCM::U_Int32 resourceId) {}
+
+        virtual void DefineBitmap(
+            FCM::U_Int32 resourceId,
+            FCM::S_Int32 height,
+            FCM::S_Int32 width,
+            const std::string& libPathName,
+            const std::string& fileName) {}
+
+        virtual void CreateTimeline(FCM::U_Int32 timelineId) {}
+
+        // type is one of the TRACE_RECORD_ADD_* records
+        virtual void PlaceObject(
+            FCM::U_Int32 timelineId,
+            TraceRecordType type,
+            FCM::U_Int32 objectId,
+            FCM::U_Int32 resourceId,
+            FCM::U_Int32 placeAfterObjectId,
+            const DOM::Utils::MATRIX2D& matrix) {}
+
+        virtual void UpdateZOrder(FCM::U_Int32 timelineId, FCM::U_Int32 objectId, FCM::U_Int32 placeAfterObjectId) {}
+
+        virtual void UpdateMask(FCM::U_Int32 timelineId, FCM::U_Int32 objectId, FCM::U_Int32 maskTillObjectId) {}
+
+        virtual void Remove(FCM::U_Int32 timelineId, FCM::U_Int32 objectId) {}
+
+        virtual void UpdateBlendMode(FCM::U_Int32 timelineId, FCM::U_Int32 objectId, FCM::U_Int32 blendMode) {}
+
+        virtual void UpdateVisibility(FCM::U_Int32 timelineId, FCM::U_Int32 objectId, FCM::Boolean visible) {}
+
+        virtual void UpdateDisplayTransform(
+            FCM::U_Int32 timelineId,
+            FCM::U_Int32 objectId,
+            const DOM::Utils::MATRIX2D& matrix) {}
+
+        virtual void ShowFrame(FCM::U_Int32 timelineId) {}
+
+        // resourceId is 0 for the root timeline
+        virtual void BuildTimeline(FCM::U_Int32 timelineId, FCM::U_Int32 resourceId) {}
+
+        virtual void StartScene(FCM::U_Int32 firstFrame, FCM::U_Int32 frameCount) {}
+    };
+
+
+    // Records the calls of one publish. Every Record* is a no-op until the
+    // trace is opened, so call sites need no check.
+    class PublishTraceWriter
+    {
+    public:
+
+        PublishTraceWriter() : m_open(false), m_recordStart(0), m_lastTimelineId(0)
+        {
+        }
+
+        ~PublishTraceWriter()
+        {
+            Close();
+        }
+
+        FCM::Boolean Open(const std::string& fileName, FCM::PIFCMCallback pCallback)
+        {
+            Close();
+
+            Utils::OpenFStream(fileName, m_file, std::ios_base::trunc | std::ios_base::out | std::ios_base::binary, pCallback);
+            if (!m_file)
+            {
+                Utils::Trace(pCallback, "Publish trace (%s) could not be created\n", fileName.c_str());
+                return false;
+            }
+
+            m_open = true;
+            m_lastTimelineId = 0;
+            m_buffer.clear();
+            m_buffer.insert(m_buffer.end(), PUBLISH_TRACE_MAGIC, PUBLISH_TRACE_MAGIC + 4);
+            PutU32(PUBLISH_TRACE_VERSION);
+            return true;
+        }
+
+        void Close()
+        {
+            if (!m_open)
+                return;
+
+            Drain();
+            m_file.close();
+            m_open = false;
+        }
+
+        FCM::Boolean IsOpen() const
+        {
+            return m_open;
+        }
+
+        void RecordDocument(
+            const DOM::Utils::COLOR& background,
+            FCM::U_Int32 stageHeight,
+            FCM::U_Int32 stageWidth,
+            FCM::U_Int32 fps)
+        {
+            if (!Begin(TRACE_RECORD_DOCUMENT))
+                return;
+            PutColor(background);
+            PutU32(stageHeight);
+            PutU32(stageWidth);
+            PutU32(fps);
+            End();
+        }
+
+        void RecordDefineShape(FCM::U_Int32 resourceId) { RecordId(TRACE_RECORD_DEFINE_SHAPE, resourceId); }
+
+        void RecordFillRegion(FCM::U_Int32 resourceId) { RecordId(TRACE_RECORD_FILL_REGION, resourceId); }
+
+        void RecordStrokePath(FCM::U_Int32 resourceId) { RecordId(TRACE_RECORD_STROKE_PATH, resourceId); }
+
+        void RecordHoles(FCM::U_Int32 resourceId) { RecordId(TRACE_RECORD_HOLES, resourceId); }
+
+        void RecordSolidColor(const DOM::Utils::COLOR& color)
+        {
+            if (!Begin(TRACE_RECORD_SOLID_COLOR))
+                return;
+            PutColor(color);
+            End();
+        }
+
+        void RecordLinearGradient(
+            const DOM::Utils::MATRIX2D& matrix,
+            const std::vector<DOM::Utils::GRADIENT_COLOR_POINT>& colorPoints)
+        {
+            if (!Begin(TRACE_RECORD_LINEAR_GRADIENT))
+                return;
+            PutMatrix(matrix);
+            PutColorPoints(colorPoints);
+            End();
+        }
+
+        void RecordRadialGradient(
+            const DOM::Utils::MATRIX2D& matrix,
+            FCM::S_Int32 focalPoint,
+            const std::vector<DOM::Utils::GRADIENT_COLOR_POINT>& colorPoints)
+        {
+            if (!Begin(TRACE_RECORD_RADIAL_GRADIENT))
+                return;
+            PutMatrix(matrix);
+            PutU32((FCM::U_Int32)focalPoint);
+            PutColorPoints(colorPoints);
+            End();
+        }
+
+        void RecordSolidStroke(
+            FCM::Double thickness,
+            FCM::U_Int32 lineCap,
+            FCM::U_Int32 lineJoin,
+            FCM::Double miterLimit)
+        {
+            if (!Begin(TRACE_RECORD_SOLID_STROKE))
+                return;
+            PutDouble(thickness);
+            PutU32(lineCap);
+            PutU32(lineJoin);
+            PutDouble(miterLimit);
+            End();
+        }
+
+        // The edges as read from the DOM, before any curve split
+        void RecordPath(const std::vector<DOM::Utils::SEGMENT>& edges, FCM::Boolean isHole)
+        {
+            if (!Begin(TRACE_RECORD_PATH))
+                return;
+            PutU8(isHole ? 1 : 0);
+            PutU32((FCM::U_Int32)edges.size());
+            for (size_t i = 0; i < edges.size(); i++)
+            {
+                const DOM::Utils::SEGMENT& edge = edges[i];
+                if (edge.segmentType == DOM::Utils::LINE_SEGMENT)
+                {
+                    PutU8(0);
+                    PutPoint(edge.line.endPoint1);
+                    PutPoint(edge.line.endPoint2);
+                }
+                else
+                {
+                    PutU8(1);
+                    PutPoint(edge.quadBezierCurve.anchor1);
+                    PutPoint(edge.quadBezierCurve.control);
+                    PutPoint(edge.quadBezierCurve.anchor2);
+                }
+            }
+            End();
+        }
+
+        void RecordDefineBitmap(
+            FCM::U_Int32 resourceId,
+            FCM::S_Int32 height,
+            FCM::S_Int32 width,
+            const std::string& libPathName,
+            const std::string& fileName)
+        {
+            if (!Begin(TRACE_RECORD_DEFINE_BITMAP))
+                return;
+            PutU32(resourceId);
+            PutU32((FCM::U_Int32)height);
+            PutU32((FCM::U_Int32)width);
+            PutString(libPathName);
+            PutString(fileName);
+            End();
+        }
+
+        // Id of a new timeline builder; 0 while the trace is closed
+        FCM::U_Int32 RecordCreateTimeline()
+        {
+            if (!Begin(TRACE_RECORD_CREATE_TIMELINE))
+                return 0;
+            PutU32(++m_lastTimelineId);
+            End();
+            return m_lastTimelineId;
+        }
+
+        void RecordPlaceObject(
+            FCM::U_Int32 timelineId,
+            TraceRecordType type,
+            FCM::U_Int32 objectId,
+            FCM::U_Int32 resourceId,
+            FCM::U_Int32 placeAfterObjectId,
+            const DOM::Utils::MATRIX2D& matrix)
+        {
+            if (!Begin(type))
+                return;
+            PutU32(timelineId);
+            PutU32(objectId);
+            PutU32(resourceId);
+            PutU32(placeAfterObjectId);
+            PutMatrix(matrix);
+            End();
+        }
+
+        void RecordUpdateZOrder(FCM::U_Int32 timelineId, FCM::U_Int32 objectId, FCM::U_Int32 placeAfterObjectId)
+        {
+            RecordObject(TRACE_RECORD_UPDATE_Z_ORDER, timelineId, objectId, &placeAfterObjectId);
+        }
+
+        void RecordUpdateMask(FCM::U_Int32 timelineId, FCM::U_Int32 objectId, FCM::U_Int32 maskTillObjectId)
+        {
+            RecordObject(TRACE_RECORD_UPDATE_MASK, timelineId, objectId, &maskTillObjectId);
+        }
+
+        void RecordRemove(FCM::U_Int32 timelineId, FCM::U_Int32 objectId)
+        {
+            RecordObject(TRACE_RECORD_REMOVE, timelineId, objectId, NULL);
+        }
+
+        void RecordUpdateBlendMode(FCM::U_Int32 timelineId, FCM::U_Int32 objectId, FCM::U_Int32 blendMode)
+        {
+            RecordObject(TRACE_RECORD_UPDATE_BLEND_MODE, timelineId, objectId, &blendMode);
+        }
+
+        void RecordUpdateVisibility(FCM::U_Int32 timelineId, FCM::U_Int32 objectId, FCM::Boolean visible)
+        {
+            FCM::U_Int32 value = visible ? 1 : 0;
+            RecordObject(TRACE_RECORD_UPDATE_VISIBILITY, timelineId, objectId, &value);
+        }
+
+        void RecordUpdateDisplayTransform(FCM::U_Int32 timelineId, FCM::U_Int32 objectId, const DOM::Utils::MATRIX2D& matrix)
+        {
+            if (!Begin(TRACE_RECORD_UPDATE_DISPLAY_TRANSFORM))
+                return;
+            PutU32(timelineId);
+            PutU32(objectId);
+            PutMatrix(matrix);
+            End();
+        }
+
+        void RecordShowFrame(FCM::U_Int32 timelineId) { RecordId(TRACE_RECORD_SHOW_FRAME, timelineId); }
+
+        void RecordBuildTimeline(FCM::U_Int32 timelineId, FCM::U_Int32 resourceId)
+        {
+            RecordObject(TRACE_RECORD_BUILD_TIMELINE, timelineId, resourceId, NULL);
+        }
+
+        void RecordStartScene(FCM::U_Int32 firstFrame, FCM::U_Int32 frameCount)
+        {
+            if (!Begin(TRACE_RECORD_START_SCENE))
+                return;
+            PutU32(firstFrame);
+            PutU32(frameCount);
+            End();
+        }
+
+    private:
+
+        FCM::Boolean Begin(TraceRecordType type)
+        {
+            if (!m_open)
+                return false;
+
+            m_recordStart = m_buffer.size();
+            PutU8((FCM::U_Int8)type);
+            PutU32(0);
+            return true;
+        }
+
+        // Patches the payload size and hands full buffers to the file
+        void End()
+        {
+            FCM::U_Int32 size = (FCM::U_Int32)(m_buffer.size() - m_recordStart - 5);
+            for (int i = 0; i < 4; i++)
+            {
+                m_buffer[m_recordStart + 1 + i] = (char)((size >> (8 * i)) & 0xFF);
+            }
+
+            if (m_buffer.size() >= PUBLISH_TRACE_BUFFER_SIZE)
+                Drain();
+        }
+
+        void Drain()
+        {
+            if (!m_buffer.empty())
+            {
+                m_file.write(&m_buffer[0], m_buffer.size());
+                m_buffer.clear();
+            }
+        }
+
+        void RecordId(TraceRecordType type, FCM::U_Int32 id)
+        {
+            if (!Begin(type))
+                return;
+            PutU32(id);
+            End();
+        }
+
+        void RecordObject(TraceRecordType type, FCM::U_Int32 timelineId, FCM::U_Int32 objectId, const FCM::U_Int32* pValue)
+        {
+            if (!Begin(type))
+                return;
+            PutU32(timelineId);
+            PutU32(objectId);
+            if (pValue)
+                PutU32(*pValue);
+            End();
+        }
+
+        void PutU8(FCM::U_Int8 value)
+        {
+            m_buffer.push_back((char)value);
+        }
+
+        // Little endian, whatever the platform
+        void PutU32(FCM::U_Int32 value)
+        {
+            for (int i = 0; i < 4; i++)
+            {
+                m_buffer.push_back((char)((value >> (8 * i)) & 0xFF));
+            }
+        }
+
+        void PutDouble(double value)
+        {
+            std::uint64_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            for (int i = 0; i < 8; i++)
+            {
+                m_buffer.push_back((char)((bits >> (8 * i)) & 0xFF));
+            }
+        }
+
+        void PutString(const std::string& value)
+        {
+            PutU32((FCM::U_Int32)value.length());
+            m_buffer.insert(m_buffer.end(), value.begin(), value.end());
+        }
+
+        void PutColor(const DOM::Utils::COLOR& color)
+        {
+            PutU8(color.red);
+            PutU8(color.green);
+            PutU8(color.blue);
+            PutU8(color.alpha);
+        }
+
+        void PutPoint(const DOM::Utils::POINT2D& point)
+        {
+            PutDouble(point.x);
+            PutDouble(point.y);
+        }
+
+        void PutMatrix(const DOM::Utils::MATRIX2D& matrix)
+        {
+            PutDouble(matrix.a);
+            PutDouble(matrix.b);
+            PutDouble(matrix.c);
+            PutDouble(matrix.d);
+            PutDouble(matrix.tx);
+            PutDouble(matrix.ty);
+        }
+
+        void PutColorPoints(const std::vector<DOM::Utils::GRADIENT_COLOR_POINT>& colorPoints)
+        {
+            PutU32((FCM::U_Int32)colorPoints.size());
+            for (size_t i = 0; i < colorPoints.size(); i++)
+            {
+                PutU8(colorPoints[i].pos);
+                PutColor(colorPoints[i].color);
+            }
+        }
+
+    private:
+
+        std::fstream m_file;
+
+        FCM::Boolean m_open;
+
+        std::vector<char> m_buffer;
+
+        // Offset of the record being written in m_buffer
+        size_t m_recordStart;
+
+        FCM::U_Int32 m_lastTimelineId;
+    };
+
+
+    // Reads a trace back and hands its records to a handler
+    class PublishTraceReader
+    {
+    public:
+
+        PublishTraceReader(std::istream& in) : m_in(in), m_pos(0)
+        {
+        }
+
+        // FCM_INVALID_PARAM if the stream is not a trace or is truncated
+        FCM::Result Replay(IPublishTraceHandler& handler)
+        {
+            FCM::U_Int32 version;
+
+            // Magic, then the version
+            m_record.resize(8);
+            if (!m_in.read(&m_record[0], 8) || memcmp(&m_record[0], PUBLISH_TRACE_MAGIC, 4) != 0)
+                return FCM_INVALID_PARAM;
+
+            m_pos = 4;
+            GetU32(version);
+            if (version != PUBLISH_TRACE_VERSION)
+                return FCM_INVALID_PARAM;
+
+            for (;;)
+            {
+                char header[5];
+                if (!m_in.read(header, 5))
+                {
+                    // Clean end of the trace, unless a header was cut
+                    return (m_in.gcount() == 0) ? FCM_SUCCESS : FCM_INVALID_PARAM;
+                }
+
+                FCM::U_Int32 size = 0;
+                for (int i = 0; i < 4; i++)
+                {
+                    size |= (FCM::U_Int32)(unsigned char)header[1 + i] << (8 * i);
+                }
+
+                m_record.resize(size);
+                m_pos = 0;
+                if (size > 0 && !m_in.read(&m_record[0], size))
+                    return FCM_INVALID_PARAM;
+
+                if (!Dispatch((TraceRecordType)(unsigned char)header[0], handler))
+                    return FCM_INVALID_PARAM;
+            }
+        }
+
+    private:
+
+        // false if the payload is shorter than its type requires
+        FCM::Boolean Dispatch(TraceRecordType type, IPublishTraceHandler& handler)
+        {
+            FCM::U_Int32 id, objectId, value;
+            DOM::Utils::COLOR color;
+            DOM::Utils::MATRIX2D matrix;
+
+            switch (type)
+            {
+                case TRACE_RECORD_DOCUMENT:
+                {
+                    FCM::U_Int32 stageHeight, stageWidth, fps;
+                    if (!GetColor(color) || !GetU32(stageHeight) || !GetU32(stageWidth) || !GetU32(fps))
+                        return false;
+                    handler.Document(color, stageHeight, stageWidth, fps);
+                    break;
+                }
+
+                case TRACE_RECORD_DEFINE_SHAPE:
+                    if (!GetU32(id))
+                        return false;
+                    handler.DefineShape(id);
+                    break;
+
+                case TRACE_RECORD_FILL_REGION:
+                    if (!GetU32(id))
+                        return false;
+                    handler.FillRegion(id);
+                    break;
+
+                case TRACE_RECORD_STROKE_PATH:
+                    if (!GetU32(id))
+                        return false;
+                    handler.StrokePath(id);
+                    break;
+
+                case TRACE_RECORD_SOLID_COLOR:
+                    if (!GetColor(color))
+                        return false;
+                    handler.SolidColor(color);
+                    break;
+
+                case TRACE_RECORD_LINEAR_GRADIENT:
+                    if (!GetMatrix(matrix) || !GetColorPoints())
+                        return false;
+                    handler.LinearGradient(matrix, m_colorPoints);
+                    break;
+
+                case TRACE_RECORD_RADIAL_GRADIENT:
+                    if (!GetMatrix(matrix) || !GetU32(value) || !GetColorPoints())
+                        return false;
+                    handler.RadialGradient(matrix, (FCM::S_Int32)value, m_colorPoints);
+                    break;
+
+                case TRACE_RECORD_SOLID_STROKE:
+                {
+                    double thickness, miterLimit;
+                    FCM::U_Int32 lineCap, lineJoin;
+                    if (!GetDouble(thickness) || !GetU32(lineCap) || !GetU32(lineJoin) || !GetDouble(miterLimit))
+                        return false;
+                    handler.SolidStroke(thickness, lineCap, lineJoin, miterLimit);
+                    break;
+                }
+
+                case TRACE_RECORD_PATH:
+                {
+                    FCM::U_Int8 isHole;
+                    if (!GetU8(isHole) || !GetEdges())
+                        return false;
+                    handler.Path(m_edges, isHole != 0);
+                    break;
+                }
+
+                case TRACE_RECORD_HOLES:
+                    if (!GetU32(id))
+                        return false;
+                    handler.Holes(id);
+                    break;
+
+                case TRACE_RECORD_DEFINE_BITMAP:
+                {
+                    FCM::U_Int32 height, width;
+                    std::string libPathName, fileName;
+                    if (!GetU32(id) || !GetU32(height) || !GetU32(width) || !GetString(libPathName) || !GetString(fileName))
+                        return false;
+                    handler.DefineBitmap(id, (FCM::S_Int32)height, (FCM::S_Int32)width, libPathName, fileName);
+                    break;
+                }
+
+                case TRACE_RECORD_CREATE_TIMELINE:
+                    if (!GetU32(id))
+                        return false;
+                    handler.CreateTimeline(id);
+                    break;
+
+                case TRACE_RECORD_ADD_SHAPE:
+                case TRACE_RECORD_ADD_BITMAP:
+                case TRACE_RECORD_ADD_MOVIE_CLIP:
+                case TRACE_RECORD_ADD_GRAPHIC:
+                {
+                    FCM::U_Int32 resourceId;
+                    if (!GetU32(id) || !GetU32(objectId) || !GetU32(resourceId) || !GetU32(value) || !GetMatrix(matrix))
+                        return false;
+                    handler.PlaceObject(id, type, objectId, resourceId, value, matrix);
+                    break;
+                }
+
+                case TRACE_RECORD_UPDATE_Z_ORDER:
+                    if (!GetU32(id) || !GetU32(objectId) || !GetU32(value))
+                        return false;
+                    handler.UpdateZOrder(id, objectId, value);
+                    break;
+
+                case TRACE_RECORD_UPDATE_MASK:
+                    if (!GetU32(id) || !GetU32(objectId) || !GetU32(value))
+                        return false;
+                    handler.UpdateMask(id, objectId, value);
+                    break;
+
+                case TRACE_RECORD_REMOVE:
+                    if (!GetU32(id) || !GetU32(objectId))
+                        return false;
+                    handler.Remove(id, objectId);
+                    break;
+
+                case TRACE_RECORD_UPDATE_BLEND_MODE:
+                    if (!GetU32(id) || !GetU32(objectId) || !GetU32(value))
+                        return false;
+                    handler.UpdateBlendMode(id, objectId, value);
+                    break;
+
+                case TRACE_RECORD_UPDATE_VISIBILITY:
+                    if (!GetU32(id) || !GetU32(objectId) || !GetU32(value))
+                        return false;
+                    handler.UpdateVisibility(id, objectId, value != 0);
+                    break;
+
+                case TRACE_RECORD_UPDATE_DISPLAY_TRANSFORM:
+                    if (!GetU32(id) || !GetU32(objectId) || !GetMatrix(matrix))
+                        return false;
+                    handler.UpdateDisplayTransform(id, objectId, matrix);
+                    break;
+
+                case TRACE_RECORD_SHOW_FRAME:
+                    if (!GetU32(id))
+                        return false;
+                    handler.ShowFrame(id);
+                    break;
+
+                case TRACE_RECORD_BUILD_TIMELINE:
+                    if (!GetU32(id) || !GetU32(value))
+                        return false;
+                    handler.BuildTimeline(id, value);
+                    break;
+
+                case TRACE_RECORD_START_SCENE:
+                    if (!GetU32(id) || !GetU32(value))
+                        return false;
+                    handler.StartScene(id, value);
+                    break;
+
+                default:
+                    // Written by a newer version
+                    break;
+            }
+
+            return true;
+        }
+
+        FCM::Boolean GetU8(FCM::U_Int8& value)
+        {
+            if (m_pos + 1 > m_record.size())
+                return false;
+            value = (FCM::U_Int8)m_record[m_pos++];
+            return true;
+        }
+
+        FCM::Boolean GetU32(FCM::U_Int32& value)
+        {
+            if (m_pos + 4 > m_record.size())
+                return false;
+            value = 0;
+            for (int i = 0; i < 4; i++)
+            {
+                value |= (FCM::U_Int32)(unsigned char)m_record[m_pos++] << (8 * i);
+            }
+            return true;
+        }
+
+        FCM::Boolean GetDouble(double& value)
+        {
+            if (m_pos + 8 > m_record.size())
+                return false;
+            std::uint64_t bits = 0;
+            for (int i = 0; i < 8; i++)
+            {
+                bits |= (std::uint64_t)(unsigned char)m_record[m_pos++] << (8 * i);
+            }
+            memcpy(&value, &bits, sizeof(value));
+            return true;
+        }
+
+        FCM::Boolean GetString(std::string& value)
+        {
+            FCM::U_Int32 length;
+            if (!GetU32(length) || m_pos + length > m_record.size())
+                return false;
+            value.assign(&m_record[0] + m_pos, length);
+            m_pos += length;
+            return true;
+        }
+
+        FCM::Boolean GetColor(DOM::Utils::COLOR& color)
+        {
+            return GetU8(color.red) && GetU8(color.green) && GetU8(color.blue) && GetU8(color.alpha);
+        }
+
+        FCM::Boolean GetPoint(DOM::Utils::POINT2D& point)
+        {
+            double x, y;
+            if (!GetDouble(x) || !GetDouble(y))
+                return false;
+            point.x = x;
+            point.y = y;
+            return true;
+        }
+
+        FCM::Boolean GetMatrix(DOM::Utils::MATRIX2D& matrix)
+        {
+            double a, b, c, d, tx, ty;
+            if (!GetDouble(a) || !GetDouble(b) || !GetDouble(c) || !GetDouble(d) || !GetDouble(tx) || !GetDouble(ty))
+                return false;
+            matrix.a = a;
+            matrix.b = b;
+            matrix.c = c;
+            matrix.d = d;
+            matrix.tx = tx;
+            matrix.ty = ty;
+            return true;
+        }
+
+        FCM::Boolean GetColorPoints()
+        {
+            FCM::U_Int32 count;
+            if (!GetU32(count))
+                return false;
+
+            m_colorPoints.resize(count);
+            for (FCM::U_Int32 i = 0; i < count; i++)
+            {
+                if (!GetU8(m_colorPoints[i].pos) || !GetColor(m_colorPoints[i].color))
+                    return false;
+            }
+            return true;
+        }
+
+        FCM::Boolean GetEdges()
+        {
+            FCM::U_Int32 count;
+            if (!GetU32(count))
+                return false;
+
+            m_edges.clear();
+            for (FCM::U_Int32 i = 0; i < count; i++)
+            {
+                DOM::Utils::SEGMENT edge;
+                FCM::U_Int8 isQuad;
+
+                memset(&edge, 0, sizeof(edge));
+                edge.structSize = sizeof(DOM::Utils::SEGMENT);
+                if (!GetU8(isQuad))
+                    return false;
+
+                if (isQuad)
+                {
+                    edge.segmentType = DOM::Utils::QUAD_BEZIER_SEGMENT;
+                    if (!GetPoint(edge.quadBezierCurve.anchor1) ||
+                        !GetPoint(edge.quadBezierCurve.control) ||
+                        !GetPoint(edge.quadBezierCurve.anchor2))
+                        return false;
+                }
+                else
+                {
+                    edge.segmentType = DOM::Utils::LINE_SEGMENT;
+                    if (!GetPoint(edge.line.endPoint1) || !GetPoint(edge.line.endPoint2))
+                        return false;
+                }
+                m_edges.push_back(edge);
+            }
+            return true;
+        }
+
+    private:
+
+        std::istream& m_in;
+
+        // Payload of the current record and the read position in it
+        std::vector<char> m_record;
+
+        size_t m_pos;
+
+        // Reused from one record to the next
+        std::vector<DOM::Utils::GRADIENT_COLOR_POINT> m_colorPoints;
+
+        std::vector<DOM::Utils::SEGMENT> m_edges;
+    };
+};
+
+#endif // PUBLISH_TRACE_H_
@@ -0,0 +1,403 @@
+/*************************************************************************
+* ADOBE CONFIDENTIAL
+* ___________________
+*
+*  Copyright 2018 Adobe Systems Incorporated
+*  All Rights Reserved.
+*
+* NOTICE:  All information contained herein is, and remains
+* the property of Adobe Systems Incorporated and its suppliers,
+* if any.  The intellectual and technical concepts contained
+* herein are proprietary to Adobe Systems Incorporated and its
+* suppliers and are protected by all applicable intellectual property
+* laws, including trade secret and copyright laws.
+* Dissemination of this information or reproduction of this material
+* is strictly forbidden unless prior written permission is obtained
+* from Adobe Systems Incorporated.
+**************************************************************************/
+
+/**
+ * @file  ShapeRecognizer.h
+ *
+ * @brief This file contains the detection of rectangles, rounded rectangles
+ *        and ellipses among the paths of a shape, so that they can be
+ *        written as Lottie "rc" and "el" shapes.
+ */
+
+#ifndef SHAPE_RECOGNIZER_H_
+#define SHAPE_RECOGNIZER_H_
+
+#include "FCMTypes.h"
+#include "Utils/DOMTypes.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+/* -------------------------------------------------- Macros / Constants */
+
+// Paths with more edges are never taken for a primitive
+#define SHAPE_RECOGNIZER_MAX_EDGES  64
+
+// Animate draws ovals and rounded corners with eight quads per turn, which
+// stray up to 0.31% of the radius from the true arc. Curves may be off by
+// this much on top of the tolerance.
+#define SHAPE_RECOGNIZER_ARC_ERROR  0.004
+
+/* -------------------------------------------------- Class Decl */
+
+namespace LottieExporter
+{
+    // Tells whether a closed path is, within the tolerance, a rectangle
+    // (possibly with rounded corners) or an ellipse, turned by any angle.
+    // Every edge is checked at several points against the outline of the
+    // primitive, and the area of the path must match the area of the
+    // primitive, so a path going around twice or only partly is rejected.
+    class ShapeRecognizer
+    {
+    public:
+
+        enum Kind
+        {
+            NONE,
+            RECTANGLE,
+            ELLIPSE
+        };
+
+        struct Primitive
+        {
+            Kind kind;
+            double centre[2];
+            double size[2];         // before the rotation
+            double roundness;       // corner radius of a rectangle
+            double angle;           // degrees, clockwise
+            bool clockwise;
+        };
+
+        bool Recognize(
+            const std::vector<DOM::Utils::SEGMENT>& edges,
+            double tolerance,
+            Primitive& primitive)
+        {
+            primitive.kind = NONE;
+
+            if (edges.size() < 3 || edges.size() > SHAPE_RECOGNIZER_MAX_EDGES || !IsClosed(edges, tolerance))
+                return false;
+
+            bool hasLines = false;
+            double area = 0;
+            double longest = -1;
+            double lineAngle = 0;
+            for (size_t e = 0; e < edges.size(); e++)
+            {
+                const DOM::Utils::SEGMENT& edge = edges[e];
+                if (edge.segmentType == DOM::Utils::LINE_SEGMENT)
+                {
+                    double dx = (double)edge.line.endPoint2.x - edge.line.endPoint1.x;
+                    double dy = (double)edge.line.endPoint2.y - edge.line.endPoint1.y;
+                    double length = std::hypot(dx, dy);
+
+                    hasLines = true;
+                    if (length > longest)
+                    {
+                        longest = length;
+                        lineAngle = std::atan2(dy, dx);
+                    }
+                    area += Cross(edge.line.endPoint1, edge.line.endPoint2) / 2;
+                }
+                else
+                {
+                    // The region between a quad and its chord is 2/3 of the
+                    // triangle of its control points
+                    const DOM::Utils::QUAD_BEZIER_CURVE& quad = edge.quadBezierCurve;
+                    double chord = Cross(quad.anchor1, quad.anchor2);
+                    double triangle = Cross(quad.anchor1, quad.control) + Cross(quad.control, quad.anchor2) - chord;
+                    area += chord / 2 + triangle / 3;
+                }
+            }
+
+            // Axis aligned shapes are the common case, try them first
+            primitive.kind = hasLines ? RECTANGLE : ELLIPSE;
+            primitive.clockwise = area > 0;
+            if (Fit(edges, 0, std::fabs(area), tolerance, primitive))
+                return true;
+
+            double angle = hasLines ? lineAngle : GetPrincipalAngle(edges);
+            angle -= HalfPi() * std::floor(angle / HalfPi() + 0.5);
+            if (angle != 0 && Fit(edges, angle, std::fabs(area), tolerance, primitive))
+                return true;
+
+            primitive.kind = NONE;
+            return false;
+        }
+
+    private:
+
+        static double HalfPi()
+        {
+            return 2 * std::atan(1.0);
+        }
+
+        static double Cross(const DOM::Utils::POINT2D& a, const DOM::Utils::POINT2D& b)
+        {
+            return (double)a.x * b.y - (double)a.y * b.x;
+        }
+
+        static DOM::Utils::POINT2D GetStart(const DOM::Utils::SEGMENT& segment)
+        {
+            return segment.segmentType == DOM::Utils::LINE_SEGMENT ?
+                segment.line.endPoint1 : segment.quadBezierCurve.anchor1;
+        }
+
+        static DOM::Utils::POINT2D GetEnd(const DOM::Utils::SEGMENT& segment)
+        {
+            return segment.segmentType == DOM::Utils::LINE_SEGMENT ?
+                segment.line.endPoint2 : segment.quadBezierCurve.anchor2;
+        }
+
+        static double Distance(const DOM::Utils::POINT2D& a, const DOM::Utils::POINT2D& b)
+        {
+            return std::hypot((double)a.x - b.x, (double)a.y - b.y);
+        }
+
+        static bool IsClosed(const std::vector<DOM::Utils::SEGMENT>& edges, double tolerance)
+        {
+            for (size_t e = 0; e < edges.size(); e++)
+            {
+                const DOM::Utils::SEGMENT& next = edges[(e + 1) % edges.size()];
+                if (Distance(GetEnd(edges[e]), GetStart(next)) > tolerance)
+                    return false;
+            }
+            return true;
+        }
+
+        static double QuadAt(double a, double c, double b, double t)
+        {
+            return (1 - t) * (1 - t) * a + 2 * t * (1 - t) * c + t * t * b;
+        }
+
+        // Points of the edges, rotated by -angle, where they are checked
+        // against the primitive. A line is checked at its ends and middle,
+        // which is enough for a convex outline; a quad at four points and
+        // its extremes.
+        void Sample(const std::vector<DOM::Utils::SEGMENT>& edges, double angle)
+        {
+            double cosA = std::cos(angle);
+            double sinA = std::sin(angle);
+
+            m_samples.clear();
+            for (size_t e = 0; e < edges.size(); e++)
+            {
+                const DOM::Utils::SEGMENT& edge = edges[e];
+                DOM::Utils::POINT2D a = GetStart(edge);
+                DOM::Utils::POINT2D b = GetEnd(edge);
+                DOM::Utils::POINT2D c = edge.segmentType == DOM::Utils::LINE_SEGMENT ? a : edge.quadBezierCurve.control;
+                double ax = a.x * cosA + a.y * sinA, ay = a.y * cosA - a.x * sinA;
+                double bx = b.x * cosA + b.y * sinA, by = b.y * cosA - b.x * sinA;
+                double cx = c.x * cosA + c.y * sinA, cy = c.y * cosA - c.x * sinA;
+
+                if (edge.segmentType == DOM::Utils::LINE_SEGMENT)
+                {
+                    AddSample(ax, ay);
+                    AddSample((ax + bx) / 2, (ay + by) / 2);
+                    continue;
+                }
+
+                for (int k = 0; k < 4; k++)
+                {
+                    double t = k / 4.0;
+                    AddSample(QuadAt(ax, cx, bx, t), QuadAt(ay, cy, by, t));
+                }
+
+                // The extremes of the quad, for the bounding box
+                double tx = ax - 2 * cx + bx != 0 ? (ax - cx) / (ax - 2 * cx + bx) : -1;
+                double ty = ay - 2 * cy + by != 0 ? (ay - cy) / (ay - 2 * cy + by) : -1;
+                if (tx > 0 && tx < 1)
+                    AddSample(QuadAt(ax, cx, bx, tx), QuadAt(ay, cy, by, tx));
+                if (ty > 0 && ty < 1)
+                    AddSample(QuadAt(ax, cx, bx, ty), QuadAt(ay, cy, by, ty));
+            }
+        }
+
+        void AddSample(double x, double y)
+        {
+            m_samples.push_back(x);
+            m_samples.push_back(y);
+        }
+
+        // Direction of the axes of a path made only of curves, from the
+        // spread of its anchors, which are placed symmetrically on an oval
+        static double GetPrincipalAngle(const std::vector<DOM::Utils::SEGMENT>& edges)
+        {
+            double mx = 0, my = 0;
+            for (size_t e = 0; e < edges.size(); e++)
+            {
+                mx += GetStart(edges[e]).x;
+                my += GetStart(edges[e]).y;
+            }
+            mx /= edges.size();
+            my /= edges.size();
+
+            double xx = 0, yy = 0, xy = 0;
+            for (size_t e = 0; e < edges.size(); e++)
+            {
+                double dx = GetStart(edges[e]).x - mx;
+                double dy = GetStart(edges[e]).y - my;
+                xx += dx * dx;
+                yy += dy * dy;
+                xy += dx * dy;
+            }
+            return std::atan2(2 * xy, xx - yy) / 2;
+        }
+
+        // Fits the primitive to the path turned by -angle, then checks that
+        // the path stays within the tolerance of it
+        bool Fit(
+            const std::vector<DOM::Utils::SEGMENT>& edges,
+            double angle,
+            double area,
+            double tolerance,
+            Primitive& primitive)
+        {
+            Sample(edges, angle);
+
+            double box[4] = { HUGE_VAL, HUGE_VAL, -HUGE_VAL, -HUGE_VAL };
+            for (size_t s = 0; s < m_samples.size(); s += 2)
+            {
+                box[0] = std::min(box[0], m_samples[s]);
+                box[1] = std::min(box[1], m_samples[s + 1]);
+                box[2] = std::max(box[2], m_samples[s]);
+                box[3] = std::max(box[3], m_samples[s + 1]);
+            }
+
+            double halfW = (box[2] - box[0]) / 2;
+            double halfH = (box[3] - box[1]) / 2;
+            double x = (box[0] + box[2]) / 2;
+            double y = (box[1] + box[3]) / 2;
+            if (halfW <= tolerance || halfH <= tolerance)
+                return false;
+
+            double radius = 0;
+            double expectedArea, perimeter;
+            if (primitive.kind == RECTANGLE)
+            {
+                if (!GetCornerRadius(edges, angle, box, tolerance, radius))
+                    return false;
+                expectedArea = 4 * halfW * halfH - (4 - 2 * HalfPi()) * radius * radius;
+                perimeter = 4 * (halfW + halfH);
+            }
+            else
+            {
+                expectedArea = 2 * HalfPi() * halfW * halfH;
+                perimeter = 2 * HalfPi() * (halfW + halfH);
+            }
+
+            double allowed = tolerance + SHAPE_RECOGNIZER_ARC_ERROR *
+                (primitive.kind == RECTANGLE ? radius : std::max(halfW, halfH));
+            for (size_t s = 0; s < m_samples.size(); s += 2)
+            {
+                double px = m_samples[s] - x;
+                double py = m_samples[s + 1] - y;
+                double distance = primitive.kind == RECTANGLE ?
+                    DistanceToRectangle(px, py, halfW, halfH, radius) :
+                    DistanceToEllipse(px, py, halfW, halfH);
+
+                if (!(distance <= allowed))
+                    return false;
+            }
+
+            if (std::fabs(area - expectedArea) > 2 * allowed * perimeter + 1e-9 * expectedArea)
+                return false;
+
+            double cosA = std::cos(angle);
+            double sinA = std::sin(angle);
+            primitive.centre[0] = x * cosA - y * sinA;
+            primitive.centre[1] = x * sinA + y * cosA;
+            primitive.size[0] = 2 * halfW;
+            primitive.size[1] = 2 * halfH;
+            primitive.roundness = radius;
+            primitive.angle = angle * 90 / HalfPi();
+            return true;
+        }
+
+        // Every line of a rectangle lies along a side of the box; where the
+        // lines stop is where the corners start to round
+        static bool GetCornerRadius(
+            const std::vector<DOM::Utils::SEGMENT>& edges,
+            double angle,
+            const double box[4],
+            double tolerance,
+            double& radius)
+        {
+            double cosA = std::cos(angle);
+            double sinA = std::sin(angle);
+            double sum = 0;
+            int count = 0;
+            bool hasCurves = false;
+
+            for (size_t e = 0; e < edges.size(); e++)
+            {
+                if (edges[e].segmentType != DOM::Utils::LINE_SEGMENT)
+                {
+                    hasCurves = true;
+                    continue;
+                }
+
+                const DOM::Utils::LINE& line = edges[e].line;
+                double ends[4] = {
+                    line.endPoint1.x * cosA + line.endPoint1.y * sinA, line.endPoint1.y * cosA - line.endPoint1.x * sinA,
+                    line.endPoint2.x * cosA + line.endPoint2.y * sinA, line.endPoint2.y * cosA - line.endPoint2.x * sinA };
+
+                // Along x for a horizontal line, along y for a vertical one
+                int along;
+                if (std::fabs(ends[1] - ends[3]) <= tolerance)
+                    along = 0;
+                else if (std::fabs(ends[0] - ends[2]) <= tolerance)
+                    along = 1;
+                else
+                    return false;
+
+                for (int k = 0; k < 2; k++)
+                {
+                    double p = ends[2 * k + along];
+                    sum += std::min(p - box[along], box[along + 2] - p);
+                    count++;
+                }
+            }
+
+            radius = hasCurves && count ? std::max(0.0, sum / count) : 0;
+            radius = std::min(radius, std::min(box[2] - box[0], box[3] - box[1]) / 2);
+            return count > 0;
+        }
+
+        static double DistanceToRectangle(double x, double y, double halfW, double halfH, double radius)
+        {
+            double qx = std::fabs(x) - (halfW - radius);
+            double qy = std::fabs(y) - (halfH - radius);
+            double outside = std::hypot(std::max(qx, 0.0), std::max(qy, 0.0));
+            double inside = std::min(std::max(qx, qy), 0.0);
+
+            return std::fabs(outside + inside - radius);
+        }
+
+        // First order distance: how far the point is from the level of the
+        // ellipse, divided by how fast that level changes there
+        static double DistanceToEllipse(double x, double y, double rx, double ry)
+        {
+            double u = x / rx;
+            double v = y / ry;
+            double level = std::sqrt(u * u + v * v);
+            if (level < 0.5)
+                return HUGE_VAL;
+
+            double gradient = std::hypot(u / rx, v / ry) / level;
+            return std::fabs(level - 1) / gradient;
+        }
+
+    private:
+
+        // Reused from one path to the next, x and y interleaved
+        std::vector<double> m_samples;
+    };
+};
+
+#endif // SHAPE_RECOGNIZER_H_
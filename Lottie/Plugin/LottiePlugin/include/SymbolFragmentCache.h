@@ -0,0 +1,295 @@
+/*************************************************************************
+* ADOBE CONFIDENTIAL
+* ___________________
+*
+*  Copyright 2018 Adobe Systems Incorporated
+*  All Rights Reserved.
+*
+* NOTICE:  All information contained herein is, and remains
+* the property of Adobe Systems Incorporated and its suppliers,
+* if any.  The intellectual and technical concepts contained
+* herein are proprietary to Adobe Systems Incorporated and its
+* suppliers and are protected by all applicable intellectual property
+* laws, including trade secret and copyright laws.
+* Dissemination of this information or reproduction of this material
+* is strictly forbidden unless prior written permission is obtained
+* from Adobe Systems Incorporated.
+**************************************************************************/
+
+/**
+ * @file  SymbolFragmentCache.h
+ *
+ * @brief This file contains the cache of the output fragments written for
+ *        the symbol compositions by earlier publishes of a document.
+ */
+
+#ifndef SYMBOL_FRAGMENT_CACHE_H_
+#define SYMBOL_FRAGMENT_CACHE_H_
+
+#include "FCMTypes.h"
+#include "Utils.h"
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+/* -------------------------------------------------- Macros / Constants */
+
+// Written next to the JSON file
+#define SYMBOL_CACHE_FILE_EXTENSION ".symbolcache"
+
+// First line of the file; a cache of another version is not read
+#define SYMBOL_CACHE_FILE_HEADER    "LottieSymbolCache 1"
+
+/* -------------------------------------------------- Structs / Unions */
+
+namespace LottieExporter
+{
+    // Content drawn by a static shape layer of the symbol, as it was shared
+    // (or not) when the fragment was written
+    struct SYMBOL_CACHE_SHAPE
+    {
+        std::string shapes;     // "shapes":[...] member
+        std::string refId;      // precomp asset id, empty if written inline
+        double left;
+        double top;
+        double width;
+        double height;
+    };
+
+    struct SYMBOL_CACHE_ENTRY
+    {
+        std::string layers;     // "layers":[...] member of the asset
+        std::vector<SYMBOL_CACHE_SHAPE> shapes;
+        FCM::Boolean used;      // written by the current publish
+    };
+};
+
+/* -------------------------------------------------- Class Decl */
+
+namespace LottieExporter
+{
+    // 64-bit FNV-1a of the values fed to it
+    class SymbolCacheHash
+    {
+    public:
+
+        SymbolCacheHash() : m_hash(14695981039346656037ULL)
+        {
+        }
+
+        void Add(const void* data, size_t size)
+        {
+            const unsigned char* bytes = static_cast<const unsigned char*>(data);
+            for (size_t i = 0; i < size; i++)
+            {
+                m_hash ^= bytes[i];
+                m_hash *= 1099511628211ULL;
+            }
+        }
+
+        template <typename T>
+        void Add(const T& value)
+        {
+            Add(&value, sizeof(value));
+        }
+
+        template <typename T>
+        void Add(const std::vector<T>& values)
+        {
+            Add(values.size());
+            if (!values.empty())
+                Add(&values[0], values.size() * sizeof(T));
+        }
+
+        void Add(const std::string& str)
+        {
+            Add(str.length());
+            Add(str.data(), str.length());
+        }
+
+        std::uint64_t Value() const
+        {
+            return m_hash;
+        }
+
+    private:
+
+        std::uint64_t m_hash;
+    };
+
+
+    // Output fragment cache: keeps the written "layers" of the symbol
+    // compositions from one publish to the next, in memory and in a file
+    // next to the output.
+    //
+    // Entries are keyed by the library name of the symbol and a hash of the
+    // composition as the frame commands built it, before any reduction. A
+    // symbol whose commands did not change is written from its entry: its
+    // keyframes are not reduced and its layers are not serialized again.
+    // The publish is not incremental: Animate still generates the frame
+    // commands of every symbol, and the key needs the model they build.
+    class SymbolFragmentCache
+    {
+    public:
+
+        SymbolFragmentCache() : m_pCallback(NULL)
+        {
+        }
+
+        // Reads the file of a previous publish, unless the entries of that
+        // file are already in memory
+        void Load(const std::string& filePath, FCM::PIFCMCallback pCallback)
+        {
+            std::fstream file;
+            std::string line;
+
+            m_pCallback = pCallback;
+            for (std::map<std::string, SYMBOL_CACHE_ENTRY>::iterator it = m_entries.begin(); it != m_entries.end(); ++it)
+                it->second.used = false;
+
+            if (filePath == m_filePath)
+                return;
+
+            m_filePath = filePath;
+            m_entries.clear();
+
+            Utils::OpenFStream(m_filePath, file, std::ios_base::in | std::ios_base::binary, m_pCallback);
+            if (!file || !std::getline(file, line) || line != SYMBOL_CACHE_FILE_HEADER)
+                return;
+
+            // key length, layers length and shape count, then the key and
+            // the layers; each shape is its bounds and lengths, then its text
+            size_t keyLength, layersLength, shapeCount;
+            while (file >> keyLength >> layersLength >> shapeCount && file.get() == '\n')
+            {
+                std::string key;
+                SYMBOL_CACHE_ENTRY entry;
+
+                if (!Read(file, keyLength, key) || !Read(file, layersLength, entry.layers))
+                    break;
+
+                entry.shapes.resize(shapeCount);
+                for (size_t i = 0; i < shapeCount; i++)
+                {
+                    SYMBOL_CACHE_SHAPE& shape = entry.shapes[i];
+                    size_t shapesLength, refIdLength;
+
+                    if (!(file >> shape.left >> shape.top >> shape.width >> shape.height >> shapesLength >> refIdLength) ||
+                        file.get() != '\n' ||
+                        !Read(file, shapesLength, shape.shapes) ||
+                        !Read(file, refIdLength, shape.refId))
+                    {
+                        return;
+                    }
+                }
+
+                entry.used = false;
+                m_entries[key] = entry;
+            }
+        }
+
+        static std::string MakeKey(const std::string& name, std::uint64_t hash)
+        {
+            char hex[32];
+            snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+            return name + '\t' + hex;
+        }
+
+        // Entry of an unchanged symbol, NULL if there is none
+        const SYMBOL_CACHE_ENTRY* Lookup(const std::string& key)
+        {
+            std::map<std::string, SYMBOL_CACHE_ENTRY>::iterator it = m_entries.find(key);
+            if (it == m_entries.end())
+                return NULL;
+
+            it->second.used = true;
+            return &it->second;
+        }
+
+        // Takes the content of 'entry'
+        void Add(const std::string& key, SYMBOL_CACHE_ENTRY& entry)
+        {
+            SYMBOL_CACHE_ENTRY& cached = m_entries[key];
+            cached.layers.swap(entry.layers);
+            cached.shapes.swap(entry.shapes);
+            cached.used = true;
+        }
+
+        // Writes the entries of the current publish; the others are dropped
+        void Save()
+        {
+            std::fstream file;
+
+            for (std::map<std::string, SYMBOL_CACHE_ENTRY>::iterator it = m_entries.begin(); it != m_entries.end(); )
+            {
+                if (it->second.used)
+                    ++it;
+                else
+                    m_entries.erase(it++);
+            }
+
+            if (m_filePath.empty())
+                return;
+
+            Utils::OpenFStream(m_filePath, file, std::ios_base::trunc | std::ios_base::out | std::ios_base::binary, m_pCallback);
+            if (!file)
+            {
+                Utils::Trace(m_pCallback, "Symbol cache (%s) could not be written\n", m_filePath.c_str());
+                return;
+            }
+
+            file.precision(17);
+            file << SYMBOL_CACHE_FILE_HEADER << '\n';
+            for (std::map<std::string, SYMBOL_CACHE_ENTRY>::const_iterator it = m_entries.begin(); it != m_entries.end(); ++it)
+            {
+                const SYMBOL_CACHE_ENTRY& entry = it->second;
+
+                file << it->first.length() << ' ' << entry.layers.length() << ' ' << entry.shapes.size() << '\n';
+                file << it->first << entry.layers << '\n';
+                for (size_t i = 0; i < entry.shapes.size(); i++)
+                {
+                    const SYMBOL_CACHE_SHAPE& shape = entry.shapes[i];
+                    file << shape.left << ' ' << shape.top << ' ' << shape.width << ' ' << shape.height << ' '
+                        << shape.shapes.length() << ' ' << shape.refId.length() << '\n';
+                    file << shape.shapes << shape.refId << '\n';
+                }
+            }
+            file.close();
+        }
+
+        // Forgets every entry and deletes the file
+        void Clear()
+        {
+            m_entries.clear();
+            if (!m_filePath.empty())
+            {
+                Utils::Remove(m_filePath, m_pCallback);
+                m_filePath.clear();
+            }
+        }
+
+    private:
+
+        static FCM::Boolean Read(std::istream& in, size_t length, std::string& str)
+        {
+            str.resize(length);
+            if (length > 0)
+                in.read(&str[0], length);
+            return (size_t)in.gcount() == length || length == 0;
+        }
+
+    private:
+
+        std::string m_filePath;
+
+        FCM::PIFCMCallback m_pCallback;
+
+        // Symbol name and hash -> composition
+        std::map<std::string, SYMBOL_CACHE_ENTRY> m_entries;
+    };
+};
+
+#endif // SYMBOL_FRAGMENT_CACHE_H_
@@ -0,0 +1,318 @@
+/*************************************************************************
+* ADOBE CONFIDENTIAL
+* ___________________
+*
+*  Copyright 2018 Adobe Systems Incorporated
+*  All Rights Reserved.
+*
+* NOTICE:  All information contained herein is, and remains
+* the property of Adobe Systems Incorporated and its suppliers,
+* if any.  The intellectual and technical concepts contained
+* herein are proprietary to Adobe Systems Incorporated and its
+* suppliers and are protected by all applicable intellectual property
+* laws, including trade secret and copyright laws.
+* Dissemination of this information or reproduction of this material
+* is strictly forbidden unless prior written permission is obtained
+* from Adobe Systems Incorporated.
+**************************************************************************/
+
+/**
+ * @file  SyntheticScene.h
+ *
+ * @brief This file contains a generator of parameterized scenes, written as
+ *        publish traces, for benchmarking the exporter without a document.
+ */
+
+#ifndef SYNTHETIC_SCENE_H_
+#define SYNTHETIC_SCENE_H_
+
+#include "PublishTrace.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+/* -------------------------------------------------- Macros / Constants */
+
+#define SYNTHETIC_SCENE_STAGE_WIDTH     550
+
+#define SYNTHETIC_SCENE_STAGE_HEIGHT    400
+
+#define SYNTHETIC_SCENE_FPS             24
+
+#define SYNTHETIC_SCENE_BITMAP_SIZE     64
+
+// M_PI needs _USE_MATH_DEFINES before <cmath> on Windows
+#define SYNTHETIC_SCENE_PI              3.14159265358979323846
+
+/* -------------------------------------------------- Structs / Unions */
+
+namespace LottieExporter
+{
+    struct SYNTHETIC_SCENE
+    {
+        // One object (and resource) per layer, placed on the first frame
+        FCM::U_Int32 layers;
+
+        // Every layer gets a new transform on every frame
+        FCM::U_Int32 frames;
+
+        // Quadratic edges of each outline (and hole)
+        FCM::U_Int32 edgesPerPath;
+
+        // Fractions (0 to 1) of the layers with a hole, a linear gradient
+        // instead of a solid fill, or a bitmap instead of a shape
+        double holeFraction;
+        double gradientFraction;
+        double bitmapFraction;
+
+        FCM::U_Int32 seed;
+    };
+};
+
+/* -------------------------------------------------- Class Decl */
+
+namespace LottieExporter
+{
+    // Writes the palette and timeline builder calls Animate would make for
+    // a scene of the given shape, so that a PublishTraceReplayer can push
+    // it through the Lottie model and the serializer. The same parameters
+    // always give the same trace.
+    class SyntheticScene
+    {
+    public:
+
+        static void GetDefault(SYNTHETIC_SCENE& scene)
+        {
+            scene.layers = 100;
+            scene.frames = 240;
+            scene.edgesPerPath = 32;
+            scene.holeFraction = 0.25;
+            scene.gradientFraction = 0.25;
+            scene.bitmapFraction = 0.1;
+            scene.seed = 1;
+        }
+
+        // Comma separated "name=value" pairs, e.g.
+        // "layers=500,frames=120,edges=64,holes=0.5,gradients=0,bitmaps=0.2".
+        // Parameters not given keep their default.
+        static FCM::Boolean Parse(const std::string& spec, SYNTHETIC_SCENE& scene)
+        {
+            GetDefault(scene);
+
+            size_t start = 0;
+            while (start < spec.length())
+            {
+                size_t end = spec.find(',', start);
+                if (end == std::string::npos)
+                    end = spec.length();
+
+                std::string pair = spec.substr(start, end - start);
+                start = end + 1;
+                if (pair.empty())
+                    continue;
+
+                size_t equal = pair.find('=');
+                if (equal == std::string::npos)
+                    return false;
+
+                std::string name = pair.substr(0, equal);
+                double value = atof(pair.c_str() + equal + 1);
+                if (value < 0)
+                    return false;
+
+                if (name == "layers")
+                    scene.layers = (FCM::U_Int32)value;
+                else if (name == "frames")
+                    scene.frames = (FCM::U_Int32)value;
+                else if (name == "edges")
+                    scene.edgesPerPath = (FCM::U_Int32)value;
+                else if (name == "holes")
+                    scene.holeFraction = value;
+                else if (name == "gradients")
+                    scene.gradientFraction = value;
+                else if (name == "bitmaps")
+                    scene.bitmapFraction = value;
+                else if (name == "seed")
+                    scene.seed = (FCM::U_Int32)value;
+                else
+                    return false;
+            }
+
+            return scene.layers > 0 && scene.frames > 0 && scene.edgesPerPath >= 3;
+        }
+
+        static void Write(const SYNTHETIC_SCENE& scene, PublishTraceWriter& trace)
+        {
+            SyntheticScene generator(scene);
+            generator.Write(trace);
+        }
+
+    private:
+
+        SyntheticScene(const SYNTHETIC_SCENE& scene) : m_scene(scene), m_random(scene.seed)
+        {
+        }
+
+        void Write(PublishTraceWriter& trace)
+        {
+            DOM::Utils::COLOR white;
+
+            white.red = white.green = white.blue = white.alpha = 0xFF;
+            trace.RecordDocument(white, SYNTHETIC_SCENE_STAGE_HEIGHT, SYNTHETIC_SCENE_STAGE_WIDTH, SYNTHETIC_SCENE_FPS);
+
+            // Resources first, the way the frame command generator
+            // defines them ahead of the timeline that uses them
+            std::vector<FCM::Boolean> isBitmap(m_scene.layers);
+            for (FCM::U_Int32 i = 0; i < m_scene.layers; i++)
+            {
+                FCM::U_Int32 resourceId = i + 1;
+
+                isBitmap[i] = Random() < m_scene.bitmapFraction;
+                if (isBitmap[i])
+                {
+                    char name[32];
+                    snprintf(name, sizeof(name), "Bitmap %u", resourceId);
+                    std::string fileName = std::string(name) + ".png";
+
+                    trace.RecordDefineBitmap(resourceId, SYNTHETIC_SCENE_BITMAP_SIZE,
+                        SYNTHETIC_SCENE_BITMAP_SIZE, name, fileName);
+                }
+                else
+                {
+                    WriteShape(trace, resourceId);
+                }
+            }
+
+            FCM::U_Int32 timelineId = trace.RecordCreateTimeline();
+            for (FCM::U_Int32 frame = 0; frame < m_scene.frames; frame++)
+            {
+                for (FCM::U_Int32 i = 0; i < m_scene.layers; i++)
+                {
+                    FCM::U_Int32 objectId = i + 1;
+                    DOM::Utils::MATRIX2D matrix;
+
+                    GetTransform(i, frame, matrix);
+                    if (frame == 0)
+                    {
+                        trace.RecordPlaceObject(timelineId,
+                            isBitmap[i] ? TRACE_RECORD_ADD_BITMAP : TRACE_RECORD_ADD_SHAPE,
+                            objectId, objectId, i, matrix);
+                    }
+                    else
+                    {
+                        trace.RecordUpdateDisplayTransform(timelineId, objectId, matrix);
+                    }
+                }
+                trace.RecordShowFrame(timelineId);
+            }
+            trace.RecordBuildTimeline(timelineId, 0);
+        }
+
+        void WriteShape(PublishTraceWriter& trace, FCM::U_Int32 resourceId)
+        {
+            double radius = 20 + 40 * Random();
+
+            trace.RecordDefineShape(resourceId);
+            trace.RecordFillRegion(resourceId);
+
+            if (Random() < m_scene.gradientFraction)
+            {
+                DOM::Utils::MATRIX2D matrix;
+                std::vector<DOM::Utils::GRADIENT_COLOR_POINT> colorPoints(2);
+
+                // The gradient square of Animate (1638.4 px) fitted to the shape
+                matrix.a = matrix.d = (FCM::Float)(radius / 819.2);
+                matrix.b = matrix.c = 0;
+                matrix.tx = matrix.ty = 0;
+
+                colorPoints[0].color = RandomColor();
+                colorPoints[0].pos = 0;
+                colorPoints[1].color = RandomColor();
+                colorPoints[1].pos = 0xFF;
+                trace.RecordLinearGradient(matrix, colorPoints);
+            }
+            else
+            {
+                trace.RecordSolidColor(RandomColor());
+            }
+
+            trace.RecordPath(GetRing(radius), false);
+
+            if (Random() < m_scene.holeFraction)
+            {
+                trace.RecordHoles(resourceId);
+                trace.RecordPath(GetRing(radius / 2), true);
+            }
+        }
+
+        // Closed ring of quadratic edges; the controls sit where the
+        // tangents at both anchors meet, so the ring is close to a circle
+        std::vector<DOM::Utils::SEGMENT> GetRing(double radius) const
+        {
+            const double step = 2 * SYNTHETIC_SCENE_PI / m_scene.edgesPerPath;
+            const double controlRadius = radius / cos(step / 2);
+            std::vector<DOM::Utils::SEGMENT> edges(m_scene.edgesPerPath);
+
+            for (FCM::U_Int32 i = 0; i < m_scene.edgesPerPath; i++)
+            {
+                DOM::Utils::SEGMENT& edge = edges[i];
+                double angle = i * step;
+
+                edge.structSize = sizeof(DOM::Utils::SEGMENT);
+                edge.segmentType = DOM::Utils::QUAD_BEZIER_SEGMENT;
+                edge.quadBezierCurve.anchor1.x = (FCM::Float)(radius * cos(angle));
+                edge.quadBezierCurve.anchor1.y = (FCM::Float)(radius * sin(angle));
+                edge.quadBezierCurve.control.x = (FCM::Float)(controlRadius * cos(angle + step / 2));
+                edge.quadBezierCurve.control.y = (FCM::Float)(controlRadius * sin(angle + step / 2));
+                edge.quadBezierCurve.anchor2.x = (FCM::Float)(radius * cos(angle + step));
+                edge.quadBezierCurve.anchor2.y = (FCM::Float)(radius * sin(angle + step));
+            }
+            return edges;
+        }
+
+        // Each layer circles its own spot on the stage and spins, so every
+        // transform channel changes on every frame
+        void GetTransform(FCM::U_Int32 layer, FCM::U_Int32 frame, DOM::Utils::MATRIX2D& matrix) const
+        {
+            double phase = 2 * SYNTHETIC_SCENE_PI * layer / m_scene.layers;
+            double angle = phase + 2 * SYNTHETIC_SCENE_PI * frame / m_scene.frames;
+            double scale = 0.75 + 0.25 * sin(angle * 2);
+            double cx = SYNTHETIC_SCENE_STAGE_WIDTH * (0.5 + 0.35 * cos(phase));
+            double cy = SYNTHETIC_SCENE_STAGE_HEIGHT * (0.5 + 0.35 * sin(phase));
+
+            matrix.a = (FCM::Float)(scale * cos(angle));
+            matrix.b = (FCM::Float)(scale * sin(angle));
+            matrix.c = (FCM::Float)(-scale * sin(angle));
+            matrix.d = (FCM::Float)(scale * cos(angle));
+            matrix.tx = (FCM::Float)(cx + 20 * cos(angle));
+            matrix.ty = (FCM::Float)(cy + 20 * sin(angle));
+        }
+
+        DOM::Utils::COLOR RandomColor()
+        {
+            DOM::Utils::COLOR color;
+            color.red = (FCM::U_Int8)(Random() * 0xFF);
+            color.green = (FCM::U_Int8)(Random() * 0xFF);
+            color.blue = (FCM::U_Int8)(Random() * 0xFF);
+            color.alpha = 0xFF;
+            return color;
+        }
+
+        // Same sequence on every platform, unlike rand()
+        double Random()
+        {
+            m_random = m_random * 1664525u + 1013904223u;
+            return (m_random >> 8) / (double)(1u << 24);
+        }
+
+    private:
+
+        const SYNTHETIC_SCENE& m_scene;
+
+        FCM::U_Int32 m_random;
+    };
+};
+
+#endif // SYNTHETIC_SCENE_H_
@@ -2,12 +2,17 @@
 #include "PluginConfiguration.h"
 
 #include <vector>
+#include <algorithm>
 #include <cstring>
 #include <fstream>
+#include <sstream>
+#include <set>
+#include <cstdio>
 #include "FlashFCMPublicIDs.h"
 #include "FCMPluginInterface.h"
 #include "libjson.h"
 #include "Utils.h"
+#include "MatrixDecomposition.h"
 #include "FrameElement/ISound.h"
 #include "Service/Image/IBitmapExportService.h"
 #include "Service/TextLayout/ITextLinesGeneratorService.h"
@@ -48,6 +53,57 @@ namespace LottieExporter
 
     static const FCM::Float GRADIENT_VECTOR_CONSTANT = 16384.0;
 
+    // Export of one image or sound. Everything calling back into Animate
+    // (the export services, string allocation) is done on the publishing
+    // thread; a worker only reads the encoded image back and hashes it.
+    struct ASSET_EXPORT_JOB
+    {
+        FCM::AutoPtr<DOM::Service::Image::IBitmapExportService> bitmapExportService;
+        FCM::AutoPtr<DOM::Service::Sound::ISoundExportService> soundExportService;
+        FCM::AutoPtr<DOM::LibraryItem::IMediaItem> pMediaItem;
+        FCM::StringRep16 pFilePath;
+        std::string filePath;
+        std::string name;
+        std::string cacheKey;   // images only
+        FCM::Result result;
+        FCM::Boolean hashed;
+        std::uint64_t hash;
+        PublishProfiler* pProfiler;
+
+        // Publishing thread
+        void Export()
+        {
+            if (bitmapExportService)
+            {
+                ProfileScope scope(*pProfiler, PROFILE_PHASE_IMAGE_ENCODING);
+
+                result = bitmapExportService->ExportToFile(pMediaItem, pFilePath, 100);
+            }
+            else
+            {
+                ProfileScope scope(*pProfiler, PROFILE_PHASE_SOUND_ENCODING);
+
+                result = soundExportService->ExportToFile(pMediaItem, pFilePath);
+            }
+        }
+
+        // Any thread: only reads the file
+        void Hash()
+        {
+            std::fstream file;
+#ifdef _WINDOWS
+            file.open(pFilePath, std::ios_base::in | std::ios_base::binary);
+#else
+            file.open(filePath.c_str(), std::ios_base::in | std::ios_base::binary);
+#endif
+            if (file)
+            {
+                BitmapExportCache::HashStream(file, hash);
+                hashed = true;
+            }
+        }
+    };
+
     static const char* htmlOutput = 
         "<!DOCTYPE html>\r\n \
         <html>\r\n \
@@ -136,7 +192,17 @@ namespace LottieExporter
 			m_outputJSONFilePath = parent + jsonFile + ".json";
 			m_outputImageFolder = parent + IMAGE_FOLDER;
 			m_outputSoundFolder = parent + SOUND_FOLDER;
+			m_bitmapCache.Load(m_outputImageFolder, m_persistentImageCache, m_pCallback);
+			if (m_pSymbolCache)
+			{
+				m_pSymbolCache->Load(parent + jsonFile + SYMBOL_CACHE_FILE_EXTENSION, m_pCallback);
+			}
+		}
+		if (!m_traceFile.empty())
+		{
+			m_publishTrace.Open(m_traceFile, m_pCallback);
 		}
+		m_profiler.Start();
 		m_LottieManager = new LottieExporter::LottieManager;
         return FCM_SUCCESS;
     }
@@ -144,8 +210,25 @@ namespace LottieExporter
 
     FCM::Result JSONOutputWriter::EndOutput()
     {
+        FCM::Result res = FinishDocument();
 
-        return FCM_SUCCESS;
+        FinishAssetExport();
+        m_bitmapCache.Save();
+        if (m_pSymbolCache)
+        {
+            m_pSymbolCache->Save();
+        }
+        m_publishTrace.Close();
+
+        m_profiler.Stop();
+        m_profiler.Trace(m_pCallback);
+        if (m_statsFile)
+        {
+            std::string statsFilePath = m_outputJSONFilePath.substr(0, m_outputJSONFilePath.rfind('.')) + PUBLISH_STATS_FILE_EXTENSION;
+            m_profiler.WriteStats(statsFilePath, m_pCallback);
+        }
+
+        return res;
     }
 
 
@@ -168,1294 +251,1821 @@ namespace LottieExporter
 
     FCM::Result JSONOutputWriter::EndDocument()
     {
-        std::fstream file;
-             
+        // The assets reference the exported files by name
+        {
+            ProfileScope scope(m_profiler, PROFILE_PHASE_ASSET_WAIT);
+            FinishAssetExport();
+        }
+
         // Write the JSON file (overwrite file if it already exists)
-        Utils::OpenFStream(m_outputJSONFilePath, file, std::ios_base::trunc|std::ios_base::out, m_pCallback);
-        if(!file)
-            std::cout<<"UNABLE TO OPEN"<<std::endl;
-        
-        JSONNode firstNode(JSON_NODE);
-		AddVersion(firstNode);
-		AddWidthHeight(firstNode);
-		AddIp(firstNode);
-		AddOp(firstNode);
-		AddFr(firstNode);
-        AddAssets(firstNode);
-		AddLayers(firstNode);
-		AddMarkers(firstNode);
-        
-        file << firstNode.write_formatted();
+        Utils::OpenFStream(m_outputJSONFilePath, m_documentFile, std::ios_base::trunc|std::ios_base::out|std::ios_base::binary, m_pCallback);
+        if (!m_documentFile)
+        {
+            Utils::Trace(m_pCallback, "Output file (%s) could not be opened\n", m_outputJSONFilePath.c_str());
+            m_documentResult = FCM_GENERAL_ERROR;
+            return m_documentResult;
+        }
+
+        // The legacy tree is separate from the Lottie model
+        if (m_legacyOutput)
+        {
+            WriteLegacyDocument();
+        }
+
+        m_documentResult = FCM_SUCCESS;
+        m_documentPending = true;
+        m_documentPool.Enqueue([this] { m_documentResult = WriteDocument(); });
+        return FCM_SUCCESS;
+    }
+
+
+    FCM::Result JSONOutputWriter::FinishDocument()
+    {
+        if (!m_documentPending)
+            return m_documentResult;
+
+        m_documentPool.Join();
+        m_documentPending = false;
+        m_documentFile.close();
+
+        if (m_sharedShapeContents > 0)
+        {
+            Utils::Trace(m_pCallback, "%u shape contents shared as precomps\n", m_sharedShapeContents);
+        }
+        if (FCM_FAILURE_CODE(m_documentResult))
+        {
+            Utils::Trace(m_pCallback, "Output file (%s) could not be written\n", m_outputJSONFilePath.c_str());
+        }
+
+        return m_documentResult;
+    }
+
+
+    // Runs on the document writer: reduces the model and writes it to the
+    // file opened by EndDocument
+    FCM::Result JSONOutputWriter::WriteDocument()
+    {
+        std::fstream& file = m_documentFile;
+
+        {
+            ProfileScope scope(m_profiler, PROFILE_PHASE_KEYFRAME_REDUCTION);
+            MeasureSymbols();
+            LookupCachedSymbols();
+            m_LottieManager->MergeShapeTweens(m_keyframeTolerance);
+            m_LottieManager->ReduceKeyframes(m_keyframeTolerance);
+            if (m_outputProfile != FULL_OUTPUT_PROFILE)
+                m_LottieManager->CollapseStaticTracks();
+        }
+
+        {
+            ProfileScope scope(m_profiler, PROFILE_PHASE_SERIALIZATION);
+            BuildShapeContents();
+            while (!CheckCachedSymbols())
+            {
+                BuildShapeContents();
+            }
+
+            // Compact JSON is streamed straight from the LottieManager; nothing
+            // of the document is held in memory beyond the write buffer.
+            JSONStreamWriter writer(file);
+            ConfigureWriter(writer);
+            writer.StartObject();
+            AddVersion(writer);
+            AddWidthHeight(writer);
+            AddIp(writer);
+            AddOp(writer);
+            AddFr(writer);
+            AddAssets(writer);
+            AddLayers(writer, m_LottieManager->GetCompositionAtIndex(0));
+            AddMarkers(writer);
+            writer.EndObject();
+            writer.Flush();
+        }
+
+        if (!file)
+        {
+            return FCM_GENERAL_ERROR;
+        }
+
+        m_profiler.SetCount(PROFILE_COUNTER_LAYERS, m_LottieManager->GetNumofLayers());
+        m_profiler.SetCount(PROFILE_COUNTER_GROUPS, m_LottieManager->GetNumofAllGroups());
+        m_profiler.SetCount(PROFILE_COUNTER_KEYFRAMES, m_LottieManager->GetNumofKeyframes());
+        m_profiler.SetCount(PROFILE_COUNTER_IMAGES, m_LottieManager->GetNumofImageResources());
+        m_profiler.SetCount(PROFILE_COUNTER_OUTPUT_BYTES, (std::uint64_t)file.tellp());
+
+        std::uint64_t cachedSymbols = 0;
+        for (size_t c = 1; c < m_LottieManager->GetNumofCompositions(); c++)
+        {
+            if (m_LottieManager->GetCompositionAtIndex(c)->cached)
+                cachedSymbols++;
+        }
+        m_profiler.SetCount(PROFILE_COUNTER_CACHED_SYMBOLS, cachedSymbols);
+
+        m_shapeContents.clear();
+        m_shapeContentOfResource.Clear();
+        m_shapeContentsByHash.clear();
+        m_symbolKeys.clear();
+        m_symbolEntries.clear();
+        m_resourceShapes.clear();
+
+        return FCM_SUCCESS;
+    }
+
+
+    void JSONOutputWriter::ConfigureWriter(JSONStreamWriter& writer) const
+    {
+        writer.SetOmitDefaults(m_outputProfile != FULL_OUTPUT_PROFILE);
+        writer.SetOmitMetadata(m_outputProfile == MINIMAL_OUTPUT_PROFILE);
+        for (int c = 0; c < NUMBER_CLASS_COUNT; c++)
+            writer.SetPrecision((NumberClass)c, m_numberPrecision[c]);
+    }
+
+
+    // Dumps the legacy (CreateJS style) tree next to the Lottie file. This is
+    // only built when the legacy JSON debug option is enabled.
+    FCM::Result JSONOutputWriter::WriteLegacyDocument()
+    {
+        std::fstream file;
+        std::string legacyFilePath;
+
+        legacyFilePath = m_outputJSONFilePath.substr(0, m_outputJSONFilePath.rfind('.')) + ".legacy.json";
+
+        Utils::OpenFStream(legacyFilePath, file, std::ios_base::trunc|std::ios_base::out, m_pCallback);
+        if (!file)
+        {
+            Utils::Trace(m_pCallback, "Legacy output file (%s) could not be opened\n", legacyFilePath.c_str());
+            return FCM_GENERAL_ERROR;
+        }
+
+        m_pRootNode->push_back(*m_pShapeArray);
+        m_pRootNode->push_back(*m_pBitmapArray);
+        m_pRootNode->push_back(*m_pTextArray);
+        m_pRootNode->push_back(*m_pSoundArray);
+        m_pRootNode->push_back(*m_pTimelineArray);
+
+        file << m_pRootNode->write_formatted();
         file.close();
-        
-        bool removeWhiteSpaces = true;
-        if(removeWhiteSpaces)
-        {
-            std::fstream ifs;
-            Utils::OpenFStream(m_outputJSONFilePath, ifs, std::ios_base::binary | std::ios_base::in, m_pCallback);
-            if (ifs) {
-                std::vector<char> content((std::istreambuf_iterator<char>(ifs)),
-                                          (std::istreambuf_iterator<char>()));
-                ifs.close();
-                content.erase(std::remove_if(content.begin(), content.end(), ::isspace), content.end());
-                std::fstream outfile;
-                Utils::OpenFStream(m_outputJSONFilePath, outfile, std::ios_base::binary | std::ios_base::out, m_pCallback);
-                if (outfile) {
-                    outfile.write(content.data(), content.size());
-                    outfile.close();
+
+        return FCM_SUCCESS;
+    }
+
+
+    FCM::Result JSONOutputWriter::AddFr(JSONStreamWriter& writer)
+    {
+        writer.WriteProperty("fr", m_LottieManager->GetFPS());
+        return FCM_SUCCESS;
+    }
+
+
+    FCM::Result JSONOutputWriter::AddIp(JSONStreamWriter& writer)
+    {
+        writer.WriteProperty("ip", m_LottieManager->GetIp());
+        return FCM_SUCCESS;
+    }
+
+
+    FCM::Result JSONOutputWriter::AddOp(JSONStreamWriter& writer)
+    {
+        writer.WriteProperty("op", m_LottieManager->GetOp());
+        return FCM_SUCCESS;
+    }
+
+
+    // Large compositions have their layers written on the serialize threads,
+    // each into a buffer of its own, then copied in z-order: the output does
+    // not depend on the number of threads.
+    FCM::Result JSONOutputWriter::AddLayers(JSONStreamWriter& writer, const composition* comp)
+    {
+        std::uint32_t size = comp->layers.size();
+
+        writer.StartArray("layers");
+        if (m_serializeLoop.GetNumThreads() <= 1 || size < SERIALIZE_PARALLEL_MIN_LAYERS)
+        {
+            for (std::uint32_t i = 0; i < size; i++)
+                AddLayer(writer, comp->layers[i]);
+        }
+        else
+        {
+            // Batches bound the memory held by the buffers
+            std::vector<std::string> buffers;
+            for (std::uint32_t first = 0; first < size; first += SERIALIZE_BATCH_LAYERS)
+            {
+                std::uint32_t count = std::min(size - first, (std::uint32_t)SERIALIZE_BATCH_LAYERS);
+
+                buffers.assign(count, std::string());
+                m_serializeLoop.Run(count, [this, comp, first, &buffers](size_t i)
+                {
+                    buffers[i] = WriteLayer(comp->layers[first + i]);
+                });
+
+                for (std::uint32_t i = 0; i < count; i++)
+                    writer.WriteRaw(buffers[i]);
+            }
+        }
+        writer.EndArray();
+
+        return FCM_SUCCESS;
+    }
+
+
+    std::string JSONOutputWriter::WriteLayer(const Layer* layer)
+    {
+        std::ostringstream out;
+        {
+            JSONStreamWriter layerWriter(out);
+            ConfigureWriter(layerWriter);
+            AddLayer(layerWriter, layer);
+        }
+        return out.str();
+    }
+
+
+    // A symbol instance is a precomp layer of the symbol composition; a
+    // shape layer whose content is shared is a precomp layer of the content.
+    // Only reads the model and the shape contents, so layers can be written
+    // at the same time.
+    void JSONOutputWriter::AddLayer(JSONStreamWriter& writer, const Layer* layer)
+    {
+        const SHAPE_CONTENT* content = GetShapeContent(layer);
+        const SHAPE_CONTENT* precomp = (content && !content->refId.empty()) ? content : NULL;
+        const composition* symbol = (layer->ty == Precomp) ? m_LottieManager->GetCompositionOfResource(layer->resourceId) : NULL;
+
+        // A symbol that was never built has nothing to show
+        int ty = layer->ty;
+        if (precomp)
+            ty = Precomp;
+        else if (layer->ty == Precomp && symbol == NULL)
+            ty = Null;
+
+        writer.StartObject();
+        writer.WriteOptional("ddd", layer->ddd, 0);
+        writer.WriteProperty("ind", layer->ind);
+        writer.WriteProperty("ty", ty);
+        writer.WriteMetadata("nm", layer->nm);
+        if (layer->ty == Image)
+        {
+            const image_resource* image = m_LottieManager->Getimage_resource_with_id(layer->resourceId);
+            if (image)
+            {
+                writer.WriteProperty("cl", image->cl);
+                writer.WriteProperty("refId", image->ref_id);
+            }
+        }
+        if (precomp)
+        {
+            writer.WriteProperty("refId", precomp->refId);
+            writer.WriteProperty("w", precomp->width);
+            writer.WriteProperty("h", precomp->height);
+        }
+        else if (symbol)
+        {
+            writer.WriteProperty("refId", symbol->id);
+            writer.WriteProperty("w", symbol->width);
+            writer.WriteProperty("h", symbol->height);
+        }
+        writer.WriteProperty("ip", layer->ip);
+        writer.WriteProperty("op", layer->op);
+        writer.WriteOptional("ao", layer->ao, 0);
+        writer.WriteProperty("st", layer->st);
+        writer.WriteOptional("bm", layer->bm, 0);
+
+        if (precomp)
+        {
+            const double anchor[2] = { -precomp->left, -precomp->top };
+            AddLayerTransform(writer, layer, anchor);
+        }
+        else if (symbol)
+        {
+            const double anchor[2] = { -symbol->left, -symbol->top };
+            AddLayerTransform(writer, layer, anchor);
+            AddTimeRemap(writer, layer, symbol);
+        }
+        else
+        {
+            AddLayerTransform(writer, layer);
+        }
+
+        if (layer->parent_ind != INVALID_LAYER_INDEX)
+            writer.WriteProperty("parent", layer->parent_ind);
+
+        if (content == NULL && layer->ty != Precomp)
+            AddGroup(writer, layer->resourceId, layer->morph.IsAnimated() ? &layer->morph : NULL);
+        else if (precomp == NULL)
+            writer.WriteRaw(content->shapes);
+        writer.EndObject();
+    }
+
+
+    // Writes a property that does not move: "k" is a number for a single
+    // value and an array otherwise. A property resting at its default (the
+    // same for every component) is left out when defaults are omitted.
+    template <typename T>
+    static void WriteStaticProperty(JSONStreamWriter& writer, const char* name, const T* k, int count, double rest, int ix)
+    {
+        if (writer.OmitsDefaults() && std::count(k, k + count, rest) == count)
+            return;
+
+        writer.StartObject(name);
+        writer.WriteOptional("a", 0, 0);
+        if (count == 1)
+        {
+            writer.WriteProperty("k", k[0]);
+        }
+        else
+        {
+            writer.StartArray("k");
+            for (int c = 0; c < count; c++)
+                writer.WriteValue(k[c]);
+            writer.EndArray();
+        }
+        writer.WriteMetadata("ix", ix);
+        writer.EndObject();
+    }
+
+
+    // Writes how a key moves on to the next one: either a hold or the per
+    // dimension out/in ease handles found by the keyframe reduction
+    static void WriteKeyframeEasing(JSONStreamWriter& writer, const keyframe_track& track, std::uint32_t key)
+    {
+        writer.WriteOptional("h", (int)track.h[key], 0);
+        if (track.h[key] || !track.IsEased())
+            return;
+
+        NumberClassScope scope(writer, NUMBER_CLASS_EASE);
+
+        const coordinates* o = &track.o[key * track.dims];
+        const coordinates* i = &track.i[key * track.dims];
+
+        writer.StartObject("o");
+        writer.StartArray("x");
+        for (int d = 0; d < track.dims; d++)
+            writer.WriteValue(o[d].x);
+        writer.EndArray();
+        writer.StartArray("y");
+        for (int d = 0; d < track.dims; d++)
+            writer.WriteValue(o[d].y);
+        writer.EndArray();
+        writer.EndObject();
+
+        writer.StartObject("i");
+        writer.StartArray("x");
+        for (int d = 0; d < track.dims; d++)
+            writer.WriteValue(i[d].x);
+        writer.EndArray();
+        writer.StartArray("y");
+        for (int d = 0; d < track.dims; d++)
+            writer.WriteValue(i[d].y);
+        writer.EndArray();
+        writer.EndObject();
+    }
+
+
+    // Writes a transform property. A static one-dimensional value is a
+    // plain number and a static point gets 'z' as its third coordinate. An
+    // animated track lists its keys with their easing; the last key ends the
+    // animation and always holds. 'z' is also the value of the property at
+    // rest, which is left out when defaults are omitted.
+    static void WriteKeyframeTrack(JSONStreamWriter& writer, const char* name, const keyframe_track& track, float z)
+    {
+        std::uint32_t size = track.Size();
+        if (size == 0)
+            return;
+
+        if (!track.IsAnimated() && writer.OmitsDefaults() &&
+            std::count(track.v.begin(), track.v.end(), z) == track.dims)
+            return;
+
+        writer.StartObject(name);
+        writer.WriteOptional("a", track.IsAnimated() ? 1 : 0, 0);
+        if (!track.IsAnimated())
+        {
+            const float* value = track.Value(0);
+            if (track.dims == 1)
+            {
+                writer.WriteProperty("k", value[0]);
+            }
+            else
+            {
+                writer.StartArray("k");
+                for (int d = 0; d < track.dims; d++)
+                    writer.WriteValue(value[d]);
+                writer.WriteValue(z);
+                writer.EndArray();
+            }
+        }
+        else
+        {
+            writer.StartArray("k");
+            for (std::uint32_t key = 0; key < size; key++)
+            {
+                const float* value = track.Value(key);
+
+                writer.StartObject();
+                {
+                    NumberClassScope time(writer, NUMBER_CLASS_TIME);
+                    writer.WriteProperty("t", track.t[key]);
+                }
+                writer.StartArray("s");
+                for (int d = 0; d < track.dims; d++)
+                    writer.WriteValue(value[d]);
+                writer.EndArray();
+                if (key + 1 < size)
+                    WriteKeyframeEasing(writer, track, key);
+                else
+                    writer.WriteProperty("h", 1);
+                writer.EndObject();
+            }
+            writer.EndArray();
+        }
+        writer.WriteMetadata("ix", track.ix);
+        writer.EndObject();
+    }
+
+
+    // Writes the "ks" transform of a layer from its keyframe tracks.
+    // A precomp layer is anchored at the origin of the resource, which sits
+    // at (-left, -top) inside the precomp.
+    FCM::Result JSONOutputWriter::AddLayerTransform(JSONStreamWriter& writer, const Layer* layer, const double* precompAnchor)
+    {
+        const layer_transform& prop = layer->ks;
+        NumberClassScope scope(writer, NUMBER_CLASS_TRANSFORM);
+
+        writer.StartObject("ks");
+
+        // POSITION
+        WriteKeyframeTrack(writer, "p", prop.p, 0);
+
+        // ANCHORPOINT
+        if (precompAnchor)
+        {
+            const double anchor[3] = { precompAnchor[0], precompAnchor[1], 0 };
+            WriteStaticProperty(writer, "a", anchor, 3, 0, 1);
+        }
+        else
+        {
+            WriteStaticProperty(writer, "a", prop.a.k, 3, 0, prop.a.ix);
+        }
+
+        // SCALE
+        WriteKeyframeTrack(writer, "s", prop.s, 100);
+
+        // ROTATION
+        WriteKeyframeTrack(writer, "r", prop.r, 0);
+
+        // OPACITY
+        WriteStaticProperty(writer, "o", &prop.o.k, 1, 100, prop.o.ix);
+
+        writer.EndObject();
+
+        return FCM_SUCCESS;
+    }
+
+
+    // Writes the "tm" of a symbol instance: the symbol time, in seconds,
+    // shown on each frame of the instance. A segment plays the symbol
+    // frames linearly up to the last one, which holds until the next segment
+    // starts again from frame 0. Times are written at full precision and a
+    // hundredth of a frame late, so that a player converting them back to
+    // frames does not land on the frame before.
+    void JSONOutputWriter::AddTimeRemap(JSONStreamWriter& writer, const Layer* layer, const composition* symbol)
+    {
+        const double fps = m_LottieManager->GetFPS() > 0 ? m_LottieManager->GetFPS() : 1;
+        const std::uint32_t last = symbol->op > 1 ? symbol->op - 1 : 0;
+        const std::uint32_t first = layer->first_frame < last ? layer->first_frame : last;
+
+        // Each key: instance frame, symbol frame, holds
+        struct TIME_KEY { std::uint32_t t; std::uint32_t frame; bool hold; };
+        std::vector<TIME_KEY> keys;
+
+        if (layer->loop == SingleFrameInstance || first == last)
+        {
+            TIME_KEY key = { layer->ip, first, true };
+            keys.push_back(key);
+        }
+        else
+        {
+            std::uint32_t t = layer->ip;
+            std::uint32_t frame = first;
+            while (t < layer->op)
+            {
+                TIME_KEY play = { t, frame, false };
+                TIME_KEY end = { t + (last - frame), last, true };
+                keys.push_back(play);
+                keys.push_back(end);
+                if (layer->loop != LoopInstance)
+                    break;
+
+                t = end.t + 1;
+                frame = 0;
+            }
+        }
+
+        NumberClassScope scope(writer, NUMBER_CLASS_DEFAULT);
+
+        writer.StartObject("tm");
+        if (keys.size() == 1)
+        {
+            writer.WriteProperty("k", (keys[0].frame + 0.01) / fps);
+        }
+        else
+        {
+            writer.WriteProperty("a", 1);
+            writer.StartArray("k");
+            for (size_t key = 0; key < keys.size(); key++)
+            {
+                writer.StartObject();
+                {
+                    NumberClassScope time(writer, NUMBER_CLASS_TIME);
+                    writer.WriteProperty("t", keys[key].t);
+                }
+                writer.StartArray("s");
+                writer.WriteValue((keys[key].frame + 0.01) / fps);
+                writer.EndArray();
+                if (keys[key].hold)
+                {
+                    writer.WriteProperty("h", 1);
+                }
+                else
+                {
+                    // Linear
+                    writer.StartObject("o");
+                    writer.StartArray("x");
+                    writer.WriteValue(0);
+                    writer.EndArray();
+                    writer.StartArray("y");
+                    writer.WriteValue(0);
+                    writer.EndArray();
+                    writer.EndObject();
+                    writer.StartObject("i");
+                    writer.StartArray("x");
+                    writer.WriteValue(1);
+                    writer.EndArray();
+                    writer.StartArray("y");
+                    writer.WriteValue(1);
+                    writer.EndArray();
+                    writer.EndObject();
                 }
+                writer.EndObject();
             }
+            writer.EndArray();
         }
-        
-      
-        delete m_inv;
-        delete m_outv;
-        delete m_cv;
-        delete m_items;
-        delete m_version;
-        delete m_layers;
+        writer.WriteMetadata("ix", 2);
+        writer.EndObject();
+    }
+
+
+    // 64-bit FNV-1a; only used to bucket candidates, matches are compared
+    static std::uint64_t HashContent(const std::string& str)
+    {
+        std::uint64_t hash = 14695981039346656037ULL;
+        for (size_t i = 0; i < str.length(); i++)
+        {
+            hash ^= (unsigned char)str[i];
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+
+    static void AddToBounds(double x, double y, double bounds[4])
+    {
+        if (x < bounds[0]) bounds[0] = x;
+        if (y < bounds[1]) bounds[1] = y;
+        if (x > bounds[2]) bounds[2] = x;
+        if (y > bounds[3]) bounds[3] = y;
+    }
+
+
+    // Maps a point through the (static) group transform: p + R * S * (pt - a)
+    static void AddGroupPointToBounds(const group* gr, double x, double y, double bounds[4])
+    {
+        if (gr->ks.a.size() == 1)
+        {
+            x -= gr->ks.a[0].k[0];
+            y -= gr->ks.a[0].k[1];
+        }
+        if (gr->ks.s.size() == 1)
+        {
+            x *= gr->ks.s[0].k[0] / 100.0;
+            y *= gr->ks.s[0].k[1] / 100.0;
+        }
+        if (gr->ks.r.size() == 1 && gr->ks.r[0].k != 0)
+        {
+            double angle = gr->ks.r[0].k / MATRIX_RADIANS_TO_DEGREES;
+            double rx = x * cos(angle) - y * sin(angle);
+            double ry = x * sin(angle) + y * cos(angle);
+            x = rx;
+            y = ry;
+        }
+        if (gr->ks.p.size() == 1)
+        {
+            x += gr->ks.p[0].k[0];
+            y += gr->ks.p[0].k[1];
+        }
+        AddToBounds(x, y, bounds);
+    }
+
+
+    // Bounds of the groups of a resource. The tangent handles are included
+    // (a bezier lies within its control points) and strokes are padded by
+    // half their width, or by the miter length for miter joins.
+    static void GetGroupBounds(LottieManager* manager, int resourceId, double bounds[4])
+    {
+        std::int32_t size = manager->GetNumofGroups(resourceId);
+
+        bounds[0] = bounds[1] = HUGE_VAL;
+        bounds[2] = bounds[3] = -HUGE_VAL;
+
+        for (std::int32_t ind = 0; ind < size; ind++)
+        {
+            const group* gr = manager->GetGroupAtIndex(ind, resourceId);
+            if (gr == NULL)
+                continue;
+
+            // Recognised rectangles and ellipses keep their path, which
+            // also covers their rotation
+            double groupBounds[4] = { HUGE_VAL, HUGE_VAL, -HUGE_VAL, -HUGE_VAL };
+            if (gr->r.isrect && gr->sh.shp.v.empty())
+            {
+                double halfW = gr->r.s.k[0] / 2.0;
+                double halfH = gr->r.s.k[1] / 2.0;
+                AddToBounds(gr->r.rc.k[0] - halfW, gr->r.rc.k[1] - halfH, groupBounds);
+                AddToBounds(gr->r.rc.k[0] + halfW, gr->r.rc.k[1] + halfH, groupBounds);
+            }
+            else
+            {
+                const ks& path = gr->sh.shp;
+                for (std::uint32_t i = 0; i < path.v.size(); i++)
+                {
+                    const coordinates& v = path.v[i];
+                    AddToBounds(v.x, v.y, groupBounds);
+                    AddToBounds(v.x + path.i[i].x, v.y + path.i[i].y, groupBounds);
+                    AddToBounds(v.x + path.o[i].x, v.y + path.o[i].y, groupBounds);
+                }
+            }
+
+            if (groupBounds[0] > groupBounds[2])
+                continue;
+
+            if (gr->st.hasstroke)
+            {
+                double pad = gr->st.solid.w.k / 2.0;
+                if (gr->st.solid.lj == 1 && gr->st.solid.ml > 1)
+                    pad *= gr->st.solid.ml;
+                groupBounds[0] -= pad;
+                groupBounds[1] -= pad;
+                groupBounds[2] += pad;
+                groupBounds[3] += pad;
+            }
+
+            AddGroupPointToBounds(gr, groupBounds[0], groupBounds[1], bounds);
+            AddGroupPointToBounds(gr, groupBounds[2], groupBounds[1], bounds);
+            AddGroupPointToBounds(gr, groupBounds[0], groupBounds[3], bounds);
+            AddGroupPointToBounds(gr, groupBounds[2], groupBounds[3], bounds);
+        }
+
+        if (bounds[0] > bounds[2])
+        {
+            bounds[0] = bounds[1] = bounds[2] = bounds[3] = 0;
+        }
+    }
+
+
+    // Value of a track at 'time' as built: every key holds until the next
+    static const float* GetTrackValue(const keyframe_track& track, float time, const float* rest)
+    {
+        if (track.Size() == 0)
+            return rest;
+
+        std::uint32_t key = (std::uint32_t)(std::upper_bound(track.t.begin(), track.t.end(), time) - track.t.begin());
+        return track.Value(key > 0 ? key - 1 : 0);
+    }
+
+
+    // Bounds of the content of a layer in its own space; false if it draws
+    // nothing. Content the model has no geometry for gets the default size
+    // of a symbol.
+    static bool GetLayerContentBounds(LottieManager* manager, const Layer* layer, double bounds[4])
+    {
+        bounds[0] = bounds[1] = HUGE_VAL;
+        bounds[2] = bounds[3] = -HUGE_VAL;
+
+        switch (layer->ty)
+        {
+        case Shape:
+        {
+            double groupBounds[4];
+            GetGroupBounds(manager, layer->resourceId, groupBounds);
+            AddToBounds(groupBounds[0], groupBounds[1], bounds);
+            AddToBounds(groupBounds[2], groupBounds[3], bounds);
+
+            // Tweened paths, through their group transform
+            for (size_t g = 0; g < layer->morph.paths.size(); g++)
+            {
+                const group* gr = manager->GetGroupAtIndex((std::int32_t)g, layer->resourceId);
+                if (gr == NULL)
+                    continue;
+
+                for (size_t k = 0; k < layer->morph.paths[g].size(); k++)
+                {
+                    const ks& path = layer->morph.paths[g][k];
+                    for (std::uint32_t i = 0; i < path.v.size(); i++)
+                    {
+                        const coordinates& v = path.v[i];
+                        AddGroupPointToBounds(gr, v.x, v.y, bounds);
+                        AddGroupPointToBounds(gr, v.x + path.i[i].x, v.y + path.i[i].y, bounds);
+                        AddGroupPointToBounds(gr, v.x + path.o[i].x, v.y + path.o[i].y, bounds);
+                    }
+                }
+            }
+
+            // An empty resource has zero bounds
+            if (groupBounds[0] == groupBounds[2] && groupBounds[1] == groupBounds[3] && layer->morph.paths.empty())
+                return false;
+            break;
+        }
+        case Image:
+        {
+            const image_resource* image = manager->Getimage_resource_with_id(layer->resourceId);
+            if (image == NULL)
+                return false;
+            AddToBounds(0, 0, bounds);
+            AddToBounds(image->width, image->height, bounds);
+            break;
+        }
+        case Precomp:
+        {
+            const composition* symbol = manager->GetCompositionOfResource(layer->resourceId);
+            if (symbol == NULL)
+                return false;
+            AddToBounds(symbol->left, symbol->top, bounds);
+            AddToBounds(symbol->left + symbol->width, symbol->top + symbol->height, bounds);
+            break;
+        }
+        case Null:
+            return false;
+        default:
+        {
+            int stageWidth = 0;
+            int stageHeight = 0;
+            manager->GetStageWidthHeight(stageWidth, stageHeight);
+            AddToBounds(-stageWidth, -stageHeight, bounds);
+            AddToBounds(stageWidth, stageHeight, bounds);
+            break;
+        }
+        }
+
+        return bounds[0] <= bounds[2];
+    }
+
+
+    // The layers of a symbol are placed relative to its origin. Their
+    // content is mapped through the transform of every frame it changes on;
+    // a nested symbol is measured before the symbols that use it, as it is
+    // defined first. A symbol drawing nothing keeps its default size.
+    void JSONOutputWriter::MeasureSymbols()
+    {
+        for (size_t c = 1; c < m_LottieManager->GetNumofCompositions(); c++)
+        {
+            composition* comp = m_LottieManager->GetCompositionAtIndex(c);
+
+            double bounds[4] = { HUGE_VAL, HUGE_VAL, -HUGE_VAL, -HUGE_VAL };
+            for (size_t i = 0; i < comp->layers.size(); i++)
+            {
+                const Layer* layer = comp->layers[i];
+
+                double content[4];
+                if (!GetLayerContentBounds(m_LottieManager, layer, content))
+                    continue;
+
+                const layer_transform& prop = layer->ks;
+                std::vector<float> times;
+                times.insert(times.end(), prop.p.t.begin(), prop.p.t.end());
+                times.insert(times.end(), prop.s.t.begin(), prop.s.t.end());
+                times.insert(times.end(), prop.r.t.begin(), prop.r.t.end());
+                std::sort(times.begin(), times.end());
+                times.erase(std::unique(times.begin(), times.end()), times.end());
+                if (times.empty())
+                    times.push_back(0);
+
+                static const float position[2] = { 0, 0 };
+                static const float scale[2] = { 100, 100 };
+                static const float rotation = 0;
+                for (size_t t = 0; t < times.size(); t++)
+                {
+                    const float* p = GetTrackValue(prop.p, times[t], position);
+                    const float* s = GetTrackValue(prop.s, times[t], scale);
+                    double angle = *GetTrackValue(prop.r, times[t], &rotation) / MATRIX_RADIANS_TO_DEGREES;
+
+                    // p + R * S * (pt - a)
+                    for (int corner = 0; corner < 4; corner++)
+                    {
+                        double x = ((corner & 1) ? content[2] : content[0]) - prop.a.k[0];
+                        double y = ((corner & 2) ? content[3] : content[1]) - prop.a.k[1];
+                        x *= s[0] / 100.0;
+                        y *= s[1] / 100.0;
+                        AddToBounds(p[0] + x * cos(angle) - y * sin(angle), p[1] + x * sin(angle) + y * cos(angle), bounds);
+                    }
+                }
+            }
+
+            if (bounds[0] > bounds[2])
+                continue;
+
+            // Same pixel of margin as the shape contents
+            double left = floor(bounds[0]) - 1;
+            double top = floor(bounds[1]) - 1;
+            m_LottieManager->SetCompositionBounds(comp, left, top, ceil(bounds[2]) + 1 - left, ceil(bounds[3]) + 1 - top);
+        }
+    }
+
+
+    // Serializes the shapes of every shape resource once and looks for
+    // resources drawing exactly the same content (same paths, fills, strokes
+    // and group transforms). Content drawn by more than one layer becomes a
+    // precomp asset; the layers then only reference it. A cached symbol
+    // counts the contents its cached layers draw.
+    FCM::Result JSONOutputWriter::BuildShapeContents()
+    {
+        std::vector<const Layer*> layers;
+
+        m_shapeContents.clear();
+        m_shapeContentOfResource.Clear();
+        m_shapeContentsByHash.clear();
+
+        // Symbols share content with the main timeline and with each other
+        for (size_t c = 0; c < m_LottieManager->GetNumofCompositions(); c++)
+        {
+            const composition* comp = m_LottieManager->GetCompositionAtIndex(c);
+            if (comp->cached)
+            {
+                const std::vector<SYMBOL_CACHE_SHAPE>& shapes = m_symbolEntries[c]->shapes;
+                for (size_t i = 0; i < shapes.size(); i++)
+                {
+                    FCM::U_Int32 index = FindShapeContent(shapes[i].shapes);
+                    if (index == m_shapeContents.size())
+                    {
+                        SHAPE_CONTENT content;
+                        content.shapes = shapes[i].shapes;
+                        content.users = 0;
+                        content.left = shapes[i].left;
+                        content.top = shapes[i].top;
+                        content.width = shapes[i].width;
+                        content.height = shapes[i].height;
+                        AddShapeContent(content);
+                    }
+                    m_shapeContents[index].users++;
+                }
+                continue;
+            }
+            layers.insert(layers.end(), comp->layers.begin(), comp->layers.end());
+        }
+
+        for (std::uint32_t i = 0; i < layers.size(); i++)
+        {
+            const Layer* layer = layers[i];
+            if (layer->ty != Shape || layer->morph.IsAnimated())
+                continue;
+
+            const FCM::U_Int32* pIndex = m_shapeContentOfResource.Find(layer->resourceId);
+            if (pIndex)
+            {
+                m_shapeContents[*pIndex].users++;
+                continue;
+            }
+
+            std::string shapes = GetResourceShapes(layer->resourceId);
+            FCM::U_Int32 index = FindShapeContent(shapes);
+            if (index == m_shapeContents.size())
+            {
+                double bounds[4];
+                GetGroupBounds(m_LottieManager, layer->resourceId, bounds);
+
+                // Precomp layers are clipped to their size: keep a pixel of
+                // margin for antialiasing.
+                SHAPE_CONTENT content;
+                content.shapes.swap(shapes);
+                content.users = 0;
+                content.left = floor(bounds[0]) - 1;
+                content.top = floor(bounds[1]) - 1;
+                content.width = ceil(bounds[2]) + 1 - content.left;
+                content.height = ceil(bounds[3]) + 1 - content.top;
+                AddShapeContent(content);
+            }
+
+            m_shapeContents[index].users++;
+            m_shapeContentOfResource.Insert(layer->resourceId) = index;
+        }
+
+        // The ids follow the content, so that a cached symbol refers to the
+        // same asset in every publish
+        std::set<std::string> refIds;
+        FCM::U_Int32 shared = 0;
+        for (size_t i = 0; i < m_shapeContents.size(); i++)
+        {
+            // Empty resources are not worth an asset
+            if (m_shapeContents[i].users > 1 && m_shapeContents[i].width > 2)
+            {
+                char hex[32];
+                snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)HashContent(m_shapeContents[i].shapes));
+
+                std::string refId = std::string("shape_") + hex;
+                for (int n = 1; !refIds.insert(refId).second; n++)
+                {
+                    refId = std::string("shape_") + hex + "_" + Utils::ToString(n);
+                }
+                m_shapeContents[i].refId = refId;
+                shared++;
+            }
+        }
+
+        // Traced by FinishDocument, off the document writer
+        m_sharedShapeContents = shared;
+
+        return FCM_SUCCESS;
+    }
+
+
+    // "shapes" member of a shape resource
+    std::string JSONOutputWriter::WriteShapes(int resourceId)
+    {
+        std::ostringstream out;
+        {
+            JSONStreamWriter shapeWriter(out);
+            ConfigureWriter(shapeWriter);
+            shapeWriter.StartObject();
+            AddGroup(shapeWriter, resourceId);
+            shapeWriter.EndObject();
+        }
+
+        // Strip the braces to keep the "shapes" member only
+        std::string json = out.str();
+        return json.substr(1, json.length() - 2);
+    }
+
+
+    const std::string& JSONOutputWriter::GetResourceShapes(int resourceId)
+    {
+        std::map<int, std::string>::iterator it = m_resourceShapes.find(resourceId);
+        if (it == m_resourceShapes.end())
+            it = m_resourceShapes.insert(std::make_pair(resourceId, WriteShapes(resourceId))).first;
+        return it->second;
+    }
+
+
+    // Index of the content equal to 'shapes', the number of contents if
+    // there is none
+    FCM::U_Int32 JSONOutputWriter::FindShapeContent(const std::string& shapes) const
+    {
+        std::map<std::uint64_t, std::vector<FCM::U_Int32> >::const_iterator it = m_shapeContentsByHash.find(HashContent(shapes));
+        if (it != m_shapeContentsByHash.end())
+        {
+            const std::vector<FCM::U_Int32>& candidates = it->second;
+            for (size_t c = 0; c < candidates.size(); c++)
+            {
+                if (m_shapeContents[candidates[c]].shapes == shapes)
+                    return candidates[c];
+            }
+        }
+        return (FCM::U_Int32)m_shapeContents.size();
+    }
+
+
+    void JSONOutputWriter::AddShapeContent(SHAPE_CONTENT& content)
+    {
+        FCM::U_Int32 index = (FCM::U_Int32)m_shapeContents.size();
+
+        m_shapeContentsByHash[HashContent(content.shapes)].push_back(index);
+        m_shapeContents.push_back(SHAPE_CONTENT());
+        std::swap(m_shapeContents.back(), content);
+    }
+
+
+    // Content of a shape layer, NULL for other layers and for tweened
+    // shapes, which are written with their own paths
+    const SHAPE_CONTENT* JSONOutputWriter::GetShapeContent(const Layer* layer) const
+    {
+        if (layer->ty != Shape || layer->morph.IsAnimated())
+            return NULL;
+
+        const FCM::U_Int32* pIndex = m_shapeContentOfResource.Find(layer->resourceId);
+        if (pIndex == NULL)
+            return NULL;
+
+        return &m_shapeContents[*pIndex];
+    }
+
+
+    /* -------------------------------------------------- Symbol cache */
+
+    void JSONOutputWriter::LookupCachedSymbols()
+    {
+        size_t compositions = m_LottieManager->GetNumofCompositions();
+
+        m_symbolKeys.assign(compositions, std::string());
+        m_symbolEntries.assign(compositions, NULL);
+        if (m_pSymbolCache == NULL)
+            return;
+
+        for (size_t c = 1; c < compositions; c++)
+        {
+            composition* comp = m_LottieManager->GetCompositionAtIndex(c);
+
+            m_symbolKeys[c] = GetSymbolCacheKey(comp);
+            m_symbolEntries[c] = m_pSymbolCache->Lookup(m_symbolKeys[c]);
+            comp->cached = (m_symbolEntries[c] != NULL);
+        }
+    }
+
+
+    static void AddTrackToHash(SymbolCacheHash& hash, const keyframe_track& track)
+    {
+        hash.Add(track.t);
+        hash.Add(track.v);
+        hash.Add(track.h);
+        hash.Add(track.o);
+        hash.Add(track.i);
+    }
+
+
+    static void AddPathToHash(SymbolCacheHash& hash, const ks& path)
+    {
+        hash.Add(path.i);
+        hash.Add(path.o);
+        hash.Add(path.v);
+        hash.Add(path.c);
+    }
+
+
+    // The composition is hashed as the frame commands built it, with the
+    // settings that change how it is reduced and written. A shape layer
+    // adds its written shapes: the resource ids change between publishes.
+    // They are written once per resource and reused for the shared contents.
+    std::string JSONOutputWriter::GetSymbolCacheKey(const composition* comp)
+    {
+        SymbolCacheHash hash;
+        std::map<int, std::uint64_t> shapeHashes;
+
+        hash.Add(m_keyframeTolerance);
+        hash.Add(m_outputProfile);
+        for (int c = 0; c < NUMBER_CLASS_COUNT; c++)
+            hash.Add(m_numberPrecision[c]);
+
+        hash.Add(comp->op);
+        hash.Add(comp->left);
+        hash.Add(comp->top);
+        hash.Add(comp->width);
+        hash.Add(comp->height);
+
+        for (size_t i = 0; i < comp->layers.size(); i++)
+        {
+            const Layer* layer = comp->layers[i];
+
+            hash.Add(layer->ty);
+            hash.Add(layer->ind);
+            hash.Add(layer->parent_ind);
+            hash.Add(layer->nm);
+            hash.Add(layer->ddd);
+            hash.Add(layer->sr);
+            hash.Add(layer->ao);
+            hash.Add(layer->bm);
+            hash.Add(layer->ip);
+            hash.Add(layer->op);
+            hash.Add(layer->st);
+            hash.Add(layer->loop);
+            hash.Add(layer->first_frame);
+            AddTrackToHash(hash, layer->ks.p);
+            AddTrackToHash(hash, layer->ks.s);
+            AddTrackToHash(hash, layer->ks.r);
+            hash.Add(layer->ks.a.k);
+            hash.Add(layer->ks.o.k);
+
+            hash.Add(layer->morph.t);
+            hash.Add(layer->morph.h);
+            for (size_t g = 0; g < layer->morph.paths.size(); g++)
+            {
+                for (size_t k = 0; k < layer->morph.paths[g].size(); k++)
+                    AddPathToHash(hash, layer->morph.paths[g][k]);
+            }
+
+            if (layer->ty == Shape)
+            {
+                std::map<int, std::uint64_t>::iterator it = shapeHashes.find(layer->resourceId);
+                if (it == shapeHashes.end())
+                    it = shapeHashes.insert(std::make_pair(layer->resourceId, HashContent(GetResourceShapes(layer->resourceId)))).first;
+                hash.Add(it->second);
+            }
+            else if (layer->ty == Image)
+            {
+                const image_resource* image = m_LottieManager->Getimage_resource_with_id(layer->resourceId);
+                if (image)
+                {
+                    hash.Add(image->cl);
+                    hash.Add(image->ref_id);
+                }
+            }
+            else if (layer->ty == Precomp)
+            {
+                const composition* symbol = m_LottieManager->GetCompositionOfResource(layer->resourceId);
+                if (symbol)
+                {
+                    hash.Add(symbol->id);
+                    hash.Add(symbol->op);
+                    hash.Add(symbol->left);
+                    hash.Add(symbol->top);
+                    hash.Add(symbol->width);
+                    hash.Add(symbol->height);
+                }
+            }
+        }
+
+        return SymbolFragmentCache::MakeKey(comp->nm, hash.Value());
+    }
+
+
+    // A cached symbol refers to the shared contents by the ids they had when
+    // it was written. A content it shared may now be drawn by this symbol
+    // only, or one it drew inline may now be shared: the symbol is then
+    // reduced and written again.
+    FCM::Boolean JSONOutputWriter::CheckCachedSymbols()
+    {
+        FCM::Boolean valid = true;
+
+        for (size_t c = 1; c < m_LottieManager->GetNumofCompositions(); c++)
+        {
+            composition* comp = m_LottieManager->GetCompositionAtIndex(c);
+            if (!comp->cached)
+                continue;
+
+            const std::vector<SYMBOL_CACHE_SHAPE>& shapes = m_symbolEntries[c]->shapes;
+            for (size_t i = 0; i < shapes.size(); i++)
+            {
+                FCM::U_Int32 index = FindShapeContent(shapes[i].shapes);
+                if (index < m_shapeContents.size() && m_shapeContents[index].refId == shapes[i].refId)
+                    continue;
+
+                comp->cached = false;
+                m_LottieManager->MergeShapeTweens(*comp, m_keyframeTolerance);
+                m_LottieManager->ReduceKeyframes(*comp, m_keyframeTolerance);
+                if (m_outputProfile != FULL_OUTPUT_PROFILE)
+                    m_LottieManager->CollapseStaticTracks(*comp);
+                valid = false;
+                break;
+            }
+        }
+
+        return valid;
+    }
+
+
+    void JSONOutputWriter::AddSymbolLayers(JSONStreamWriter& writer, size_t index)
+    {
+        const composition* comp = m_LottieManager->GetCompositionAtIndex(index);
+
+        if (comp->cached)
+        {
+            writer.WriteRaw(m_symbolEntries[index]->layers);
+            return;
+        }
+
+        if (m_pSymbolCache == NULL)
+        {
+            AddLayers(writer, comp);
+            return;
+        }
+
+        std::ostringstream out;
+        {
+            JSONStreamWriter layerWriter(out);
+            ConfigureWriter(layerWriter);
+            layerWriter.StartObject();
+            AddLayers(layerWriter, comp);
+            layerWriter.EndObject();
+        }
+
+        // Strip the braces to keep the "layers" member only
+        std::string json = out.str();
+        SYMBOL_CACHE_ENTRY entry;
+        entry.layers = json.substr(1, json.length() - 2);
+        for (size_t i = 0; i < comp->layers.size(); i++)
+        {
+            const SHAPE_CONTENT* content = GetShapeContent(comp->layers[i]);
+            if (content == NULL)
+                continue;
+
+            SYMBOL_CACHE_SHAPE shape;
+            shape.shapes = content->shapes;
+            shape.refId = content->refId;
+            shape.left = content->left;
+            shape.top = content->top;
+            shape.width = content->width;
+            shape.height = content->height;
+            entry.shapes.push_back(shape);
+        }
+
+        writer.WriteRaw(entry.layers);
+        m_pSymbolCache->Add(m_symbolKeys[index], entry);
+    }
+
+
+    // 'morph' replaces the paths of the groups by their animated keys
+    FCM::Result JSONOutputWriter::AddGroup(JSONStreamWriter& writer, int resourceid, const path_track* morph)
+    {
+        std::int32_t size = m_LottieManager->GetNumofGroups(resourceid);
+
+        writer.StartArray("shapes");
+        for (std::int32_t ind = size - 1; ind >= 0; ind--)
+        {
+            group* gr = m_LottieManager->GetGroupAtIndex(ind, resourceid);
+            if (gr != NULL)
+            {
+                AddShapeGroup(writer, gr, morph, ind);
+            }
+        }
+        writer.EndArray();
+
+        return FCM_SUCCESS;
+    }
+
+
+    FCM::Result JSONOutputWriter::AddShapeGroup(JSONStreamWriter& writer, const group* gr, const path_track* morph, std::uint32_t index)
+    {
+        writer.StartObject();
+        writer.WriteProperty("ty", gr->ty);
+        AddItems(writer, gr, morph, index);
+        writer.WriteMetadata("nm", gr->nm);
+        writer.WriteMetadata("mn", gr->mn);
+        writer.WriteMetadata("np", gr->np);
+        writer.WriteMetadata("cix", gr->cix);
+        writer.WriteOptional("bm", gr->bm, 0);
+        writer.WriteMetadata("ix", gr->ix);
+        writer.WriteOptional("hd", gr->hd, false);
+        writer.EndObject();
+
+        return FCM_SUCCESS;
+    }
+
+
+    // Writes the members of a path value: tangents and vertices as [x,y] pairs
+    static void WritePathValue(JSONStreamWriter& writer, const ks& path)
+    {
+        NumberClassScope scope(writer, NUMBER_CLASS_VERTEX);
+        std::uint32_t size = path.i.size();
+
+        writer.StartArray("i");
+        for (std::uint32_t index = 0; index < size; index++)
+        {
+            writer.StartArray();
+            writer.WriteValue(path.i[index].x);
+            writer.WriteValue(path.i[index].y);
+            writer.EndArray();
+        }
+        writer.EndArray();
+
+        writer.StartArray("o");
+        for (std::uint32_t index = 0; index < size; index++)
+        {
+            writer.StartArray();
+            writer.WriteValue(path.o[index].x);
+            writer.WriteValue(path.o[index].y);
+            writer.EndArray();
+        }
+        writer.EndArray();
+
+        writer.StartArray("v");
+        for (std::uint32_t index = 0; index < size; index++)
+        {
+            writer.StartArray();
+            writer.WriteValue(path.v[index].x);
+            writer.WriteValue(path.v[index].y);
+            writer.EndArray();
+        }
+        writer.EndArray();
+
+        writer.WriteProperty("c", path.c);
+    }
+
+
+    // Writes the "a" and "k" of the animated path of one group of a tween.
+    // A key moves linearly to the next one unless it holds.
+    static void WritePathKeyframes(JSONStreamWriter& writer, const path_track& morph, std::uint32_t index)
+    {
+        const std::vector<ks>& paths = morph.paths[index];
+
+        writer.WriteProperty("a", 1);
+        writer.StartArray("k");
+        for (std::uint32_t key = 0; key < morph.Size(); key++)
+        {
+            writer.StartObject();
+            {
+                NumberClassScope time(writer, NUMBER_CLASS_TIME);
+                writer.WriteProperty("t", morph.t[key]);
+            }
+            writer.StartArray("s");
+            writer.StartObject();
+            WritePathValue(writer, paths[key]);
+            writer.EndObject();
+            writer.EndArray();
+            if (key + 1 == morph.Size() || morph.h[key])
+            {
+                writer.WriteProperty("h", 1);
+            }
+            else
+            {
+                NumberClassScope ease(writer, NUMBER_CLASS_EASE);
+                writer.WriteOptional("h", 0, 0);
+                writer.StartObject("o");
+                writer.WriteProperty("x", 1.0 / 3.0);
+                writer.WriteProperty("y", 1.0 / 3.0);
+                writer.EndObject();
+                writer.StartObject("i");
+                writer.WriteProperty("x", 2.0 / 3.0);
+                writer.WriteProperty("y", 2.0 / 3.0);
+                writer.EndObject();
+            }
+            writer.EndObject();
+        }
+        writer.EndArray();
+    }
+
+
+    // Writes the "k" value of a path
+    FCM::Result JSONOutputWriter::AddPath(JSONStreamWriter& writer, const ks& path)
+    {
+        writer.StartObject("k");
+        WritePathValue(writer, path);
+        writer.EndObject();
+
+        return FCM_SUCCESS;
+    }
+
+
+    // Writes a gradient fill ("gf"), shared by linear and radial gradients
+    static void WriteGradientFill(JSONStreamWriter& writer, const gradient_fill& fill)
+    {
+        writer.WriteProperty("ty", fill.ty);
+
+        writer.StartObject("o");
+        writer.WriteOptional("a", fill.o.a, 0);
+        writer.WriteProperty("k", fill.o.k);
+        writer.WriteMetadata("ix", fill.o.ix);
+        writer.EndObject();
+
+        writer.WriteOptional("r", fill.r, 1);
+        writer.WriteMetadata("nm", fill.nm);
+        writer.WriteProperty("t", fill.type);
+
+        writer.StartObject("s");
+        writer.WriteOptional("a", fill.s.a, 0);
+        writer.StartArray("k");
+        writer.WriteValue(fill.s.k[0]);
+        writer.WriteValue(fill.s.k[1]);
+        writer.EndArray();
+        writer.WriteMetadata("ix", fill.s.ix);
+        writer.EndObject();
+
+        writer.WriteOptional("bm", fill.bm, 0);
+
+        writer.StartObject("g");
+        writer.WriteProperty("p", fill.g.p);
+        writer.StartObject("k");
+        writer.WriteOptional("a", fill.g.k.a, 0);
+        writer.StartArray("k");
+        {
+            NumberClassScope scope(writer, NUMBER_CLASS_COLOR);
+            for (int i = 0; i < 4 * fill.g.p; i++)
+            {
+                writer.WriteValue(fill.g.k.color[i]);
+            }
+        }
+        writer.EndArray();
+        writer.WriteMetadata("ix", fill.g.k.ix);
+        writer.EndObject();
+        writer.EndObject();
+
+        writer.StartObject("e");
+        writer.WriteOptional("a", fill.e.a, 0);
+        writer.StartArray("k");
+        writer.WriteValue(fill.e.k[0]);
+        writer.WriteValue(fill.e.k[1]);
+        writer.EndArray();
+        writer.WriteMetadata("ix", fill.e.ix);
+        writer.EndObject();
+    }
+
+
+    FCM::Result JSONOutputWriter::AddItems(JSONStreamWriter& writer, const group* gr, const path_track* morph, std::uint32_t index)
+    {
+        writer.StartArray("it");
+
+        // A turned primitive is rotated by the group transform, which would
+        // turn the holes as well: the group then keeps its path
+        bool primitive = !morph && (gr->shape_angle == 0 || gr->holes.empty());
+
+        // SHAPE
+        writer.StartObject();
+        if (gr->r.isrect && primitive)
+        {
+            NumberClassScope scope(writer, NUMBER_CLASS_VERTEX);
+            writer.WriteProperty("ty", gr->r.ty);
+            writer.WriteMetadata("nm", gr->r.nm);
+            writer.WriteMetadata("mn", gr->r.mn);
+            writer.WriteOptional("hd", gr->r.hd, false);
+            writer.WriteOptional("d", gr->r.d, 1);
+
+            writer.StartObject("s");
+            writer.WriteOptional("a", gr->r.s.a, 0);
+            writer.StartArray("k");
+            writer.WriteValue(gr->r.s.k[0]);
+            writer.WriteValue(gr->r.s.k[1]);
+            writer.EndArray();
+            writer.WriteMetadata("ix", gr->r.s.ix);
+            writer.EndObject();
+
+            writer.StartObject("p");
+            writer.WriteOptional("a", gr->r.rc.a, 0);
+            writer.StartArray("k");
+            writer.WriteValue(gr->r.rc.k[0]);
+            writer.WriteValue(gr->r.rc.k[1]);
+            writer.EndArray();
+            writer.WriteMetadata("ix", gr->r.rc.ix);
+            writer.EndObject();
+
+            writer.StartObject("r");
+            writer.WriteOptional("a", gr->r.r.a, 0);
+            writer.WriteProperty("k", gr->r.r.k);
+            writer.WriteMetadata("ix", gr->r.r.ix);
+            writer.EndObject();
+        }
+        else if (gr->el.isellipse && primitive)
+        {
+            NumberClassScope scope(writer, NUMBER_CLASS_VERTEX);
+            writer.WriteProperty("ty", gr->el.ty);
+            writer.WriteMetadata("nm", gr->el.nm);
+            writer.WriteMetadata("mn", gr->el.mn);
+            writer.WriteOptional("hd", gr->el.hd, false);
+            writer.WriteOptional("d", gr->el.d, 1);
+
+            writer.StartObject("s");
+            writer.WriteOptional("a", gr->el.s.a, 0);
+            writer.StartArray("k");
+            writer.WriteValue(gr->el.s.k[0]);
+            writer.WriteValue(gr->el.s.k[1]);
+            writer.EndArray();
+            writer.WriteMetadata("ix", gr->el.s.ix);
+            writer.EndObject();
+
+            writer.StartObject("p");
+            writer.WriteOptional("a", gr->el.p.a, 0);
+            writer.StartArray("k");
+            writer.WriteValue(gr->el.p.k[0]);
+            writer.WriteValue(gr->el.p.k[1]);
+            writer.EndArray();
+            writer.WriteMetadata("ix", gr->el.p.ix);
+            writer.EndObject();
+        }
+        else
+        {
+            writer.WriteProperty("ty", gr->sh.ty);
+            writer.WriteMetadata("nm", gr->sh.nm);
+            writer.WriteMetadata("mn", gr->sh.mn);
+            writer.WriteOptional("hd", gr->sh.hd, false);
+            writer.WriteMetadata("ind", "0");
+            writer.WriteMetadata("ix", gr->sh.ix);
+
+            writer.StartObject("ks");
+            if (morph)
+            {
+                WritePathKeyframes(writer, *morph, index);
+            }
+            else
+            {
+                writer.WriteOptional("a", gr->sh.shp.a, 0);
+                AddPath(writer, gr->sh.shp);
+            }
+            writer.WriteMetadata("ix", gr->sh.shp.ix);
+            writer.EndObject();
+        }
+        writer.EndObject();
+
+        // HOLES, cut out by the even-odd rule of the fill
+        for (std::uint32_t h = 0; h < gr->holes.size(); h++)
+        {
+            writer.StartObject();
+            writer.WriteProperty("ty", gr->sh.ty);
+            writer.WriteMetadata("nm", "Path " + std::to_string(h + 2));
+            writer.WriteMetadata("mn", gr->sh.mn);
+            writer.WriteOptional("hd", gr->sh.hd, false);
+            writer.WriteMetadata("ix", gr->sh.ix + h + 1);
+
+            writer.StartObject("ks");
+            writer.WriteOptional("a", gr->holes[h].a, 0);
+            AddPath(writer, gr->holes[h]);
+            writer.WriteMetadata("ix", gr->holes[h].ix);
+            writer.EndObject();
+
+            writer.EndObject();
+        }
+
+        // STROKE
+        if (gr->st.hasstroke)
+        {
+            const solid_stroke& stroke = gr->st.solid;
+
+            writer.StartObject();
+            if (gr->st.issolid)
+            {
+                writer.WriteProperty("ty", stroke.ty);
+
+                writer.StartObject("o");
+                writer.WriteOptional("a", stroke.o.a, 0);
+                writer.WriteProperty("k", stroke.o.k);
+                writer.WriteMetadata("ix", stroke.o.ix);
+                writer.EndObject();
+
+                writer.StartObject("w");
+                writer.WriteOptional("a", stroke.w.a, 0);
+                writer.WriteProperty("k", stroke.w.k);
+                writer.WriteMetadata("ix", stroke.w.ix);
+                writer.EndObject();
+
+                writer.WriteProperty("lc", stroke.lc);
+                writer.WriteProperty("lj", stroke.lj);
+                if (stroke.lj == 1)
+                    writer.WriteProperty("ml", stroke.ml);
+                writer.WriteOptional("bm", stroke.bm, 0);
+                writer.WriteMetadata("nm", stroke.nm);
+                writer.WriteMetadata("mn", stroke.mn);
+                writer.WriteOptional("hd", stroke.hd, false);
+
+                writer.StartObject("c");
+                writer.WriteOptional("a", stroke.color1.a, 0);
+                writer.StartArray("k");
+                {
+                    NumberClassScope scope(writer, NUMBER_CLASS_COLOR);
+                    writer.WriteValue(stroke.color1.r);
+                    writer.WriteValue(stroke.color1.g);
+                    writer.WriteValue(stroke.color1.b);
+                    writer.WriteValue(stroke.color1.alpha);
+                }
+                writer.EndArray();
+                writer.WriteMetadata("ix", stroke.color1.ix);
+                writer.EndObject();
+            }
+            writer.EndObject();
+        }
+
+        // FILL
+        if (gr->fl.isfilled)
+        {
+            if (gr->fl.issolid)
+            {
+                const solid_fill& fill = gr->fl.solid;
+
+                writer.StartObject();
+                writer.WriteProperty("ty", fill.ty);
+
+                writer.StartObject("c");
+                writer.WriteOptional("a", fill.color1.a, 0);
+                writer.StartArray("k");
+                {
+                    NumberClassScope scope(writer, NUMBER_CLASS_COLOR);
+                    writer.WriteValue(fill.color1.r);
+                    writer.WriteValue(fill.color1.g);
+                    writer.WriteValue(fill.color1.b);
+                    writer.WriteValue(fill.color1.alpha);
+                }
+                writer.EndArray();
+                writer.WriteMetadata("ix", fill.color1.ix);
+                writer.EndObject();
+
+                writer.StartObject("o");
+                writer.WriteOptional("a", fill.o.a, 0);
+                writer.WriteProperty("k", fill.o.k);
+                writer.WriteMetadata("ix", fill.o.ix);
+                writer.EndObject();
+
+                writer.WriteOptional("r", fill.r, 1);
+                writer.WriteOptional("bm", fill.bm, 0);
+                writer.WriteMetadata("nm", fill.nm);
+                writer.WriteMetadata("mn", fill.mn);
+                writer.WriteOptional("hd", fill.hd, false);
+                writer.EndObject();
+            }
+            else if (gr->fl.islinear_gradient)
+            {
+                writer.StartObject();
+                WriteGradientFill(writer, gr->fl.linear);
+                writer.WriteMetadata("mn", gr->fl.linear.mn);
+                writer.WriteOptional("hd", gr->fl.linear.hd, false);
+                writer.EndObject();
+            }
+            else if (gr->fl.isradial_gradient)
+            {
+                const radial_gradient_fill& radial = gr->fl.radial;
+
+                writer.StartObject();
+                WriteGradientFill(writer, radial.radial_fill);
+
+                writer.StartObject("h");
+                writer.WriteOptional("a", radial.h.a, 0);
+                writer.WriteProperty("k", radial.h.k);
+                writer.WriteMetadata("ix", radial.h.ix);
+                writer.EndObject();
+
+                writer.StartObject("a");
+                writer.WriteOptional("a", radial.a.a, 0);
+                writer.WriteProperty("k", radial.a.k);
+                writer.WriteMetadata("ix", radial.a.ix);
+                writer.EndObject();
+
+                writer.WriteMetadata("mn", radial.radial_fill.mn);
+                writer.WriteOptional("hd", radial.radial_fill.hd, false);
+                writer.EndObject();
+            }
+        }
+
+        // TRANSFORM
+        writer.StartObject();
+        writer.WriteProperty("ty", "tr");
+        NumberClassScope scope(writer, NUMBER_CLASS_TRANSFORM);
+
+        // A turned rectangle or ellipse is drawn upright and rotated around
+        // its centre, which is where the anchor and the position go
+        const float* pivot = NULL;
+        if (gr->shape_angle != 0 && primitive)
+            pivot = gr->r.isrect ? gr->r.rc.k : gr->el.p.k;
+
+        if (gr->ks.p.size() == 1)
+            WriteStaticProperty(writer, "p", pivot ? pivot : gr->ks.p[0].k, 2, 0, gr->ks.p[0].ix);
+
+        if (gr->ks.a.size() == 1)
+            WriteStaticProperty(writer, "a", pivot ? pivot : gr->ks.a[0].k, 2, 0, gr->ks.a[0].ix);
+
+        if (gr->ks.s.size() == 1)
+            WriteStaticProperty(writer, "s", gr->ks.s[0].k, 2, 100, gr->ks.s[0].ix);
+
+        if (gr->ks.r.size() == 1)
+        {
+            float rotation = pivot ? gr->ks.r[0].k + gr->shape_angle : gr->ks.r[0].k;
+            WriteStaticProperty(writer, "r", &rotation, 1, 0, gr->ks.r[0].ix);
+        }
+
+        if (gr->ks.o.size() == 1)
+            WriteStaticProperty(writer, "o", &gr->ks.o[0].k, 1, 100, gr->ks.o[0].ix);
+
+        if (gr->ks.sk.size() == 1)
+            WriteStaticProperty(writer, "sk", &gr->ks.sk[0].k, 1, 0, gr->ks.sk[0].ix);
+
+        if (gr->ks.sa.size() == 1)
+            WriteStaticProperty(writer, "sa", &gr->ks.sa[0].k, 1, 0, gr->ks.sa[0].ix);
+
+        writer.WriteMetadata("nm", "Transform");
+        writer.EndObject();
+
+        writer.EndArray();
+
+        return FCM_SUCCESS;
+    }
+
+
+    FCM::Result JSONOutputWriter::AddVersion(JSONStreamWriter& writer)
+    {
+        writer.WriteProperty("v", m_LottieManager->GetVersion());
+        return FCM_SUCCESS;
+    }
+
+
+    // Image assets, in the order the bitmaps were defined, followed by the
+    // shape contents shared by several layers and the symbol compositions
+    FCM::Result JSONOutputWriter::AddAssets(JSONStreamWriter& writer)
+    {
+        std::uint32_t size = m_LottieManager->GetNumofImageResources();
+        size_t compositions = m_LottieManager->GetNumofCompositions();
+        bool started = false;
+
+        // Shared contents are drawn for as long as the longest timeline
+        std::uint32_t op = (std::uint32_t)m_LottieManager->GetOp();
+        for (size_t c = 1; c < compositions; c++)
+            op = std::max(op, m_LottieManager->GetCompositionAtIndex(c)->op);
+
+        for (std::uint32_t i = 0; i < size; i++)
+        {
+            const image_resource* image = m_LottieManager->GetImageResourceAtIndex(i);
+            if (image->p.empty())
+                continue;
+
+            if (!started)
+            {
+                writer.StartArray("assets");
+                started = true;
+            }
+
+            writer.StartObject();
+            writer.WriteProperty("id", image->ref_id);
+            writer.WriteProperty("w", image->width);
+            writer.WriteProperty("h", image->height);
+            writer.WriteProperty("e", 0);
+            writer.WriteProperty("u", image->u);
+            writer.WriteProperty("p", image->p);
+            writer.EndObject();
+        }
+
+        for (std::uint32_t i = 0; i < m_shapeContents.size(); i++)
+        {
+            const SHAPE_CONTENT& content = m_shapeContents[i];
+            if (content.refId.empty())
+                continue;
+
+            if (!started)
+            {
+                writer.StartArray("assets");
+                started = true;
+            }
+
+            // A single shape layer, moved so that the bounds start at (0,0)
+            writer.StartObject();
+            writer.WriteProperty("id", content.refId);
+            writer.StartArray("layers");
+            writer.StartObject();
+            writer.WriteOptional("ddd", 0, 0);
+            writer.WriteProperty("ind", 1);
+            writer.WriteProperty("ty", (int)Shape);
+            writer.WriteMetadata("nm", content.refId);
+            writer.WriteOptional("sr", 1, 1);
+
+            const double opacity = 100;
+            const double rotation = 0;
+            const double position[3] = { -content.left, -content.top, 0 };
+            const double anchor[3] = { 0, 0, 0 };
+            const double scale[3] = { 100, 100, 100 };
+            NumberClassScope scope(writer, NUMBER_CLASS_TRANSFORM);
+            writer.StartObject("ks");
+            WriteStaticProperty(writer, "o", &opacity, 1, 100, 11);
+            WriteStaticProperty(writer, "r", &rotation, 1, 0, 10);
+            WriteStaticProperty(writer, "p", position, 3, 0, 2);
+            WriteStaticProperty(writer, "a", anchor, 3, 0, 1);
+            WriteStaticProperty(writer, "s", scale, 3, 100, 6);
+            writer.EndObject();
+
+            writer.WriteOptional("ao", 0, 0);
+            writer.WriteRaw(content.shapes);
+            writer.WriteProperty("ip", 0);
+            writer.WriteProperty("op", op);
+            writer.WriteProperty("st", 0);
+            writer.WriteOptional("bm", 0, 0);
+            writer.EndObject();
+            writer.EndArray();
+            writer.EndObject();
+        }
+
+        for (size_t c = 1; c < compositions; c++)
+        {
+            const composition* comp = m_LottieManager->GetCompositionAtIndex(c);
+
+            if (!started)
+            {
+                writer.StartArray("assets");
+                started = true;
+            }
+
+            writer.StartObject();
+            writer.WriteProperty("id", comp->id);
+            writer.WriteMetadata("nm", comp->nm);
+            AddSymbolLayers(writer, c);
+            writer.EndObject();
+        }
+
+        if (started)
+            writer.EndArray();
+
         return FCM_SUCCESS;
     }
-	FCM::Result JSONOutputWriter::AddFr(JSONNode &firstNode)
-	{//std::cout<<"ENTERED fr"<<std::endl;
-		
-		(firstNode).push_back(JSONNode("fr", m_LottieManager->GetFPS()));
-		return FCM_SUCCESS;
-	}
-	FCM::Result JSONOutputWriter::AddIp(JSONNode &firstNode)
-	{//std::cout<<"ENTERED ip"<<std::endl;
-		
-		firstNode.push_back(JSONNode("ip", m_LottieManager->GetIp()));
-		return FCM_SUCCESS;
-	}
-    FCM::Result JSONOutputWriter::AddOp(JSONNode &firstNode)
+
+
+    FCM::Result JSONOutputWriter::AddMarkers(JSONStreamWriter& writer)
     {
-        //std::cout<<"ENTERED op"<<std::endl;
-        firstNode.push_back(JSONNode("op", m_LottieManager->GetOp()));
-         return FCM_SUCCESS;
+        // No markers are exported, so an empty list is only written in full
+        if (writer.OmitsDefaults())
+            return FCM_SUCCESS;
 
-        \
-        
+        writer.StartArray("markers");
+        writer.EndArray();
+        return FCM_SUCCESS;
     }
-                                        
-                                                
-    FCM::Result JSONOutputWriter::AddLayers(JSONNode &firstNode)
-    {
-      //std::cout<<"ENTERED layrs"<<std::endl;
-        if(m_layers)
-            delete m_layers;
-        m_layers=new JSONNode(JSON_ARRAY);
-        m_layers->set_name("layers");
-        std::uint32_t size=m_LottieManager->GetNumofLayers();
-        int index;
-        std::map<int , Layer *>::iterator it;
-        std::map<int , Layer *>objectid_Layer=m_LottieManager->GetobjIdLayer();
-        //m_LottieManager->SortLayers();
-            
-        for(int i=0;i<size;i++)
-        {
-            Layer * layer =m_LottieManager->GetLayerAtIndex(i);
-            JSONNode layerprop;
-            layerprop.push_back(JSONNode("ddd",layer->ddd));
-            layerprop.push_back(JSONNode("ind",layer->ind));
-            layerprop.push_back(JSONNode("ty",layer->ty));
-            layerprop.push_back(JSONNode("nm",layer->nm));
-            if(layer->ty == 2)
-            {image_resource * image = m_LottieManager->Getimage_resource_with_id(layer->resourceId);
-                layerprop.push_back(JSONNode("cl",image->cl));
-                layerprop.push_back(JSONNode("refId",image->ref_id));
-                
-            }
-            layerprop.push_back(JSONNode("ip",layer->ip));
-            layerprop.push_back(JSONNode("op",layer->op));
-            layerprop.push_back(JSONNode("ao",layer->ao));
-            layerprop.push_back(JSONNode("st",layer->st));
-            layerprop.push_back(JSONNode("bm",layer->bm));
-            
-            JSONNode layer_transformprop;
-            layer_transformprop.set_name("ks");
-            
-            //POSITION
-            
-            std::uint32_t p_size=layer->ks.p.size();
-            
-            if(p_size==1){
-                JSONNode position;
-            position.set_name("p");
-            position.push_back(JSONNode("a",layer->ks.p[p_size-1].a));
-            JSONNode value_p(JSON_ARRAY);
-            value_p.set_name("k");
-            value_p.push_back(JSONNode("",layer->ks.p[p_size-1].k[0]));
-            value_p.push_back(JSONNode("",layer->ks.p[p_size-1].k[1]));
-            value_p.push_back(JSONNode("",layer->ks.p[p_size-1].k[2]));
-            
-            position.push_back(value_p);
-            position.push_back(JSONNode("ix",layer->ks.p[p_size-1].ix));
-            layer_transformprop.push_back(position);
-            }
-            
-            else
-            {
-                JSONNode position;
-               position.set_name("p");
-               position.push_back(JSONNode("a",layer->ks.p[p_size-1].a));
-                JSONNode value_p(JSON_ARRAY);
-                value_p.set_name("k");
-                for(int i=0;i<p_size-1;i++)
-                {
-                    JSONNode pos_node;
-              /*    JSONNode in_value;
-                   in_value.set_name("i");
-                    in_value.push_back(JSONNode("x",layer->ks.p[i].offset.i.x));
-                    in_value.push_back(JSONNode("y",layer->ks.p[i].offset.i.y));
-                    JSONNode out_value;
-                    out_value.set_name("o");
-                    out_value.push_back(JSONNode("x",layer->ks.p[i].offset.o.x));
-                    out_value.push_back(JSONNode("y",layer->ks.p[i].offset.o.y));
-                    pos_node.push_back(in_value);
-                    pos_node.push_back(out_value);*/
-                    pos_node.push_back(JSONNode("t",layer->ks.p[i].offset.time));
-                    JSONNode start_value(JSON_ARRAY);
-                    start_value.set_name("s");
-                    start_value.push_back(JSONNode("",layer->ks.p[i].offset.start[0]));
-                    start_value.push_back(JSONNode("",layer->ks.p[i].offset.start[1]));
-                   // start_value.push_back(JSONNode("",layer->ks.p[i].offset.start[2]));
-                    pos_node.push_back(start_value);
-                   pos_node.push_back(JSONNode("h",layer->ks.p[i].offset.h));
-           /*   JSONNode ti(JSON_ARRAY);
-                    ti.set_name("ti");
-                    ti.push_back(JSONNode("",layer->ks.p[i].multi_keyframe.ti.x));
-                    ti.push_back(JSONNode("",layer->ks.p[i].multi_keyframe.ti.y));
-                    JSONNode to(JSON_ARRAY);
-                    to.set_name("to");
-                    to.push_back(JSONNode("",layer->ks.p[i].multi_keyframe.to.x));
-                    to.push_back(JSONNode("",layer->ks.p[i].multi_keyframe.to.y));
-                    pos_node.push_back(to);
-                    pos_node.push_back(ti);*/
-                    value_p.push_back(pos_node);
-                }
-                JSONNode last_pos;
-                last_pos.push_back(JSONNode("t",layer->ks.p[p_size-1].offset.time));
-                JSONNode start_value(JSON_ARRAY);
-                start_value.set_name("s");
-                start_value.push_back(JSONNode("",layer->ks.p[p_size-1].k[0]));
-                start_value.push_back(JSONNode("",layer->ks.p[p_size-1].k[1]));
-               //start_value.push_back(JSONNode("",layer->ks.p[p_size-1].k[2]));
-               last_pos.push_back(JSONNode("h",layer->ks.p[p_size-1].offset.h));
-                last_pos.push_back(start_value);
-                value_p.push_back(last_pos);
-                position.push_back(value_p);
-                position.push_back(JSONNode("ix",layer->ks.p[p_size-1].ix));
-                layer_transformprop.push_back(position);
-    
-               
-            }
-            
-            //ANCHORPOINT
-            std::uint32_t a_size=layer->ks.a.size();
-            if(a_size==1)
-            {
-            JSONNode anchorpoint;
-            anchorpoint.set_name("a");
-            anchorpoint.push_back(JSONNode("a",layer->ks.a[a_size-1].a));
-            JSONNode value_a(JSON_ARRAY);
-            value_a.set_name("k");
-            value_a.push_back(JSONNode("",layer->ks.a[a_size-1].k[0]));
-            value_a.push_back(JSONNode("",layer->ks.a[a_size-1].k[1]));
-            value_a.push_back(JSONNode("",layer->ks.a[a_size-1].k[2]));
-            anchorpoint.push_back(value_a);
-            anchorpoint.push_back(JSONNode("ix",layer->ks.a[a_size-1].ix));
-            layer_transformprop.push_back(anchorpoint);
-            }
-            
-            //SCALE
-            std::uint32_t s_size=layer->ks.s.size();
-            if(s_size==1)
-            {
-            JSONNode scale;
-            scale.set_name("s");
-            scale.push_back(JSONNode("a",layer->ks.s[s_size-1].a));
-            JSONNode value_s(JSON_ARRAY);
-            value_s.set_name("k");
-            value_s.push_back(JSONNode("",layer->ks.s[s_size-1].k[0]));
-            value_s.push_back(JSONNode("",layer->ks.s[s_size-1].k[1]));
-            value_s.push_back(JSONNode("",layer->ks.s[s_size-1].k[2]));
-            scale.push_back(value_s);
-            scale.push_back(JSONNode("ix",layer->ks.s[s_size-1].ix));
-            layer_transformprop.push_back(scale);
-            }
-            else
-            {
-                JSONNode scale;
-                scale.set_name("s");
-                scale.push_back(JSONNode("a",layer->ks.s[s_size-1].a));
-                JSONNode value_s(JSON_ARRAY);
-                value_s.set_name("k");
-                for(int i=0;i<s_size-1;i++)
-                {
-                    JSONNode scale_node;
-                    JSONNode in_value;
-                 /*   in_value.set_name("i");
-                    in_value.push_back(JSONNode("x",layer->ks.s[i].offset.i.x));
-                    in_value.push_back(JSONNode("y",layer->ks.s[i].offset.i.y));
-                    JSONNode out_value;
-                    out_value.set_name("o");
-                    out_value.push_back(JSONNode("x",layer->ks.s[i].offset.o.x));
-                    out_value.push_back(JSONNode("y",layer->ks.s[i].offset.o.y));
-                    scale_node.push_back(in_value);
-                    scale_node.push_back(out_value);*/
-                    scale_node.push_back(JSONNode("t",layer->ks.s[i].offset.time));
-                    JSONNode start_value(JSON_ARRAY);
-                    start_value.set_name("s");
-                    start_value.push_back(JSONNode("",layer->ks.s[i].offset.start[0]));
-                    start_value.push_back(JSONNode("",layer->ks.s[i].offset.start[1]));
-                    //start_value.push_back(JSONNode("",layer->ks.s[i].offset.start[2]));
-                    scale_node.push_back(start_value);
-                    scale_node.push_back(JSONNode("h",layer->ks.s[i].offset.h));
-                    value_s.push_back(scale_node);
-                    
-                }
-                JSONNode last_scale;
-                last_scale.push_back(JSONNode("t",layer->ks.s[s_size-1].offset.time));
-                JSONNode start_value(JSON_ARRAY);
-                start_value.set_name("s");
-                start_value.push_back(JSONNode("",layer->ks.s[s_size-1].k[0]));
-                start_value.push_back(JSONNode("",layer->ks.s[s_size-1].k[1]));
-               // start_value.push_back(JSONNode("",layer->ks.s[s_size-1].k[2]));
-                last_scale.push_back(start_value);
-                last_scale.push_back(JSONNode("h",layer->ks.s[s_size-1].offset.h));
-                value_s.push_back(last_scale);
-                scale.push_back(value_s);
-                
-                scale.push_back(JSONNode("ix",layer->ks.s[s_size-1].ix));
-                layer_transformprop.push_back(scale);
-                
-                
-            }
-            
-            
-            //ROTATION
-            std::uint32_t r_size=layer->ks.r.size();
-            if(r_size==1)
-            {
-            JSONNode rotation;
-            rotation.set_name("r");
-            rotation.push_back(JSONNode("a",layer->ks.r[r_size-1].a));
-            rotation.push_back(JSONNode("k",layer->ks.r[r_size-1].k));
-            rotation.push_back(JSONNode("ix",layer->ks.r[r_size-1].ix));
-            layer_transformprop.push_back(rotation);
-            }
-            
-            else
-            {
-                JSONNode rotation;
-                rotation.set_name("r");
-                rotation.push_back(JSONNode("a",layer->ks.r[r_size-1].a));
-                JSONNode value_r(JSON_ARRAY);
-                value_r.set_name("k");
-                for(int i=0;i<r_size-1;i++)
-                {
-                    JSONNode rot_node;
-                 /*   JSONNode in_value;
-                    in_value.set_name("i");
-                    in_value.push_back(JSONNode("x",layer->ks.r[i].offset.i.x));
-                    in_value.push_back(JSONNode("y",layer->ks.r[i].offset.i.y));
-                    JSONNode out_value;
-                    out_value.set_name("o");
-                    out_value.push_back(JSONNode("x",layer->ks.r[i].offset.o.x));
-                    out_value.push_back(JSONNode("y",layer->ks.r[i].offset.o.y));
-                    rot_node.push_back(in_value);
-                    rot_node.push_back(out_value);*/
-                    rot_node.push_back(JSONNode("t",layer->ks.r[i].offset.time));
-                    JSONNode start_value(JSON_ARRAY);
-                    start_value.set_name("s");
-                    start_value.push_back(JSONNode("",layer->ks.r[i].offset.start[0]));
-                    rot_node.push_back(start_value);
-                    rot_node.push_back(JSONNode("h",layer->ks.r[i].offset.h));
-                    value_r.push_back(rot_node);
-                }
-                JSONNode last_pos;
-                last_pos.push_back(JSONNode("t",layer->ks.r[r_size-1].offset.time));
-                JSONNode start_value(JSON_ARRAY);
-                start_value.set_name("s");
-                start_value.push_back(JSONNode("",layer->ks.r[r_size-1].k));
-                last_pos.push_back(start_value);
-                last_pos.push_back(JSONNode("h",layer->ks.r[r_size-1].offset.h));
-                value_r.push_back(last_pos);
-                rotation.push_back(value_r);
-                rotation.push_back(JSONNode("ix",layer->ks.r[r_size-1].ix));
-                layer_transformprop.push_back(rotation);
-            }
-            
-            
-            //OPACITY
-            std::uint32_t o_size=layer->ks.o.size();
-            if(o_size==1)
-            {
-            JSONNode opacity;
-            opacity.set_name("o");
-            opacity.push_back(JSONNode("a",layer->ks.o[o_size-1].a));
-            opacity.push_back(JSONNode("k",layer->ks.o[o_size-1].k));
-            opacity.push_back(JSONNode("ix",layer->ks.o[o_size-1].ix));
-            layer_transformprop.push_back(opacity);
-            }
-            
-            
-            layerprop.push_back(layer_transformprop);
-            if(layer->parent_ind != -1)
-                layerprop.push_back(JSONNode("parent",layer->parent_ind));
-           // std::cout<<layer->nm<<std::endl;
-            bool hasmask;int index = -1;
-            AddGroup(layer->resourceId);
-            layerprop.push_back(*m_group);
-            
-            
-           // delete m_group;
-            m_layers->push_back(layerprop);
-           //f delete layer;
-            
-            
-        }
-        AddHoles();
-        firstNode.push_back(*m_layers);
-    
-        
-        
+
+
+    FCM::Result JSONOutputWriter::AddWidthHeight(JSONStreamWriter& writer)
+    {
+        int width;
+        int height;
+
+        m_LottieManager->GetStageWidthHeight(width, height);
+        writer.WriteProperty("w", width);
+        writer.WriteProperty("h", height);
         return FCM_SUCCESS;
-                                                             
-    }
-   FCM::Result JSONOutputWriter::AddHoles()
-     {
-     
-         std::uint32_t layer_size=m_LottieManager->GetNumofLayers();
-         std::uint32_t hole_ind= layer_size;
-         std::map<int,std::vector<hole_layer *>>  hole_resource_map = m_LottieManager->get_hole_resource_map();
-         std::map<int,std::vector<hole_layer *>>:: iterator it;
-         for(it = hole_resource_map.begin();it != hole_resource_map.end();it++)
-         {
-             std::vector< hole_layer * > hole_layers= m_LottieManager->GetholelayersAtresourceid(it->first);
-             std::map<int,std::vector<int>>  object_resource_map = m_LottieManager->get_object_resource_map();
-             std::vector<int>objectids= object_resource_map[it->first];
-             std::uint32_t hole_layersize = hole_layers.size();
-             for(int j=0 ; j< hole_layersize;j++)
-             {
-             for(int i = 0; i < objectids.size(); i++)
-             {   hole_ind ++;
-                 Layer * layer =m_LottieManager->GetLayerAtObjectId(objectids[i]);
-                 hole_layer * hole_layer = m_LottieManager->Getholelayerfrommap(it->first,j);
-                 JSONNode layerprop;
-                 layerprop.push_back(JSONNode("ddd",layer->ddd));
-                 layerprop.push_back(JSONNode("ind",hole_ind));
-                 layerprop.push_back(JSONNode("ty",layer->ty));
-                 layerprop.push_back(JSONNode("nm","hole_layer"));
-                 layerprop.push_back(JSONNode("ip",layer->ip));
-                 layerprop.push_back(JSONNode("op",layer->op));
-                 layerprop.push_back(JSONNode("ao",layer->ao));
-                 layerprop.push_back(JSONNode("st",layer->st));
-                 layerprop.push_back(JSONNode("bm",layer->bm));
-                 layerprop.push_back(JSONNode("hasMask",true));
-
-                 JSONNode shapes(JSON_ARRAY);
-                 JSONNode groupprop;
-                 shapes.set_name("shapes");
-                 group * gr= hole_layer->gr;
-                 if(gr!=NULL ){
-                     groupprop.push_back(JSONNode("ty",gr->ty));
-                     AddItems(gr);
-                     groupprop.push_back(*m_items);
-                     groupprop.push_back(JSONNode("nm",gr->nm));
-                     groupprop.push_back(JSONNode("mn",gr->mn));
-                     groupprop.push_back(JSONNode("np",gr->np));
-                     groupprop.push_back(JSONNode("cix",gr->cix));
-                     groupprop.push_back(JSONNode("bm",gr->bm));
-                     groupprop.push_back(JSONNode("ix",gr->ix));
-                     groupprop.push_back(JSONNode("hd",gr->hd));
-                     shapes.push_back(groupprop);
-                     layerprop.push_back(shapes);
-                     JSONNode maskproperties(JSON_ARRAY);
-                     maskproperties.set_name("masksProperties");
-                     std::uint32_t mp_size= hole_layer->mp.size();
-                     for(int i=0;i<mp_size;i++)
-                     {   JSONNode mask_node;
-                         mask_node.push_back(JSONNode("inv",hole_layer->mp[i]->inv));
-                         mask_node.push_back(JSONNode("mode",hole_layer->mp[i]->mode));
-                         JSONNode pt;
-                         pt.set_name("pt");
-                         pt.push_back(JSONNode("a",hole_layer->mp[i]->pt.a));
-                         
-                         JSONNode k;
-                         k.set_name("k");
-                         
-                         std::uint32_t size=hole_layer->mp[i]->pt.i.size();
-                         if(m_inv)
-                             delete m_inv;
-                         m_inv=new JSONNode(JSON_ARRAY);
-                         
-                         m_inv->set_name("i");
-                         if(m_outv)
-                             delete m_outv;
-                         m_outv=new JSONNode(JSON_ARRAY);
-                         m_outv->set_name("o");
-                         if(m_cv)
-                             delete m_cv;
-                       
-                         m_cv=new JSONNode(JSON_ARRAY);
-                           m_cv->set_name("v");
-                         
-                         for(int index=0;index<size;index++)
-                         {
-                             JSONNode inv(JSON_ARRAY);
-                             
-                             inv.push_back(JSONNode("",hole_layer->mp[i]->pt.i[index].x));
-                             inv.push_back(JSONNode("",hole_layer->mp[i]->pt.i[index].y));
-                             JSONNode outv(JSON_ARRAY);
-                             
-                             outv.push_back(JSONNode("",hole_layer->mp[i]->pt.o[index].x));
-                             outv.push_back(JSONNode("",hole_layer->mp[i]->pt.o[index].y));
-                             JSONNode cv(JSON_ARRAY);
-                             
-                             cv.push_back(JSONNode("",hole_layer->mp[i]->pt.v[index].x));
-                             cv.push_back(JSONNode("",hole_layer->mp[i]->pt.v[index].y));
-                             
-                             m_inv->push_back(inv);
-                             m_outv->push_back(outv);
-                             m_cv->push_back(cv);
-                             
-                         }
-                         //m_inv->set_name("i");
-                         k.push_back(*m_inv);
-                         k.push_back(*m_outv);
-                         k.push_back(*m_cv);
-                         
-                         k.push_back(JSONNode("c",hole_layer->mp[i]->pt.c));
-                         
-                         
-                         pt.push_back(k);
-                         pt.push_back(JSONNode("ix",hole_layer->mp[i]->pt.ix));
-                         mask_node.push_back(pt);
-                         
-                         JSONNode opacity;
-                         opacity.set_name("o");
-                         opacity.push_back(JSONNode("a",hole_layer->mp[i]->o.a));
-                         opacity.push_back(JSONNode("k",hole_layer->mp[i]->o.k));
-                         opacity.push_back(JSONNode("ix",hole_layer->mp[i]->o.ix));
-                         
-                         mask_node.push_back(opacity);
-                         JSONNode x;
-                         x.set_name("x");
-                         x.push_back(JSONNode("a",hole_layer->mp[i]->expansion.a));
-                         x.push_back(JSONNode("k",hole_layer->mp[i]->expansion.k));
-                         x.push_back(JSONNode("ix",hole_layer->mp[i]->expansion.ix));
-                         
-                         mask_node.push_back(x);
-                         mask_node.push_back(JSONNode("nm",hole_layer->mp[i]->nm));
-                         
-                         maskproperties.push_back(mask_node);
-                         
-
-                     }layerprop.push_back(JSONNode("parent",layer->ind));
-                     layerprop.push_back(maskproperties);
-                     
-                     JSONNode layer_transformprop;
-                     layer_transformprop.set_name("ks");
-                     
-                     //POSITION
-                     
-                     std::uint32_t p_size=layer->ks.p.size();
-                     
-                     if(p_size==1){
-                         JSONNode position;
-                         position.set_name("p");
-                         position.push_back(JSONNode("a",layer->ks.p[p_size-1].a));
-                         JSONNode value_p(JSON_ARRAY);
-                         value_p.set_name("k");
-                         value_p.push_back(JSONNode("",layer->ks.p[p_size-1].k[0]));
-                         value_p.push_back(JSONNode("",layer->ks.p[p_size-1].k[1]));
-                         value_p.push_back(JSONNode("",layer->ks.p[p_size-1].k[2]));
-                         
-                         position.push_back(value_p);
-                         position.push_back(JSONNode("ix",layer->ks.p[p_size-1].ix));
-                         layer_transformprop.push_back(position);
-                     }
-                     
-                     else
-                     {
-                         JSONNode position;
-                         position.set_name("p");
-                         position.push_back(JSONNode("a",layer->ks.p[p_size-1].a));
-                         JSONNode value_p(JSON_ARRAY);
-                         value_p.set_name("k");
-                         for(int i=0;i<p_size-1;i++)
-                         {
-                             JSONNode pos_node;
-                             /*    JSONNode in_value;
-                              in_value.set_name("i");
-                              in_value.push_back(JSONNode("x",layer->ks.p[i].offset.i.x));
-                              in_value.push_back(JSONNode("y",layer->ks.p[i].offset.i.y));
-                              JSONNode out_value;
-                              out_value.set_name("o");
-                              out_value.push_back(JSONNode("x",layer->ks.p[i].offset.o.x));
-                              out_value.push_back(JSONNode("y",layer->ks.p[i].offset.o.y));
-                              pos_node.push_back(in_value);
-                              pos_node.push_back(out_value);*/
-                             pos_node.push_back(JSONNode("t",layer->ks.p[i].offset.time));
-                             JSONNode start_value(JSON_ARRAY);
-                             start_value.set_name("s");
-                             start_value.push_back(JSONNode("",layer->ks.p[i].offset.start[0]));
-                             start_value.push_back(JSONNode("",layer->ks.p[i].offset.start[1]));
-                             // start_value.push_back(JSONNode("",layer->ks.p[i].offset.start[2]));
-                             pos_node.push_back(start_value);
-                             pos_node.push_back(JSONNode("h",layer->ks.p[i].offset.h));
-                             /*   JSONNode ti(JSON_ARRAY);
-                              ti.set_name("ti");
-                              ti.push_back(JSONNode("",layer->ks.p[i].multi_keyframe.ti.x));
-                              ti.push_back(JSONNode("",layer->ks.p[i].multi_keyframe.ti.y));
-                              JSONNode to(JSON_ARRAY);
-                              to.set_name("to");
-                              to.push_back(JSONNode("",layer->ks.p[i].multi_keyframe.to.x));
-                              to.push_back(JSONNode("",layer->ks.p[i].multi_keyframe.to.y));
-                              pos_node.push_back(to);
-                              pos_node.push_back(ti);*/
-                             value_p.push_back(pos_node);
-                         }
-                         JSONNode last_pos;
-                         last_pos.push_back(JSONNode("t",layer->ks.p[p_size-1].offset.time));
-                         JSONNode start_value(JSON_ARRAY);
-                         start_value.set_name("s");
-                         start_value.push_back(JSONNode("",layer->ks.p[p_size-1].k[0]));
-                         start_value.push_back(JSONNode("",layer->ks.p[p_size-1].k[1]));
-                         //start_value.push_back(JSONNode("",layer->ks.p[p_size-1].k[2]));
-                         last_pos.push_back(JSONNode("h",layer->ks.p[p_size-1].offset.h));
-                         last_pos.push_back(start_value);
-                         value_p.push_back(last_pos);
-                         position.push_back(value_p);
-                         position.push_back(JSONNode("ix",layer->ks.p[p_size-1].ix));
-                         layer_transformprop.push_back(position);
-                         
-                         
-                     }
-                     
-                     //ANCHORPOINT
-                     std::uint32_t a_size=layer->ks.a.size();
-                     if(a_size==1)
-                     {
-                         JSONNode anchorpoint;
-                         anchorpoint.set_name("a");
-                         anchorpoint.push_back(JSONNode("a",layer->ks.a[a_size-1].a));
-                         JSONNode value_a(JSON_ARRAY);
-                         value_a.set_name("k");
-                         value_a.push_back(JSONNode("",layer->ks.a[a_size-1].k[0]));
-                         value_a.push_back(JSONNode("",layer->ks.a[a_size-1].k[1]));
-                         value_a.push_back(JSONNode("",layer->ks.a[a_size-1].k[2]));
-                         anchorpoint.push_back(value_a);
-                         anchorpoint.push_back(JSONNode("ix",layer->ks.a[a_size-1].ix));
-                         layer_transformprop.push_back(anchorpoint);
-                     }
-                     
-                     //SCALE
-                     std::uint32_t s_size=layer->ks.s.size();
-                     if(s_size==1)
-                     {
-                         JSONNode scale;
-                         scale.set_name("s");
-                         scale.push_back(JSONNode("a",layer->ks.s[s_size-1].a));
-                         JSONNode value_s(JSON_ARRAY);
-                         value_s.set_name("k");
-                         value_s.push_back(JSONNode("",layer->ks.s[s_size-1].k[0]));
-                         value_s.push_back(JSONNode("",layer->ks.s[s_size-1].k[1]));
-                         value_s.push_back(JSONNode("",layer->ks.s[s_size-1].k[2]));
-                         scale.push_back(value_s);
-                         scale.push_back(JSONNode("ix",layer->ks.s[s_size-1].ix));
-                         layer_transformprop.push_back(scale);
-                     }
-                     else
-                     {
-                         JSONNode scale;
-                         scale.set_name("s");
-                         scale.push_back(JSONNode("a",layer->ks.s[s_size-1].a));
-                         JSONNode value_s(JSON_ARRAY);
-                         value_s.set_name("k");
-                         for(int i=0;i<s_size-1;i++)
-                         {
-                             JSONNode scale_node;
-                             JSONNode in_value;
-                             /*   in_value.set_name("i");
-                              in_value.push_back(JSONNode("x",layer->ks.s[i].offset.i.x));
-                              in_value.push_back(JSONNode("y",layer->ks.s[i].offset.i.y));
-                              JSONNode out_value;
-                              out_value.set_name("o");
-                              out_value.push_back(JSONNode("x",layer->ks.s[i].offset.o.x));
-                              out_value.push_back(JSONNode("y",layer->ks.s[i].offset.o.y));
-                              scale_node.push_back(in_value);
-                              scale_node.push_back(out_value);*/
-                             scale_node.push_back(JSONNode("t",layer->ks.s[i].offset.time));
-                             JSONNode start_value(JSON_ARRAY);
-                             start_value.set_name("s");
-                             start_value.push_back(JSONNode("",layer->ks.s[i].offset.start[0]));
-                             start_value.push_back(JSONNode("",layer->ks.s[i].offset.start[1]));
-                             //start_value.push_back(JSONNode("",layer->ks.s[i].offset.start[2]));
-                             scale_node.push_back(start_value);
-                             scale_node.push_back(JSONNode("h",layer->ks.s[i].offset.h));
-                             value_s.push_back(scale_node);
-                             
-                         }
-                         JSONNode last_scale;
-                         last_scale.push_back(JSONNode("t",layer->ks.s[s_size-1].offset.time));
-                         JSONNode start_value(JSON_ARRAY);
-                         start_value.set_name("s");
-                         start_value.push_back(JSONNode("",layer->ks.s[s_size-1].k[0]));
-                         start_value.push_back(JSONNode("",layer->ks.s[s_size-1].k[1]));
-                         // start_value.push_back(JSONNode("",layer->ks.s[s_size-1].k[2]));
-                         last_scale.push_back(start_value);
-                         last_scale.push_back(JSONNode("h",layer->ks.s[s_size-1].offset.h));
-                         value_s.push_back(last_scale);
-                         scale.push_back(value_s);
-                         
-                         scale.push_back(JSONNode("ix",layer->ks.s[s_size-1].ix));
-                         layer_transformprop.push_back(scale);
-                         
-                         
-                     }
-                     
-                     
-                     //ROTATION
-                     std::uint32_t r_size=layer->ks.r.size();
-                     if(r_size==1)
-                     {
-                         JSONNode rotation;
-                         rotation.set_name("r");
-                         rotation.push_back(JSONNode("a",layer->ks.r[r_size-1].a));
-                         rotation.push_back(JSONNode("k",layer->ks.r[r_size-1].k));
-                         rotation.push_back(JSONNode("ix",layer->ks.r[r_size-1].ix));
-                         layer_transformprop.push_back(rotation);
-                     }
-                     
-                     else
-                     {
-                         JSONNode rotation;
-                         rotation.set_name("r");
-                         rotation.push_back(JSONNode("a",layer->ks.r[r_size-1].a));
-                         JSONNode value_r(JSON_ARRAY);
-                         value_r.set_name("k");
-                         for(int i=0;i<r_size-1;i++)
-                         {
-                             JSONNode rot_node;
-                             /*   JSONNode in_value;
-                              in_value.set_name("i");
-                              in_value.push_back(JSONNode("x",layer->ks.r[i].offset.i.x));
-                              in_value.push_back(JSONNode("y",layer->ks.r[i].offset.i.y));
-                              JSONNode out_value;
-                              out_value.set_name("o");
-                              out_value.push_back(JSONNode("x",layer->ks.r[i].offset.o.x));
-                              out_value.push_back(JSONNode("y",layer->ks.r[i].offset.o.y));
-                              rot_node.push_back(in_value);
-                              rot_node.push_back(out_value);*/
-                             rot_node.push_back(JSONNode("t",layer->ks.r[i].offset.time));
-                             JSONNode start_value(JSON_ARRAY);
-                             start_value.set_name("s");
-                             start_value.push_back(JSONNode("",layer->ks.r[i].offset.start[0]));
-                             rot_node.push_back(start_value);
-                             rot_node.push_back(JSONNode("h",layer->ks.r[i].offset.h));
-                             value_r.push_back(rot_node);
-                         }
-                         JSONNode last_pos;
-                         last_pos.push_back(JSONNode("t",layer->ks.r[r_size-1].offset.time));
-                         JSONNode start_value(JSON_ARRAY);
-                         start_value.set_name("s");
-                         start_value.push_back(JSONNode("",layer->ks.r[r_size-1].k));
-                         last_pos.push_back(start_value);
-                         last_pos.push_back(JSONNode("h",layer->ks.r[r_size-1].offset.h));
-                         value_r.push_back(last_pos);
-                         rotation.push_back(value_r);
-                         rotation.push_back(JSONNode("ix",layer->ks.r[r_size-1].ix));
-                         layer_transformprop.push_back(rotation);
-                     }
-                     
-                     
-                     //OPACITY
-                     std::uint32_t o_size=layer->ks.o.size();
-                     if(o_size==1)
-                     {
-                         JSONNode opacity;
-                         opacity.set_name("o");
-                         opacity.push_back(JSONNode("a",layer->ks.o[o_size-1].a));
-                         opacity.push_back(JSONNode("k",layer->ks.o[o_size-1].k));
-                         opacity.push_back(JSONNode("ix",layer->ks.o[o_size-1].ix));
-                         layer_transformprop.push_back(opacity);
-                     }
-                     layerprop.push_back(layer_transformprop);
-                    
-             
-                 } m_layers->push_back(layerprop);}
-  
-        }
-             
-         }
-         return FCM_SUCCESS;
-     }
-
-         
-         
-         
-     
-                                                         
-                                                         
-        FCM::Result JSONOutputWriter::AddGroup(int resourceid)
-     {
-         //std::cout<<"ENTERED group"<<std::endl;
-         if(m_group)
-             delete m_group;
-         m_group=new JSONNode(JSON_ARRAY);
-         
-         m_group->set_name("shapes");
-        // std::cout<<"layer number"<<index+1<<std::endl;
-         std::uint32_t size=m_LottieManager->GetNumofGroups(resourceid);
-         //std:: cout<<size<<std::endl;
-         for(int ind=size-1;ind>=0;ind--)
-         {
-             group * gr = m_LottieManager->GetGroupAtIndex(ind,resourceid);
-             JSONNode groupprop;
-             /*std::  cout<<gr->fl.isfilled<<std::endl;*/
-           
-             if(gr!=NULL ){
-                groupprop.push_back(JSONNode("ty",gr->ty));
-                AddItems(gr);
-                 groupprop.push_back(*m_items);
-                 groupprop.push_back(JSONNode("nm",gr->nm));
-                 groupprop.push_back(JSONNode("mn",gr->mn));
-                 groupprop.push_back(JSONNode("np",gr->np));
-                 groupprop.push_back(JSONNode("cix",gr->cix));
-                 groupprop.push_back(JSONNode("bm",gr->bm));
-                 groupprop.push_back(JSONNode("ix",gr->ix));
-                 groupprop.push_back(JSONNode("hd",gr->hd));
-                 
-                 m_group->push_back(groupprop);
-              //   delete gr;
-                 
-         }
-           
-             
-        
-             
-         }
-         
-           return FCM_SUCCESS;
-                                                             
-    }
-                                                         
-    FCM::Result JSONOutputWriter::AddItems(struct group * gr)
-        {//Adding sh
-            //std::cout<<"ENTERED items"<<std::endl;
-            m_items=new JSONNode(JSON_ARRAY);
-            m_items->set_name("it");
-           if(m_inv)
-                delete m_inv;
-            m_inv=new JSONNode(JSON_ARRAY);
-            
-            m_inv->set_name("i");
-            if(m_outv)
-                delete m_outv;
-            m_outv=new JSONNode(JSON_ARRAY);
-            m_outv->set_name("o");
-            if(m_cv)
-                delete m_cv;
-            m_cv=new JSONNode(JSON_ARRAY);
-         /*   if(m_cv2)
-                delete m_cv2;
-            m_cv2=new JSONNode(JSON_ARRAY);*/
-            m_cv->set_name("v");
-           // m_cv2->set_name("v2");
-            if(gr->r.isrect == true)
-            {
-                JSONNode itemproprect;
-                itemproprect.push_back(JSONNode("ty",gr->r.ty));
-                itemproprect.push_back(JSONNode("nm",gr->r.nm));
-                itemproprect.push_back(JSONNode("mn",gr->r.mn));
-                itemproprect.push_back(JSONNode("hd",gr->r.hd));
-                itemproprect.push_back(JSONNode("d",gr->r.d));
-                JSONNode size;
-                size.set_name("s");
-                size.push_back(JSONNode("a",gr->r.s.a));
-                JSONNode size_k(JSON_ARRAY);
-                size_k.set_name("k");
-                size_k.push_back(JSONNode("",gr->r.s.k[0]));
-                size_k.push_back(JSONNode("",gr->r.s.k[1]));
-     
-                size.push_back(size_k);
-                size.push_back(JSONNode("ix",gr->r.s.ix));
-                itemproprect.push_back(size);
-                
-                JSONNode position;
-                position.set_name("p");
-                position.push_back(JSONNode("a",gr->r.rc.a));
-                JSONNode position_k(JSON_ARRAY);
-                position_k.set_name("k");
-                position_k.push_back(JSONNode("",gr->r.rc.k[0]));
-                position_k.push_back(JSONNode("",gr->r.rc.k[1]));
-                
-                position.push_back(position_k);
-                position.push_back(JSONNode("ix",gr->r.rc.ix));
-                itemproprect.push_back(position);
-                
-                JSONNode rounded_corners;
-                rounded_corners.set_name("r");
-                rounded_corners.push_back(JSONNode("a",gr->r.r.a));
-            
-                rounded_corners.push_back(JSONNode("k",gr->r.r.k));
-                rounded_corners.push_back(JSONNode("ix",gr->r.r.ix));
-                itemproprect.push_back(rounded_corners);
-                
-            
-                m_items->push_back(itemproprect);
-                
-            }
-            else
-            {
-            JSONNode itempropsh;
-            itempropsh.push_back(JSONNode("ty",gr->sh.ty));
-            itempropsh.push_back(JSONNode("nm",gr->sh.nm));
-            itempropsh.push_back(JSONNode("mn",gr->sh.mn));
-            itempropsh.push_back(JSONNode("hd",gr->sh.hd));
-            itempropsh.push_back(JSONNode("ind","0"));
-            itempropsh.push_back(JSONNode("ix",gr->sh.ix));
-            
-            JSONNode ks;
-            ks.set_name("ks");
-            ks.push_back(JSONNode("a",gr->sh.shp.a));
-            
-            JSONNode k;
-            k.set_name("k");
-            
-            std::uint32_t size=gr->sh.shp.i.size();
-            
-            for(int index=0;index<size;index++)
-            {
-                JSONNode inv(JSON_ARRAY);
-             
-                inv.push_back(JSONNode("",gr->sh.shp.i[index].x));
-                inv.push_back(JSONNode("",gr->sh.shp.i[index].y));
-                JSONNode outv(JSON_ARRAY);
-           
-                outv.push_back(JSONNode("",gr->sh.shp.o[index].x));
-                outv.push_back(JSONNode("",gr->sh.shp.o[index].y));
-                JSONNode cv(JSON_ARRAY);
-        
-                cv.push_back(JSONNode("",gr->sh.shp.v[index].x));
-                cv.push_back(JSONNode("",gr->sh.shp.v[index].y));
-
-                m_inv->push_back(inv);
-                m_outv->push_back(outv);
-                m_cv->push_back(cv);
-                
-            }
-             m_inv->set_name("i");
-             k.push_back(*m_inv);
-             k.push_back(*m_outv);
-             k.push_back(*m_cv);
-            
-            k.push_back(JSONNode("c",gr->sh.shp.c));
-            ks.push_back(k);
-            ks.push_back(JSONNode("ix",gr->sh.shp.ix));
-            itempropsh.push_back(ks);
-            m_items->push_back(itempropsh);
-            }
-        
-            //STROKE FILLING
-            
-            if(gr->st.hasstroke){
-                JSONNode itempropst;
-                
-                if(gr->st.issolid){
-                    itempropst.push_back(JSONNode("ty",gr->st.solid.ty));
-                    JSONNode opacity;
-                    opacity.set_name("o");
-                    opacity.push_back(JSONNode("a",gr->st.solid.o.a));
-                    opacity.push_back(JSONNode("k",gr->st.solid.o.k));
-                    opacity.push_back(JSONNode("ix",gr->st.solid.o.ix));
-                    itempropst.push_back(opacity);
-                    
-                    JSONNode width;
-                    width.set_name("w");
-                    width.push_back(JSONNode("a",gr->st.solid.w.a));
-                    width.push_back(JSONNode("k",gr->st.solid.w.k));
-                    width.push_back(JSONNode("ix",gr->st.solid.w.ix));
-                    itempropst.push_back(width);
-                    
-                    
-                    itempropst.push_back(JSONNode("lc",gr->st.solid.lc));
-                    itempropst.push_back(JSONNode("lj",gr->st.solid.lj));
-                    if(gr->st.solid.lj==1)
-                        itempropst.push_back(JSONNode("ml",gr->st.solid.ml));
-                    itempropst.push_back(JSONNode("bm",gr->st.solid.bm));
-                    itempropst.push_back(JSONNode("nm",gr->st.solid.nm));
-                    itempropst.push_back(JSONNode("mn",gr->st.solid.mn));
-                    itempropst.push_back(JSONNode("hd",gr->st.solid.hd));
-                    
-                    
-                    JSONNode colornode;
-                    colornode.set_name("c");
-                    colornode.push_back(JSONNode("a",gr->st.solid.color1.a));
-                    JSONNode color(JSON_ARRAY);
-                    color.set_name("k");
-                    color.push_back(JSONNode("",gr->st.solid.color1.r));
-                    color.push_back(JSONNode("",gr->st.solid.color1.g));
-                    color.push_back(JSONNode("",gr->st.solid.color1.b));
-                    color.push_back(JSONNode("",gr->st.solid.color1.alpha));
-                    colornode.push_back(color);
-                    colornode.push_back(JSONNode("ix",gr->st.solid.color1.ix));
-                    itempropst.push_back(colornode);
-                    
-                }
-                m_items->push_back(itempropst);
-            }
-            
-            
-            //Adding fl
-            if(gr->fl.isfilled){
-                if(gr->fl.issolid){
-            JSONNode itempropfl;
-            itempropfl.push_back(JSONNode("ty",gr->fl.solid.ty));
-            JSONNode colornode;
-                colornode.set_name("c");
-            colornode.push_back(JSONNode("a",gr->fl.solid.color1.a));
-            JSONNode color(JSON_ARRAY);
-            color.set_name("k");
-            color.push_back(JSONNode("",gr->fl.solid.color1.r));
-            color.push_back(JSONNode("",gr->fl.solid.color1.g));
-            color.push_back(JSONNode("",gr->fl.solid.color1.b));
-            color.push_back(JSONNode("",gr->fl.solid.color1.alpha));
-            colornode.push_back(color);
-            colornode.push_back(JSONNode("ix",gr->fl.solid.color1.ix));
-            itempropfl.push_back(colornode);
-            
-                JSONNode opacity;
-                opacity.set_name("o");
-                opacity.push_back(JSONNode("a",gr->fl.solid.o.a));
-                opacity.push_back(JSONNode("k",gr->fl.solid.o.k));
-                opacity.push_back(JSONNode("ix",gr->fl.solid.o.ix));
-                itempropfl.push_back(opacity);
-            itempropfl.push_back(JSONNode("r",gr->fl.solid.r));
-            itempropfl.push_back(JSONNode("bm",gr->fl.solid.bm));
-            itempropfl.push_back(JSONNode("nm",gr->fl.solid.nm));
-            itempropfl.push_back(JSONNode("mn",gr->fl.solid.mn));
-            itempropfl.push_back(JSONNode("hd",gr->fl.solid.hd));
-                m_items->push_back(itempropfl);
-                }
-                
-                //linear gradient
-                
-        else if(gr->fl.islinear_gradient){
-                    JSONNode itempropfl;
-                    itempropfl.push_back(JSONNode("ty",gr->fl.linear.ty));
-                    
-                    JSONNode opacity;
-                    opacity.set_name("o");
-                    opacity.push_back(JSONNode("a",gr->fl.linear.o.a));
-                    opacity.push_back(JSONNode("k",gr->fl.linear.o.k));
-                    opacity.push_back(JSONNode("ix",gr->fl.linear.o.ix));
-                    itempropfl.push_back(opacity);
-                    
-                    itempropfl.push_back(JSONNode("r",gr->fl.linear.r));
-            
-                    itempropfl.push_back(JSONNode("nm",gr->fl.linear.nm));
-            
-            JSONNode start_point;
-            start_point.set_name("s");
-            start_point.push_back(JSONNode("a",gr->fl.linear.s.a));
-            
-            JSONNode start_point_value(JSON_ARRAY);
-            start_point_value.set_name("k");
-
-            start_point_value.push_back(JSONNode("",gr->fl.linear.s.k[0]));
-            start_point_value.push_back(JSONNode("",gr->fl.linear.s.k[1]));
-            
-            start_point.push_back(start_point_value);
-            start_point.push_back(JSONNode("ix",gr->fl.linear.s.ix));
-            itempropfl.push_back(JSONNode("t",gr->fl.linear.type));
-            itempropfl.push_back(start_point);
-            itempropfl.push_back(JSONNode("bm",gr->fl.linear.bm));
-            
-            JSONNode gradient_color;
-            gradient_color.set_name("g");
-            gradient_color.push_back(JSONNode("p",gr->fl.linear.g.p));
-            
-            JSONNode gradient_color_values;
-            gradient_color_values.set_name("k");
-            gradient_color_values.push_back(JSONNode("a",gr->fl.linear.g.k.a));
-            
-            JSONNode g_color(JSON_ARRAY);
-            g_color.set_name("k");
-            for(int i=0;i<(4*(gr->fl.linear.g.p));i++)
-            {
-                g_color.push_back(JSONNode("",gr->fl.linear.g.k.color[i]));
-            }
-            gradient_color_values.push_back(g_color);
-            gradient_color_values.push_back(JSONNode("ix",gr->fl.linear.g.k.ix));
-            gradient_color.push_back(gradient_color_values);
-            itempropfl.push_back(gradient_color);
-            
-            
-            JSONNode end_point;
-            end_point.set_name("e");
-            end_point.push_back(JSONNode("a",gr->fl.linear.e.a));
-            
-            JSONNode end_point_value(JSON_ARRAY);
-            end_point_value.set_name("k");
-            end_point_value.push_back(JSONNode("",gr->fl.linear.e.k[0]));
-            end_point_value.push_back(JSONNode("",gr->fl.linear.e.k[1]));
-            
-            end_point.push_back(end_point_value);
-            end_point.push_back(JSONNode("ix",gr->fl.linear.e.ix));
-            
-            itempropfl.push_back(end_point);
-            itempropfl.push_back(JSONNode("mn",gr->fl.linear.mn));
-            itempropfl.push_back(JSONNode("hd",gr->fl.linear.hd));
-            m_items->push_back(itempropfl);
-                }
-                
-                
-              //radial gradient
-                
-                else if(gr->fl.isradial_gradient){
-                    JSONNode itempropfl;
-                    itempropfl.push_back(JSONNode("ty",gr->fl.radial.radial_fill.ty));
-                    
-                    JSONNode opacity;
-                    opacity.set_name("o");
-                    opacity.push_back(JSONNode("a",gr->fl.radial.radial_fill.o.a));
-                    opacity.push_back(JSONNode("k",gr->fl.radial.radial_fill.o.k));
-                    opacity.push_back(JSONNode("ix",gr->fl.radial.radial_fill.o.ix));
-                    itempropfl.push_back(opacity);
-                    
-                    itempropfl.push_back(JSONNode("r",gr->fl.radial.radial_fill.r));
-                    
-                    itempropfl.push_back(JSONNode("nm",gr->fl.radial.radial_fill.nm));
-                    
-                    JSONNode start_point;
-                    start_point.set_name("s");
-                    start_point.push_back(JSONNode("a",gr->fl.radial.radial_fill.s.a));
-                    
-                    JSONNode start_point_value(JSON_ARRAY);
-                    start_point_value.set_name("k");
-                    
-                    start_point_value.push_back(JSONNode("",gr->fl.radial.radial_fill.s.k[0]));
-                    start_point_value.push_back(JSONNode("",gr->fl.radial.radial_fill.s.k[1]));
-                    
-                    start_point.push_back(start_point_value);
-                    start_point.push_back(JSONNode("ix",gr->fl.radial.radial_fill.s.ix));
-                    itempropfl.push_back(JSONNode("t",gr->fl.radial.radial_fill.type));
-                    itempropfl.push_back(start_point);
-                    itempropfl.push_back(JSONNode("bm",gr->fl.radial.radial_fill.bm));
-                    
-                    JSONNode gradient_color;
-                    gradient_color.set_name("g");
-                    gradient_color.push_back(JSONNode("p",gr->fl.radial.radial_fill.g.p));
-                    
-                    JSONNode gradient_color_values;
-                    gradient_color_values.set_name("k");
-         gradient_color_values.push_back(JSONNode("a",gr->fl.radial.radial_fill.g.k.a));
-                    
-                    JSONNode g_color(JSON_ARRAY);
-                    g_color.set_name("k");
-                    for(int i=0;i<(4*(gr->fl.radial.radial_fill.g.p));i++)
-                    {
-                        g_color.push_back(JSONNode("",gr->fl.radial.radial_fill.g.k.color[i]));
-                    }
-                    gradient_color_values.push_back(g_color);
-                    gradient_color_values.push_back(JSONNode("ix",gr->fl.radial.radial_fill.g.k.ix));
-                    gradient_color.push_back(gradient_color_values);
-                    itempropfl.push_back(gradient_color);
-                    
-                    
-                    JSONNode end_point;
-                    end_point.set_name("e");
-                    end_point.push_back(JSONNode("a",gr->fl.radial.radial_fill.e.a));
-                    
-                    JSONNode end_point_value(JSON_ARRAY);
-                    end_point_value.set_name("k");
-                    end_point_value.push_back(JSONNode("",gr->fl.radial.radial_fill.e.k[0]));
-                    end_point_value.push_back(JSONNode("",gr->fl.radial.radial_fill.e.k[1]));
-                    
-                    end_point.push_back(end_point_value);
-                    end_point.push_back(JSONNode("ix",gr->fl.radial.radial_fill.e.ix));
-                    
-                    itempropfl.push_back(end_point);
-                    
-                    JSONNode highlight_length;
-                    highlight_length.set_name("h");
-                    highlight_length.push_back(JSONNode("a",gr->fl.radial.h.a));
-                    highlight_length.push_back(JSONNode("k",gr->fl.radial.h.k));
-                   highlight_length.push_back(JSONNode("ix",gr->fl.radial.h.ix));
-                    itempropfl.push_back(highlight_length);
-                    
-                    
-                    
-                    JSONNode highlight_angle;
-                    highlight_angle.set_name("a");
-                    highlight_angle.push_back(JSONNode("a",gr->fl.radial.a.a));
-                    highlight_angle.push_back(JSONNode("k",gr->fl.radial.a.k));
-                    highlight_angle.push_back(JSONNode("ix",gr->fl.radial.a.ix));
-                    itempropfl.push_back(highlight_angle);
-                    
-                    
-                    itempropfl.push_back(JSONNode("mn",gr->fl.radial.radial_fill.mn));
-                    itempropfl.push_back(JSONNode("hd",gr->fl.radial.radial_fill.hd));
-                    m_items->push_back(itempropfl);
-                }
-            
-            }
-            
-     
-            
-            JSONNode itemproptr;
-            itemproptr.push_back(JSONNode("ty","tr"));
-            
-            //POSITION
-            
-            std::uint32_t p_size=gr->ks.p.size();
-            if(p_size==1){
-            JSONNode position;
-            position.set_name("p");
-            position.push_back(JSONNode("a",gr->ks.p[p_size-1].a));
-            JSONNode value_p(JSON_ARRAY);
-            value_p.set_name("k");
-            value_p.push_back(JSONNode("",gr->ks.p[p_size-1].k[0]));
-            value_p.push_back(JSONNode("",gr->ks.p[p_size-1].k[1]));
-            position.push_back(value_p);
-            position.push_back(JSONNode("ix",gr->ks.p[p_size-1].ix));
-            itemproptr.push_back(position);
-            }
-            
-            //ANCHOR POINT
-            
-            std::uint32_t a_size=gr->ks.a.size();
-            if(a_size==1){
-            JSONNode anchorpoint;
-            anchorpoint.set_name("a");
-            anchorpoint.push_back(JSONNode("a",gr->ks.a[a_size-1].a));
-            JSONNode value_a(JSON_ARRAY);
-            value_a.set_name("k");
-            value_a.push_back(JSONNode("",gr->ks.a[a_size-1].k[0]));
-            value_a.push_back(JSONNode("",gr->ks.a[a_size-1].k[1]));
-            anchorpoint.push_back(value_a);
-            anchorpoint.push_back(JSONNode("ix",gr->ks.a[a_size-1].ix));
-            itemproptr.push_back(anchorpoint);
-            }
-            
-            //SCALE
-            
-            std::uint32_t s_size=gr->ks.s.size();
-            if(s_size==1)
-            {
-            JSONNode scale;
-            scale.set_name("s");
-            scale.push_back(JSONNode("a",gr->ks.s[s_size-1].a));
-            JSONNode value_s(JSON_ARRAY);
-            value_s.set_name("k");
-            value_s.push_back(JSONNode("",gr->ks.s[s_size-1].k[0]));
-            value_s.push_back(JSONNode("",gr->ks.s[s_size-1].k[1]));
-            scale.push_back(value_s);
-            scale.push_back(JSONNode("ix",gr->ks.s[s_size-1].ix));
-            itemproptr.push_back(scale);
-            }
-            
-            //ROTATION
-            
-            std::uint32_t r_size=gr->ks.r.size();
-            if(r_size==1)
-            {
-            JSONNode rotation;
-            rotation.set_name("r");
-            rotation.push_back(JSONNode("a",gr->ks.r[r_size-1].a));
-            rotation.push_back(JSONNode("k",gr->ks.r[r_size-1].k));
-            rotation.push_back(JSONNode("ix",gr->ks.r[r_size-1].ix));
-            itemproptr.push_back(rotation);
-            }
-            
-            //OPACITY
-            
-            std::uint32_t o_size=gr->ks.o.size();
-            if(o_size==1)
-            {
-            JSONNode opacity;
-            opacity.set_name("o");
-            opacity.push_back(JSONNode("a",gr->ks.o[o_size-1].a));
-            opacity.push_back(JSONNode("k",gr->ks.o[o_size-1].k));
-            opacity.push_back(JSONNode("ix",gr->ks.o[o_size-1].ix));
-            itemproptr.push_back(opacity);
-            }
-            
-            //SKEW
-            
-            std::uint32_t sk_size=gr->ks.sk.size();
-            if(sk_size==1)
-            {
-            JSONNode skew;
-            skew.set_name("sk");
-            skew.push_back(JSONNode("a",gr->ks.sk[sk_size-1].a));
-            skew.push_back(JSONNode("k",gr->ks.sk[sk_size-1].k));
-            skew.push_back(JSONNode("ix",gr->ks.sk[sk_size-1].ix));
-            itemproptr.push_back(skew);
-            }
-            
-            
-            //SKEW AXIS
-            
-            std::uint32_t sa_size=gr->ks.sa.size();
-            if(sa_size==1)
-            {
-            JSONNode skewaxis;
-            skewaxis.set_name("sa");
-            skewaxis.push_back(JSONNode("a",gr->ks.sa[sa_size-1].a));
-            skewaxis.push_back(JSONNode("k",gr->ks.sa[sa_size-1].k));
-            skewaxis.push_back(JSONNode("ix",gr->ks.sa[sa_size-1].ix));
-            itemproptr.push_back(skewaxis);
-            }
-            
-            itemproptr.push_back(JSONNode("nm","Transform"));
-            m_items->push_back(itemproptr);
-            return FCM_SUCCESS;
-                                                             
-        }
-       
-                                                    
-	FCM::Result JSONOutputWriter::AddVersion(JSONNode &firstNode)
-                                                         {// std::cout<<"ENTERED VERSION"<<std::endl;
-		firstNode.push_back(JSONNode("v", m_LottieManager->GetVersion()));
-		return FCM_SUCCESS;
-	}
-	FCM::Result JSONOutputWriter::AddAssets(JSONNode &firstNode)
-	{
-      //  std::cout<<"ENTERED assets"<<std::endl;
-        if(m_assets)
-        firstNode.push_back(*m_assets);
-		return FCM_SUCCESS;
-        
-	}
-	FCM::Result JSONOutputWriter::AddMarkers(JSONNode &firstNode)
-	{
-       // std::cout<<"ENTERED markers"<<std::endl;
-		JSONNode c = JSONNode(JSON_ARRAY);
-		c.set_name("markers");
-		firstNode.push_back(c);
-		return FCM_SUCCESS;
-	}
-    
-	/*FCM::Result JSONOutputWriter::AddOp()
-	{
+    }
 
-	}*/
-	
-	FCM::Result JSONOutputWriter::AddWidthHeight(JSONNode &firstNode)
-	{
-		int width; int height;
-        //std::cout<<"ENTERED w and h"<<std::endl;
-		m_LottieManager-> GetStageWidthHeight(  width, height);
-		firstNode.push_back(JSONNode("w", width));
-		firstNode.push_back(JSONNode("h", height));
-		return FCM_SUCCESS;
-	}
-	
 
     FCM::Result JSONOutputWriter::StartDefineTimeline()
     {
@@ -1468,6 +2078,9 @@ namespace LottieExporter
         FCM::StringRep16 pName,
         ITimelineWriter* pTimelineWriter)
     {
+        if (!m_legacyOutput)
+            return FCM_SUCCESS;
+
         JSONTimelineWriter* pWriter = static_cast<JSONTimelineWriter*> (pTimelineWriter);
 
         pWriter->Finish(resId, pName);
@@ -1480,6 +2093,9 @@ namespace LottieExporter
 
     FCM::Result JSONOutputWriter::StartDefineShape()
     {
+        if (!m_legacyOutput)
+            return FCM_SUCCESS;
+
         m_shapeElem = new JSONNode(JSON_NODE);
         ASSERT(m_shapeElem);
 
@@ -1494,6 +2110,9 @@ namespace LottieExporter
     // Marks the end of a shape
     FCM::Result JSONOutputWriter::EndDefineShape(FCM::U_Int32 resId)
     {
+        if (!m_legacyOutput)
+            return FCM_SUCCESS;
+
         m_shapeElem->push_back(JSONNode(("charid"), LottieExporter::Utils::ToString(resId)));
         m_shapeElem->push_back(*m_pathArray);
 
@@ -1509,6 +2128,9 @@ namespace LottieExporter
     // Start of fill region definition
     FCM::Result JSONOutputWriter::StartDefineFill()
     {
+        if (!m_legacyOutput)
+            return FCM_SUCCESS;
+
         m_pathElem = new JSONNode(JSON_NODE);
         ASSERT(m_pathElem);
 
@@ -1521,6 +2143,9 @@ namespace LottieExporter
     // Solid fill style definition
     FCM::Result JSONOutputWriter::DefineSolidFillStyle(const DOM::Utils::COLOR& color)
     {
+        if (!m_legacyOutput)
+            return FCM_SUCCESS;
+
         std::string colorStr = Utils::ToString(color);
         std::string colorOpacityStr = LottieExporter::Utils::ToString((double)(color.alpha / 255.0));
 
@@ -1540,6 +2165,11 @@ namespace LottieExporter
         const std::string& libPathName,
         DOM::LibraryItem::PIMediaItem pMediaItem)
     {
+        // The bitmap fill is only referenced by the legacy tree, so the
+        // image does not need to be exported for Lottie-only output.
+        if (!m_legacyOutput)
+            return FCM_SUCCESS;
+
         FCM::Result res;
         std::string name;
         JSONNode bitmapElem(JSON_NODE);
@@ -1551,51 +2181,19 @@ namespace LottieExporter
         bitmapElem.push_back(JSONNode(("height"), LottieExporter::Utils::ToString(height)));
         bitmapElem.push_back(JSONNode(("width"), LottieExporter::Utils::ToString(width)));
 
-        FCM::AutoPtr<FCM::IFCMUnknown> pUnk;
         std::string bitmapRelPath;
-        std::string bitmapExportPath = m_outputImageFolder + "/";
-            
-        FCM::Boolean alreadyExported = GetImageExportFileName(libPathName, name);
-        if (!alreadyExported)
+
+        res = ExportImage(libPathName, height, width, pMediaItem, name);
+        if (FCM_FAILURE_CODE(res))
         {
-            if (!m_imageFolderCreated)
-            {
-                res = Utils::CreateDir(m_outputImageFolder, m_pCallback);
-                if (!(FCM_SUCCESS_CODE(res)))
-                {
-                    Utils::Trace(m_pCallback, "Output image folder (%s) could not be created\n", m_outputImageFolder.c_str());
-                    return res;
-                }
-                m_imageFolderCreated = true;
-            }
-            CreateImageFileName(libPathName, name);
-            SetImageExportFileName(libPathName, name);
+            return res;
         }
 
-        bitmapExportPath += name;
-            
         bitmapRelPath = "./";
         bitmapRelPath += IMAGE_FOLDER;
         bitmapRelPath += "/";
         bitmapRelPath += name;
 
-        res = m_pCallback->GetService(DOM::FLA_BITMAP_SERVICE, pUnk.m_Ptr);
-        ASSERT(FCM_SUCCESS_CODE(res));
-
-        FCM::AutoPtr<DOM::Service::Image::IBitmapExportService> bitmapExportService = pUnk;
-        if (bitmapExportService)
-        {
-            FCM::AutoPtr<FCM::IFCMCalloc> pCalloc;
-            FCM::StringRep16 pFilePath = Utils::ToString16(bitmapExportPath, m_pCallback);
-            res = bitmapExportService->ExportToFile(pMediaItem, pFilePath, 100);
-            ASSERT(FCM_SUCCESS_CODE(res));
-
-            pCalloc =LottieExporter::Utils::GetCallocService(m_pCallback);
-            ASSERT(pCalloc.m_Ptr != NULL);
-
-            pCalloc->Free(pFilePath);
-        }
-
         bitmapElem.push_back(JSONNode(("bitmapPath"), bitmapRelPath)); 
 
         DOM::Utils::MATRIX2D matrix1 = matrix;
@@ -1620,6 +2218,9 @@ namespace LottieExporter
     {
         DOM::Utils::POINT2D point;
 
+        if (!m_legacyOutput)
+            return FCM_SUCCESS;
+
         m_gradientColor = new JSONNode(JSON_NODE);
         ASSERT(m_gradientColor);
         m_gradientColor->set_name("linearGradient");
@@ -1655,6 +2256,9 @@ namespace LottieExporter
         JSONNode stopEntry(JSON_NODE);
         FCM::Float offset;
         
+        if (!m_legacyOutput)
+            return FCM_SUCCESS;
+
         offset = (float)((colorPoint.pos * 100) / 255.0);
 
         stopEntry.push_back(JSONNode("offset", Utils::ToString((double) offset)));
@@ -1670,6 +2274,9 @@ namespace LottieExporter
     // End Linear Gradient fill style definition
     FCM::Result JSONOutputWriter::EndDefineLinearGradientFillStyle()
     {
+        if (!m_legacyOutput)
+            return FCM_SUCCESS;
+
         m_gradientColor->push_back(*m_stopPointArray);
         m_pathElem->push_back(*m_gradientColor);
 
@@ -1690,6 +2297,9 @@ namespace LottieExporter
         DOM::Utils::POINT2D point1;
         DOM::Utils::POINT2D point2;
 
+        if (!m_legacyOutput)
+            return FCM_SUCCESS;
+
         m_gradientColor = new JSONNode(JSON_NODE);
         ASSERT(m_gradientColor);
         m_gradientColor->set_name("radialGradient");
@@ -1740,6 +2350,9 @@ namespace LottieExporter
     // End Radial Gradient fill style definition
     FCM::Result JSONOutputWriter::EndDefineRadialGradientFillStyle()
     {
+        if (!m_legacyOutput)
+            return FCM_SUCCESS;
+
         m_gradientColor->push_back(*m_stopPointArray);
         m_pathElem->push_back(*m_gradientColor);
 
@@ -1760,6 +2373,9 @@ namespace LottieExporter
     // Sets a segment of a path (Used for boundary, holes)
     FCM::Result JSONOutputWriter::SetSegment(const DOM::Utils::SEGMENT& segment)
     {
+        if (!m_legacyOutput)
+            return FCM_SUCCESS;
+
         if (m_firstSegment)
         {
             if (segment.segmentType == DOM::Utils::LINE_SEGMENT)
@@ -1865,6 +2481,9 @@ namespace LottieExporter
     // Start of stroke 
     FCM::Result JSONOutputWriter::StartDefineStroke()
     {
+        if (!m_legacyOutput)
+            return FCM_SUCCESS;
+
         m_pathElem = new JSONNode(JSON_NODE);
         ASSERT(m_pathElem);
 
@@ -1878,6 +2497,9 @@ namespace LottieExporter
     // End of a stroke 
     FCM::Result JSONOutputWriter::EndDefineStroke()
     {
+        if (!m_legacyOutput)
+            return FCM_SUCCESS;
+
         m_pathElem->push_back(JSONNode("d", m_pathCmdStr));
 
         if (m_strokeStyle.type == SOLID_STROKE_STYLE_TYPE)
@@ -1916,6 +2538,9 @@ namespace LottieExporter
     // End of fill style definition
     FCM::Result JSONOutputWriter::EndDefineFill()
     {
+        if (!m_legacyOutput)
+            return FCM_SUCCESS;
+
         m_pathElem->push_back(JSONNode("d", m_pathCmdStr));
         m_pathElem->push_back(JSONNode("pathType", JSON_TEXT("Fill")));
         m_pathElem->push_back(JSONNode("stroke", JSON_TEXT("none")));
@@ -1938,20 +2563,7 @@ namespace LottieExporter
         const std::string& libPathName,
         DOM::LibraryItem::PIMediaItem pMediaItem)
     {
-        if(!m_assets)
-        {m_assets =new JSONNode(JSON_ARRAY);m_assets->set_name("assets");}
-        
-        std::map<int , image_resource *>::iterator it;
-        std::map<int , image_resource *>image_resource_id=m_LottieManager->Getimageresource_id();
-       
-            image_resource * image =m_LottieManager->Getimage_resource_with_id(resId);
-            JSONNode imagenode;
-
-        
-            imagenode.push_back(JSONNode("id",image->ref_id));
-            imagenode.push_back(JSONNode("w",width));
-            imagenode.push_back(JSONNode("h",height));
-            imagenode.push_back(JSONNode("e",0));
+        image_resource * image =m_LottieManager->Getimage_resource_with_id(resId);
         
      FCM::Result res;
         JSONNode bitmapElem(JSON_NODE);
@@ -1964,61 +2576,30 @@ namespace LottieExporter
         bitmapElem.push_back(JSONNode(("height"), LottieExporter::Utils::ToString(height)));
         bitmapElem.push_back(JSONNode(("width"), LottieExporter::Utils::ToString(width)));*/
 
-        FCM::AutoPtr<FCM::IFCMUnknown> pUnk;
         std::string bitmapRelPath;
-        std::string bitmapExportPath = m_outputImageFolder + "/";
-            
-        FCM::Boolean alreadyExported = GetImageExportFileName(libPathName, name);
-        if (!alreadyExported)
+
+        res = ExportImage(libPathName, height, width, pMediaItem, name);
+        if (FCM_FAILURE_CODE(res))
         {
-            if (!m_imageFolderCreated)
-            {
-                res = Utils::CreateDir(m_outputImageFolder, m_pCallback);
-                if (!(FCM_SUCCESS_CODE(res)))
-                {
-                    Utils::Trace(m_pCallback, "Output image folder (%s) could not be created\n", m_outputImageFolder.c_str());
-                    return res;
-                }
-                m_imageFolderCreated = true;
-            }
-            CreateImageFileName(libPathName, name);
-            SetImageExportFileName(libPathName, name);
+            return res;
         }
-        
-        bitmapExportPath += name;
-            
+
         bitmapRelPath = "./";
         bitmapRelPath += IMAGE_FOLDER;
         bitmapRelPath += "/";
-        imagenode.push_back(JSONNode("u",bitmapRelPath));
+        if (image)
+        {
+            image->u = bitmapRelPath;
+            image->p = name;
+        }
         bitmapRelPath += name;
-        imagenode.push_back(JSONNode("p",name));
-        
-
-        res = m_pCallback->GetService(DOM::FLA_BITMAP_SERVICE, pUnk.m_Ptr);
-        ASSERT(FCM_SUCCESS_CODE(res));
 
-        FCM::AutoPtr<DOM::Service::Image::IBitmapExportService> bitmapExportService = pUnk;
-        if (bitmapExportService)
+        if (m_legacyOutput)
         {
-            FCM::AutoPtr<FCM::IFCMCalloc> pCalloc;
-            FCM::StringRep16 pFilePath = Utils::ToString16(bitmapExportPath, m_pCallback);
-            res = bitmapExportService->ExportToFile(pMediaItem, pFilePath, 100);
-            ASSERT(FCM_SUCCESS_CODE(res));
-
-            pCalloc = LottieExporter::Utils::GetCallocService(m_pCallback);
-            ASSERT(pCalloc.m_Ptr != NULL);
-
-            pCalloc->Free(pFilePath);
+            bitmapElem.push_back(JSONNode(("bitmapPath"), bitmapRelPath));
+            m_pBitmapArray->push_back(bitmapElem);
         }
 
-        bitmapElem.push_back(JSONNode(("bitmapPath"), bitmapRelPath));
-        
-        m_assets->push_back(imagenode);
-
-
-        m_pBitmapArray->push_back(bitmapElem);
-
         return FCM_SUCCESS;
     }
 
@@ -2029,6 +2610,9 @@ namespace LottieExporter
             const std::string& displayText, 
             DOM::FrameElement::PIClassicText pTextItem)
     {
+        if (!m_legacyOutput)
+            return FCM_SUCCESS;
+
         std::string txt = displayText;
         std::string colorStr = Utils::ToString(color);
         std::string find = "\r";
@@ -2071,7 +2655,10 @@ namespace LottieExporter
         std::string name;
 
         soundElem.set_name("sound");
-        soundElem.push_back(JSONNode(("charid"),LottieExporter::Utils::ToString(resId)));
+        if (m_legacyOutput)
+        {
+            soundElem.push_back(JSONNode(("charid"),LottieExporter::Utils::ToString(resId)));
+        }
         
         FCM::AutoPtr<FCM::IFCMUnknown> pUnk;
         std::string soundRelPath;
@@ -2101,23 +2688,34 @@ namespace LottieExporter
         FCM::AutoPtr<DOM::Service::Sound::ISoundExportService> soundExportService = pUnk;
         if (soundExportService)
         {
-            FCM::AutoPtr<FCM::IFCMCalloc> pCalloc;
-            FCM::StringRep16 pFilePath = Utils::ToString16(soundExportPath, m_pCallback);
-            res = soundExportService->ExportToFile(pMediaItem, pFilePath);
-            ASSERT(FCM_SUCCESS_CODE(res));
-            pCalloc = LottieExporter::Utils::GetCallocService(m_pCallback);
-            ASSERT(pCalloc.m_Ptr != NULL);
-            pCalloc->Free(pFilePath);
+            ASSET_EXPORT_JOB* pJob = new ASSET_EXPORT_JOB;
+            pJob->soundExportService = soundExportService;
+            pJob->pMediaItem = pMediaItem;
+            pJob->filePath = soundExportPath;
+            pJob->pFilePath = Utils::ToString16(pJob->filePath, m_pCallback);
+            pJob->name = name;
+            QueueAssetExport(pJob);
+            m_profiler.AddCount(PROFILE_COUNTER_SOUNDS, 1);
         }
         
-        soundElem.push_back(JSONNode(("soundPath"), soundRelPath)); 
-        m_pSoundArray->push_back(soundElem);
+        if (m_legacyOutput)
+        {
+            soundElem.push_back(JSONNode(("soundPath"), soundRelPath));
+            m_pSoundArray->push_back(soundElem);
+        }
         
         return FCM_SUCCESS;
     }
 
-    JSONOutputWriter::JSONOutputWriter(FCM::PIFCMCallback pCallback)
+    JSONOutputWriter::JSONOutputWriter(FCM::PIFCMCallback pCallback, FCM::Boolean legacyOutput)
         : m_pCallback(pCallback),
+          m_legacyOutput(legacyOutput),
+          m_pRootNode(NULL),
+          m_pShapeArray(NULL),
+          m_pTimelineArray(NULL),
+          m_pBitmapArray(NULL),
+          m_pSoundArray(NULL),
+          m_pTextArray(NULL),
           m_shapeElem(NULL),
           m_pathArray(NULL),
           m_pathElem(NULL),
@@ -2126,8 +2724,30 @@ namespace LottieExporter
           m_imageFileNameLabel(0),
           m_soundFileNameLabel(0),
           m_imageFolderCreated(false),
-          m_soundFolderCreated(false)
+          m_soundFolderCreated(false),
+          m_keyframeTolerance(KEYFRAME_REDUCTION_TOLERANCE),
+          m_pathTolerance(PATH_SIMPLIFY_TOLERANCE),
+          m_outputProfile(COMPACT_OUTPUT_PROFILE),
+          m_persistentImageCache(false),
+          m_documentPending(false),
+          m_documentResult(FCM_SUCCESS),
+          m_sharedShapeContents(0),
+          m_pSymbolCache(NULL),
+          m_statsFile(false)
     {
+        m_strokeStyle.type = INVALID_STROKE_STYLE_TYPE;
+
+        for (int c = 0; c < NUMBER_CLASS_COUNT; c++)
+            m_numberPrecision[c] = NumberFormatter::DefaultPrecision((NumberClass)c);
+
+        m_documentPool.SetNumThreads(1);
+
+        if (!m_legacyOutput)
+        {
+            // Lottie-only export: the legacy tree is never allocated
+            return;
+        }
+
         m_pRootNode = new JSONNode(JSON_NODE);
         ASSERT(m_pRootNode);
         m_pRootNode->set_name("DOMDocument");
@@ -2151,12 +2771,17 @@ namespace LottieExporter
         m_pSoundArray = new JSONNode(JSON_ARRAY);
         ASSERT(m_pSoundArray);
         m_pSoundArray->set_name("Sounds");
-        m_strokeStyle.type = INVALID_STROKE_STYLE_TYPE;
     }
 
 
     JSONOutputWriter::~JSONOutputWriter()
     {
+        m_documentPool.Join();
+        FinishAssetExport();
+
+        // Releases the whole Lottie model of the publish
+        delete m_LottieManager;
+
         delete m_pBitmapArray;
         delete m_pSoundArray;
 
@@ -2172,6 +2797,9 @@ namespace LottieExporter
 
     FCM::Result JSONOutputWriter::StartDefinePath()
     {
+        if (!m_legacyOutput)
+            return FCM_SUCCESS;
+
         m_pathCmdStr.append(moveTo);
         m_pathCmdStr.append(space);
         m_firstSegment = true;
@@ -2287,6 +2915,146 @@ namespace LottieExporter
 
         m_imageMap.insert(std::pair<std::string, std::string>(libPathName, name));
     }
+
+
+    // Gets the image of a library item into the image folder, encoding it only
+    // if neither this publish nor a previous one to the same folder did.
+    FCM::Result JSONOutputWriter::ExportImage(
+        const std::string& libPathName,
+        FCM::S_Int32 height,
+        FCM::S_Int32 width,
+        DOM::LibraryItem::PIMediaItem pMediaItem,
+        std::string& name)
+    {
+        FCM::Result res;
+        FCM::AutoPtr<FCM::IFCMUnknown> pUnk;
+        std::string cacheKey;
+
+        if (GetImageExportFileName(libPathName, name))
+        {
+            return FCM_SUCCESS;
+        }
+
+        cacheKey = libPathName + "|" + Utils::ToString(width) + "x" + Utils::ToString(height);
+        if (m_bitmapCache.Lookup(cacheKey, name))
+        {
+            SetImageExportFileName(libPathName, name);
+            return FCM_SUCCESS;
+        }
+
+        if (!m_imageFolderCreated)
+        {
+            res = Utils::CreateDir(m_outputImageFolder, m_pCallback);
+            if (!(FCM_SUCCESS_CODE(res)))
+            {
+                Utils::Trace(m_pCallback, "Output image folder (%s) could not be created\n", m_outputImageFolder.c_str());
+                return res;
+            }
+            m_imageFolderCreated = true;
+        }
+
+        do
+        {
+            CreateImageFileName(libPathName, name);
+        } while (m_bitmapCache.IsNameTaken(name));
+
+        res = m_pCallback->GetService(DOM::FLA_BITMAP_SERVICE, pUnk.m_Ptr);
+        ASSERT(FCM_SUCCESS_CODE(res));
+
+        FCM::AutoPtr<DOM::Service::Image::IBitmapExportService> bitmapExportService = pUnk;
+        if (bitmapExportService)
+        {
+            ASSET_EXPORT_JOB* pJob = new ASSET_EXPORT_JOB;
+            pJob->bitmapExportService = bitmapExportService;
+            pJob->pMediaItem = pMediaItem;
+            pJob->filePath = m_outputImageFolder + "/" + name;
+            pJob->pFilePath = Utils::ToString16(pJob->filePath, m_pCallback);
+            pJob->name = name;
+            pJob->cacheKey = cacheKey;
+            QueueAssetExport(pJob);
+        }
+
+        SetImageExportFileName(libPathName, name);
+
+        return FCM_SUCCESS;
+    }
+
+
+    // The file name is already decided; the encoding and the write happen on
+    // a worker while the timelines are being traversed.
+    void JSONOutputWriter::QueueAssetExport(ASSET_EXPORT_JOB* pJob)
+    {
+        pJob->result = FCM_SUCCESS;
+        pJob->hashed = false;
+        pJob->hash = 0;
+        pJob->pProfiler = &m_profiler;
+        m_exportJobs.push_back(pJob);
+
+        // The export services are not known to be safe off the publishing
+        // thread: the file is encoded here, and read back in the background
+        pJob->Export();
+        if (pJob->bitmapExportService && FCM_SUCCESS_CODE(pJob->result))
+        {
+            m_exportPool.Enqueue([pJob] { pJob->Hash(); });
+        }
+    }
+
+
+    // Waits for the queued exports and records them in the image cache. Run
+    // in queue order, so the files shared by identical images do not depend
+    // on which worker finished first.
+    FCM::Result JSONOutputWriter::FinishAssetExport()
+    {
+        FCM::Result res = FCM_SUCCESS;
+        std::string sameContent;
+
+        if (m_exportJobs.empty())
+            return FCM_SUCCESS;
+
+        m_exportPool.Join();
+
+        FCM::AutoPtr<FCM::IFCMCalloc> pCalloc = LottieExporter::Utils::GetCallocService(m_pCallback);
+        ASSERT(pCalloc.m_Ptr != NULL);
+
+        for (size_t i = 0; i < m_exportJobs.size(); i++)
+        {
+            ASSET_EXPORT_JOB* pJob = m_exportJobs[i];
+
+            pCalloc->Free(pJob->pFilePath);
+
+            if (FCM_FAILURE_CODE(pJob->result))
+            {
+                Utils::Trace(m_pCallback, "Asset (%s) could not be exported\n", pJob->name.c_str());
+                res = pJob->result;
+            }
+            else if (pJob->hashed)
+            {
+                std::string name = pJob->name;
+                if (m_bitmapCache.FindContent(pJob->hash, sameContent) && sameContent != name &&
+                    m_bitmapCache.IsSameFile(name, sameContent))
+                {
+                    // Another library item with the same pixels. The legacy
+                    // tree keeps pointing at its own copy.
+                    std::uint32_t size = m_LottieManager->GetNumofImageResources();
+                    for (std::uint32_t j = 0; j < size; j++)
+                    {
+                        image_resource* image = m_LottieManager->GetImageResourceAtIndex(j);
+                        if (image->p == name)
+                            image->p = sameContent;
+                    }
+                    if (!m_legacyOutput)
+                        Utils::Remove(m_outputImageFolder + "/" + name, m_pCallback);
+                    name = sameContent;
+                }
+                m_bitmapCache.Add(pJob->cacheKey, name, pJob->hash);
+            }
+
+            delete pJob;
+        }
+        m_exportJobs.clear();
+
+        return res;
+    }
     /* -------------------------------------------------- JSONTimelineWriter */
 
     FCM::Result JSONTimelineWriter::PlaceObject(
@@ -2298,6 +3066,9 @@ namespace LottieExporter
     {
         JSONNode commandElement(JSON_NODE);
 
+        if (!m_legacyOutput)
+            return FCM_SUCCESS;
+
         commandElement.push_back(JSONNode("cmdType", "Place"));
         commandElement.push_back(JSONNode("charid", LottieExporter::Utils::ToString(resId)));
         commandElement.push_back(JSONNode("objectId",LottieExporter::Utils::ToString(objectId)));
@@ -2321,6 +3092,9 @@ namespace LottieExporter
     {
         FCM::Result res;
 
+        if (!m_legacyOutput)
+            return FCM_SUCCESS;
+
         JSONNode commandElement(JSON_NODE);
         FCM::AutoPtr<DOM::FrameElement::ISound> pSound;
 
@@ -2376,6 +3150,9 @@ namespace LottieExporter
     {
         JSONNode commandElement(JSON_NODE);
 
+        if (!m_legacyOutput)
+            return FCM_SUCCESS;
+
         commandElement.push_back(JSONNode("cmdType", "Remove"));
         commandElement.push_back(JSONNode("objectId", LottieExporter::Utils::ToString(objectId)));
 
@@ -2391,6 +3168,9 @@ namespace LottieExporter
     {
         JSONNode commandElement(JSON_NODE);
 
+        if (!m_legacyOutput)
+            return FCM_SUCCESS;
+
         commandElement.push_back(JSONNode("cmdType", "UpdateZOrder"));
         commandElement.push_back(JSONNode("objectId", LottieExporter::Utils::ToString(objectId)));
         commandElement.push_back(JSONNode("placeAfter", LottieExporter::Utils::ToString(placeAfterObjectId)));
@@ -2426,6 +3206,9 @@ namespace LottieExporter
     {
         JSONNode commandElement(JSON_NODE);
 
+        if (!m_legacyOutput)
+            return FCM_SUCCESS;
+
         commandElement.push_back(JSONNode("cmdType", "UpdateBlendMode"));
         commandElement.push_back(JSONNode("objectId", LottieExporter::Utils::ToString(objectId)));
         if(blendMode == 0)
@@ -2468,6 +3251,9 @@ namespace LottieExporter
     {
         JSONNode commandElement(JSON_NODE);
 
+        if (!m_legacyOutput)
+            return FCM_SUCCESS;
+
         commandElement.push_back(JSONNode("cmdType", "UpdateVisibility"));
         commandElement.push_back(JSONNode("objectId", LottieExporter::Utils::ToString(objectId)));
 
@@ -2492,6 +3278,10 @@ namespace LottieExporter
     {
         FCM::Result res;
         JSONNode commandElement(JSON_NODE);
+
+        if (!m_legacyOutput)
+            return FCM_SUCCESS;
+
         commandElement.push_back(JSONNode("cmdType", "UpdateFilter"));
         commandElement.push_back(JSONNode("objectId", LottieExporter::Utils::ToString(objectId)));
         FCM::AutoPtr<DOM::GraphicFilter::IDropShadowFilter> pDropShadowFilter = pFilter;
@@ -3071,6 +3861,9 @@ namespace LottieExporter
         JSONNode commandElement(JSON_NODE);
         std::string transformMat;
 
+        if (!m_legacyOutput)
+            return FCM_SUCCESS;
+
         commandElement.push_back(JSONNode("cmdType", "Move"));
         commandElement.push_back(JSONNode("objectId", LottieExporter::Utils::ToString(objectId)));
         transformMat = LottieExporter::Utils::ToString(matrix);
@@ -3093,6 +3886,9 @@ namespace LottieExporter
 
     FCM::Result JSONTimelineWriter::ShowFrame(FCM::U_Int32 frameNum)
     {
+        if (!m_legacyOutput)
+            return FCM_SUCCESS;
+
         m_pFrameElement->push_back(JSONNode(("num"), LottieExporter::Utils::ToString(frameNum)));
         m_pFrameElement->push_back(*m_pCommandArray);
         m_pFrameArray->push_back(*m_pFrameElement);
@@ -3137,6 +3933,9 @@ namespace LottieExporter
         
         Utils::Trace(m_pCallback, "[AddFrameScript] (Layer: %d): %s\n", layerNum, script.c_str());
 
+        if (!m_legacyOutput)
+            return FCM_SUCCESS;
+
         m_pFrameElement->push_back(JSONNode(scriptWithLayerNumber,script));
 
         return FCM_SUCCESS;
@@ -3155,6 +3954,9 @@ namespace LottieExporter
         std::string label = Utils::ToString(pLabel, m_pCallback);
         Utils::Trace(m_pCallback, "[SetFrameLabel] (Type: %d): %s\n", labelType, label.c_str());
 
+        if (!m_legacyOutput)
+            return FCM_SUCCESS;
+
         if(labelType == 1)
              m_pFrameElement->push_back(JSONNode("LabelType:Name",label));
         else if(labelType == 2)
@@ -3168,9 +3970,20 @@ namespace LottieExporter
     }
 
 
-    JSONTimelineWriter::JSONTimelineWriter(FCM::PIFCMCallback pCallback) :
-        m_pCallback(pCallback)
+    JSONTimelineWriter::JSONTimelineWriter(FCM::PIFCMCallback pCallback, FCM::Boolean legacyOutput) :
+        m_pCommandArray(NULL),
+        m_pFrameArray(NULL),
+        m_pTimelineElement(NULL),
+        m_pFrameElement(NULL),
+        m_pCallback(pCallback),
+        m_legacyOutput(legacyOutput)
     {
+        if (!m_legacyOutput)
+        {
+            // Lottie-only export: frame commands are not recorded
+            return;
+        }
+
         m_pCommandArray = new JSONNode(JSON_ARRAY);
         ASSERT(m_pCommandArray);
         m_pCommandArray->set_name("Command");
@@ -3209,6 +4022,9 @@ namespace LottieExporter
 
     void JSONTimelineWriter::Finish(FCM::U_Int32 resId, FCM::StringRep16 pName)
     {
+        if (!m_legacyOutput)
+            return;
+
         if (resId != 0)
         {
             m_pTimelineElement->push_back(
@@ -48,6 +48,8 @@
 #include "Utils/IRadialColorGradient.h"
 
 #include "OutputWriter.h"
+#include "PublishBenchmark.h"
+#include "SyntheticScene.h"
 
 #include "Exporter/Service/IResourcePalette.h"
 #include "Exporter/Service/ITimelineBuilder2.h"
@@ -55,9 +57,11 @@
 
 #include "Exporter/Service/ISWFExportService.h"
 #include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include "PluginConfiguration.h"
 #include"PublishToLottie.h"
-#include<Utils/IMatrix2D.h>
 struct opacity_gradient
 {
     double alpha;
@@ -66,6 +70,17 @@ struct opacity_gradient
 int i=0,j=0;
 namespace LottieExporter
 {
+    // Null layer parenting the layers of the root timeline; it has to exist
+    // from the first frame
+    static void AddRootLayer(JSONOutputWriter* writer)
+    {
+        LottieExporter::LottieManager *manager = writer->GetLottieManager();
+
+        manager->CreateLayer(Null,-1,0,0,0);
+        Layer * layer=manager->GetLayer();
+        manager->shape_layer_map(-1,layer);
+        layer->ip=0;
+    }
 
 	/* ----------------------------------------------------- CPublisher */
 
@@ -138,6 +153,12 @@ namespace LottieExporter
 
 		Utils::Trace(GetCallback(), "Creating output file : %s\n", outFile.c_str());
 
+		std::string benchmarkScene;
+		if (ReadString(pDictPublishSettings, (FCM::StringRep8)PUBLISH_SETTINGS_KEY_BENCHMARK_SCENE, benchmarkScene) &&
+			!benchmarkScene.empty())
+		{
+			return RunBenchmark(benchmarkScene, outFile, pDictPublishSettings);
+		}
 
 		DOM::Utils::COLOR color;
 		FCM::U_Int32 stageHeight;
@@ -149,12 +170,37 @@ namespace LottieExporter
 		FCM::U_Int32 timelineCount;
 
 		// Create a output writer
-		std::auto_ptr<IOutputWriter> pOutputWriter(new JSONOutputWriter(GetCallback()));
+		std::auto_ptr<IOutputWriter> pOutputWriter(
+			new JSONOutputWriter(GetCallback(), IsLegacyOutputNeeded(pDictPublishSettings)));
 		if (pOutputWriter.get() == NULL)
 		{
 			return FCM_MEM_NOT_AVAILABLE;
 		}
 
+		static_cast<JSONOutputWriter*>(pOutputWriter.get())->SetKeyframeTolerance(
+			GetKeyframeTolerance(pDictPublishSettings));
+		static_cast<JSONOutputWriter*>(pOutputWriter.get())->SetPathTolerance(
+			GetPathTolerance(pDictPublishSettings));
+		static_cast<JSONOutputWriter*>(pOutputWriter.get())->SetOutputProfile(
+			GetOutputProfile(pDictPublishSettings));
+		for (int c = 0; c < NUMBER_CLASS_COUNT; c++)
+		{
+			static_cast<JSONOutputWriter*>(pOutputWriter.get())->SetNumberPrecision(
+				(NumberClass)c, GetNumberPrecision(pDictPublishSettings, (NumberClass)c));
+		}
+		static_cast<JSONOutputWriter*>(pOutputWriter.get())->SetPersistentImageCache(
+			IsImageCacheEnabled(pDictPublishSettings));
+		static_cast<JSONOutputWriter*>(pOutputWriter.get())->SetSymbolCache(
+			IsSymbolCacheEnabled(pDictPublishSettings) ? &m_symbolCache : NULL);
+		static_cast<JSONOutputWriter*>(pOutputWriter.get())->SetExportThreads(
+			GetExportThreads(pDictPublishSettings));
+		static_cast<JSONOutputWriter*>(pOutputWriter.get())->SetSerializeThreads(
+			GetSerializeThreads(pDictPublishSettings));
+		static_cast<JSONOutputWriter*>(pOutputWriter.get())->SetTraceFile(
+			GetTraceFile(pDictPublishSettings));
+		static_cast<JSONOutputWriter*>(pOutputWriter.get())->SetProfiling(
+			IsProfilingEnabled(pDictPublishSettings), IsStatsFileEnabled(pDictPublishSettings));
+
 		// Start output
 		pOutputWriter->StartOutput(outFile);
 
@@ -174,7 +220,7 @@ namespace LottieExporter
 
 		ResourcePalette* pResPalette = static_cast<ResourcePalette*>(m_pResourcePalette.m_Ptr);
 		pResPalette->Clear();
-		pResPalette->Init(pOutputWriter.get());
+		pResPalette->Init(pOutputWriter.get(), GetCurveTolerance(pDictPublishSettings));
 
 		res = pFlaDocument->GetBackgroundColor(color);
 		ASSERT(FCM_SUCCESS_CODE(res));
@@ -193,22 +239,9 @@ namespace LottieExporter
 		res = pOutputWriter->StartDocument(color, stageHeight, stageWidth, framesPerSec);
 		ASSERT(FCM_SUCCESS_CODE(res));
 		JSONOutputWriter *writer = static_cast<JSONOutputWriter*>(pOutputWriter.get());
-        LottieExporter::LottieManager *manager = writer->GetLottieManager();
-        
-        
-        manager->CreateLayer(Null,-1,0,0,0);
-        //manager->shape_layer_map(0,layer);//create null layer for first frame
-        Layer * layer=manager->GetLayer();
-        manager->shape_layer_map(-1,layer);
-        layer->ip=0; ///Null layer has to be created on first frame.
-       // gr->parent_layer=1;
+        writer->GetPublishTrace().RecordDocument(color, stageHeight, stageWidth, framesPerSec);
+        AddRootLayer(writer);
 
-
-		if (writer)
-		{
-			LottieExporter::LottieManager *manager = writer->GetLottieManager();
-            
-		}
 		// Export complete document ?
 		if (!pTimeline)
 		{
@@ -225,26 +258,12 @@ namespace LottieExporter
 				return res;
 			}
 
-			/*
-			* IMPORTANT NOTE:
-			*
-			* For the current sample plugin, multiple scene export is not supported.
-			* Supporting export of multiple scene is little tricky. This is due to
-			* the fact that IFrameCommandGenerator::GenerateFrameCommands() expects
-			* that a new empty resource palette is passed for each timeline.
-			*
-			* In other words, for each timeline (scene), a resource palette is exported.
-			* So, if a resource is present in 2 scenes, its definition will be replicated
-			* in both the resource palettes. Plugin can choose to optimize by comparing the
-			* resource names to find the common resources and put it in a global resource
-			* palette and also modifying the timeline builder commands to use the new
-			* resource ids.
-			*
-			* For our current implementation, we chosen to keep it simple and not support
-			* multiple scenes. For this plugin to work, the feature "Scene" must be disabled
-			* by the corresponding DocType.
-			*/
-			ASSERT(timelineCount == 1);
+			// Every scene is exported into the one document, the scenes play
+			// one after the other. The frame command generator expects a new
+			// palette for each timeline and gives resources ids of its own; the
+			// palette starts a scene and puts the resources in a global palette
+			// instead, sharing library items used by several scenes.
+			FCM::U_Int32 firstFrame = 0;
 
 			// Generate frame commands for each timeline
 			for (FCM::U_Int32 i = 0; i < timelineCount; i++)
@@ -263,35 +282,45 @@ namespace LottieExporter
 				}
 
 				range.max--;
+				pResPalette->StartScene();
+				writer->GetLottieManager()->StartScene(firstFrame, range.max + 1);
+				writer->GetPublishTrace().RecordStartScene(firstFrame, range.max + 1);
 
 				// Generate frame commands
-				res = m_frameCmdGeneratorService->GenerateFrameCommands(
-					timeline,
-					range,
-					pDictPublishSettings,
-					m_pResourcePalette,
-					pTimelineBuilderFactory,
-					pTimelineBuilder.m_Ptr);
+				{
+					ProfileScope scope(writer->GetProfiler(), PROFILE_PHASE_FRAME_COMMANDS);
+					res = m_frameCmdGeneratorService->GenerateFrameCommands(
+						timeline,
+						range,
+						pDictPublishSettings,
+						m_pResourcePalette,
+						pTimelineBuilderFactory,
+						pTimelineBuilder.m_Ptr);
+				}
 
 				if (FCM_FAILURE_CODE(res))
 				{
 					return res;
 				}
 
-				((TimelineBuilder*)pTimelineBuilder.m_Ptr)->Build(0, NULL, &pTimelineWriter);
+				{
+					ProfileScope scope(writer->GetProfiler(), PROFILE_PHASE_TIMELINE_BUILD);
+					((TimelineBuilder*)pTimelineBuilder.m_Ptr)->Build(0, NULL, &pTimelineWriter);
+				}
+
+				firstFrame += range.max + 1;
 			}
 
+			// The document is written in the background from here on
 			res = pOutputWriter->EndDocument();
 			ASSERT(FCM_SUCCESS_CODE(res));
 
-			res = pOutputWriter->EndOutput();
-			ASSERT(FCM_SUCCESS_CODE(res));
-
 			// Export the library items with linkages
 			FCM::FCMListPtr pLibraryItemList;
 			res = pFlaDocument->GetLibraryItems(pLibraryItemList.m_Ptr);
 			if (FCM_FAILURE_CODE(res))
 			{
+				pOutputWriter->EndOutput();
 				return res;
 			}
 
@@ -302,27 +331,31 @@ namespace LottieExporter
 			// Export a timeline
 			AutoPtr<ITimelineBuilder> pTimelineBuilder;
 			ITimelineWriter* pTimelineWriter;
+			writer->GetLottieManager()->SetFrameCount(pFrameRange->max - pFrameRange->min + 1);
 			// Generate frame commands
-			res = m_frameCmdGeneratorService->GenerateFrameCommands(
-				pTimeline,
-				*pFrameRange,
-				pDictPublishSettings,
-				m_pResourcePalette,
-				pTimelineBuilderFactory,
-				pTimelineBuilder.m_Ptr);
+			{
+				ProfileScope scope(writer->GetProfiler(), PROFILE_PHASE_FRAME_COMMANDS);
+				res = m_frameCmdGeneratorService->GenerateFrameCommands(
+					pTimeline,
+					*pFrameRange,
+					pDictPublishSettings,
+					m_pResourcePalette,
+					pTimelineBuilderFactory,
+					pTimelineBuilder.m_Ptr);
+			}
 
 			if (FCM_FAILURE_CODE(res))
 			{
 				return res;
 			}
 
-			((TimelineBuilder*)pTimelineBuilder.m_Ptr)->Build(0, NULL, &pTimelineWriter);
+			{
+				ProfileScope scope(writer->GetProfiler(), PROFILE_PHASE_TIMELINE_BUILD);
+				((TimelineBuilder*)pTimelineBuilder.m_Ptr)->Build(0, NULL, &pTimelineWriter);
+			}
 
 			res = pOutputWriter->EndDocument();
 			ASSERT(FCM_SUCCESS_CODE(res));
-
-			res = pOutputWriter->EndOutput();
-			ASSERT(FCM_SUCCESS_CODE(res));
 		}
 
 #ifdef USE_RUNTIME
@@ -335,6 +368,10 @@ namespace LottieExporter
 		CopyRuntime(outFolder);
 
 #endif
+		// Waits for the document
+		res = pOutputWriter->EndOutput();
+		ASSERT(FCM_SUCCESS_CODE(res));
+
 		if (IsPreviewNeeded(pDictConfig))
 		{
 			ShowPreview(outFile);
@@ -352,6 +389,7 @@ namespace LottieExporter
 
 			pResPalette->Clear();
 		}
+		m_symbolCache.Clear();
 		return FCM_SUCCESS;
 	}
 
@@ -489,6 +527,256 @@ namespace LottieExporter
 	}
 
 
+	FCM::Boolean CPublisher::IsLegacyOutputNeeded(const PIFCMDictionary pDictPublishSettings)
+	{
+		std::string legacyOutput;
+
+		// Only the Lottie JSON is written unless explicitly asked for
+		if (ReadString(pDictPublishSettings, (FCM::StringRep8)PUBLISH_SETTINGS_KEY_LEGACY_JSON, legacyOutput))
+		{
+			return (legacyOutput == "true");
+		}
+		return false;
+	}
+
+
+	float CPublisher::GetKeyframeTolerance(const PIFCMDictionary pDictPublishSettings)
+	{
+		std::string tolerance;
+
+		if (ReadString(pDictPublishSettings, (FCM::StringRep8)PUBLISH_SETTINGS_KEY_KEYFRAME_TOLERANCE, tolerance) &&
+			!tolerance.empty())
+		{
+			return (float)atof(tolerance.c_str());
+		}
+		return KEYFRAME_REDUCTION_TOLERANCE;
+	}
+
+
+	double CPublisher::GetCurveTolerance(const PIFCMDictionary pDictPublishSettings)
+	{
+		std::string tolerance;
+
+		if (ReadString(pDictPublishSettings, (FCM::StringRep8)PUBLISH_SETTINGS_KEY_CURVE_TOLERANCE, tolerance) &&
+			!tolerance.empty())
+		{
+			return atof(tolerance.c_str());
+		}
+		return 0;
+	}
+
+
+	double CPublisher::GetPathTolerance(const PIFCMDictionary pDictPublishSettings)
+	{
+		std::string tolerance;
+
+		if (ReadString(pDictPublishSettings, (FCM::StringRep8)PUBLISH_SETTINGS_KEY_PATH_TOLERANCE, tolerance) &&
+			!tolerance.empty())
+		{
+			return atof(tolerance.c_str());
+		}
+		return PATH_SIMPLIFY_TOLERANCE;
+	}
+
+
+	OutputProfile CPublisher::GetOutputProfile(const PIFCMDictionary pDictPublishSettings)
+	{
+		std::string profile;
+
+		if (ReadString(pDictPublishSettings, (FCM::StringRep8)PUBLISH_SETTINGS_KEY_OUTPUT_PROFILE, profile))
+		{
+			if (profile == "full")
+				return FULL_OUTPUT_PROFILE;
+			if (profile == "minimal")
+				return MINIMAL_OUTPUT_PROFILE;
+		}
+		return COMPACT_OUTPUT_PROFILE;
+	}
+
+
+	int CPublisher::GetNumberPrecision(const PIFCMDictionary pDictPublishSettings, NumberClass numberClass)
+	{
+		static const char* keys[NUMBER_CLASS_COUNT] =
+		{
+			NULL,
+			PUBLISH_SETTINGS_KEY_VERTEX_PRECISION,
+			PUBLISH_SETTINGS_KEY_TRANSFORM_PRECISION,
+			PUBLISH_SETTINGS_KEY_COLOR_PRECISION,
+			PUBLISH_SETTINGS_KEY_EASE_PRECISION,
+			PUBLISH_SETTINGS_KEY_TIME_PRECISION
+		};
+		std::string decimals;
+
+		if (keys[numberClass] &&
+			ReadString(pDictPublishSettings, (FCM::StringRep8)keys[numberClass], decimals) &&
+			!decimals.empty())
+		{
+			return atoi(decimals.c_str());
+		}
+		return NumberFormatter::DefaultPrecision(numberClass);
+	}
+
+
+	FCM::Boolean CPublisher::IsImageCacheEnabled(const PIFCMDictionary pDictPublishSettings)
+	{
+		std::string imageCache;
+
+		if (ReadString(pDictPublishSettings, (FCM::StringRep8)PUBLISH_SETTINGS_KEY_IMAGE_CACHE, imageCache))
+		{
+			return (imageCache == "true");
+		}
+		return false;
+	}
+
+
+	FCM::Boolean CPublisher::IsSymbolCacheEnabled(const PIFCMDictionary pDictPublishSettings)
+	{
+		std::string symbolCache;
+
+		if (ReadString(pDictPublishSettings, (FCM::StringRep8)PUBLISH_SETTINGS_KEY_SYMBOL_CACHE, symbolCache))
+		{
+			return (symbolCache != "false");
+		}
+		return true;
+	}
+
+
+	unsigned int CPublisher::GetExportThreads(const PIFCMDictionary pDictPublishSettings)
+	{
+		std::string numThreads;
+
+		if (ReadString(pDictPublishSettings, (FCM::StringRep8)PUBLISH_SETTINGS_KEY_EXPORT_THREADS, numThreads) &&
+			!numThreads.empty())
+		{
+			int value = atoi(numThreads.c_str());
+			return (value > 0) ? (unsigned int)value : 0;
+		}
+		return ExportWorkerPool::GetDefaultNumThreads();
+	}
+
+
+	unsigned int CPublisher::GetSerializeThreads(const PIFCMDictionary pDictPublishSettings)
+	{
+		std::string numThreads;
+
+		if (ReadString(pDictPublishSettings, (FCM::StringRep8)PUBLISH_SETTINGS_KEY_SERIALIZE_THREADS, numThreads) &&
+			!numThreads.empty())
+		{
+			int value = atoi(numThreads.c_str());
+			return (value > 1) ? (unsigned int)value : 1;
+		}
+		return ParallelLoop::GetDefaultNumThreads();
+	}
+
+
+	std::string CPublisher::GetTraceFile(const PIFCMDictionary pDictPublishSettings)
+	{
+		std::string traceFile;
+
+		// Not traced unless asked for
+		ReadString(pDictPublishSettings, (FCM::StringRep8)PUBLISH_SETTINGS_KEY_TRACE_FILE, traceFile);
+		return traceFile;
+	}
+
+
+	FCM::Boolean CPublisher::IsProfilingEnabled(const PIFCMDictionary pDictPublishSettings)
+	{
+		std::string profile;
+
+		// Off by default
+		return ReadString(pDictPublishSettings, (FCM::StringRep8)PUBLISH_SETTINGS_KEY_PROFILE, profile) &&
+			profile == "true";
+	}
+
+
+	FCM::Boolean CPublisher::IsStatsFileEnabled(const PIFCMDictionary pDictPublishSettings)
+	{
+		std::string statsFile;
+
+		// Off by default
+		return ReadString(pDictPublishSettings, (FCM::StringRep8)PUBLISH_SETTINGS_KEY_STATS_FILE, statsFile) &&
+			statsFile == "true";
+	}
+
+
+	// Exports a synthetic scene through the trace replay, which drives the
+	// same palette, timeline builder and serializer code as a publish
+	FCM::Result CPublisher::RunBenchmark(
+		const std::string& sceneSpec,
+		std::string& outFile,
+		const PIFCMDictionary pDictPublishSettings)
+	{
+		SYNTHETIC_SCENE scene;
+		std::string parent;
+		std::string name;
+		std::string baselineFile;
+		FCM::Result res;
+
+		if (!SyntheticScene::Parse(sceneSpec, scene))
+		{
+			Utils::Trace(GetCallback(), "Invalid benchmark scene: %s\n", sceneSpec.c_str());
+			return FCM_INVALID_PARAM;
+		}
+
+		Utils::Trace(GetCallback(), "Benchmark scene: %u layers, %u frames, %u edges per path\n",
+			scene.layers, scene.frames, scene.edgesPerPath);
+
+		Utils::GetParent(outFile, parent);
+		Utils::GetFileNameWithoutExtension(outFile, name);
+		std::string traceFile = parent + name + ".benchmark.trace";
+
+		ReadString(pDictPublishSettings, (FCM::StringRep8)PUBLISH_SETTINGS_KEY_BENCHMARK_BASELINE, baselineFile);
+
+		PublishBenchmark benchmark(GetCallback());
+
+		benchmark.StartPhase("generate");
+		{
+			PublishTraceWriter trace;
+			if (!trace.Open(traceFile, GetCallback()))
+			{
+				return FCM_GENERAL_ERROR;
+			}
+			SyntheticScene::Write(scene, trace);
+		}
+		benchmark.EndPhase();
+
+		// The images of the scene are never encoded
+		JSONOutputWriter outputWriter(GetCallback(), false);
+		outputWriter.SetKeyframeTolerance(GetKeyframeTolerance(pDictPublishSettings));
+		outputWriter.SetPathTolerance(GetPathTolerance(pDictPublishSettings));
+		outputWriter.SetOutputProfile(GetOutputProfile(pDictPublishSettings));
+		for (int c = 0; c < NUMBER_CLASS_COUNT; c++)
+			outputWriter.SetNumberPrecision((NumberClass)c, GetNumberPrecision(pDictPublishSettings, (NumberClass)c));
+		outputWriter.SetPersistentImageCache(false);
+		outputWriter.SetSerializeThreads(GetSerializeThreads(pDictPublishSettings));
+		outputWriter.SetProfiling(IsProfilingEnabled(pDictPublishSettings), IsStatsFileEnabled(pDictPublishSettings));
+
+		res = PublishTraceReplayer::Replay(traceFile, outputWriter, outFile, GetCallback(),
+			GetCurveTolerance(pDictPublishSettings), &benchmark);
+		if (FCM_FAILURE_CODE(res))
+		{
+			return res;
+		}
+
+		std::fstream output;
+		Utils::OpenFStream(outputWriter.GetOutputJSONFilePath(), output, std::ios_base::in | std::ios_base::binary, GetCallback());
+		if (output)
+		{
+			output.seekg(0, std::ios_base::end);
+			benchmark.AddResult("output", (double)output.tellg(), "bytes");
+		}
+		benchmark.AddResult("peak_memory", PublishBenchmark::GetPeakMemory(), "KB");
+
+		FCM::U_Int32 regressions = benchmark.Report(baselineFile);
+		if (regressions > 0)
+		{
+			Utils::Trace(GetCallback(), "Benchmark: %u result(s) above the baseline\n", regressions);
+		}
+
+		return FCM_SUCCESS;
+	}
+
+
 	FCM::Result CPublisher::ShowPreview(const std::string& outFile)
 	{
 		FCM::Result res = FCM_SUCCESS;
@@ -664,9 +952,24 @@ namespace LottieExporter
 
 		m_resourceList.push_back(resourceId);
 
+		std::string name;
+		if (pName != NULL)
+		{
+			name = Utils::ToString(pName, GetCallback());
+			m_resourceNames.push_back(name);
+
+			// A symbol used by several scenes is built once; the instances of
+			// the later scenes play the composition of the first
+			if (FindLibraryResource(name, resourceId))
+			{
+				return FCM_SUCCESS;
+			}
+		}
+
+		resourceId = AddGlobalResource(resourceId);
 		if (pName != NULL)
 		{
-			m_resourceNames.push_back(Utils::ToString(pName, GetCallback()));
+			m_libraryResourceIds[name] = resourceId;
 		}
 
 		TimelineBuilder* pTimeline = static_cast<TimelineBuilder*>(pTimelineBuilder);
@@ -684,33 +987,13 @@ namespace LottieExporter
 		FCM::Result res;
 		FCM::Boolean hasFancy;
 		FCM::AutoPtr<DOM::FrameElement::IShape> pNewShape;
-        JSONOutputWriter *writer = static_cast<JSONOutputWriter*>(m_pOutputWriter);
-        LottieExporter::LottieManager *manager = writer->GetLottieManager();
-        manager->CreateGroup();
-        group * gr=manager->Getgroup();
-        manager->GetStageWidthHeight(gr->r.s.k[0], gr->r.s.k[1]);
-        gr->r.s.k[0]=gr->r.s.k[0]*2;
-        gr->r.s.k[1]=gr->r.s.k[1]*2;
-        gr->r.isrect= true;
-        gr->r.rc.k[0]=(gr->r.s.k[0]/4);
-        gr->r.rc.k[1]=(gr->r.s.k[1]/4);
-        gr->st.hasstroke = true;
-        gr->st.issolid = true;
-        gr->st.solid.color1.a=0;
-        gr->st.solid.color1.r=0;
-        gr->st.solid.color1.g=0;
-        gr->st.solid.color1.b=0;
-        gr->st.solid.color1.alpha=1;
-        gr->st.solid.lc = 1;
-        gr->st.solid.lj = 1;
-        gr->st.solid.ml = 2;
-        gr->st.solid.color1.ix = 3;
-        gr->st.solid.w.k=2;
-        manager->resource_group_map(resourceId, gr);
 
 		LOG(("[DefineShape] ResId: %d\n", resourceId));
   
 		m_resourceList.push_back(resourceId);
+		resourceId = AddGlobalResource(resourceId);
+
+        StartShape(resourceId);
        
 		m_pOutputWriter->StartDefineShape();
 
@@ -759,13 +1042,19 @@ namespace LottieExporter
 		libName = Utils::ToString(pName, GetCallback());
 		m_resourceNames.push_back(libName);
 
-		res = pMediaItem->GetMediaInfo(pUnknown.m_Ptr);
-		ASSERT(FCM_SUCCESS_CODE(res));
+		if (!FindLibraryResource(libName, resourceId))
+		{
+			resourceId = AddGlobalResource(resourceId);
+			m_libraryResourceIds[libName] = resourceId;
 
-		AutoPtr<DOM::MediaInfo::ISoundInfo> pSoundInfo = pUnknown;
-		ASSERT(pSoundInfo);
+			res = pMediaItem->GetMediaInfo(pUnknown.m_Ptr);
+			ASSERT(FCM_SUCCESS_CODE(res));
+
+			AutoPtr<DOM::MediaInfo::ISoundInfo> pSoundInfo = pUnknown;
+			ASSERT(pSoundInfo);
 
-		m_pOutputWriter->DefineSound(resourceId, libName, pMediaItem);
+			m_pOutputWriter->DefineSound(resourceId, libName, pMediaItem);
+		}
 
 		// Free the name
 		FCM::AutoPtr<FCM::IFCMUnknown> pUnkCalloc;
@@ -796,32 +1085,38 @@ namespace LottieExporter
 		std::string libItemName = Utils::ToString(pName, GetCallback());
 		m_resourceNames.push_back(libItemName);
 
-		AutoPtr<FCM::IFCMUnknown> medInfo;
-		pMediaItem->GetMediaInfo(medInfo.m_Ptr);
+		// A bitmap used by several scenes is exported once
+		if (!FindLibraryResource(libItemName, resourceId))
+		{
+			resourceId = AddGlobalResource(resourceId);
+			m_libraryResourceIds[libItemName] = resourceId;
 
-		AutoPtr<DOM::MediaInfo::IBitmapInfo> bitsInfo = medInfo;
-		ASSERT(bitsInfo);
+			AutoPtr<FCM::IFCMUnknown> medInfo;
+			pMediaItem->GetMediaInfo(medInfo.m_Ptr);
 
-		// Get image height
-		FCM::S_Int32 height;
-		res = bitsInfo->GetHeight(height);
-		ASSERT(FCM_SUCCESS_CODE(res));
+			AutoPtr<DOM::MediaInfo::IBitmapInfo> bitsInfo = medInfo;
+			ASSERT(bitsInfo);
 
-		// Get image width
-		FCM::S_Int32 width;
-		res = bitsInfo->GetWidth(width);
-		ASSERT(FCM_SUCCESS_CODE(res));
+			// Get image height
+			FCM::S_Int32 height;
+			res = bitsInfo->GetHeight(height);
+			ASSERT(FCM_SUCCESS_CODE(res));
+
+			// Get image width
+			FCM::S_Int32 width;
+			res = bitsInfo->GetWidth(width);
+			ASSERT(FCM_SUCCESS_CODE(res));
+
+			// Dump the definition of a bitmap
+			DefineBitmap(resourceId, height, width, libItemName);
+			res = m_pOutputWriter->DefineBitmap(resourceId, height, width, libItemName, pMediaItem);
+
+			// Recorded once the file name is known
+			JSONOutputWriter *writer = static_cast<JSONOutputWriter*>(m_pOutputWriter);
+			image_resource * image = writer->GetLottieManager()->Getimage_resource_with_id(resourceId);
+			writer->GetPublishTrace().RecordDefineBitmap(resourceId, height, width, libItemName, image ? image->p : std::string());
+		}
 
-		// Dump the definition of a bitmap
-        JSONOutputWriter *writer = static_cast<JSONOutputWriter*>(m_pOutputWriter);
-        LottieExporter::LottieManager *manager = writer->GetLottieManager();
-        manager->createimage_resourceid(width,  height, libItemName,resourceId);
-        image_resource * image_resource_id = manager->Getimage_resource();
-        manager->image_resource_id_map(resourceId ,image_resource_id);
-		res = m_pOutputWriter->DefineBitmap(resourceId, height, width, libItemName, pMediaItem);
-    
-   
-     
 		// Free the name
 		FCM::AutoPtr<FCM::IFCMUnknown> pUnkCalloc;
 		res = GetCallback()->GetService(SRVCID_Core_Memory, pUnkCalloc.m_Ptr);
@@ -848,6 +1143,7 @@ namespace LottieExporter
 		LOG(("[DefineClassicText] ResId: %d\n", resourceId));
 
 		m_resourceList.push_back(resourceId);
+		resourceId = AddGlobalResource(resourceId);
 
 		pTextItem = pClassicText;
 		AutoPtr<DOM::FrameElement::ITextBehaviour> textBehaviour;
@@ -934,6 +1230,9 @@ namespace LottieExporter
 	ResourcePalette::ResourcePalette()
 	{
 		m_pOutputWriter = NULL;
+		m_curveTolerance = 0;
+		m_sceneCount = 0;
+		m_nextResourceId = 1;
 	}
 
 
@@ -942,14 +1241,53 @@ namespace LottieExporter
 	}
 
 
-	void ResourcePalette::Init(IOutputWriter* pOutputWriter)
+	void ResourcePalette::Init(IOutputWriter* pOutputWriter, double curveTolerance)
 	{
 		m_pOutputWriter = pOutputWriter;
+		m_curveTolerance = curveTolerance;
 	}
 
 	void ResourcePalette::Clear()
 	{
 		m_resourceList.clear();
+		m_sceneCount = 0;
+		m_nextResourceId = 1;
+		m_libraryResourceIds.clear();
+	}
+
+	void ResourcePalette::StartScene()
+	{
+		m_resourceList.clear();
+		m_resourceNames.clear();
+		m_sceneCount++;
+	}
+
+	// The first scene keeps the ids it was given. The generator numbers the
+	// resources of every scene on its own, so the resources of later scenes
+	// get ids after all the ones in use.
+	FCM::U_Int32 ResourcePalette::AddGlobalResource(FCM::U_Int32 resourceId)
+	{
+		FCM::U_Int32 globalId = (m_sceneCount > 1) ? m_nextResourceId : resourceId;
+		if (globalId >= m_nextResourceId)
+			m_nextResourceId = globalId + 1;
+
+		if (globalId != resourceId)
+		{
+			JSONOutputWriter *writer = static_cast<JSONOutputWriter*>(m_pOutputWriter);
+			writer->GetLottieManager()->MapResourceId(resourceId, globalId);
+		}
+		return globalId;
+	}
+
+	FCM::Boolean ResourcePalette::FindLibraryResource(const std::string& name, FCM::U_Int32 resourceId)
+	{
+		std::map<std::string, FCM::U_Int32>::const_iterator found = m_libraryResourceIds.find(name);
+		if (found == m_libraryResourceIds.end())
+			return false;
+
+		JSONOutputWriter *writer = static_cast<JSONOutputWriter*>(m_pOutputWriter);
+		writer->GetLottieManager()->MapResourceId(resourceId, found->second);
+		return true;
 	}
 
 	FCM::Result ResourcePalette::HasResource(
@@ -970,36 +1308,123 @@ namespace LottieExporter
 	}
 
 
-	FCM::Result ResourcePalette::ExportFill(DOM::FrameElement::PIShape pIShape,FCM::U_Int32 resourceId)
-    {//std::cout<<"check";
-		FCM::Result res;
-		FCM::FCMListPtr pFilledRegionList;
-		FCM::AutoPtr<FCM::IFCMUnknown> pUnkSRVReg;
-		FCM::U_Int32 regionCount;
-
-		GetCallback()->GetService(DOM::FLA_REGION_GENERATOR_SERVICE, pUnkSRVReg.m_Ptr);
-		AutoPtr<DOM::Service::Shape::IRegionGeneratorService> pIRegionGeneratorService(pUnkSRVReg);
-		ASSERT(pIRegionGeneratorService);
-
-		res = pIRegionGeneratorService->GetFilledRegions(pIShape, pFilledRegionList.m_Ptr);
-		ASSERT(FCM_SUCCESS_CODE(res));
+    // Default content of a shape: a transparent rectangle twice the size of
+    // the stage
+    void ResourcePalette::StartShape(FCM::U_Int32 resourceId)
+    {
         JSONOutputWriter *writer = static_cast<JSONOutputWriter*>(m_pOutputWriter);
         LottieExporter::LottieManager *manager = writer->GetLottieManager();
-        
-        
-		pFilledRegionList->Count(regionCount);
+
+        writer->GetPublishTrace().RecordDefineShape(resourceId);
+
+        int width, height;
+        manager->GetStageWidthHeight(width, height);
+
+        manager->CreateGroup();
+        group * gr=manager->Getgroup();
+        gr->r.s.k[0]=width*2;
+        gr->r.s.k[1]=height*2;
+        gr->r.isrect= true;
+        gr->r.rc.k[0]=width/2;
+        gr->r.rc.k[1]=height/2;
+        gr->st.hasstroke = true;
+        gr->st.issolid = true;
+        gr->st.solid.color1.a=0;
+        gr->st.solid.color1.r=0;
+        gr->st.solid.color1.g=0;
+        gr->st.solid.color1.b=0;
+        gr->st.solid.color1.alpha=1;
+        gr->st.solid.lc = 1;
+        gr->st.solid.lj = 1;
+        gr->st.solid.ml = 2;
+        gr->st.solid.color1.ix = 3;
+        gr->st.solid.w.k=2;
+        manager->resource_group_map(resourceId, gr);
+    }
+
+
+    void ResourcePalette::StartFillRegion(FCM::U_Int32 resourceId)
+    {
+        JSONOutputWriter *writer = static_cast<JSONOutputWriter*>(m_pOutputWriter);
+        LottieExporter::LottieManager *manager = writer->GetLottieManager();
+
+        writer->GetPublishTrace().RecordFillRegion(resourceId);
+
+        manager->CreateGroup();
+        group * gr=manager->Getgroup();
+        manager->resource_group_map(resourceId, gr);
+        gr->fl.isfilled = true;
+    }
+
+
+    void ResourcePalette::StartStrokePath(FCM::U_Int32 resourceId)
+    {
+        JSONOutputWriter *writer = static_cast<JSONOutputWriter*>(m_pOutputWriter);
+        LottieExporter::LottieManager *manager = writer->GetLottieManager();
+
+        writer->GetPublishTrace().RecordStrokePath(resourceId);
+
+        manager->CreateGroup();
+        group * gr=manager->Getgroup();
+        manager->resource_group_map(resourceId, gr);
+        gr->st.hasstroke=true;
+    }
+
+
+    void ResourcePalette::StartHoles(FCM::U_Int32 resourceId)
+    {
+        JSONOutputWriter *writer = static_cast<JSONOutputWriter*>(m_pOutputWriter);
+        LottieExporter::LottieManager *manager = writer->GetLottieManager();
+
+        writer->GetPublishTrace().RecordHoles(resourceId);
+
+        // The holes become more paths of the region, which they cut out of
+        // the fill with the even-odd rule; no mask is needed
+        group * gr=manager->Getgroup();
+        gr->fl.solid.r = 2;
+        gr->fl.linear.r = 2;
+        gr->fl.radial.radial_fill.r = 2;
+    }
+
+
+    void ResourcePalette::DefineBitmap(
+        FCM::U_Int32 resourceId,
+        FCM::S_Int32 height,
+        FCM::S_Int32 width,
+        const std::string& libPathName)
+    {
+        JSONOutputWriter *writer = static_cast<JSONOutputWriter*>(m_pOutputWriter);
+        LottieExporter::LottieManager *manager = writer->GetLottieManager();
+
+        manager->createimage_resourceid(width,  height, libPathName,resourceId);
+        image_resource * image_resource_id = manager->Getimage_resource();
+        manager->image_resource_id_map(resourceId ,image_resource_id);
+    }
+
+
+	FCM::Result ResourcePalette::ExportFill(DOM::FrameElement::PIShape pIShape,FCM::U_Int32 resourceId)
+    {//std::cout<<"check";
+		FCM::Result res;
+		FCM::FCMListPtr pFilledRegionList;
+		FCM::AutoPtr<FCM::IFCMUnknown> pUnkSRVReg;
+		FCM::U_Int32 regionCount;
+
+		GetCallback()->GetService(DOM::FLA_REGION_GENERATOR_SERVICE, pUnkSRVReg.m_Ptr);
+		AutoPtr<DOM::Service::Shape::IRegionGeneratorService> pIRegionGeneratorService(pUnkSRVReg);
+		ASSERT(pIRegionGeneratorService);
+
+		{
+			ProfileScope scope(GetProfiler(), PROFILE_PHASE_REGIONS);
+			res = pIRegionGeneratorService->GetFilledRegions(pIShape, pFilledRegionList.m_Ptr);
+		}
+		ASSERT(FCM_SUCCESS_CODE(res));
+
+		pFilledRegionList->Count(regionCount);
 
 		for (FCM::U_Int32 j = 0; j < regionCount; j++)
-        { //std::cout<<j;
-            manager->CreateGroup();
+        {
+            StartFillRegion(resourceId);
 
-            group * gr=manager->Getgroup();
-            
-              manager->resource_group_map(resourceId, gr);
-            
-            
-            //std::cout<<"GROUP"<<j<<"created with parent layer"<<gr->parent_layer<<std::endl;
-            gr->fl.isfilled = true;
 			FCM::AutoPtr<DOM::Service::Shape::IFilledRegion> pFilledRegion = pFilledRegionList[j];
 			FCM::AutoPtr<DOM::Service::Shape::IPath> pPath;
             
@@ -1033,12 +1458,8 @@ namespace LottieExporter
 
 			res = pHoleList->Count(holeCount);
 			ASSERT(FCM_SUCCESS_CODE(res));
-            if(holeCount){
-                 gr=manager->Getgroup();
-                 manager->DeleteLastGroup(resourceId);
-                 manager->CreateHoleLayer(gr);
-                hole_layer * hole_layer=manager->Getholelayer();
-                manager->hole_layer_resource_id_map(resourceId,hole_layer);}
+            if(holeCount)
+                StartHoles(resourceId);
 			for (FCM::U_Int32 k = 0; k < holeCount; k++)
 			{
 				FCM::FCMListPtr pEdgeList;
@@ -1130,242 +1551,208 @@ namespace LottieExporter
         
     }
     
-    std::vector<DOM::Utils::SEGMENT> interpolateSegmentList(std::vector<DOM::Utils::SEGMENT> segmentListSrc)
+    // Adds a quadratic segment, split in halves until it stays within
+    // 'tolerance' of its chord. A quad bulges |anchor1 - 2 * control + anchor2| / 4
+    // away from its chord and every split divides that by four.
+    static void AddQuadSegment(
+        const DOM::Utils::SEGMENT& segment,
+        double tolerance,
+        int depth,
+        std::vector<DOM::Utils::SEGMENT>& segments)
     {
-        std::vector<DOM::Utils::SEGMENT> retSegmentList;
-        DOM::Utils::SEGMENT splitSegment1;
-        DOM::Utils::SEGMENT splitSegment2;
-        
-        for (std::vector<DOM::Utils::SEGMENT>::iterator seg = segmentListSrc.begin() ; seg != segmentListSrc.end(); ++seg)
+        const DOM::Utils::QUAD_BEZIER_CURVE& quad = segment.quadBezierCurve;
+        double dx = quad.anchor1.x - 2.0 * quad.control.x + quad.anchor2.x;
+        double dy = quad.anchor1.y - 2.0 * quad.control.y + quad.anchor2.y;
+
+        if (tolerance <= 0 || depth >= MAX_CURVE_SPLIT_DEPTH ||
+            (dx * dx + dy * dy) <= 16.0 * tolerance * tolerance)
+        {
+            segments.push_back(segment);
+            return;
+        }
+
+        AddQuadSegment(splitSegment(segment, 0.5, true), tolerance, depth + 1, segments);
+        AddQuadSegment(splitSegment(segment, 0.5, false), tolerance, depth + 1, segments);
+    }
+
+    // Appends the segments to a Lottie path. Quadratic segments are elevated
+    // to cubics, which is exact.
+    static void AddSegmentsToPath(const std::vector<DOM::Utils::SEGMENT>& segments, ks& path)
+    {
+        coordinates q_c;
+        coordinates anchor1 = {0, 0}, anchor2 = {0, 0}, c_c1, c_c2;
+
+        for (std::uint32_t l = 0; l < segments.size(); l++)
         {
-            if(seg->segmentType == DOM::Utils::QUAD_BEZIER_SEGMENT)
+            const DOM::Utils::SEGMENT& segment = segments[l];
+            if(segment.segmentType == DOM::Utils::LINE_SEGMENT)
             {
-                splitSegment1 = splitSegment(*seg,0.5, false);
-                splitSegment2 = splitSegment(*seg,0.5, true);
-                retSegmentList.push_back(splitSegment2);
-                retSegmentList.push_back(splitSegment1);
+                anchor1={segment.line.endPoint1.x,segment.line.endPoint1.y};
+                anchor2={segment.line.endPoint2.x,segment.line.endPoint2.y};
+                c_c1={anchor1.x,anchor1.y};
+                c_c2={anchor2.x,anchor2.y};
             }
             else
             {
-                retSegmentList.push_back(*seg);
+                q_c={segment.quadBezierCurve.control.x,segment.quadBezierCurve.control.y};
+                anchor1={segment.quadBezierCurve.anchor1.x,segment.quadBezierCurve.anchor1.y};
+                anchor2={segment.quadBezierCurve.anchor2.x,segment.quadBezierCurve.anchor2.y};
+                c_c1.x= (anchor1.x+((2.0f/3.0f) * (double)(q_c.x - anchor1.x)));
+                c_c1.y=(anchor1.y +((2.0f/3.0f) * (double)(q_c.y - anchor1.y)));
+                c_c2.x= (anchor2.x+((2.0f/3.0f) * (double)(q_c.x - anchor2.x)));
+                c_c2.y=(anchor2.y +((2.0f/3.0f) * (double)(q_c.y - anchor2.y)));
             }
+
+            c_c1.x=(anchor1.x - c_c1.x);
+            c_c1.y=(anchor1.y - c_c1.y);
+            c_c2.x= (anchor2.x - c_c2.x);
+            c_c2.y=(anchor2.y - c_c2.y);
+            path.i.push_back(c_c1);
+            path.o.push_back(c_c2);
+            path.v.push_back(anchor1);
         }
-        
-        return retSegmentList;
+
+        if((anchor2.x==path.v[0].x) && (anchor2.y==path.v[0].y))
+            path.c=true;
+        else
+        {
+            path.c=false;
+            path.v.push_back(anchor2);
+            c_c1={0,0};c_c2={0,0};
+            path.i.push_back(c_c1);
+            path.o.push_back(c_c2);
+        }
+
+        std::uint32_t size=path.o.size();
+        coordinates temp={path.o[size-1].x,path.o[size-1].y};
+        path.o.pop_back();
+        path.o.insert(path.o.begin(), temp);
     }
-    
-    std::vector<DOM::Utils::SEGMENT> getSegmentList(DOM::Service::Shape::PIPath pPath)
+
+    // Makes the group draw a rectangle or an ellipse, upright and turned by
+    // the group transform. d is 1 for clockwise paths and 3 otherwise, as
+    // the winding matters once several paths share a fill.
+    static void SetPrimitive(const ShapeRecognizer::Primitive& primitive, group* gr)
+    {
+        int direction = primitive.clockwise ? 1 : 3;
+
+        if (primitive.kind == ShapeRecognizer::RECTANGLE)
+        {
+            gr->r.isrect = true;
+            gr->r.d = direction;
+            gr->r.s.k[0] = primitive.size[0];
+            gr->r.s.k[1] = primitive.size[1];
+            gr->r.rc.k[0] = primitive.centre[0];
+            gr->r.rc.k[1] = primitive.centre[1];
+            gr->r.r.k = primitive.roundness;
+        }
+        else
+        {
+            gr->el.isellipse = true;
+            gr->el.d = direction;
+            gr->el.s.k[0] = primitive.size[0];
+            gr->el.s.k[1] = primitive.size[1];
+            gr->el.p.k[0] = primitive.centre[0];
+            gr->el.p.k[1] = primitive.centre[1];
+        }
+        gr->shape_angle = primitive.angle;
+    }
+
+    // Reads the edges of the path into m_edges, which is reused from one
+    // path to the next
+    FCM::Result ResourcePalette::GetSegments(DOM::Service::Shape::PIPath pPath)
     {
-        std::vector<DOM::Utils::SEGMENT> segmentList;
         FCM::U_Int32 edgeCount;
         DOM::Utils::SEGMENT segment;
         FCM::FCMListPtr pEdgeList;
         FCM::AutoPtr<DOM::Service::Shape::IEdge> pEdge;
-        
+        ProfileScope scope(GetProfiler(), PROFILE_PHASE_SEGMENT_READ);
+
+        m_edges.clear();
+
         FCM::Result res = pPath->GetEdges(pEdgeList.m_Ptr);
         ASSERT(FCM_SUCCESS_CODE(res));
-        
-        segment.structSize = sizeof(DOM::Utils::SEGMENT);
+
         res = pEdgeList->Count(edgeCount);
         ASSERT(FCM_SUCCESS_CODE(res));
+
+        m_edges.reserve(edgeCount);
         for (FCM::U_Int32 l = 0; l < edgeCount; l++)
         {
-            //DOM::Utils::SEGMENT segment;
             segment.structSize = sizeof(DOM::Utils::SEGMENT);
             pEdge = pEdgeList[l];
             res = pEdge->GetSegment(segment);
             ASSERT(FCM_SUCCESS_CODE(res));
-            
-            segmentList.push_back(segment);
-            
+
+            m_edges.push_back(segment);
         }
-        
-        return segmentList;
+
+        return res;
     }
-    
+
 
 	FCM::Result ResourcePalette::ExportPath(DOM::Service::Shape::PIPath pPath , FCM::Boolean ishole)
 	{
-        
-        FCM::Result res;
-        FCM::U_Int32 edgeCount;
-        FCM::FCMListPtr pEdgeList;
-        std::vector<DOM::Utils::SEGMENT> pSegmentList;
-        pSegmentList = getSegmentList(pPath);
-        
-        for(int i=0;i < mCurveFactor ; i++)
-        {
-            pSegmentList = interpolateSegmentList(pSegmentList);
-        }
-        res = pPath->GetEdges(pEdgeList.m_Ptr);
-        ASSERT(FCM_SUCCESS_CODE(res));
-        
-        /*res = pEdgeList->Count(edgeCount);
-         ASSERT(FCM_SUCCESS_CODE(res));*/
-        
-        edgeCount = pSegmentList.size();
-        
+        FCM::Result res = GetSegments(pPath);
+
+        AddPath(m_edges, ishole);
+
+        return res;
+	}
+
+    void ResourcePalette::AddPath(const std::vector<DOM::Utils::SEGMENT>& edges, FCM::Boolean ishole)
+    {
         JSONOutputWriter *writer = static_cast<JSONOutputWriter*>(m_pOutputWriter);
         LottieExporter::LottieManager *manager = writer->GetLottieManager();
-        coordinates q_c;coordinates outv;coordinates anchor1,anchor2, c_c1, c_c2;
-        group * gr=manager->Getgroup();
 
-        std::uint32_t size,m_size;
-        if(!ishole){
-		for (FCM::U_Int32 l = 0; l < edgeCount; l++)
-		{
-            
-			DOM::Utils::SEGMENT segment;
-			/*segment.structSize = sizeof(DOM::Utils::SEGMENT);
-			FCM::AutoPtr<DOM::Service::Shape::IEdge> pEdge = pEdgeList[l];
-			res = pEdge->GetSegment(segment);
- 			m_pOutputWriter->SetSegment(segment);*/
-            segment = pSegmentList[l];
-            if(segment.segmentType == DOM::Utils::LINE_SEGMENT)
+        writer->GetPublishTrace().RecordPath(edges, ishole);
+
+        ProfileScope scope(writer->GetProfiler(), PROFILE_PHASE_SEGMENT_CONVERSION);
+
+        const std::vector<DOM::Utils::SEGMENT>& simplified = writer->GetPathTolerance() >= 0 ?
+            m_pathSimplifier.Simplify(edges, writer->GetPathTolerance()) : edges;
+
+        m_segments.clear();
+        m_segments.reserve(simplified.size());
+        for (std::uint32_t l = 0; l < simplified.size(); l++)
+        {
+            if (simplified[l].segmentType == DOM::Utils::QUAD_BEZIER_SEGMENT)
             {
-              
-                anchor1={segment.line.endPoint1.x,segment.line.endPoint1.y};
-                anchor2={segment.line.endPoint2.x,segment.line.endPoint2.y};
-                c_c1={anchor1.x,anchor1.y};
-                c_c2={anchor2.x,anchor2.y};
-     
+                AddQuadSegment(simplified[l], m_curveTolerance, 0, m_segments);
             }
-            else if(segment.segmentType == DOM::Utils::QUAD_BEZIER_SEGMENT) {
-            q_c={segment.quadBezierCurve.control.x,segment.quadBezierCurve.control.y};
-            //anchor1={segment.quadBezierCurve.anchor1.x,segment.quadBezierCurve.anchor1.y};
-            //anchor2={segment.quadBezierCurve.anchor2.x,segment.quadBezierCurve.anchor2.y};
-            //std::cout<<" CONTROL POINT QUAD "<<q_c.x<<" , "<<q_c.y<<std::endl;
-                anchor1={segment.quadBezierCurve.anchor1.x,segment.quadBezierCurve.anchor1.y};
-               // std::cout<<" ANCHOR 1 "<<anchor1.x<<" , "<<anchor1.y<<std::endl;
-                anchor2={segment.quadBezierCurve.anchor2.x,segment.quadBezierCurve.anchor2.y};
-             //   std::cout<<" ANCHOR 2 "<<anchor2.x<<" , "<<anchor2.y<<std::endl;
-              //  std::cout<<"after conversion control points are"<<std::endl;
-                c_c1.x= (anchor1.x+((2.0f/3.0f) * (double)(q_c.x - anchor1.x)));
-                c_c1.y=(anchor1.y +((2.0f/3.0f) * (double)(q_c.y - anchor1.y)));
-               // std::cout<<" CONTROL POINT QUAD "<<std::endl;
-                c_c2.x= (anchor2.x+((2.0f/3.0f) * (double)(q_c.x - anchor2.x)));
-                c_c2.y=(anchor2.y +((2.0f/3.0f) * (double)(q_c.y - anchor2.y)));
-                
-
-            c_c1.x= (anchor1.x+((2.0f/3.0f) * (double)(q_c.x - anchor1.x)));
-            c_c1.y=(anchor1.y +((2.0f/3.0f) * (double)(q_c.y - anchor1.y)));
-              //    std::cout<<" control 1 "<<c_c1.x<<" , "<<c_c1.y<<std::endl;
-            c_c2.x= (anchor2.x+((2.0f/3.0f) * (double)(q_c.x - anchor2.x)));
-            c_c2.y=(anchor2.y +((2.0f/3.0f) * (double)(q_c.y - anchor2.y)));
+            else
+            {
+                m_segments.push_back(simplified[l]);
             }
-   
-            c_c1.x=(anchor1.x - c_c1.x);
-            c_c1.y=(anchor1.y - c_c1.y);
-            c_c2.x= (anchor2.x - c_c2.x);
-            c_c2.y=(anchor2.y - c_c2.y);
-            gr->sh.shp.i.push_back(c_c1);
-            gr->sh.shp.o.push_back(c_c2);
-            gr->sh.shp.v.push_back(anchor1);
+        }
 
-		}
-        if((anchor2.x==gr->sh.shp.v[0].x) && (anchor2.y==gr->sh.shp.v[0].y))
-            gr->sh.shp.c=true;
-        else
+        if (m_segments.empty())
         {
-            gr->sh.shp.c=false;
-            gr->sh.shp.v.push_back(anchor2);
-            c_c1={0,0};c_c2={0,0};
-            gr->sh.shp.i.push_back(c_c1);
-            gr->sh.shp.o.push_back(c_c2);
-    
-        }
-            
-        size=gr->sh.shp.o.size();
-        coordinates temp={gr->sh.shp.o[size-1].x,gr->sh.shp.o[size-1].y};
-        gr->sh.shp.o.pop_back();
-        gr->sh.shp.o.insert(gr->sh.shp.o.begin(), temp);
+            return;
         }
-        
-        else
+
+        if(!ishole)
         {
-            hole_layer * hole_layer=manager->Getholelayer();
-            hole_layer->mp.push_back(new maskproperties);
-            m_size = hole_layer->mp.size();
+            group * gr=manager->Getgroup();
+            AddSegmentsToPath(m_segments, gr->sh.shp);
+            writer->GetProfiler().AddCount(PROFILE_COUNTER_VERTICES, gr->sh.shp.v.size());
 
-            for (FCM::U_Int32 l = 0; l < edgeCount; l++)
-            {
-                
-                DOM::Utils::SEGMENT segment;
-                /*segment.structSize = sizeof(DOM::Utils::SEGMENT);
-                 FCM::AutoPtr<DOM::Service::Shape::IEdge> pEdge = pEdgeList[l];
-                 res = pEdge->GetSegment(segment);
-                 m_pOutputWriter->SetSegment(segment);*/
-                segment = pSegmentList[l];
-                if(segment.segmentType == DOM::Utils::LINE_SEGMENT)
-                {
-                    
-                    anchor1={segment.line.endPoint1.x,segment.line.endPoint1.y};
-                    anchor2={segment.line.endPoint2.x,segment.line.endPoint2.y};
-                    c_c1={anchor1.x,anchor1.y};
-                    c_c2={anchor2.x,anchor2.y};
-                    
-                }
-                else if(segment.segmentType == DOM::Utils::QUAD_BEZIER_SEGMENT) {
-                    q_c={segment.quadBezierCurve.control.x,segment.quadBezierCurve.control.y};
-                    //anchor1={segment.quadBezierCurve.anchor1.x,segment.quadBezierCurve.anchor1.y};
-                    //anchor2={segment.quadBezierCurve.anchor2.x,segment.quadBezierCurve.anchor2.y};
-                    //std::cout<<" CONTROL POINT QUAD "<<q_c.x<<" , "<<q_c.y<<std::endl;
-                    anchor1={segment.quadBezierCurve.anchor1.x,segment.quadBezierCurve.anchor1.y};
-                    // std::cout<<" ANCHOR 1 "<<anchor1.x<<" , "<<anchor1.y<<std::endl;
-                    anchor2={segment.quadBezierCurve.anchor2.x,segment.quadBezierCurve.anchor2.y};
-                    //   std::cout<<" ANCHOR 2 "<<anchor2.x<<" , "<<anchor2.y<<std::endl;
-                    //  std::cout<<"after conversion control points are"<<std::endl;
-                    c_c1.x= (anchor1.x+((2.0f/3.0f) * (double)(q_c.x - anchor1.x)));
-                    c_c1.y=(anchor1.y +((2.0f/3.0f) * (double)(q_c.y - anchor1.y)));
-                    // std::cout<<" CONTROL POINT QUAD "<<std::endl;
-                    c_c2.x= (anchor2.x+((2.0f/3.0f) * (double)(q_c.x - anchor2.x)));
-                    c_c2.y=(anchor2.y +((2.0f/3.0f) * (double)(q_c.y - anchor2.y)));
-                    
-                    
-                    c_c1.x= (anchor1.x+((2.0f/3.0f) * (double)(q_c.x - anchor1.x)));
-                    c_c1.y=(anchor1.y +((2.0f/3.0f) * (double)(q_c.y - anchor1.y)));
-                    //    std::cout<<" control 1 "<<c_c1.x<<" , "<<c_c1.y<<std::endl;
-                    c_c2.x= (anchor2.x+((2.0f/3.0f) * (double)(q_c.x - anchor2.x)));
-                    c_c2.y=(anchor2.y +((2.0f/3.0f) * (double)(q_c.y - anchor2.y)));
-                    //  std::cout<<" control 1 "<<c_c2.x<<" , "<<c_c2.y<<std::endl;
-                    
-                }
-                
-                c_c1.x=(anchor1.x - c_c1.x);
-                c_c1.y=(anchor1.y - c_c1.y);
-                c_c2.x= (anchor2.x - c_c2.x);
-                c_c2.y=(anchor2.y - c_c2.y);
-
-                hole_layer->mp[m_size-1]->pt.i.push_back(c_c1);
-                hole_layer->mp[m_size-1]->pt.o.push_back(c_c2);
-                hole_layer->mp[m_size-1]->pt.v.push_back(anchor1);
-   
-            }
-            if((anchor2.x== hole_layer->mp[m_size-1]->pt.v[0].x) && (anchor2.y== hole_layer->mp[m_size-1]->pt.v[0].y))
-                hole_layer->mp[m_size-1]->pt.c=true;
-            else
+            // The path is kept as well, for the shape tweens
+            ShapeRecognizer::Primitive primitive;
+            if (writer->GetPathTolerance() >= 0 &&
+                m_shapeRecognizer.Recognize(simplified, writer->GetPathTolerance(), primitive))
             {
-                hole_layer->mp[m_size-1]->pt.c=false;
-                hole_layer->mp[m_size-1]->pt.v.push_back(anchor2);
-                c_c1={0,0};c_c2={0,0};
-                hole_layer->mp[m_size-1]->pt.i.push_back(c_c1);
-                hole_layer->mp[m_size-1]->pt.o.push_back(c_c2);
-
+                SetPrimitive(primitive, gr);
             }
-            
-            size=hole_layer->mp[m_size-1]->pt.o.size();
-            coordinates temp={hole_layer->mp[m_size-1]->pt.o[size-1].x,hole_layer->mp[m_size-1]->pt.o[size-1].y};
-            hole_layer->mp[m_size-1]->pt.o.pop_back();
-            hole_layer->mp[m_size-1]->pt.o.insert(hole_layer->mp[m_size-1]->pt.o.begin(), temp);
-            hole_layer->mp[m_size-1]->mode="s";
-            hole_layer->mp[m_size-1]->inv=false;
-            hole_layer->mp[m_size-1]->pt.ix=1;
-            std::string hole_num = std::to_string(m_size);
-            hole_layer->mp[m_size-1]->nm.append(hole_num);
         }
-
-        return res;
-	}
+        else
+        {
+            group * gr=manager->Getgroup();
+            gr->holes.push_back(ks());
+            AddSegmentsToPath(m_segments, gr->holes.back());
+            writer->GetProfiler().AddCount(PROFILE_COUNTER_VERTICES, gr->holes.back().v.size());
+        }
+    }
 
 	FCM::Result ResourcePalette::ExportFillStyle(FCM::PIFCMUnknown pFillStyle)
 	{
@@ -1425,7 +1812,10 @@ namespace LottieExporter
 		AutoPtr<DOM::Service::Shape::IRegionGeneratorService> pIRegionGeneratorService(pUnkSRVReg);
 		ASSERT(pIRegionGeneratorService);
 
-		res = pIRegionGeneratorService->GetStrokeGroups(pIShape, pStrokeGroupList.m_Ptr);
+		{
+			ProfileScope scope(GetProfiler(), PROFILE_PHASE_REGIONS);
+			res = pIRegionGeneratorService->GetStrokeGroups(pIShape, pStrokeGroupList.m_Ptr);
+		}
 		ASSERT(FCM_SUCCESS_CODE(res));
 
 		res = pStrokeGroupList->Count(strokeStyleCount);
@@ -1457,25 +1847,15 @@ namespace LottieExporter
 
 			res = pPathList->Count(pathCount);
 			ASSERT(FCM_SUCCESS_CODE(res));
-            JSONOutputWriter *writer = static_cast<JSONOutputWriter*>(m_pOutputWriter);
-            LottieExporter::LottieManager *manager = writer->GetLottieManager();
-            
-            
-
 
 			for (FCM::U_Int32 k = 0; k < pathCount; k++)
 			{
-                manager->CreateGroup();
+                StartStrokePath(resourceId);
 				FCM::AutoPtr<DOM::Service::Shape::IPath> pPath;
 
 				pPath = pPathList[k];
 				ASSERT(pPath);
-                
-                group * gr=manager->Getgroup();
-                 manager->resource_group_map(resourceId, gr);
-                
-                gr->st.hasstroke=true;
-                
+
 				res = m_pOutputWriter->StartDefineStroke();
 				ASSERT(FCM_SUCCESS_CODE(res));
 
@@ -1572,6 +1952,11 @@ namespace LottieExporter
 		return FCM_SUCCESS;
 	}
 
+	PublishProfiler& ResourcePalette::GetProfiler()
+	{
+		return static_cast<JSONOutputWriter*>(m_pOutputWriter)->GetProfiler();
+	}
+
 	FCM::Result ResourcePalette::ExportStrokeStyle(FCM::PIFCMUnknown pStrokeStyle)
 	{
 		FCM::Result res = FCM_SUCCESS;
@@ -1601,21 +1986,15 @@ namespace LottieExporter
 		DOM::StrokeStyle::JOIN_STYLE joinStyle;
 		DOM::Utils::ScaleType scaleType;
 		FCM::Boolean strokeHinting;
-        JSONOutputWriter *writer = static_cast<JSONOutputWriter*>(m_pOutputWriter);
-        LottieExporter::LottieManager *manager = writer->GetLottieManager();
-        
-        group * gr=manager->Getgroup();
-        gr->st.issolid=true;
+
 		capStyle.structSize = sizeof(DOM::StrokeStyle::CAP_STYLE);
 		res = pSolidStrokeStyle->GetCapStyle(capStyle);
 		ASSERT(FCM_SUCCESS_CODE(res));
-        gr->st.solid.lc=capStyle.type + 1;
+
 		joinStyle.structSize = sizeof(DOM::StrokeStyle::JOIN_STYLE);
 		res = pSolidStrokeStyle->GetJoinStyle(joinStyle);
 		ASSERT(FCM_SUCCESS_CODE(res));
-        gr->st.solid.lj=joinStyle.type + 1;
-        if(gr->st.solid.lj == 1)
-            gr->st.solid.ml = joinStyle.miterJoinProp.miterLimit;
+
 		res = pSolidStrokeStyle->GetThickness(thickness);
 		ASSERT(FCM_SUCCESS_CODE(res));
 
@@ -1623,8 +2002,16 @@ namespace LottieExporter
 		{
 			thickness = 0.1;
 		}
-        gr->st.solid.w.k = thickness ;
-    
+
+        // Lottie line caps and joins count from 1; the miter limit is only
+        // meaningful for miter joins
+        FCM::U_Int32 lineJoin = joinStyle.type + 1;
+        SetSolidStroke(
+            thickness,
+            capStyle.type + 1,
+            lineJoin,
+            (lineJoin == 1) ? joinStyle.miterJoinProp.miterLimit : 0);
+
 		res = pSolidStrokeStyle->GetScaleType(scaleType);
 		ASSERT(FCM_SUCCESS_CODE(res));
 
@@ -1653,6 +2040,27 @@ namespace LottieExporter
 	}
 
 
+    void ResourcePalette::SetSolidStroke(
+        FCM::Double thickness,
+        FCM::U_Int32 lineCap,
+        FCM::U_Int32 lineJoin,
+        FCM::Double miterLimit)
+    {
+        JSONOutputWriter *writer = static_cast<JSONOutputWriter*>(m_pOutputWriter);
+        LottieExporter::LottieManager *manager = writer->GetLottieManager();
+
+        writer->GetPublishTrace().RecordSolidStroke(thickness, lineCap, lineJoin, miterLimit);
+
+        group * gr=manager->Getgroup();
+        gr->st.issolid=true;
+        gr->st.solid.lc=lineCap;
+        gr->st.solid.lj=lineJoin;
+        if(gr->st.solid.lj == 1)
+            gr->st.solid.ml = miterLimit;
+        gr->st.solid.w.k = thickness;
+    }
+
+
 	FCM::Result ResourcePalette::ExportSolidFillStyle(DOM::FillStyle::ISolidFillStyle* pSolidFillStyle)
 	{
 		FCM::Result res;
@@ -1663,9 +2071,23 @@ namespace LottieExporter
 
 		res = solidFill->GetColor(color);
 		ASSERT(FCM_SUCCESS_CODE(res));
+
+        SetSolidColor(color);
+
+		m_pOutputWriter->DefineSolidFillStyle(color);
+        
+		return res;
+	}
+
+
+    // Color of the fill of the current group or, in a stroke, of the stroke
+    void ResourcePalette::SetSolidColor(const DOM::Utils::COLOR& color)
+    {
         JSONOutputWriter *writer = static_cast<JSONOutputWriter*>(m_pOutputWriter);
         LottieExporter::LottieManager *manager = writer->GetLottieManager();
-        
+
+        writer->GetPublishTrace().RecordSolidColor(color);
+
         group * gr=manager->Getgroup();
         if(gr->fl.isfilled){
         gr->fl.issolid=true;
@@ -1684,13 +2106,8 @@ namespace LottieExporter
             gr->st.solid.color1.b =((double)(color.blue / 255.0));
             gr->st.solid.color1.ix=3;
             gr->st.solid.o.ix=4;
-  
         }
-     
-		m_pOutputWriter->DefineSolidFillStyle(color);
-        
-		return res;
-	}
+    }
 
 
 	FCM::Result ResourcePalette::ExportRadialGradientFillStyle(DOM::FillStyle::IGradientFillStyle* pGradientFillStyle)
@@ -1719,9 +2136,40 @@ namespace LottieExporter
 
 		res = m_pOutputWriter->StartDefineRadialGradientFillStyle(spread, matrix, focalPoint);
 		ASSERT(FCM_SUCCESS_CODE(res));
+
+		FCM::U_Int8 nColors;
+		res = radialColorGradient->GetKeyColorCount(nColors);
+		ASSERT(FCM_SUCCESS_CODE(res));
+
+		std::vector<DOM::Utils::GRADIENT_COLOR_POINT> colorPoints(nColors);
+		for (FCM::U_Int8 i = 0; i < nColors; i++)
+		{
+			res = radialColorGradient->GetKeyColorAtIndex(i, colorPoints[i]);
+			ASSERT(FCM_SUCCESS_CODE(res));
+
+			res = m_pOutputWriter->SetKeyColorPoint(colorPoints[i]);
+			ASSERT(FCM_SUCCESS_CODE(res));
+		}
+
+        SetRadialGradient(matrix, focalPoint, colorPoints);
+
+		res = m_pOutputWriter->EndDefineRadialGradientFillStyle();
+		ASSERT(FCM_SUCCESS_CODE(res));
+
+		return res;
+	}
+
+
+    void ResourcePalette::SetRadialGradient(
+        const DOM::Utils::MATRIX2D& matrix,
+        FCM::S_Int32 focalPoint,
+        const std::vector<DOM::Utils::GRADIENT_COLOR_POINT>& colorPoints)
+    {
         JSONOutputWriter *writer = static_cast<JSONOutputWriter*>(m_pOutputWriter);
         LottieExporter::LottieManager *manager = writer->GetLottieManager();
-        
+
+        writer->GetPublishTrace().RecordRadialGradient(matrix, focalPoint, colorPoints);
+
         group * gr=manager->Getgroup();
         static const FCM::Float GRADIENT_VECTOR_CONSTANT = 16384.0;
         
@@ -1751,15 +2199,8 @@ namespace LottieExporter
         FCM::Float angle = atan2(yd, xd);
         gr->fl.radial.a.k = angle;
         gr->fl.radial.h.k = r;
-        
-        
-        
-        
-
-		FCM::U_Int8 nColors;
-		res = radialColorGradient->GetKeyColorCount(nColors);
-		ASSERT(FCM_SUCCESS_CODE(res));
 
+        FCM::U_Int8 nColors = (FCM::U_Int8)colorPoints.size();
         gr->fl.isfilled=true;
         gr->fl.isradial_gradient=true;
         gr->fl.radial.radial_fill.type=2;
@@ -1772,10 +2213,8 @@ namespace LottieExporter
 
 		for (FCM::U_Int8 i = 0; i < nColors; i++)
 		{
-			DOM::Utils::GRADIENT_COLOR_POINT point;
+			const DOM::Utils::GRADIENT_COLOR_POINT& point = colorPoints[i];
 
-			res = radialColorGradient->GetKeyColorAtIndex(i, point);
-			ASSERT(FCM_SUCCESS_CODE(res));
             gr->fl.radial.radial_fill.g.k.color.push_back((float)((point.pos) / 255.0));
             gr->fl.radial.radial_fill.g.k.color.push_back(double(point.color.red)/255.0);
             gr->fl.radial.radial_fill.g.k.color.push_back(double(point.color.green)/255.0);
@@ -1788,18 +2227,8 @@ namespace LottieExporter
                 alpha_value.pos = i;
                 opacity.push_back(alpha_value);
             }
-       
-			res = m_pOutputWriter->SetKeyColorPoint(point);
-			ASSERT(FCM_SUCCESS_CODE(res));
 		}
-        
-        
 
-       
-        
-        
-		res = m_pOutputWriter->EndDefineRadialGradientFillStyle();
-		ASSERT(FCM_SUCCESS_CODE(res));
         if(opacity.size()!=0)
         {
             for(int j=0;j<(2*nColors);j++)
@@ -1808,10 +2237,7 @@ namespace LottieExporter
                 gr->fl.linear.g.k.color.insert(gr->fl.linear.g.k.color.end()+ opacity[j].pos , opacity[j].alpha);
             
         }
-        
-
-		return res;
-	}
+    }
 
 
 	FCM::Result ResourcePalette::ExportLinearGradientFillStyle(DOM::FillStyle::IGradientFillStyle* pGradientFillStyle)
@@ -1839,11 +2265,37 @@ namespace LottieExporter
 		FCM::U_Int8 nColors;
 		res = linearColorGradient->GetKeyColorCount(nColors);
 		ASSERT(FCM_SUCCESS_CODE(res));
-        
-        
+
+		std::vector<DOM::Utils::GRADIENT_COLOR_POINT> colorPoints(nColors);
+		for (FCM::U_Int8 i = 0; i < nColors; i++)
+		{
+			res = linearColorGradient->GetKeyColorAtIndex(i, colorPoints[i]);
+			ASSERT(FCM_SUCCESS_CODE(res));
+
+			res = m_pOutputWriter->SetKeyColorPoint(colorPoints[i]);
+			ASSERT(FCM_SUCCESS_CODE(res));
+		}
+
+        SetLinearGradient(matrix, colorPoints);
+
+		res = m_pOutputWriter->EndDefineLinearGradientFillStyle();
+		ASSERT(FCM_SUCCESS_CODE(res));
+       
+		return res;
+	}
+
+
+    void ResourcePalette::SetLinearGradient(
+        const DOM::Utils::MATRIX2D& matrix,
+        const std::vector<DOM::Utils::GRADIENT_COLOR_POINT>& colorPoints)
+    {
         JSONOutputWriter *writer = static_cast<JSONOutputWriter*>(m_pOutputWriter);
         LottieExporter::LottieManager *manager = writer->GetLottieManager();
+
+        writer->GetPublishTrace().RecordLinearGradient(matrix, colorPoints);
+
         static const FCM::Float GRADIENT_VECTOR_CONSTANT = 16384.0;
+        FCM::U_Int8 nColors = (FCM::U_Int8)colorPoints.size();
         std::vector<opacity_gradient>opacity;
         group * gr=manager->Getgroup();
         gr->fl.isfilled=true;
@@ -1852,10 +2304,8 @@ namespace LottieExporter
         gr->fl.linear.g.p= nColors;
 		for (FCM::U_Int8 i = 0; i < nColors; i++)
 		{
-			DOM::Utils::GRADIENT_COLOR_POINT point;
+			const DOM::Utils::GRADIENT_COLOR_POINT& point = colorPoints[i];
 
-			res = linearColorGradient->GetKeyColorAtIndex(i, point);
-			ASSERT(FCM_SUCCESS_CODE(res));
             gr->fl.linear.g.k.color.push_back((float)((point.pos))/255.0);
             gr->fl.linear.g.k.color.push_back(double(point.color.red)/255.0);
             gr->fl.linear.g.k.color.push_back(double(point.color.green)/255.0);
@@ -1868,10 +2318,6 @@ namespace LottieExporter
                 alpha_value.pos = i;
                 opacity.push_back(alpha_value);
             }
-            
-            
-			res = m_pOutputWriter->SetKeyColorPoint(point);
-			ASSERT(FCM_SUCCESS_CODE(res));
 		}
         if(opacity.size()!=0)
         {
@@ -1895,12 +2341,7 @@ namespace LottieExporter
         Utils::TransformPoint(matrix, point_end, point_end);
         gr->fl.linear.e.k[0]=point_end.x;
         gr->fl.linear.e.k[1]=point_end.y;
-
-		res = m_pOutputWriter->EndDefineLinearGradientFillStyle();
-		ASSERT(FCM_SUCCESS_CODE(res));
-       
-		return res;
-	}
+    }
 
 
 	FCM::Result ResourcePalette::ExportBitmapFillStyle(DOM::FillStyle::IBitmapFillStyle* pBitmapFillStyle)
@@ -2016,69 +2457,51 @@ namespace LottieExporter
 	FCM::Result TimelineBuilder::AddShape(FCM::U_Int32 objectId, SHAPE_INFO* pShapeInfo)
 	{
 		FCM::Result res;
-        JSONOutputWriter *writer = static_cast<JSONOutputWriter*>(m_pOutputWriter);
-        LottieExporter::LottieManager *manager = writer->GetLottieManager();
+        LottieExporter::LottieManager *manager = GetLottieManager();
+        FCM::U_Int32 resourceId = GetResourceId(pShapeInfo->resourceId);
         
         //std::cout<<"entered 2nd addshape call"<<std::endl;
 
-        manager->CreateLayer(Shape,1,objectId,pShapeInfo->resourceId,pShapeInfo->placeAfterObjectId);
+        GetPublishTrace().RecordPlaceObject(m_traceId, TRACE_RECORD_ADD_SHAPE, objectId,
+            resourceId, pShapeInfo->placeAfterObjectId, pShapeInfo->matrix);
+
+        manager->CreateLayer(Shape,1,objectId,resourceId,pShapeInfo->placeAfterObjectId);
 		ASSERT(pShapeInfo);
 		ASSERT(pShapeInfo->structSize >= sizeof(SHAPE_INFO));
         Layer * layer1 = manager->GetLayer();
         layer1->ip=m_frameIndex;
         manager->shape_layer_map(objectId,layer1);
-        manager->object_resource_map(pShapeInfo->resourceId,objectId);
 		LOG(("[AddShape] ObjId: %d ResId: %d PlaceAfter: %d\n",
-			objectId, pShapeInfo->resourceId, pShapeInfo->placeAfterObjectId));
+			objectId, resourceId, pShapeInfo->placeAfterObjectId));
         
 		res = m_pTimelineWriter->PlaceObject(
-			pShapeInfo->resourceId,
+			resourceId,
 			objectId,
 			pShapeInfo->placeAfterObjectId,
 			&pShapeInfo->matrix);
         
-        std::uint32_t size=layer1->ks.p.size();
-        layer1->ks.p[size-1].k[0]=pShapeInfo->matrix.tx;
-        layer1->ks.p[size-1].k[1]=pShapeInfo->matrix.ty;
-        layer1->ks.p[size-1].frame_number=m_frameIndex;
+        const float position[2] = { pShapeInfo->matrix.tx, pShapeInfo->matrix.ty };
+        layer1->ks.p.SetLast(m_frameIndex, position);
         
         
-        AutoPtr<DOM::Utils::IMatrix2D> pMatrix;
-        res = GetCallback()->CreateInstance(0, DOM::Utils::CLSID_Matrix2D, DOM::Utils::IID_IMatrix2D, (void **)&pMatrix);
-        ASSERT(FCM_SUCCESS_CODE(res));
-        pMatrix.m_Ptr->SetMatrix(pShapeInfo->matrix);
+        MATRIX_COMPONENTS components;
+        DecomposeMatrix(pShapeInfo->matrix, components);
         
         /*float mat[3][3] = {{pShapeInfo->matrix.a, pShapeInfo->matrix.b , 0},
          {pShapeInfo->matrix.c, pShapeInfo->matrix.d, 0},
          {pShapeInfo->matrix.tx, pShapeInfo->matrix.ty, 1}};
          ASSERT(determinantOfMatrix(mat, 3) > 0);*/
         
-        float rotation = 0.0;
-        pMatrix.m_Ptr->GetRotation(rotation);
+        float rotation = components.rotation;
         if(isnan(rotation))
         {
            //fgetlayer node.hasSkew |= true;
             rotation = 0.0;
         }
         
-        DOM::Utils::POINT2D skew = {0.0,0.0};
-        DOM::Utils::POINT2D scale = {0.0,0.0};
-        pMatrix.m_Ptr->GetScale(scale);
-        size=layer1->ks.s.size();
-        layer1->ks.s[size-1].k[0] = scale.x * 100;
-        layer1->ks.s[size-1].k[1] = scale.y * 100;
-        layer1->ks.s[size-1].frame_number = m_frameIndex;
-        size=layer1->ks.r.size();
-        layer1->ks.r[size-1].k = rotation;
-        layer1->ks.r[size-1].frame_number = m_frameIndex;
-        size=layer1->ks.a.size();
-        layer1->ks.a[size-1].frame_number = m_frameIndex;
-        size=layer1->ks.sk.size();
-        layer1->ks.sk[size-1].frame_number = m_frameIndex;
-        size=layer1->ks.sa.size();
-        layer1->ks.sa[size-1].frame_number = m_frameIndex;
-        size=layer1->ks.o.size();
-        layer1->ks.o[size-1].frame_number = m_frameIndex;
+        const float scale[2] = { components.scaleX * 100, components.scaleY * 100 };
+        layer1->ks.s.SetLast(m_frameIndex, scale);
+        layer1->ks.r.SetLast(m_frameIndex, &rotation);
         layer1->objectId = objectId;
     
    
@@ -2092,9 +2515,10 @@ namespace LottieExporter
 
 		ASSERT(pClassicTextInfo);
 		ASSERT(pClassicTextInfo->structSize >= sizeof(CLASSIC_TEXT_INFO));
+		FCM::U_Int32 resourceId = GetResourceId(pClassicTextInfo->resourceId);
 
 		LOG(("[AddClassicText] ObjId: %d ResId: %d PlaceAfter: %d\n",
-			objectId, pClassicTextInfo->resourceId, pClassicTextInfo->placeAfterObjectId));
+			objectId, resourceId, pClassicTextInfo->placeAfterObjectId));
 
 		//To get the bounding rect of the text
 		if (pClassicTextInfo->structSize >= sizeof(DISPLAY_OBJECT_INFO))
@@ -2104,7 +2528,7 @@ namespace LottieExporter
 		}
 
 		res = m_pTimelineWriter->PlaceObject(
-			pClassicTextInfo->resourceId,
+			resourceId,
 			objectId,
 			pClassicTextInfo->placeAfterObjectId,
 			&pClassicTextInfo->matrix);
@@ -2118,59 +2542,42 @@ namespace LottieExporter
 
 		ASSERT(pBitmapInfo);
 		ASSERT(pBitmapInfo->structSize >= sizeof(BITMAP_INFO));
+		FCM::U_Int32 resourceId = GetResourceId(pBitmapInfo->resourceId);
 
 		LOG(("[AddBitmap] ObjId: %d ResId: %d PlaceAfter: %d\n",
-			objectId, pBitmapInfo->resourceId, pBitmapInfo->placeAfterObjectId));
-        JSONOutputWriter *writer = static_cast<JSONOutputWriter*>(m_pOutputWriter);
-        LottieExporter::LottieManager *manager = writer->GetLottieManager();
+			objectId, resourceId, pBitmapInfo->placeAfterObjectId));
+        LottieExporter::LottieManager *manager = GetLottieManager();
+
+        GetPublishTrace().RecordPlaceObject(m_traceId, TRACE_RECORD_ADD_BITMAP, objectId,
+            resourceId, pBitmapInfo->placeAfterObjectId, pBitmapInfo->matrix);
 
-        manager->CreateLayer(Image,1,objectId,pBitmapInfo->resourceId,pBitmapInfo->placeAfterObjectId);
+        manager->CreateLayer(Image,1,objectId,resourceId,pBitmapInfo->placeAfterObjectId);
         Layer * layer=manager->GetLayer();
         layer->ip=m_frameIndex;
         manager->shape_layer_map(objectId,layer);
 		res = m_pTimelineWriter->PlaceObject(
-			pBitmapInfo->resourceId,
+			resourceId,
 			objectId,
 			pBitmapInfo->placeAfterObjectId,
 			&pBitmapInfo->matrix);
         
         
-        std::uint32_t size=layer->ks.p.size();
-        layer->ks.p[size-1].k[0]=pBitmapInfo->matrix.tx;
-        layer->ks.p[size-1].k[1]=pBitmapInfo->matrix.ty;
-        layer->ks.p[size-1].frame_number=m_frameIndex;
+        const float position[2] = { pBitmapInfo->matrix.tx, pBitmapInfo->matrix.ty };
+        layer->ks.p.SetLast(m_frameIndex, position);
         
-        AutoPtr<DOM::Utils::IMatrix2D> pMatrix;
-        res = GetCallback()->CreateInstance(0, DOM::Utils::CLSID_Matrix2D, DOM::Utils::IID_IMatrix2D, (void **)&pMatrix);
-        ASSERT(FCM_SUCCESS_CODE(res));
-        pMatrix.m_Ptr->SetMatrix(pBitmapInfo->matrix);
+        MATRIX_COMPONENTS components;
+        DecomposeMatrix(pBitmapInfo->matrix, components);
         
-        float rotation = 0.0;
-        pMatrix.m_Ptr->GetRotation(rotation);
+        float rotation = components.rotation;
         if(isnan(rotation))
         {
             //fgetlayer node.hasSkew |= true;
             rotation = 0.0;
         }
         
-        DOM::Utils::POINT2D skew = {0.0,0.0};
-        DOM::Utils::POINT2D scale = {0.0,0.0};
-        pMatrix.m_Ptr->GetScale(scale);
-        size=layer->ks.s.size();
-        layer->ks.s[size-1].k[0] = scale.x * 100;
-        layer->ks.s[size-1].k[1] = scale.y * 100;
-        layer->ks.s[size-1].frame_number = m_frameIndex;
-        size=layer->ks.r.size();
-        layer->ks.r[size-1].k = rotation;
-        layer->ks.r[size-1].frame_number = m_frameIndex;
-        size=layer->ks.a.size();
-        layer->ks.a[size-1].frame_number = m_frameIndex;
-        size=layer->ks.sk.size();
-        layer->ks.sk[size-1].frame_number = m_frameIndex;
-        size=layer->ks.sa.size();
-        layer->ks.sa[size-1].frame_number = m_frameIndex;
-        size=layer->ks.o.size();
-        layer->ks.o[size-1].frame_number = m_frameIndex;
+        const float scale[2] = { components.scaleX * 100, components.scaleY * 100 };
+        layer->ks.s.SetLast(m_frameIndex, scale);
+        layer->ks.r.SetLast(m_frameIndex, &rotation);
         
         
         
@@ -2185,12 +2592,18 @@ namespace LottieExporter
 
 		ASSERT(pMovieClipInfo);
 		ASSERT(pMovieClipInfo->structSize >= sizeof(MOVIE_CLIP_INFO));
+		FCM::U_Int32 resourceId = GetResourceId(pMovieClipInfo->resourceId);
 
 		LOG(("[AddMovieClip] ObjId: %d ResId: %d PlaceAfter: %d\n",
-			objectId, pMovieClipInfo->resourceId, pMovieClipInfo->placeAfterObjectId));
+			objectId, resourceId, pMovieClipInfo->placeAfterObjectId));
+
+		GetPublishTrace().RecordPlaceObject(m_traceId, TRACE_RECORD_ADD_MOVIE_CLIP, objectId,
+			resourceId, pMovieClipInfo->placeAfterObjectId, pMovieClipInfo->matrix);
+
+		AddSymbolInstance(objectId, resourceId, pMovieClipInfo->placeAfterObjectId, pMovieClipInfo->matrix);
 
 		res = m_pTimelineWriter->PlaceObject(
-			pMovieClipInfo->resourceId,
+			resourceId,
 			objectId,
 			pMovieClipInfo->placeAfterObjectId,
 			&pMovieClipInfo->matrix,
@@ -2205,12 +2618,21 @@ namespace LottieExporter
 
 		ASSERT(pGraphicInfo);
 		ASSERT(pGraphicInfo->structSize >= sizeof(GRAPHIC_INFO));
+		FCM::U_Int32 resourceId = GetResourceId(pGraphicInfo->resourceId);
 
 		LOG(("[AddGraphic] ObjId: %d ResId: %d PlaceAfter: %d\n",
-			objectId, pGraphicInfo->resourceId, pGraphicInfo->placeAfterObjectId));
+			objectId, resourceId, pGraphicInfo->placeAfterObjectId));
+
+		GetPublishTrace().RecordPlaceObject(m_traceId, TRACE_RECORD_ADD_GRAPHIC, objectId,
+			resourceId, pGraphicInfo->placeAfterObjectId, pGraphicInfo->matrix);
+
+		// The instance loops from the first frame of the symbol, the default
+		// of a graphic; its loop mode and first frame are not part of the
+		// graphic info
+		AddSymbolInstance(objectId, resourceId, pGraphicInfo->placeAfterObjectId, pGraphicInfo->matrix);
 
 		res = m_pTimelineWriter->PlaceObject(
-			pGraphicInfo->resourceId,
+			resourceId,
 			objectId,
 			pGraphicInfo->placeAfterObjectId,
 			&pGraphicInfo->matrix);
@@ -2218,6 +2640,40 @@ namespace LottieExporter
 		return res;
 	}
 
+	// An instance only carries its transform and the frame its symbol
+	// starts playing on; the symbol timeline is its precomp. Its keys are
+	// on the parent timeline like those of any layer, so it starts at 0 and
+	// the writer maps its frames to the symbol frames with "tm".
+	void TimelineBuilder::AddSymbolInstance(
+		FCM::U_Int32 objectId,
+		FCM::U_Int32 resourceId,
+		FCM::U_Int32 placeAfterObjectId,
+		const DOM::Utils::MATRIX2D& matrix)
+	{
+		LottieExporter::LottieManager *manager = GetLottieManager();
+
+		manager->CreateLayer(Precomp, 1, objectId, resourceId, placeAfterObjectId);
+		Layer * layer = manager->GetLayer();
+		layer->ip = m_frameIndex;
+		manager->shape_layer_map(objectId, layer);
+
+		const float position[2] = { matrix.tx, matrix.ty };
+		layer->ks.p.SetLast(m_frameIndex, position);
+
+		MATRIX_COMPONENTS components;
+		DecomposeMatrix(matrix, components);
+
+		float rotation = components.rotation;
+		if (isnan(rotation))
+		{
+			rotation = 0.0;
+		}
+
+		const float scale[2] = { components.scaleX * 100, components.scaleY * 100 };
+		layer->ks.s.SetLast(m_frameIndex, scale);
+		layer->ks.r.SetLast(m_frameIndex, &rotation);
+	}
+
 	FCM::Result TimelineBuilder::AddSound(
 		FCM::U_Int32 objectId,
 		SOUND_INFO* pSoundInfo,
@@ -2228,12 +2684,13 @@ namespace LottieExporter
 
 		ASSERT(pSoundInfo);
 		ASSERT(pSoundInfo->structSize == sizeof(SOUND_INFO));
+		FCM::U_Int32 resourceId = GetResourceId(pSoundInfo->resourceId);
 
 		LOG(("[AddSound] ObjId: %d ResId: %d\n",
-			objectId, pSoundInfo->resourceId));
+			objectId, resourceId));
 
 		res = m_pTimelineWriter->PlaceObject(
-			pSoundInfo->resourceId,
+			resourceId,
 			objectId,
 			pUnknown);
 
@@ -2247,6 +2704,8 @@ namespace LottieExporter
 		LOG(("[UpdateZOrder] ObjId: %d PlaceAfter: %d\n",
 			objectId, placeAfterObjectId));
 
+		GetPublishTrace().RecordUpdateZOrder(m_traceId, objectId, placeAfterObjectId);
+
 		res = m_pTimelineWriter->UpdateZOrder(objectId, placeAfterObjectId);
 
 		return res;
@@ -2259,6 +2718,8 @@ namespace LottieExporter
 		LOG(("[UpdateMask] ObjId: %d MaskTill: %d\n",
 			objectId, maskTillObjectId));
 
+		GetPublishTrace().RecordUpdateMask(m_traceId, objectId, maskTillObjectId);
+
 		res = m_pTimelineWriter->UpdateMask(objectId, maskTillObjectId);
 
 		return res;
@@ -2269,10 +2730,15 @@ namespace LottieExporter
 		FCM::Result res;
 
 		LOG(("[Remove] ObjId: %d\n", objectId));
-        JSONOutputWriter *writer = static_cast<JSONOutputWriter*>(m_pOutputWriter);
-        LottieExporter::LottieManager *manager = writer->GetLottieManager();
+
+		GetPublishTrace().RecordRemove(m_traceId, objectId);
+
+		// The object id may be reused by a later placement in this frame
+		FlushDisplayTransforms();
+        LottieExporter::LottieManager *manager = GetLottieManager();
         Layer * layer = manager->GetLayerAtObjectId(objectId);
-        layer->op = m_frameIndex;
+        if (layer)
+            layer->op = m_frameIndex;
 		res = m_pTimelineWriter->RemoveObject(objectId);
         //std::cout<<"remove"<<j<<std::endl;j++;
 		return res;
@@ -2284,6 +2750,8 @@ namespace LottieExporter
 
 		LOG(("[UpdateBlendMode] ObjId: %d BlendMode: %d\n", objectId, blendMode));
 
+		GetPublishTrace().RecordUpdateBlendMode(m_traceId, objectId, (FCM::U_Int32)blendMode);
+
 		res = m_pTimelineWriter->UpdateBlendMode(objectId, blendMode);
 
 		return res;
@@ -2295,6 +2763,8 @@ namespace LottieExporter
 
 		LOG(("[UpdateVisibility] ObjId: %d Visible: %d\n", objectId, visible));
 
+		GetPublishTrace().RecordUpdateVisibility(m_traceId, objectId, visible);
+
 		res = m_pTimelineWriter->UpdateVisibility(objectId, visible);
 
 		return res;
@@ -2329,118 +2799,89 @@ namespace LottieExporter
 
 	FCM::Result TimelineBuilder::UpdateDisplayTransform(FCM::U_Int32 objectId, const DOM::Utils::MATRIX2D& matrix)
 	{
-        FCM::Result res = FCM_SUCCESS;
         LOG(("[Update3dDisplayTransform] ObjId: %d\n", objectId));
-        
-        JSONOutputWriter *writer = static_cast<JSONOutputWriter*>(m_pOutputWriter);
-        LottieExporter::LottieManager *manager = writer->GetLottieManager();
+
+        GetPublishTrace().RecordUpdateDisplayTransform(m_traceId, objectId, matrix);
+
+        // Decomposed together with the rest of the frame in FlushDisplayTransforms
+        m_pendingObjectIds.push_back(objectId);
+        m_pendingMatrices.push_back(matrix);
+
+        return FCM_SUCCESS;
+	}
+
+    void TimelineBuilder::FlushDisplayTransforms()
+    {
+        std::uint32_t count = m_pendingMatrices.size();
+        if (count == 0)
+        {
+            return;
+        }
+
+        m_pendingComponents.resize(count);
+        DecomposeMatrices(&m_pendingMatrices[0], &m_pendingComponents[0], count);
+
+        for (std::uint32_t i = 0; i < count; i++)
+        {
+            ApplyDisplayTransform(m_pendingObjectIds[i], m_pendingMatrices[i], m_pendingComponents[i]);
+        }
+
+        m_pendingObjectIds.clear();
+        m_pendingMatrices.clear();
+    }
+
+    void TimelineBuilder::ApplyDisplayTransform(
+        FCM::U_Int32 objectId,
+        const DOM::Utils::MATRIX2D& mat2D,
+        const MATRIX_COMPONENTS& components)
+    {
+        LottieExporter::LottieManager *manager = GetLottieManager();
         Layer * layer1 = manager->GetLayerAtObjectId(objectId);
-        float framespersec= float(manager->GetFPS());
-        if(writer)
+        if (layer1 == NULL)
+            return;
+
+        //CHANGE IN TX TY
+        keyframe_track& p = layer1->ks.p;
+        const float position[2] = { mat2D.tx, mat2D.ty };
+        if (!std::equal(position, position + 2, p.Value(p.Size() - 1)))
         {
-            AutoPtr<DOM::Utils::IMatrix2D> pMatrix;
-            res = GetCallback()->CreateInstance(0, DOM::Utils::CLSID_Matrix2D, DOM::Utils::IID_IMatrix2D, (void **)&pMatrix);
-            DOM::Utils::MATRIX2D mat2D = matrix;
-            
-            
-            std::uint32_t p_size=layer1->ks.p.size();
-            
-            //CHANGE IN TX TY
-            
-            if((layer1->ks.p[p_size-1].k[0] != mat2D.tx) || (layer1->ks.p[p_size-1].k[1] != mat2D.ty))
-            {      layer1->ks.p[p_size-1].a=1;
-                /* layer1->ks.p[p_size-1].offset.i  = {0.8333,0.833};
-                 layer1->ks.p[p_size-1].offset.o = {0.167,0.167};
-                 midpoint ={ (layer1->ks.p[p_size-1].k[0] +  mat2D.tx )/2,(layer1->ks.p[p_size-1].k[1] +  mat2D.ty )/2 };
-                 /* layer1->ks.p[p_size-1].multi_keyframe.ti = {layer1->ks.p[p_size-1].offset.start[0] - midpoint.x, layer1->ks.p[p_size-1].offset.start[1] - midpoint.y };
-                 
-                 layer1->ks.p[p_size-1].multi_keyframe.to = {(mat2D.tx- midpoint.x), (mat2D.ty - midpoint.y) };*/
-                coordinates midpoint;
-                layer1->ks.p[p_size-1].offset.h =1;
-                layer1->ks.p[p_size-1].offset.start[0] = layer1->ks.p[p_size-1].k[0];
-                layer1->ks.p[p_size-1].offset.start[1] = layer1->ks.p[p_size-1].k[1];
-                layer1->ks.p[p_size-1].offset.time = (float)(layer1->ks.p[p_size-1].frame_number );
-                
-                
-                struct::position p;
-                p.k[0] = mat2D.tx;
-                p.k[1] = mat2D.ty;
-                p.a=1;
-                p.frame_number=m_frameIndex;
-                p.offset.time=((float)(p.frame_number));
-                p.offset.h=1;
-                layer1->ks.p.push_back(p);
-                //size= layer
-            }
-            
-            std::uint32_t s_size=layer1->ks.s.size();
-            DOM::Utils::POINT2D scale = {0.0,0.0};
-            ASSERT(FCM_SUCCESS_CODE(res));
-            pMatrix.m_Ptr->SetMatrix(mat2D);
-            pMatrix.m_Ptr->GetScale(scale);
-            scale.x= scale.x * 100;
-            scale.y= scale.y * 100;
-            
-            if((layer1->ks.s[s_size-1].k[0] != scale.x) ||  (layer1->ks.s[s_size-1].k[1] != scale.y))
-            {
-                layer1->ks.s[s_size-1].a=1;
-                /* layer1->ks.s[s_size-1].offset.i  = {0.8333,0.833};
-                 layer1->ks.s[s_size-1].offset.o =  {0.167,0.167};*/
-                layer1->ks.s[s_size-1].offset.time = (((float)(layer1->ks.s[s_size-1].frame_number )));
-                layer1->ks.s[s_size-1].offset.start[0] = layer1->ks.s[s_size-1].k[0];
-                layer1->ks.s[s_size-1].offset.start[1] = layer1->ks.s[s_size-1].k[1];
-                layer1->ks.s[s_size-1].offset.h =1;
-                
-                struct::scale s;
-                s.k[0] = scale.x;
-                s.k[1] = scale.y;
-                s.a=1;
-                s.frame_number=m_frameIndex;
-                s.offset.time=(((float)(s.frame_number)));
-                s.offset.h=1;
-                layer1->ks.s.push_back(s);
-                
-            }
-            
-            
-            //float layerDepth = matrix.m32;
-            
-            float rotation = 0.0;
-            pMatrix.m_Ptr->GetRotation(rotation);
-            DOM::Utils::POINT2D skew = {0.0,0.0};
-            bool hasSkew = false;
-            if(isnan(rotation))
-            {
-                hasSkew = true;
-                rotation = 0.0;
-            }
-            pMatrix.m_Ptr->GetSkew(skew);
-            
-            //rotation *= -1;
-            std::uint32_t r_size=layer1->ks.r.size();
-            
-            if(rotation!=layer1->ks.r[r_size-1].k )
-            {
-                layer1->ks.r[r_size-1].a=1;
-                /* layer1->ks.r[r_size-1].offset.i  = {0.8333,0.833};
-                 layer1->ks.r[r_size-1].offset.o =  {0.167,0.167};*/
-                layer1->ks.r[r_size-1].offset.time = (((float)(layer1->ks.r[r_size-1].frame_number )));
-                layer1->ks.r[r_size-1].offset.start[0] = layer1->ks.r[r_size-1].k;
-                layer1->ks.r[r_size-1].offset.h =1;
-                
-                struct::rotation r;
-                r.k = rotation;
-                r.a=1;
-                r.frame_number=m_frameIndex;
-                r.offset.time=(((float)(r.frame_number)));
-                r.offset.h = 1;
-                layer1->ks.r.push_back(r);
-            }
-            
+            AddKeyframe(p, position);
         }
-        
-        return res;
-	}
+
+        keyframe_track& s = layer1->ks.s;
+        const float scale[2] = { components.scaleX * 100, components.scaleY * 100 };
+        if (!std::equal(scale, scale + 2, s.Value(s.Size() - 1)))
+        {
+            AddKeyframe(s, scale);
+        }
+
+        // Skewed matrices have no rotation
+        float rotation = components.rotation;
+        if(isnan(rotation))
+        {
+            rotation = 0.0;
+        }
+
+        keyframe_track& r = layer1->ks.r;
+        if (rotation != r.Value(r.Size() - 1)[0])
+        {
+            AddKeyframe(r, &rotation);
+        }
+    }
+
+    // A track that starts moving usually keeps moving: room is made for a
+    // key on each of the remaining frames up front
+    void TimelineBuilder::AddKeyframe(keyframe_track& track, const float* value)
+    {
+        JSONOutputWriter *writer = static_cast<JSONOutputWriter*>(m_pOutputWriter);
+        int remaining = writer->GetLottieManager()->GetFrameCount() - (int)m_frameIndex;
+
+        if (track.Size() == 1 && remaining > 0)
+        {
+            track.Reserve(remaining + 1);
+        }
+        track.Add((float)m_frameIndex, value);
+    }
 
     FCM::Result TimelineBuilder::UpdateColorTransform(FCM::U_Int32 objectId, const DOM::Utils::COLOR_MATRIX& colorMatrix)
 	{
@@ -2458,6 +2899,10 @@ namespace LottieExporter
 		FCM::Result res;
        
 		LOG(("[ShowFrame] Frame: %d\n", m_frameIndex));
+
+		GetPublishTrace().RecordShowFrame(m_traceId);
+
+		FlushDisplayTransforms();
         
 		res = m_pTimelineWriter->ShowFrame(m_frameIndex);
 
@@ -2511,22 +2956,32 @@ namespace LottieExporter
 		ITimelineWriter** ppTimelineWriter)
 	{
 		FCM::Result res;
+
+		GetPublishTrace().RecordBuildTimeline(m_traceId, resourceId);
+
+		FlushDisplayTransforms();
         // manager->SetIp(m_frameIndex);
-        JSONOutputWriter *writer = static_cast<JSONOutputWriter*>(m_pOutputWriter);
-        LottieExporter::LottieManager *manager = writer->GetLottieManager();
+        LottieExporter::LottieManager *manager = GetLottieManager();
         
-        
-        manager->SetOp(m_frameIndex);
-        
-        std::map<int , Layer *>::iterator it;
-        std::map<int , Layer *>objectid_Layer=manager->GetobjIdLayer();
-        for(it=objectid_Layer.begin();it != objectid_Layer.end();it++)
+        const IdTable<Layer *>& objectid_Layer = manager->GetobjIdLayer();
+        for (int objectId = objectid_Layer.MinId(); objectId < objectid_Layer.EndId(); objectId++)
         {
-            Layer * layer =manager->GetLayerAtObjectId(it->first);
-            if(layer->op==0)
-                layer->op=m_frameIndex;
+            Layer * const * layer = objectid_Layer.Find(objectId);
+            if (layer && *layer && (*layer)->op == 0)
+                (*layer)->op = m_frameIndex;
         }
         
+        // Only the root timeline makes the length of the document
+        if (resourceId != 0)
+        {
+            std::string name = (pName != NULL) ? Utils::ToString(pName, GetCallback()) : std::string();
+            manager->DefineComposition(m_composition, resourceId, name, m_frameIndex - manager->GetSceneStart());
+        }
+        else
+        {
+            manager->SetOp(m_frameIndex);
+            manager->AddToMainComposition(m_composition);
+        }
       
 		res = m_pOutputWriter->EndDefineTimeline(resourceId, pName, m_pTimelineWriter);
 
@@ -2538,7 +2993,9 @@ namespace LottieExporter
 
 	TimelineBuilder::TimelineBuilder() :
 		m_pOutputWriter(NULL),
-		m_frameIndex(0)
+		m_composition(NULL),
+		m_frameIndex(0),
+		m_traceId(0)
 	{
 		//LOG(("[CreateTimeline]\n"));
 	}
@@ -2553,8 +3010,34 @@ namespace LottieExporter
 
 		m_pOutputWriter->StartDefineTimeline();
 
-		m_pTimelineWriter = new JSONTimelineWriter(GetCallback());
+		m_pTimelineWriter = new JSONTimelineWriter(GetCallback(),
+			static_cast<JSONOutputWriter*>(m_pOutputWriter)->IsLegacyOutput());
 		ASSERT(m_pTimelineWriter);
+
+		m_traceId = GetPublishTrace().RecordCreateTimeline();
+
+		// Frames of a later scene follow the frames of the scenes before it
+		LottieExporter::LottieManager *manager = static_cast<JSONOutputWriter*>(m_pOutputWriter)->GetLottieManager();
+		m_frameIndex = manager->GetSceneStart();
+		m_composition = manager->CreateComposition();
+	}
+
+	PublishTraceWriter& TimelineBuilder::GetPublishTrace()
+	{
+		return static_cast<JSONOutputWriter*>(m_pOutputWriter)->GetPublishTrace();
+	}
+
+	// Builders may be fed in turns: each one selects its composition first
+	LottieExporter::LottieManager* TimelineBuilder::GetLottieManager()
+	{
+		LottieExporter::LottieManager *manager = static_cast<JSONOutputWriter*>(m_pOutputWriter)->GetLottieManager();
+		manager->SetComposition(m_composition);
+		return manager;
+	}
+
+	FCM::U_Int32 TimelineBuilder::GetResourceId(FCM::U_Int32 resourceId)
+	{
+		return static_cast<JSONOutputWriter*>(m_pOutputWriter)->GetLottieManager()->GetResourceId(resourceId);
 	}
 
 	/* ----------------------------------------------------- TimelineBuilderFactory */
@@ -2583,6 +3066,316 @@ namespace LottieExporter
 		m_pOutputWriter = pOutputWriter;
 	}
 
+	/* ----------------------------------------------------- PublishTraceReplayer */
+
+	PublishTraceReplayer::PublishTraceReplayer(JSONOutputWriter* pOutputWriter, double curveTolerance) :
+		m_pOutputWriter(pOutputWriter)
+	{
+		m_pResourcePalette = new ResourcePalette();
+		m_pResourcePalette->Init(m_pOutputWriter, curveTolerance);
+	}
+
+	PublishTraceReplayer::~PublishTraceReplayer()
+	{
+		for (std::map<FCM::U_Int32, TimelineBuilder*>::iterator it = m_timelines.begin(); it != m_timelines.end(); ++it)
+		{
+			delete it->second;
+		}
+
+		delete m_pResourcePalette;
+	}
+
+	FCM::Result PublishTraceReplayer::Replay(
+		const std::string& traceFile,
+		JSONOutputWriter& outputWriter,
+		std::string& outputFile,
+		FCM::PIFCMCallback pCallback,
+		double curveTolerance,
+		PublishBenchmark* pBenchmark)
+	{
+		std::fstream file;
+
+		Utils::OpenFStream(traceFile, file, std::ios_base::in | std::ios_base::binary, pCallback);
+		if (!file)
+		{
+			Utils::Trace(pCallback, "Publish trace (%s) could not be read\n", traceFile.c_str());
+			return FCM_INVALID_PARAM;
+		}
+
+		outputWriter.StartOutput(outputFile);
+
+		FCM::Result res;
+		if (pBenchmark)
+			pBenchmark->StartPhase("model");
+		{
+			PublishTraceReplayer replayer(&outputWriter, curveTolerance);
+			PublishTraceReader reader(file);
+
+			res = reader.Replay(replayer);
+		}
+		if (FCM_FAILURE_CODE(res))
+		{
+			Utils::Trace(pCallback, "Publish trace (%s) is invalid or truncated\n", traceFile.c_str());
+			return res;
+		}
+
+		if (pBenchmark)
+		{
+			pBenchmark->EndPhase();
+			pBenchmark->AddResult("model_objects", (double)outputWriter.GetLottieManager()->GetObjectCount(), "");
+			pBenchmark->StartPhase("serialize");
+		}
+
+		res = outputWriter.EndDocument();
+		ASSERT(FCM_SUCCESS_CODE(res));
+
+		res = outputWriter.FinishDocument();
+		ASSERT(FCM_SUCCESS_CODE(res));
+
+		if (pBenchmark)
+			pBenchmark->EndPhase();
+
+		res = outputWriter.EndOutput();
+		ASSERT(FCM_SUCCESS_CODE(res));
+
+		return res;
+	}
+
+	void PublishTraceReplayer::Document(
+		const DOM::Utils::COLOR& background,
+		FCM::U_Int32 stageHeight,
+		FCM::U_Int32 stageWidth,
+		FCM::U_Int32 fps)
+	{
+		m_pOutputWriter->StartDocument(background, stageHeight, stageWidth, fps);
+		AddRootLayer(m_pOutputWriter);
+	}
+
+	void PublishTraceReplayer::DefineShape(FCM::U_Int32 resourceId)
+	{
+		m_pResourcePalette->StartShape(resourceId);
+	}
+
+	void PublishTraceReplayer::FillRegion(FCM::U_Int32 resourceId)
+	{
+		m_pResourcePalette->StartFillRegion(resourceId);
+	}
+
+	void PublishTraceReplayer::StrokePath(FCM::U_Int32 resourceId)
+	{
+		m_pResourcePalette->StartStrokePath(resourceId);
+	}
+
+	void PublishTraceReplayer::SolidColor(const DOM::Utils::COLOR& color)
+	{
+		m_pResourcePalette->SetSolidColor(color);
+	}
+
+	void PublishTraceReplayer::LinearGradient(
+		const DOM::Utils::MATRIX2D& matrix,
+		const std::vector<DOM::Utils::GRADIENT_COLOR_POINT>& colorPoints)
+	{
+		m_pResourcePalette->SetLinearGradient(matrix, colorPoints);
+	}
+
+	void PublishTraceReplayer::RadialGradient(
+		const DOM::Utils::MATRIX2D& matrix,
+		FCM::S_Int32 focalPoint,
+		const std::vector<DOM::Utils::GRADIENT_COLOR_POINT>& colorPoints)
+	{
+		m_pResourcePalette->SetRadialGradient(matrix, focalPoint, colorPoints);
+	}
+
+	void PublishTraceReplayer::SolidStroke(
+		FCM::Double thickness,
+		FCM::U_Int32 lineCap,
+		FCM::U_Int32 lineJoin,
+		FCM::Double miterLimit)
+	{
+		m_pResourcePalette->SetSolidStroke(thickness, lineCap, lineJoin, miterLimit);
+	}
+
+	void PublishTraceReplayer::Path(const std::vector<DOM::Utils::SEGMENT>& edges, FCM::Boolean isHole)
+	{
+		m_pResourcePalette->AddPath(edges, isHole);
+	}
+
+	void PublishTraceReplayer::Holes(FCM::U_Int32 resourceId)
+	{
+		m_pResourcePalette->StartHoles(resourceId);
+	}
+
+	void PublishTraceReplayer::DefineBitmap(
+		FCM::U_Int32 resourceId,
+		FCM::S_Int32 height,
+		FCM::S_Int32 width,
+		const std::string& libPathName,
+		const std::string& fileName)
+	{
+		m_pResourcePalette->DefineBitmap(resourceId, height, width, libPathName);
+
+		image_resource * image = m_pOutputWriter->GetLottieManager()->Getimage_resource_with_id(resourceId);
+		if (image)
+		{
+			image->u = std::string("./") + IMAGE_FOLDER + "/";
+			image->p = fileName;
+		}
+	}
+
+	void PublishTraceReplayer::CreateTimeline(FCM::U_Int32 timelineId)
+	{
+		TimelineBuilder* pTimeline = new TimelineBuilder();
+		pTimeline->Init(m_pOutputWriter);
+
+		delete m_timelines[timelineId];
+		m_timelines[timelineId] = pTimeline;
+	}
+
+	void PublishTraceReplayer::PlaceObject(
+		FCM::U_Int32 timelineId,
+		TraceRecordType type,
+		FCM::U_Int32 objectId,
+		FCM::U_Int32 resourceId,
+		FCM::U_Int32 placeAfterObjectId,
+		const DOM::Utils::MATRIX2D& matrix)
+	{
+		TimelineBuilder* pTimeline = GetTimeline(timelineId);
+		if (pTimeline == NULL)
+			return;
+
+		switch (type)
+		{
+			case TRACE_RECORD_ADD_SHAPE:
+			{
+				SHAPE_INFO info;
+				memset(&info, 0, sizeof(info));
+				info.structSize = sizeof(SHAPE_INFO);
+				info.resourceId = resourceId;
+				info.placeAfterObjectId = placeAfterObjectId;
+				info.matrix = matrix;
+				pTimeline->AddShape(objectId, &info);
+				break;
+			}
+
+			case TRACE_RECORD_ADD_BITMAP:
+			{
+				BITMAP_INFO info;
+				memset(&info, 0, sizeof(info));
+				info.structSize = sizeof(BITMAP_INFO);
+				info.resourceId = resourceId;
+				info.placeAfterObjectId = placeAfterObjectId;
+				info.matrix = matrix;
+				pTimeline->AddBitmap(objectId, &info);
+				break;
+			}
+
+			case TRACE_RECORD_ADD_MOVIE_CLIP:
+			{
+				MOVIE_CLIP_INFO info;
+				memset(&info, 0, sizeof(info));
+				info.structSize = sizeof(MOVIE_CLIP_INFO);
+				info.resourceId = resourceId;
+				info.placeAfterObjectId = placeAfterObjectId;
+				info.matrix = matrix;
+				pTimeline->AddMovieClip(objectId, &info, NULL);
+				break;
+			}
+
+			case TRACE_RECORD_ADD_GRAPHIC:
+			{
+				GRAPHIC_INFO info;
+				memset(&info, 0, sizeof(info));
+				info.structSize = sizeof(GRAPHIC_INFO);
+				info.resourceId = resourceId;
+				info.placeAfterObjectId = placeAfterObjectId;
+				info.matrix = matrix;
+				pTimeline->AddGraphic(objectId, &info);
+				break;
+			}
+
+			default:
+				break;
+		}
+	}
+
+	void PublishTraceReplayer::UpdateZOrder(FCM::U_Int32 timelineId, FCM::U_Int32 objectId, FCM::U_Int32 placeAfterObjectId)
+	{
+		TimelineBuilder* pTimeline = GetTimeline(timelineId);
+		if (pTimeline)
+			pTimeline->UpdateZOrder(objectId, placeAfterObjectId);
+	}
+
+	void PublishTraceReplayer::UpdateMask(FCM::U_Int32 timelineId, FCM::U_Int32 objectId, FCM::U_Int32 maskTillObjectId)
+	{
+		TimelineBuilder* pTimeline = GetTimeline(timelineId);
+		if (pTimeline)
+			pTimeline->UpdateMask(objectId, maskTillObjectId);
+	}
+
+	void PublishTraceReplayer::Remove(FCM::U_Int32 timelineId, FCM::U_Int32 objectId)
+	{
+		TimelineBuilder* pTimeline = GetTimeline(timelineId);
+		if (pTimeline)
+			pTimeline->Remove(objectId);
+	}
+
+	void PublishTraceReplayer::UpdateBlendMode(FCM::U_Int32 timelineId, FCM::U_Int32 objectId, FCM::U_Int32 blendMode)
+	{
+		TimelineBuilder* pTimeline = GetTimeline(timelineId);
+		if (pTimeline)
+			pTimeline->UpdateBlendMode(objectId, (DOM::FrameElement::BlendMode)blendMode);
+	}
+
+	void PublishTraceReplayer::UpdateVisibility(FCM::U_Int32 timelineId, FCM::U_Int32 objectId, FCM::Boolean visible)
+	{
+		TimelineBuilder* pTimeline = GetTimeline(timelineId);
+		if (pTimeline)
+			pTimeline->UpdateVisibility(objectId, visible);
+	}
+
+	void PublishTraceReplayer::UpdateDisplayTransform(
+		FCM::U_Int32 timelineId,
+		FCM::U_Int32 objectId,
+		const DOM::Utils::MATRIX2D& matrix)
+	{
+		TimelineBuilder* pTimeline = GetTimeline(timelineId);
+		if (pTimeline)
+			pTimeline->UpdateDisplayTransform(objectId, matrix);
+	}
+
+	void PublishTraceReplayer::ShowFrame(FCM::U_Int32 timelineId)
+	{
+		TimelineBuilder* pTimeline = GetTimeline(timelineId);
+		if (pTimeline)
+			pTimeline->ShowFrame();
+	}
+
+	void PublishTraceReplayer::StartScene(FCM::U_Int32 firstFrame, FCM::U_Int32 frameCount)
+	{
+		m_pOutputWriter->GetLottieManager()->StartScene(firstFrame, frameCount);
+	}
+
+	void PublishTraceReplayer::BuildTimeline(FCM::U_Int32 timelineId, FCM::U_Int32 resourceId)
+	{
+		ITimelineWriter* pTimelineWriter;
+
+		TimelineBuilder* pTimeline = GetTimeline(timelineId);
+		if (pTimeline == NULL)
+			return;
+
+		// Symbols are built through the palette, the root timeline directly
+		if (resourceId != 0)
+			m_pResourcePalette->AddSymbol(resourceId, NULL, pTimeline);
+		else
+			pTimeline->Build(0, NULL, &pTimelineWriter);
+	}
+
+	TimelineBuilder* PublishTraceReplayer::GetTimeline(FCM::U_Int32 timelineId)
+	{
+		std::map<FCM::U_Int32, TimelineBuilder*>::iterator it = m_timelines.find(timelineId);
+		return (it != m_timelines.end()) ? it->second : NULL;
+	}
+
 	FCM::Result RegisterPublisher(PIFCMDictionary pPlugins, FCM::FCMCLSID docId)
 	{
 		FCM::Result res;
@@ -33,6 +33,7 @@
 #include "Application/Service/IOutputConsoleService.h"
 #include "Application/Service/IFlashApplicationService.h"
 #include "FlashFCMPublicIDs.h"
+#include "NumberFormatter.h"
 
 #ifndef _WINDOWS
 #define _XOPEN_SOURCE 500
@@ -181,20 +182,20 @@ namespace LottieExporter
         return string;
     }
     
+    // Shortest text that reads back as the same value, with a '.' whatever
+    // the locale
     std::string Utils::ToString(const double& in)
     {
-        char buffer[32];
-        sprintf(buffer,"%.6f", in);
-        std::string str(buffer);
-        return str;
+        char buffer[NUMBER_FORMAT_BUFFER_SIZE];
+        size_t len = NumberFormatter::Format(in, NUMBER_PRECISION_DEFAULT, false, buffer);
+        return std::string(buffer, len);
     }
     
     std::string Utils::ToString(const float& in)
     {
-        char buffer[32];
-        sprintf(buffer,"%.6f", in);
-        std::string str(buffer);
-        return str;
+        char buffer[NUMBER_FORMAT_BUFFER_SIZE];
+        size_t len = NumberFormatter::Format(in, NUMBER_PRECISION_DEFAULT, true, buffer);
+        return std::string(buffer, len);
     }
     
     std::string Utils::ToString(const FCM::U_Int32& in)
@@ -7,10 +7,15 @@
 #include "fstream"
 #include "Utils.h"
 #include <algorithm>
+#include <map>
 
 #define _USE_MATH_DEFINES // for C++  
 #include <math.h>
 
+// Range allowed for the y of a fitted ease handle (overshoot included)
+#define KEYFRAME_EASE_MIN -0.5
+#define KEYFRAME_EASE_MAX 1.5
+
 namespace LottieExporter {
 
 
@@ -29,6 +34,803 @@ namespace LottieExporter {
 	}
 
 
+	// The arenas free every layer, group and image resource at once
+	LottieManager::~LottieManager()
+	{
+	}
+
+
+	/* -------------------------------------------------- Keyframe reduction */
+
+	// A run of keys [start, end] replaced by a single keyframe. The ease
+	// handles are kept per dimension.
+	struct KeyframeSegment
+	{
+		std::uint32_t start;
+		std::uint32_t end;
+		bool hold;
+		coordinates o[KEYFRAME_TRACK_MAX_DIMS];
+		coordinates i[KEYFRAME_TRACK_MAX_DIMS];
+	};
+
+	// Value of a Lottie ease at normalized time s. The x handles are fixed at
+	// 1/3 and 2/3 so that the bezier is linear in time and only y1/y2 shape it.
+	static double EaseAt(double s, double y1, double y2)
+	{
+		double u = 1.0 - s;
+		return 3.0 * u * u * s * y1 + 3.0 * u * s * s * y2 + s * s * s;
+	}
+
+	static bool IsWithinTolerance(
+		double t0,
+		double v0,
+		double delta,
+		double span,
+		const keyframe_track& checks,
+		int d,
+		double y1,
+		double y2,
+		double tolerance)
+	{
+		for (std::uint32_t c = 0; c < checks.Size(); c++)
+		{
+			double e = EaseAt((checks.t[c] - t0) / span, y1, y2);
+			if (std::fabs(v0 + delta * e - checks.v[c * checks.dims + d]) > tolerance)
+				return false;
+		}
+		return true;
+	}
+
+	// Finds the ease handles of one dimension: linear if that is close
+	// enough, otherwise a least squares fit of y1/y2.
+	static bool FitEase(
+		double t0,
+		double v0,
+		double delta,
+		double span,
+		const keyframe_track& checks,
+		int d,
+		double tolerance,
+		double& y1,
+		double& y2)
+	{
+		y1 = 1.0 / 3.0;
+		y2 = 2.0 / 3.0;
+		if (IsWithinTolerance(t0, v0, delta, span, checks, d, y1, y2, tolerance))
+			return true;
+
+		if (std::fabs(delta) <= tolerance)
+		{
+			// Returns to where it started: cannot be eased
+			return false;
+		}
+
+		double a11 = 0, a12 = 0, a22 = 0, r1 = 0, r2 = 0;
+		for (std::uint32_t c = 0; c < checks.Size(); c++)
+		{
+			double s = (checks.t[c] - t0) / span;
+			double u = 1.0 - s;
+			double b1 = 3.0 * u * u * s * delta;
+			double b2 = 3.0 * u * s * s * delta;
+			double r = checks.v[c * checks.dims + d] - v0 - s * s * s * delta;
+
+			a11 += b1 * b1;
+			a12 += b1 * b2;
+			a22 += b2 * b2;
+			r1 += b1 * r;
+			r2 += b2 * r;
+		}
+
+		double det = a11 * a22 - a12 * a12;
+		if (std::fabs(det) < 1e-12)
+			return false;
+
+		y1 = (r1 * a22 - r2 * a12) / det;
+		y2 = (a11 * r2 - a12 * r1) / det;
+
+		// Steeper handles would only match the samples by swinging wildly
+		// between frames, e.g. across a jump
+		if (y1 < KEYFRAME_EASE_MIN || y1 > KEYFRAME_EASE_MAX ||
+			y2 < KEYFRAME_EASE_MIN || y2 > KEYFRAME_EASE_MAX)
+			return false;
+
+		return IsWithinTolerance(t0, v0, delta, span, checks, d, y1, y2, tolerance);
+	}
+
+	// Tries to replace keys [first..last] by one keyframe. 'checks' holds
+	// every value the track takes strictly inside the run: the inner keys
+	// and, where frames were skipped, the held value on the frame before the
+	// next key.
+	static bool FitSegment(
+		const keyframe_track& track,
+		std::uint32_t first,
+		std::uint32_t last,
+		const keyframe_track& checks,
+		double tolerance,
+		KeyframeSegment& seg)
+	{
+		const float* v0 = track.Value(first);
+		const float* v1 = track.Value(last);
+		double span = track.t[last] - track.t[first];
+		bool moving = false;
+
+		if (span <= 0)
+			return false;
+
+		seg.start = first;
+		seg.end = last;
+
+		for (int d = 0; d < track.dims; d++)
+		{
+			double delta = v1[d] - v0[d];
+			double y1, y2;
+
+			if (!FitEase(track.t[first], v0[d], delta, span, checks, d, tolerance, y1, y2))
+				return false;
+
+			if (std::fabs(delta) > tolerance)
+				moving = true;
+
+			seg.o[d].x = 1.0 / 3.0;
+			seg.o[d].y = y1;
+			seg.i[d].x = 2.0 / 3.0;
+			seg.i[d].y = y2;
+		}
+
+		// A static run is simply held
+		seg.hold = !moving;
+		return true;
+	}
+
+	static void AddHeldValue(
+		const keyframe_track& track,
+		std::uint32_t index,
+		keyframe_track& checks)
+	{
+		if (track.t[index + 1] - track.t[index] > 1)
+			checks.Add(track.t[index + 1] - 1, track.Value(index));
+	}
+
+	// Greedily grows each segment for as long as it still fits. A segment
+	// without inner keys stays a hold key, as sampled.
+	static void FitSegments(
+		const keyframe_track& track,
+		double tolerance,
+		std::vector<KeyframeSegment>& segments)
+	{
+		keyframe_track checks;
+		std::uint32_t first = 0;
+		std::uint32_t count = track.Size();
+
+		checks.dims = track.dims;
+		while (first + 1 < count)
+		{
+			KeyframeSegment seg = KeyframeSegment();
+			seg.start = first;
+			seg.end = first + 1;
+			seg.hold = true;
+
+			checks.Clear();
+			AddHeldValue(track, first, checks);
+
+			for (std::uint32_t last = first + 1; last + 1 < count; last++)
+			{
+				KeyframeSegment candidate;
+
+				checks.Add(track.t[last], track.Value(last));
+				AddHeldValue(track, last, checks);
+
+				if (!FitSegment(track, first, last + 1, checks, tolerance, candidate))
+					break;
+
+				seg = candidate;
+			}
+
+			segments.push_back(seg);
+			first = seg.end;
+		}
+	}
+
+	// Replaces the per frame keys of a track by the eased keyframes that
+	// stay within tolerance of them
+	static void ReduceTrack(keyframe_track& track, float tolerance, bool unwrapAngles)
+	{
+		if (track.Size() < 3)
+			return;
+
+		if (unwrapAngles)
+		{
+			// Keep rotation continuous so that a spin past 180 degrees can
+			// be interpolated instead of jumping back by a full turn
+			for (std::uint32_t j = 1; j < track.Size(); j++)
+			{
+				float prev = track.Value(j - 1)[0];
+				float& value = track.Value(j)[0];
+				while (value - prev > 180)
+					value -= 360;
+				while (value - prev < -180)
+					value += 360;
+			}
+		}
+
+		std::vector<KeyframeSegment> segments;
+		FitSegments(track, tolerance, segments);
+
+		keyframe_track reduced;
+		reduced.dims = track.dims;
+		reduced.ix = track.ix;
+		reduced.Reserve(segments.size() + 1);
+		reduced.o.reserve((segments.size() + 1) * track.dims);
+		reduced.i.reserve((segments.size() + 1) * track.dims);
+		for (std::uint32_t j = 0; j < segments.size(); j++)
+		{
+			const KeyframeSegment& seg = segments[j];
+
+			reduced.Add(track.t[seg.start], track.Value(seg.start));
+			reduced.h.back() = seg.hold ? 1 : 0;
+			reduced.o.insert(reduced.o.end(), seg.o, seg.o + track.dims);
+			reduced.i.insert(reduced.i.end(), seg.i, seg.i + track.dims);
+		}
+
+		reduced.Add(track.t.back(), track.Value(track.Size() - 1));
+		reduced.o.resize(reduced.Size() * track.dims);
+		reduced.i.resize(reduced.Size() * track.dims);
+
+		std::swap(track, reduced);
+	}
+
+
+	size_t LottieManager::GetNumofKeyframes() const
+	{
+		size_t count = 0;
+		for (size_t c = 0; c < GetNumofCompositions(); c++)
+		{
+			const std::vector<Layer *>& layers = GetCompositionAtIndex(c)->layers;
+			for (size_t i = 0; i < layers.size(); i++)
+			{
+				const layer_transform& ks = layers[i]->ks;
+				count += ks.p.Size() + ks.s.Size() + ks.r.Size() + layers[i]->morph.Size();
+			}
+		}
+		return count;
+	}
+
+
+	void LottieManager::ReduceKeyframes(float tolerance)
+	{
+		for (size_t c = 0; c < GetNumofCompositions(); c++)
+		{
+			if (!GetCompositionAtIndex(c)->cached)
+				ReduceKeyframes(*GetCompositionAtIndex(c), tolerance);
+		}
+	}
+
+
+	void LottieManager::ReduceKeyframes(composition& comp, float tolerance)
+	{
+		if (tolerance < 0)
+			return;
+
+		for (std::uint32_t i = 0; i < comp.layers.size(); i++)
+		{
+			layer_transform& ks = comp.layers[i]->ks;
+
+			ReduceTrack(ks.p, tolerance, false);
+			ReduceTrack(ks.s, tolerance, false);
+			ReduceTrack(ks.r, tolerance, true);
+		}
+	}
+
+
+	/* -------------------------------------------------- Shape tweens */
+
+	static bool IsSameColor(const color& a, const color& b)
+	{
+		return a.r == b.r && a.g == b.g && a.b == b.b && a.alpha == b.alpha;
+	}
+
+	template <typename T>
+	static bool IsSameGradient(const T& a, const T& b)
+	{
+		return a.type == b.type && a.o.k == b.o.k && a.g.p == b.g.p && a.g.k.color == b.g.k.color &&
+			a.s.k[0] == b.s.k[0] && a.s.k[1] == b.s.k[1] && a.e.k[0] == b.e.k[0] && a.e.k[1] == b.e.k[1];
+	}
+
+	static bool IsSameTransform(const layer_prop& a, const layer_prop& b)
+	{
+		if (a.p.size() != 1 || a.a.size() != 1 || a.s.size() != 1 || a.r.size() != 1 || a.o.size() != 1 ||
+			b.p.size() != 1 || b.a.size() != 1 || b.s.size() != 1 || b.r.size() != 1 || b.o.size() != 1)
+			return false;
+
+		return a.p[0].k[0] == b.p[0].k[0] && a.p[0].k[1] == b.p[0].k[1] &&
+			a.a[0].k[0] == b.a[0].k[0] && a.a[0].k[1] == b.a[0].k[1] &&
+			a.s[0].k[0] == b.s[0].k[0] && a.s[0].k[1] == b.s[0].k[1] &&
+			a.r[0].k == b.r[0].k && a.o[0].k == b.o[0].k;
+	}
+
+	// Everything a group draws but its path
+	static bool IsSameStyle(const group& a, const group& b)
+	{
+		const fill& fa = a.fl;
+		const fill& fb = b.fl;
+		if (fa.isfilled != fb.isfilled || fa.issolid != fb.issolid ||
+			fa.islinear_gradient != fb.islinear_gradient || fa.isradial_gradient != fb.isradial_gradient)
+			return false;
+		if (fa.issolid && !(IsSameColor(fa.solid.color1, fb.solid.color1) && fa.solid.o.k == fb.solid.o.k))
+			return false;
+		if (fa.islinear_gradient && !IsSameGradient(fa.linear, fb.linear))
+			return false;
+		if (fa.isradial_gradient && !(IsSameGradient(fa.radial.radial_fill, fb.radial.radial_fill) &&
+			fa.radial.h.k == fb.radial.h.k && fa.radial.a.k == fb.radial.a.k))
+			return false;
+
+		const stroke& sa = a.st;
+		const stroke& sb = b.st;
+		if (sa.hasstroke != sb.hasstroke)
+			return false;
+		if (sa.hasstroke)
+		{
+			if (sa.issolid != sb.issolid || sa.islinear_gradient != sb.islinear_gradient ||
+				sa.isradial_gradient != sb.isradial_gradient)
+				return false;
+			if (sa.solid.w.k != sb.solid.w.k || sa.solid.lc != sb.solid.lc ||
+				sa.solid.lj != sb.solid.lj || sa.solid.ml != sb.solid.ml)
+				return false;
+			if (sa.issolid && !(IsSameColor(sa.solid.color1, sb.solid.color1) && sa.solid.o.k == sb.solid.o.k))
+				return false;
+			if (sa.islinear_gradient && !IsSameGradient(sa.linear, sb.linear))
+				return false;
+			if (sa.isradial_gradient && !(IsSameGradient(sa.radial.radial_stroke, sb.radial.radial_stroke) &&
+				sa.radial.h.k == sb.radial.h.k && sa.radial.a.k == sb.radial.a.k))
+				return false;
+		}
+
+		return a.bm == b.bm && a.np == b.np && IsSameTransform(a.ks, b.ks);
+	}
+
+	// A shape layer that can be part of a tween: visible for at least a
+	// frame, with a static transform and only paths without holes
+	// (recognised rectangles and ellipses keep theirs)
+	static bool CanTween(const LottieManager& manager, const Layer* layer)
+	{
+		if (layer->ty != Shape || layer->op <= layer->ip)
+			return false;
+
+		if (layer->ks.p.IsAnimated() || layer->ks.s.IsAnimated() || layer->ks.r.IsAnimated())
+			return false;
+
+		const std::vector<group*>& groups = manager.GetGroupAtResourceId(layer->resourceId);
+		if (groups.empty())
+			return false;
+
+		for (size_t g = 0; g < groups.size(); g++)
+		{
+			if (groups[g]->sh.shp.v.empty() || !groups[g]->holes.empty())
+				return false;
+		}
+		return true;
+	}
+
+	// Whether segment j of a path is a curve rather than a line
+	static bool IsCurveSegment(const ks& path, std::uint32_t j)
+	{
+		std::uint32_t k = (j + 1) % path.v.size();
+		return path.o[j].x != 0 || path.o[j].y != 0 || path.i[k].x != 0 || path.i[k].y != 0;
+	}
+
+	// Whether two paths have the same topology: open or closed alike, the
+	// same vertex count and a line or a curve between the same vertices.
+	// Only then does vertex j of one correspond to vertex j of the other.
+	static bool IsSameTopology(const ks& a, const ks& b)
+	{
+		if (a.c != b.c || a.v.size() != b.v.size())
+			return false;
+
+		std::uint32_t size = a.v.size();
+		std::uint32_t segments = a.c ? size : size - 1;
+		for (std::uint32_t j = 0; j < segments; j++)
+		{
+			if (IsCurveSegment(a, j) != IsCurveSegment(b, j))
+				return false;
+		}
+		return true;
+	}
+
+	// Whether 'next' continues the tween of 'head': same place, same
+	// groups with the same styles and the same path topology, only the
+	// vertex positions differ
+	static bool CanMorph(const LottieManager& manager, const Layer* head, const Layer* next)
+	{
+		if (head->parent_ind != next->parent_ind ||
+			head->ks.p.v != next->ks.p.v || head->ks.s.v != next->ks.s.v || head->ks.r.v != next->ks.r.v)
+			return false;
+
+		const std::vector<group*>& groups = manager.GetGroupAtResourceId(head->resourceId);
+		const std::vector<group*>& nextGroups = manager.GetGroupAtResourceId(next->resourceId);
+		if (groups.size() != nextGroups.size())
+			return false;
+
+		for (size_t g = 0; g < groups.size(); g++)
+		{
+			if (!IsSameStyle(*groups[g], *nextGroups[g]) || !IsSameTopology(groups[g]->sh.shp, nextGroups[g]->sh.shp))
+				return false;
+		}
+		return true;
+	}
+
+	// The paths of 'layer' become the key of 'head' on the frame the layer
+	// was placed
+	static void AddPathKey(const LottieManager& manager, Layer* head, const Layer* layer)
+	{
+		const std::vector<group*>& groups = manager.GetGroupAtResourceId(layer->resourceId);
+		path_track& morph = head->morph;
+
+		morph.t.push_back((float)layer->ip);
+		morph.h.push_back(1);
+		morph.paths.resize(groups.size());
+		for (size_t g = 0; g < groups.size(); g++)
+		{
+			morph.paths[g].push_back(groups[g]->sh.shp);
+		}
+	}
+
+	static bool IsNearLerp(const coordinates& a, const coordinates& b, const coordinates& p, double s, double tolerance)
+	{
+		return std::fabs(a.x + (b.x - a.x) * s - p.x) <= tolerance &&
+			std::fabs(a.y + (b.y - a.y) * s - p.y) <= tolerance;
+	}
+
+	// Whether every path of 'key', as shown at 'time', is within tolerance
+	// of the linear move from key 'first' to key 'last'
+	static bool IsNearLerp(const path_track& morph, std::uint32_t first, std::uint32_t last, std::uint32_t key,
+		double time, double tolerance)
+	{
+		double s = (time - morph.t[first]) / (morph.t[last] - morph.t[first]);
+
+		for (size_t g = 0; g < morph.paths.size(); g++)
+		{
+			const ks& a = morph.paths[g][first];
+			const ks& b = morph.paths[g][last];
+			const ks& p = morph.paths[g][key];
+
+			for (size_t j = 0; j < p.v.size(); j++)
+			{
+				if (!IsNearLerp(a.v[j], b.v[j], p.v[j], s, tolerance) ||
+					!IsNearLerp(a.i[j], b.i[j], p.i[j], s, tolerance) ||
+					!IsNearLerp(a.o[j], b.o[j], p.o[j], s, tolerance))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	// Whether the keys strictly between 'first' and 'last', and the paths
+	// held on the frames before each next key, all fit a linear move. Keys
+	// on consecutive frames show nothing in between: they hold.
+	static bool IsLinearMorph(const path_track& morph, std::uint32_t first, std::uint32_t last, double tolerance)
+	{
+		if (last == first + 1 && morph.t[last] - morph.t[first] <= 1)
+			return false;
+
+		for (std::uint32_t k = first; k < last; k++)
+		{
+			if (k > first && !IsNearLerp(morph, first, last, k, morph.t[k], tolerance))
+				return false;
+			if (morph.t[k + 1] - morph.t[k] > 1 && !IsNearLerp(morph, first, last, k, morph.t[k + 1] - 1, tolerance))
+				return false;
+		}
+		return true;
+	}
+
+	// Keeps the keys a linear move cannot stand in for, greedily like the
+	// transform reduction
+	static void ReducePathTrack(path_track& morph, float tolerance)
+	{
+		std::vector<std::uint32_t> keys;
+		std::vector<std::uint8_t> holds;
+		std::uint32_t count = morph.Size();
+		std::uint32_t first = 0;
+
+		while (first + 1 < count)
+		{
+			std::uint32_t last = first + 1;
+			while (last + 1 < count && IsLinearMorph(morph, first, last + 1, tolerance))
+				last++;
+
+			keys.push_back(first);
+			holds.push_back(IsLinearMorph(morph, first, last, tolerance) ? 0 : 1);
+			first = last;
+		}
+		keys.push_back(count - 1);
+		holds.push_back(1);
+
+		path_track reduced;
+		reduced.h.swap(holds);
+		reduced.paths.resize(morph.paths.size());
+		for (size_t k = 0; k < keys.size(); k++)
+		{
+			reduced.t.push_back(morph.t[keys[k]]);
+			for (size_t g = 0; g < morph.paths.size(); g++)
+			{
+				reduced.paths[g].push_back(morph.paths[g][keys[k]]);
+			}
+		}
+		std::swap(morph, reduced);
+	}
+
+
+	void LottieManager::MergeShapeTweens(float tolerance)
+	{
+		for (size_t c = 0; c < GetNumofCompositions(); c++)
+		{
+			if (!GetCompositionAtIndex(c)->cached)
+				MergeShapeTweens(*GetCompositionAtIndex(c), tolerance);
+		}
+	}
+
+
+	void LottieManager::MergeShapeTweens(composition& comp, float tolerance)
+	{
+		std::vector<Layer*>& layers = comp.layers;
+
+		// Tween in progress at each depth, by the frame it ends on
+		std::map<std::pair<std::uint32_t, int>, Layer*> tweens;
+		std::vector<Layer*> heads;
+		std::vector<Layer*> kept;
+
+		kept.reserve(layers.size());
+		for (size_t i = 0; i < layers.size(); i++)
+		{
+			Layer* layer = layers[i];
+			if (!CanTween(*this, layer))
+			{
+				kept.push_back(layer);
+				continue;
+			}
+
+			std::map<std::pair<std::uint32_t, int>, Layer*>::iterator found =
+				tweens.find(std::make_pair(layer->ip, layer->placeafterobjectId));
+			if (found != tweens.end() && CanMorph(*this, found->second, layer))
+			{
+				Layer* head = found->second;
+				if (head->morph.Size() == 0)
+				{
+					AddPathKey(*this, head, head);
+					heads.push_back(head);
+				}
+				AddPathKey(*this, head, layer);
+				head->op = layer->op;
+				comp.objectId_layer.Insert(layer->objectId) = head;
+
+				tweens.erase(found);
+				tweens[std::make_pair(head->op, head->placeafterobjectId)] = head;
+				continue;
+			}
+
+			kept.push_back(layer);
+			tweens[std::make_pair(layer->op, layer->placeafterobjectId)] = layer;
+		}
+
+		if (heads.empty())
+			return;
+
+		for (size_t i = 0; i < heads.size(); i++)
+		{
+			if (tolerance >= 0)
+				ReducePathTrack(heads[i]->morph, tolerance);
+		}
+
+		// Number the remaining layers again and follow their parents
+		std::vector<std::uint32_t> indices(layers.size() + 1, 0);
+		for (size_t i = 0; i < kept.size(); i++)
+		{
+			if (kept[i]->ind < indices.size())
+				indices[kept[i]->ind] = i + 1;
+		}
+		for (size_t i = 0; i < kept.size(); i++)
+		{
+			kept[i]->ind = i + 1;
+			if (kept[i]->parent_ind != (std::uint32_t)INVALID_LAYER_INDEX &&
+				kept[i]->parent_ind < indices.size() && indices[kept[i]->parent_ind] != 0)
+				kept[i]->parent_ind = indices[kept[i]->parent_ind];
+		}
+
+		layers.swap(kept);
+	}
+
+
+	/* -------------------------------------------------- Static tracks */
+
+	static void CollapseTrack(keyframe_track& track)
+	{
+		if (!track.IsAnimated())
+			return;
+
+		for (std::uint32_t key = 1; key < track.Size(); key++)
+		{
+			if (!std::equal(track.Value(key), track.Value(key) + track.dims, track.Value(0)))
+				return;
+		}
+
+		float time = track.t[0];
+		float value[KEYFRAME_TRACK_MAX_DIMS];
+		std::copy(track.Value(0), track.Value(0) + track.dims, value);
+		track.Clear();
+		track.Add(time, value);
+	}
+
+	static bool IsSameCoordinates(const std::vector<coordinates>& a, const std::vector<coordinates>& b)
+	{
+		if (a.size() != b.size())
+			return false;
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			if (a[i].x != b[i].x || a[i].y != b[i].y)
+				return false;
+		}
+		return true;
+	}
+
+	static void CollapsePathTrack(path_track& morph)
+	{
+		if (!morph.IsAnimated())
+			return;
+
+		for (size_t g = 0; g < morph.paths.size(); g++)
+		{
+			const ks& first = morph.paths[g][0];
+			for (size_t k = 1; k < morph.paths[g].size(); k++)
+			{
+				const ks& path = morph.paths[g][k];
+				if (path.c != first.c || !IsSameCoordinates(path.v, first.v) ||
+					!IsSameCoordinates(path.i, first.i) || !IsSameCoordinates(path.o, first.o))
+					return;
+			}
+		}
+
+		morph.t.resize(1);
+		morph.h.resize(1);
+		for (size_t g = 0; g < morph.paths.size(); g++)
+			morph.paths[g].resize(1);
+	}
+
+
+	void LottieManager::CollapseStaticTracks()
+	{
+		for (size_t c = 0; c < GetNumofCompositions(); c++)
+		{
+			if (!GetCompositionAtIndex(c)->cached)
+				CollapseStaticTracks(*GetCompositionAtIndex(c));
+		}
+	}
+
+
+	void LottieManager::CollapseStaticTracks(composition& comp)
+	{
+		for (std::uint32_t i = 0; i < comp.layers.size(); i++)
+		{
+			layer_transform& ks = comp.layers[i]->ks;
+
+			CollapseTrack(ks.p);
+			CollapseTrack(ks.s);
+			CollapseTrack(ks.r);
+			CollapsePathTrack(comp.layers[i]->morph);
+		}
+	}
+
+
+	/* -------------------------------------------------- Compositions */
+
+	int LottieManager::GetNumofLayers() const
+	{
+		size_t count = 0;
+		for (size_t c = 0; c < GetNumofCompositions(); c++)
+			count += GetCompositionAtIndex(c)->layers.size();
+		return (int)count;
+	}
+
+	static void ShiftTrack(keyframe_track& track, float frames)
+	{
+		for (std::uint32_t key = 0; key < track.Size(); key++)
+			track.t[key] += frames;
+	}
+
+	void LottieManager::DefineComposition(composition * comp, int resourceId, const std::string& name, int frameCount)
+	{
+		std::vector<Layer *>& layers = comp->layers;
+
+		// The builder counts frames from the start of the scene, the symbol
+		// time starts at 0
+		if (m_sceneStart != 0)
+		{
+			for (size_t i = 0; i < layers.size(); i++)
+			{
+				Layer* layer = layers[i];
+				layer->ip -= m_sceneStart;
+				layer->op -= m_sceneStart;
+				ShiftTrack(layer->ks.p, (float)-m_sceneStart);
+				ShiftTrack(layer->ks.s, (float)-m_sceneStart);
+				ShiftTrack(layer->ks.r, (float)-m_sceneStart);
+			}
+		}
+
+		// Symbols are drawn around their registration point; until the
+		// writer measures the content, the precomp is twice the stage with
+		// the point at its centre
+		comp->left = -mStageWidth;
+		comp->top = -mStageHeight;
+		comp->width = 2 * mStageWidth;
+		comp->height = 2 * mStageHeight;
+
+		// The layers of the timeline already have the first layer as their
+		// parent: the null layer is put there
+		Layer * origin = m_layerArena.Create();
+		origin->ty = Null;
+		origin->ind = 1;
+		origin->parent_ind = INVALID_LAYER_INDEX;
+		origin->objectId = -1;
+		origin->resourceId = 0;
+		origin->placeafterobjectId = 0;
+		origin->nm = "Origin";
+		origin->op = frameCount;
+		const float pos[2] = { (float)-comp->left, (float)-comp->top };
+		origin->ks.p.Add(0, pos);
+		const float s[2] = { 100, 100 };
+		origin->ks.s.Add(0, s);
+		const float r = 0;
+		origin->ks.r.Add(0, &r);
+
+		layers.insert(layers.begin(), origin);
+		for (size_t i = 1; i < layers.size(); i++)
+			layers[i]->ind = i + 1;
+
+		comp->id = "comp_" + std::to_string(resourceId);
+		comp->nm = name;
+		comp->resourceId = resourceId;
+		comp->op = frameCount;
+		comp->objectId_layer.Clear();
+
+		m_compositions.push_back(comp);
+		resourceId_composition.Insert(resourceId) = comp;
+		m_composition = &m_mainComposition;
+	}
+
+	void LottieManager::SetCompositionBounds(composition * comp, double left, double top, double width, double height)
+	{
+		comp->left = left;
+		comp->top = top;
+		comp->width = width;
+		comp->height = height;
+
+		if (comp->layers.empty() || comp->layers[0]->objectId != -1)
+			return;
+
+		const float pos[2] = { (float)-left, (float)-top };
+		comp->layers[0]->ks.p.Clear();
+		comp->layers[0]->ks.p.Add(0, pos);
+	}
+
+	void LottieManager::AddToMainComposition(composition * comp)
+	{
+		std::vector<Layer *>& layers = m_mainComposition.layers;
+
+		for (size_t i = 0; i < comp->layers.size(); i++)
+		{
+			layers.push_back(comp->layers[i]);
+			layers.back()->ind = layers.size();
+		}
+		comp->layers.clear();
+		comp->objectId_layer.Clear();
+
+		// The root layer lasts as long as the scenes so far
+		Layer * const * root = m_mainComposition.objectId_layer.Find(-1);
+		if (root)
+			(*root)->op = m_op;
+
+		m_composition = &m_mainComposition;
+	}
+
+
 	
 
 